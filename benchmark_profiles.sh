@@ -0,0 +1,28 @@
+#!/bin/sh
+# Runs EngineBench on every workload profile of generate_synthetic_data.py.
+#   ./benchmark_profiles.sh [orders per profile] [EngineBench options...]
+# e.g. ./benchmark_profiles.sh 1000000 --book-type ladder --workers 2 --rate 500000
+# The order files are generated once per profile and size (fixed seeds, so they are the same on every
+# machine) and converted to the binary format, so the replay does not measure the CSV parser.
+# Every run appends one line to engine_bench.csv (or to the file given with --results).
+# BUILD_DIR (default src/build) and DATA_DIR (default bench_data) can be set in the environment.
+set -e
+
+ORDERS=${1:-1000000}
+[ $# -gt 0 ] && shift
+SCRIPT_DIR=$(cd "$(dirname "$0")" && pwd)
+BUILD_DIR=${BUILD_DIR:-$SCRIPT_DIR/src/build}
+DATA_DIR=${DATA_DIR:-$SCRIPT_DIR/bench_data}
+PROFILES="cancel-heavy crossing-heavy many-instruments hot-instrument market-storm"
+
+mkdir -p "$DATA_DIR"
+for profile in $PROFILES; do
+    csv_file="$DATA_DIR/$profile-$ORDERS.csv"
+    bin_file="$DATA_DIR/$profile-$ORDERS.bin"
+    if [ ! -f "$bin_file" ]; then
+        python3 "$SCRIPT_DIR/generate_synthetic_data.py" "$ORDERS" --profile "$profile" -o "$csv_file"
+        "$BUILD_DIR/OrderFileConverter" "$csv_file" "$bin_file"
+    fi
+    echo "== $profile ($ORDERS orders)"
+    "$BUILD_DIR/EngineBench" "$bin_file" --profile "$profile" "$@"
+done
@@ -12,17 +12,55 @@ SIDES = ["BUY", "SELL"]
 TYPES = ["LIMIT", "MARKET"]
 ACTIONS = ["NEW", "MODIFY", "CANCEL"]
 
-def generate_order_data(num_lines, output_target):
+# Named workload profiles (used by the end-to-end benchmark, see benchmark_profiles.sh).
+# - new / modify: probabilities of the NEW and MODIFY actions (CANCEL gets the rest)
+# - market: probability that a NEW order is a MARKET order
+# - instruments: number of instruments used
+# - hot: probability that an order goes to the first instrument (the "hot" one)
+# - spread: None = prices uniform in [50, 500] for every instrument (few crosses),
+#           otherwise prices within +/- spread around a fixed mid price per instrument (many crosses)
+# - seed: seed used when --seed is not given, so every profile is reproducible
+PROFILES = {
+    "default":          dict(new=0.70, modify=0.15, market=0.50, instruments=200,  hot=0.0, spread=None,  seed=None),
+    "cancel-heavy":     dict(new=0.45, modify=0.05, market=0.05, instruments=50,   hot=0.0, spread=0.02,  seed=1),
+    "crossing-heavy":   dict(new=0.85, modify=0.10, market=0.10, instruments=20,   hot=0.0, spread=0.005, seed=2),
+    "many-instruments": dict(new=0.70, modify=0.15, market=0.20, instruments=5000, hot=0.0, spread=0.02,  seed=3),
+    "hot-instrument":   dict(new=0.70, modify=0.15, market=0.20, instruments=200,  hot=0.9, spread=0.01,  seed=4),
+    "market-storm":     dict(new=0.90, modify=0.05, market=0.60, instruments=20,   hot=0.0, spread=0.01,  seed=5),
+}
+
+# first timestamp of the reproducible runs (the default profile starts at the current time)
+FIXED_START_TIMESTAMP = 1_700_000_000_000_000_000
+
+def generate_order_data(num_lines, output_target, profile=None, seeded=False):
     """
     Generates synthetic order data and writes it to the output_target.
     """
+    if profile is None:
+        profile = PROFILES["default"]
+    instruments = INSTRUMENTS if profile["instruments"] == len(INSTRUMENTS) \
+        else [f"INST{i:03}" for i in range(1, profile["instruments"] + 1)]
+    # fixed mid price of every instrument, for the profiles with a spread
+    mid_prices = {name: 50.0 + (index * 37) % 450 for index, name in enumerate(instruments)}
+
+    def pick_instrument():
+        if profile["hot"] > 0.0 and random.random() < profile["hot"]:
+            return instruments[0]
+        return random.choice(instruments)
+
+    def pick_base_price(name):
+        if profile["spread"] is None:
+            return random.uniform(50.0, 500.0)
+        mid = mid_prices[name]
+        return random.uniform(mid * (1.0 - profile["spread"]), mid * (1.0 + profile["spread"]))
+
     writer = csv.writer(output_target) 
     # Write header
     writer.writerow(["timestamp", "order_id", "instrument", "side", "type", "quantity", "price", "action"])
 
     # Initial values
     # Using nanoseconds for timestamp
-    current_timestamp = int(time.time() * 1_000_000_000) 
+    current_timestamp = FIXED_START_TIMESTAMP if seeded else int(time.time() * 1_000_000_000)
     order_id_counter = 1
     
     # Keep track of active orders to allow for plausible MODIFY/CANCEL actions
@@ -40,21 +78,21 @@ def generate_order_data(num_lines, output_target):
             action = "NEW"
         else:
             action_choice_rand = random.random()
-            if action_choice_rand < 0.70:  # 70% chance of NEW
+            if action_choice_rand < profile["new"]:  # 70% chance of NEW (default profile)
                 action = "NEW"
-            elif action_choice_rand < 0.85:  # 15% chance of MODIFY
+            elif action_choice_rand < profile["new"] + profile["modify"]:  # 15% chance of MODIFY
                 action = "MODIFY"
             else:  # 15% chance of CANCEL
                 action = "CANCEL"
         
 
         order_id_to_use = 0 # Will be set based on action
-        instrument = random.choice(INSTRUMENTS)
+        instrument = pick_instrument()
         side = random.choice(SIDES)
-        order_type = random.choice(TYPES)
+        order_type = "MARKET" if random.random() < profile["market"] else "LIMIT"
         quantity = random.randint(1, 200) * 5 
         
-        base_price = random.uniform(50.0, 500.0)
+        base_price = pick_base_price(instrument)
         price_tick = 0.01
         price = round(base_price / price_tick) * price_tick 
 
@@ -134,17 +172,33 @@ if __name__ == "__main__":
         type=str,
         help="Optional: Path to the output CSV file. If not provided, prints to stdout."
     )
+    parser.add_argument(
+        "--profile",
+        choices=sorted(PROFILES.keys()),
+        default="default",
+        help="Workload profile (mix of actions, instruments and prices)."
+    )
+    parser.add_argument(
+        "--seed",
+        type=int,
+        help="Seed of the random generator. Profiles other than 'default' have a fixed seed of their own."
+    )
 
     args = parser.parse_args()
+    profile = PROFILES[args.profile]
+    seed = args.seed if args.seed is not None else profile["seed"]
+    seeded = seed is not None
+    if seeded:
+        random.seed(seed)
 
     if args.output_file:
         try:
             with open(args.output_file, 'w', newline='') as outfile:
-                generate_order_data(args.num_lines, outfile) # Pass file object
+                generate_order_data(args.num_lines, outfile, profile, seeded) # Pass file object
             print(f"Successfully generated {args.num_lines} lines to {args.output_file}")
         except IOError as e:
             print(f"Error writing to file {args.output_file}: {e}")
             print("Falling back to generating data on stdout:")
-            generate_order_data(args.num_lines, sys.stdout) # Fallback to stdout
+            generate_order_data(args.num_lines, sys.stdout, profile, seeded) # Fallback to stdout
     else:
-        generate_order_data(args.num_lines, sys.stdout) # Pass sys.stdout
+        generate_order_data(args.num_lines, sys.stdout, profile, seeded) # Pass sys.stdout
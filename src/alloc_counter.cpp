@@ -0,0 +1,71 @@
+#include "alloc_counter.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Replacement of the global operator new / delete that counts the allocations.
+// The per-thread counter is a plain thread_local (no synchronisation on the hot path),
+// the global one is a relaxed atomic.
+
+namespace {
+thread_local unsigned long long tls_allocations = 0;
+std::atomic<unsigned long long> all_allocations{0};
+
+void* counted_malloc(std::size_t size) {
+    ++tls_allocations;
+    all_allocations.fetch_add(1, std::memory_order_relaxed);
+    // malloc(0) may return nullptr, operator new must return a unique pointer
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* counted_aligned_malloc(std::size_t size, std::align_val_t alignment) {
+    ++tls_allocations;
+    all_allocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t align = static_cast<std::size_t>(alignment);
+    // aligned_alloc needs a size that is a multiple of the alignment
+    std::size_t rounded_size = ((size == 0 ? 1 : size) + align - 1) / align * align;
+    void* ptr = std::aligned_alloc(align, rounded_size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+} // namespace
+
+namespace alloc_counter {
+
+unsigned long long thread_allocations() {
+    return tls_allocations;
+}
+
+unsigned long long total_allocations() {
+    return all_allocations.load(std::memory_order_relaxed);
+}
+
+} // namespace alloc_counter
+
+void* operator new(std::size_t size) { return counted_malloc(size); }
+void* operator new[](std::size_t size) { return counted_malloc(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try { return counted_malloc(size); } catch (...) { return nullptr; }
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    try { return counted_malloc(size); } catch (...) { return nullptr; }
+}
+void* operator new(std::size_t size, std::align_val_t alignment) { return counted_aligned_malloc(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return counted_aligned_malloc(size, alignment); }
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
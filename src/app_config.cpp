@@ -1,5 +1,9 @@
 #include "app_config.hpp"
 #include <iostream> // For std::cerr
+#include "worker_pool.hpp" // For parseCpuList
+#include "shard.hpp"       // For parseShardList
+#include "csv_simd.hpp"    // For csv_simd::parseLevel
+#include "output_file.hpp" // For parseOutputIo
 
 // Constructor implementation
 AppConfig::AppConfig(const std::string& program_description)
@@ -12,6 +16,12 @@ AppConfig::AppConfig(const std::string& program_description)
         .set_default(std::string("info")) // Default is "info"
         .type_string();
 
+    // Synchronous or asynchronous logging
+    parser_.add_flag({"--log-mode"})
+        .help("'sync' (each log call writes its line) or 'async' (the calls push a record into a per-thread ring, a background thread writes the lines).")
+        .set_default(std::string("sync"))
+        .type_string();
+
     // Log file
     parser_.add_flag({"--log-file"})
         .help("Path to the log file. If not specified or 'none', logs to stdout.")
@@ -28,6 +38,173 @@ AppConfig::AppConfig(const std::string& program_description)
         .help("Path for the order result output file.")
         .required(true); // This is a required positional argument
 
+    // Order book implementation
+    parser_.add_flag({"--book-type"})
+        .help("Order book implementation: 'map' (std::map of price levels) or 'ladder' (flat integer tick ladder).")
+        .set_default(std::string("map"))
+        .type_string();
+
+    // Where the pools of the books take their memory
+    parser_.add_flag({"--book-memory"})
+        .help("Memory of the pools of the books: 'heap' (plain allocations) or 'huge-pages' (2 MiB pages, for books with millions of resting orders).")
+        .set_default(std::string("heap"))
+        .type_string();
+
+    // Default tick size used to convert prices into integer ticks
+    parser_.add_flag({"--tick-size"})
+        .help("Default tick size of the instruments (prices are stored as integer multiples of it).")
+        .set_default(0.01)
+        .type_double();
+
+    // Per-instrument tick sizes
+    parser_.add_flag({"--tick-size-overrides"})
+        .help("Per-instrument tick sizes, e.g. 'AAPL=0.01,INST001=0.05'.")
+        .set_default(std::string(""))
+        .type_string();
+
+    // How the input file is read
+    parser_.add_flag({"--input-mode"})
+        .help("How the input CSV is read: 'mmap' (memory-mapped, zero-copy parser) or 'stream' (std::istream, line by line).")
+        .set_default(std::string("mmap"))
+        .type_string();
+
+    // SIMD level of the CSV tokenizer
+    parser_.add_flag({"--csv-simd"})
+        .help("SIMD level of the CSV tokenizer (mmap input mode): 'auto' (best one of the cpu, or the ENGINE_CSV_SIMD build option), 'avx2', 'sse4.2' or 'scalar'.")
+        .set_default(std::string("auto"))
+        .type_string();
+
+    // Parallel parsing of the input file
+    parser_.add_flag({"--reader-threads"})
+        .help("Number of threads parsing the input file in chunks (mmap input mode only, the order of the file is kept).")
+        .set_default(1)
+        .type_int();
+
+    // Format of the input and output files
+    parser_.add_flag({"--input-format"})
+        .help("Format of the order input file: 'csv' or 'binary' (written by OrderFileConverter).")
+        .set_default(std::string("csv"))
+        .type_string();
+
+    parser_.add_flag({"--output-format"})
+        .help("Format of the order result output file: 'csv' or 'binary' (OrderFileConverter turns it back into CSV).")
+        .set_default(std::string("csv"))
+        .type_string();
+
+    // How the CSV output files are written
+    parser_.add_flag({"--output-io"})
+        .help("How the CSV output buffers are written: 'sync' (write() from the writer thread), 'pwrite' (double buffer, a background thread writes) or 'io_uring' (double buffer, asynchronous writes through io_uring, 'pwrite' if the kernel refuses it).")
+        .set_default(std::string("sync"))
+        .type_string();
+    parser_.add_flag({"--output-cache"})
+        .help("'buffered' (through the page cache) or 'direct' (O_DIRECT with 4 KiB aligned writes, when the file system allows it).")
+        .set_default(std::string("buffered"))
+        .type_string();
+
+    // How the threads of the pipeline wait for their queues
+    parser_.add_flag({"--wait-strategy"})
+        .help("How idle pipeline threads wait: 'spin' (busy spin), 'yield' (spin then yield) or 'park' (spin then sleep until notified).")
+        .set_default(std::string("park"))
+        .type_string();
+
+    // Matching worker threads
+    parser_.add_flag({"--workers"})
+        .help("Number of matching threads, the instruments are sharded onto them (0 = one per core).")
+        .set_default(0)
+        .type_int();
+
+    // CPU pinning of the matching threads
+    parser_.add_flag({"--worker-cpus"})
+        .help("Pin the matching threads to these cpus, e.g. '2,3,4,5' (worker i uses the i-th cpu, cycling). Empty = no pinning.")
+        .set_default(std::string(""))
+        .type_string();
+
+    // Periodic dump of the pipeline statistics (the summary at the end is always logged)
+    parser_.add_flag({"--stats-interval"})
+        .help("Log the queue depths, counters and latency histograms of the pipeline every N milliseconds (0 = only the final summary).")
+        .set_default(0)
+        .type_int();
+
+    // Snapshots of the books
+    parser_.add_flag({"--snapshot-in"})
+        .help("Load the books from this snapshot at startup, and skip the input orders it already contains.")
+        .set_default(std::string(""))
+        .type_string();
+    parser_.add_flag({"--snapshot-out"})
+        .help("Write a snapshot of the books to this file at the end of the run (and every --snapshot-every orders).")
+        .set_default(std::string(""))
+        .type_string();
+    parser_.add_flag({"--snapshot-every"})
+        .help("Also write the --snapshot-out snapshot every N input orders while the engine runs (0 = only at the end).")
+        .set_default(0)
+        .type_int();
+
+    // Write-ahead journal of the input orders
+    parser_.add_flag({"--journal"})
+        .help("Journal every input order to this file before it is matched, and replay it at startup (see README).")
+        .set_default(std::string(""))
+        .type_string();
+    parser_.add_flag({"--journal-commit-us"})
+        .help("Latency budget of a journal group commit, in microseconds: one fdatasync covers the orders of this window (default: 1000).")
+        .set_default(1000)
+        .type_int();
+
+    // Level 2 market data of the books
+    parser_.add_flag({"--market-data"})
+        .help("Write the level 2 market data of the books (price level updates, BBO, snapshots) to this CSV file.")
+        .set_default(std::string(""))
+        .type_string();
+    parser_.add_flag({"--market-data-snapshot-every"})
+        .help("Publish the full depth of a book every N of its orders in the market data (0 = never, default: 10000).")
+        .set_default(10000)
+        .type_int();
+
+    // Pre-trade risk checks and self-trade prevention in the books
+    parser_.add_flag({"--risk-limits"})
+        .help("Default limits of every account, e.g. 'max_quantity=1000,max_notional=250000,max_open_orders=50,price_band=0.05' (0 = no limit). Turns the risk checks on.")
+        .set_default(std::string(""))
+        .type_string();
+    parser_.add_flag({"--risk-account-limits"})
+        .help("CSV file 'account,max_quantity,max_notional,max_open_orders' with the limits of some accounts. Turns the risk checks on.")
+        .set_default(std::string(""))
+        .type_string();
+    parser_.add_flag({"--risk-max-accounts"})
+        .help("Size of the per-account tables of the risk checks: account ids go from 0 to N-1 (default: 4096).")
+        .set_default(4096)
+        .type_int();
+    parser_.add_flag({"--self-trade-prevention"})
+        .help("What happens when two orders of one account would trade: 'none', 'cancel-resting', 'cancel-incoming' or 'cancel-both'.")
+        .set_default(std::string("none"))
+        .type_string();
+
+    // Network gateway instead of the input file
+    parser_.add_flag({"--gateway-tcp"})
+        .help("Take the orders from TCP clients on this port instead of the input file (pass '-' as input file). 0 = off.")
+        .set_default(0)
+        .type_int();
+    parser_.add_flag({"--gateway-udp"})
+        .help("Take the orders from UDP datagrams on this port instead of the input file. 0 = off.")
+        .set_default(0)
+        .type_int();
+    parser_.add_flag({"--gateway-multicast"})
+        .help("Multicast group joined by the --gateway-udp socket (e.g. 239.1.1.1).")
+        .set_default(std::string(""))
+        .type_string();
+    parser_.add_flag({"--gateway-address"})
+        .help("Local address of the gateway sockets, and interface of the multicast group.")
+        .set_default(std::string("0.0.0.0"))
+        .type_string();
+
+    // Instruments partitioned over several processes (shard.hpp)
+    parser_.add_flag({"--shards"})
+        .help("Front-end mode: match in these processes instead of local workers, e.g. 'shm:book0,shm:book1,tcp:10.0.0.2:7001'. Each one owns the books of its share of the instruments.")
+        .set_default(std::string(""))
+        .type_string();
+    parser_.add_flag({"--shard-listen"})
+        .help("Matching process mode: wait for a front-end on 'shm:NAME' or 'tcp:[ADDRESS:]PORT' and match its orders (pass '- -' as input and output files).")
+        .set_default(std::string(""))
+        .type_string();
+
     // Number of jobs
     // parser_.add_flag({"-q", "--queue-size"})
     //     .help("maximum number of jobs in queue between parser and matcher (default: 1000)")
@@ -45,9 +222,134 @@ bool AppConfig::parse(int argc, char* argv[]) {
         // If parse_args didn't exit (due to --help) and didn't throw, retrieve values.
         log_level_ = parser_.get<std::string>("log_level"); // dest name from --log-level
         log_file_ = parser_.get<std::string>("log_file");   // dest name from --log-file
+        log_mode_ = parser_.get<std::string>("log_mode");
         order_input_file_ = parser_.get<std::string>("order_input_file");
         order_result_output_file_ = parser_.get<std::string>("order_result_output_file");
         queue_size_ = 1000; // FIXME later parser_.get<long int>("queue_size");                  
+        book_type_ = parser_.get<std::string>("book_type");
+        book_memory_ = parser_.get<std::string>("book_memory");
+        tick_size_ = parser_.get<double>("tick_size");
+        tick_size_overrides_ = parser_.get<std::string>("tick_size_overrides");
+        wait_strategy_ = parser_.get<std::string>("wait_strategy");
+        input_mode_ = parser_.get<std::string>("input_mode");
+        csv_simd_ = parser_.get<std::string>("csv_simd");
+        reader_threads_ = parser_.get<int>("reader_threads");
+        input_format_ = parser_.get<std::string>("input_format");
+        output_format_ = parser_.get<std::string>("output_format");
+        output_io_ = parser_.get<std::string>("output_io");
+        output_cache_ = parser_.get<std::string>("output_cache");
+        worker_count_ = parser_.get<int>("workers");
+        std::string worker_cpus = parser_.get<std::string>("worker_cpus");
+        stats_interval_ = parser_.get<int>("stats_interval");
+        snapshot_in_ = parser_.get<std::string>("snapshot_in");
+        snapshot_out_ = parser_.get<std::string>("snapshot_out");
+        snapshot_every_ = parser_.get<int>("snapshot_every");
+        journal_ = parser_.get<std::string>("journal");
+        journal_commit_us_ = parser_.get<int>("journal_commit_us");
+        market_data_ = parser_.get<std::string>("market_data");
+        market_data_snapshot_every_ = parser_.get<int>("market_data_snapshot_every");
+        gateway_tcp_port_ = parser_.get<int>("gateway_tcp");
+        gateway_udp_port_ = parser_.get<int>("gateway_udp");
+        gateway_multicast_ = parser_.get<std::string>("gateway_multicast");
+        gateway_address_ = parser_.get<std::string>("gateway_address");
+        risk_limits_ = parser_.get<std::string>("risk_limits");
+        risk_account_limits_ = parser_.get<std::string>("risk_account_limits");
+        risk_max_accounts_ = parser_.get<int>("risk_max_accounts");
+        self_trade_prevention_ = parser_.get<std::string>("self_trade_prevention");
+        std::string shards = parser_.get<std::string>("shards");
+        shard_listen_ = parser_.get<std::string>("shard_listen");
+
+        if (log_mode_ != "sync" && log_mode_ != "async") {
+            throw std::runtime_error("Invalid value for --log-mode: '" + log_mode_ + "'. Expected 'sync' or 'async'.");
+        }
+        if (book_type_ != "map" && book_type_ != "ladder") {
+            throw std::runtime_error("Invalid value for --book-type: '" + book_type_ + "'. Expected 'map' or 'ladder'.");
+        }
+        if (book_memory_ != "heap" && book_memory_ != "huge-pages") {
+            throw std::runtime_error("Invalid value for --book-memory: '" + book_memory_ + "'. Expected 'heap' or 'huge-pages'.");
+        }
+        if (!(tick_size_ > 0.0)) {
+            throw std::runtime_error("Invalid value for --tick-size: it must be positive.");
+        }
+
+        if (input_mode_ != "mmap" && input_mode_ != "stream") {
+            throw std::runtime_error("Invalid value for --input-mode: '" + input_mode_ + "'. Expected 'mmap' or 'stream'.");
+        }
+        csv_simd::Level csv_level;
+        if (csv_simd_ != "auto" && !csv_simd::parseLevel(csv_simd_, csv_level)) {
+            throw std::runtime_error("Invalid value for --csv-simd: '" + csv_simd_ + "'. Expected 'auto', 'avx2', 'sse4.2' or 'scalar'.");
+        }
+        if (input_format_ != "csv" && input_format_ != "binary") {
+            throw std::runtime_error("Invalid value for --input-format: '" + input_format_ + "'. Expected 'csv' or 'binary'.");
+        }
+        if (output_format_ != "csv" && output_format_ != "binary") {
+            throw std::runtime_error("Invalid value for --output-format: '" + output_format_ + "'. Expected 'csv' or 'binary'.");
+        }
+        OutputIo output_io;
+        if (!parseOutputIo(output_io_, output_io)) {
+            throw std::runtime_error("Invalid value for --output-io: '" + output_io_ + "'. Expected 'sync', 'pwrite' or 'io_uring'.");
+        }
+        if (output_cache_ != "buffered" && output_cache_ != "direct") {
+            throw std::runtime_error("Invalid value for --output-cache: '" + output_cache_ + "'. Expected 'buffered' or 'direct'.");
+        }
+        if (reader_threads_ < 1) {
+            throw std::runtime_error("Invalid value for --reader-threads: it must be at least 1.");
+        }
+        if (!parseWaitStrategyType(wait_strategy_)) {
+            throw std::runtime_error("Invalid value for --wait-strategy: '" + wait_strategy_ + "'. Expected 'spin', 'yield' or 'park'.");
+        }
+
+        if (worker_count_ < 0) {
+            throw std::runtime_error("Invalid value for --workers: it cannot be negative.");
+        }
+        if (!parseCpuList(worker_cpus, worker_cpus_)) {
+            throw std::runtime_error("Invalid value for --worker-cpus: '" + worker_cpus + "'. Expected a list like '2,3,4'.");
+        }
+
+        if (stats_interval_ < 0) {
+            throw std::runtime_error("Invalid value for --stats-interval: it cannot be negative.");
+        }
+        if (snapshot_every_ < 0) {
+            throw std::runtime_error("Invalid value for --snapshot-every: it cannot be negative.");
+        }
+        if (snapshot_every_ > 0 && snapshot_out_.empty()) {
+            throw std::runtime_error("--snapshot-every needs --snapshot-out.");
+        }
+        if (journal_commit_us_ < 0) {
+            throw std::runtime_error("Invalid value for --journal-commit-us: it cannot be negative.");
+        }
+        if (market_data_snapshot_every_ < 0) {
+            throw std::runtime_error("Invalid value for --market-data-snapshot-every: it cannot be negative.");
+        }
+        if (gateway_tcp_port_ < 0 || gateway_tcp_port_ > 65535 || gateway_udp_port_ < 0 || gateway_udp_port_ > 65535) {
+            throw std::runtime_error("Invalid gateway port: expected 0 (off) to 65535.");
+        }
+        if (!gateway_multicast_.empty() && gateway_udp_port_ == 0) {
+            throw std::runtime_error("--gateway-multicast needs --gateway-udp.");
+        }
+        if (risk_max_accounts_ < 1) {
+            throw std::runtime_error("Invalid value for --risk-max-accounts: it must be at least 1.");
+        }
+        if (!RiskConfig().parseSelfTradePrevention(self_trade_prevention_)) {
+            throw std::runtime_error("Invalid value for --self-trade-prevention: '" + self_trade_prevention_ +
+                                     "'. Expected 'none', 'cancel-resting', 'cancel-incoming' or 'cancel-both'.");
+        }
+        if (is_gateway_enabled() && !journal_.empty()) {
+            // the journal finds the orders again by their position in the input file
+            throw std::runtime_error("--journal cannot be used with the gateway.");
+        }
+        if (!shards.empty() && !parseShardList(shards, shards_)) {
+            throw std::runtime_error("Invalid value for --shards: '" + shards + "'. Expected a list like 'shm:book0,tcp:host:7001'.");
+        }
+        if (!shards_.empty() && (!snapshot_in_.empty() || !snapshot_out_.empty())) {
+            // the books live in the matching processes
+            throw std::runtime_error("--snapshot-in and --snapshot-out cannot be used with --shards.");
+        }
+        if (!shard_listen_.empty() && (!shards_.empty() || is_gateway_enabled() || !journal_.empty() ||
+                                       !snapshot_in_.empty() || !snapshot_out_.empty() || !market_data_.empty())) {
+            // a matching process only gets orders from its front-end, which does all of that
+            throw std::runtime_error("--shard-listen cannot be used with --shards, the gateway, --journal, the snapshots or --market-data (they are options of the front-end).");
+        }
 
         successfully_parsed_ = true;
         return true;
@@ -76,6 +378,11 @@ const std::string& AppConfig::get_log_file() const {
     return log_file_;
 }
 
+bool AppConfig::is_async_logging() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return log_mode_ == "async";
+}
+
 bool AppConfig::is_log_to_stdout() const {
     if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
     return log_file_.empty() || log_file_ == "none"; // Consider "none" also as stdout
@@ -96,3 +403,167 @@ long int AppConfig::get_queue_size() const {
     return queue_size_;
 }
 
+
+const std::string& AppConfig::get_book_type() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return book_type_;
+}
+
+double AppConfig::get_tick_size() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return tick_size_;
+}
+
+const std::string& AppConfig::get_tick_size_overrides() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return tick_size_overrides_;
+}
+
+WaitStrategyType AppConfig::get_wait_strategy() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return *parseWaitStrategyType(wait_strategy_);
+}
+
+size_t AppConfig::get_worker_count() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return static_cast<size_t>(worker_count_);
+}
+
+const std::vector<int>& AppConfig::get_worker_cpus() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return worker_cpus_;
+}
+
+const std::string& AppConfig::get_input_mode() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return input_mode_;
+}
+
+size_t AppConfig::get_reader_threads() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return static_cast<size_t>(reader_threads_);
+}
+
+const std::string& AppConfig::get_input_format() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return input_format_;
+}
+
+const std::string& AppConfig::get_output_format() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return output_format_;
+}
+
+const std::string& AppConfig::get_output_io() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return output_io_;
+}
+
+bool AppConfig::is_output_direct() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return output_cache_ == "direct";
+}
+
+int AppConfig::get_stats_interval() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return stats_interval_;
+}
+
+const std::string& AppConfig::get_snapshot_in() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return snapshot_in_;
+}
+
+const std::string& AppConfig::get_snapshot_out() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return snapshot_out_;
+}
+
+unsigned long long AppConfig::get_snapshot_every() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return static_cast<unsigned long long>(snapshot_every_);
+}
+
+const std::string& AppConfig::get_journal() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return journal_;
+}
+
+const std::string& AppConfig::get_market_data() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return market_data_;
+}
+
+unsigned long long AppConfig::get_market_data_snapshot_every() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return static_cast<unsigned long long>(market_data_snapshot_every_);
+}
+
+bool AppConfig::is_gateway_enabled() const {
+    return gateway_tcp_port_ > 0 || gateway_udp_port_ > 0;
+}
+
+int AppConfig::get_gateway_tcp_port() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return gateway_tcp_port_;
+}
+
+int AppConfig::get_gateway_udp_port() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return gateway_udp_port_;
+}
+
+const std::string& AppConfig::get_gateway_multicast() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return gateway_multicast_;
+}
+
+const std::string& AppConfig::get_gateway_address() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return gateway_address_;
+}
+
+const std::string& AppConfig::get_risk_limits() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return risk_limits_;
+}
+
+const std::string& AppConfig::get_risk_account_limits() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return risk_account_limits_;
+}
+
+uint32_t AppConfig::get_risk_max_accounts() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return static_cast<uint32_t>(risk_max_accounts_);
+}
+
+const std::string& AppConfig::get_self_trade_prevention() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return self_trade_prevention_;
+}
+
+const std::vector<std::string>& AppConfig::get_shards() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return shards_;
+}
+
+const std::string& AppConfig::get_csv_simd() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return csv_simd_;
+}
+
+const std::string& AppConfig::get_book_memory() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return book_memory_;
+}
+
+const std::string& AppConfig::get_shard_listen() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return shard_listen_;
+}
+
+int AppConfig::get_journal_commit_us() const {
+    if (!successfully_parsed_) throw std::runtime_error("AppConfig: Arguments not parsed or parsing failed.");
+    return journal_commit_us_;
+}
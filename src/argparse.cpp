@@ -197,7 +197,8 @@ void ArgumentParser::parse_args(int argc, char* argv[]) {
         if (token == "--") { double_dash = true; continue; }
         if (!double_dash && (token == "-h" || token == "--help")) { print_help(); std::exit(0); }
 
-        if (!double_dash && token.rfind("-", 0) == 0) {
+        // a lone "-" is a positional value (e.g. no input file)
+        if (!double_dash && token.rfind("-", 0) == 0 && token != "-") {
             auto it = arg_map_by_flag_.find(token);
             if (it == arg_map_by_flag_.end()) {
                 if (token.length() > 2 && token[0] == '-' && token[1] != '-') {
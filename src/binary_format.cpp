@@ -0,0 +1,405 @@
+#include "binary_format.hpp"
+#include "pipeline_stats.hpp"
+
+#include <algorithm>
+#include <cmath>     // For std::llround
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+// sections start at a multiple of 8 bytes
+static constexpr uint64_t kSectionAlignment = 8;
+
+static uint64_t alignUp(uint64_t offset) {
+    return (offset + kSectionAlignment - 1) / kSectionAlignment * kSectionAlignment;
+}
+
+static uint32_t recordSizeOf(BinaryFileKind kind) {
+    switch (kind) {
+        case BinaryFileKind::ORDERS: return static_cast<uint32_t>(sizeof(BinaryOrderRecord));
+        case BinaryFileKind::EXECUTION_REPORTS: return static_cast<uint32_t>(sizeof(BinaryReportRecord));
+        case BinaryFileKind::BOOK_SNAPSHOT: return static_cast<uint32_t>(sizeof(BinaryRestingOrderRecord));
+    }
+    return 0;
+}
+
+static const char* kindToString(BinaryFileKind kind) {
+    switch (kind) {
+        case BinaryFileKind::ORDERS: return "orders";
+        case BinaryFileKind::EXECUTION_REPORTS: return "execution reports";
+        case BinaryFileKind::BOOK_SNAPSHOT: return "a book snapshot";
+    }
+    return "unknown records";
+}
+
+BinaryOrderRecord toBinaryRecord(const Order& order) {
+    BinaryOrderRecord record{};
+    record.timestamp = order.timestamp;
+    record.order_id = order.order_id;
+    record.quantity = order.quantity;
+    record.price = order.price;
+    record.display_quantity = order.display_quantity;
+    record.symbol_id = order.symbol_id;
+    record.side = static_cast<uint8_t>(order.side);
+    record.type = static_cast<uint8_t>(order.type);
+    record.action = static_cast<uint8_t>(order.action);
+    record.flags = packOrderFlags(order.time_in_force, order.post_only);
+    record.account_id = order.account_id;
+    return record;
+}
+
+BinaryReportRecord toBinaryRecord(const ExecutionReport& report) {
+    BinaryReportRecord record{};
+    record.timestamp = report.timestamp;
+    record.order_id = report.order_id;
+    record.quantity = report.quantity;
+    record.price = report.price;
+    record.executed_quantity = report.executed_quantity;
+    record.execution_price = report.execution_price;
+    record.counterparty_id = report.counterparty_id;
+    record.symbol_id = report.symbol_id;
+    record.side = static_cast<uint8_t>(report.side);
+    record.type = static_cast<uint8_t>(report.type);
+    record.action = static_cast<uint8_t>(report.action);
+    record.status = static_cast<uint8_t>(report.status);
+    return record;
+}
+
+ExecutionReport fromBinaryRecord(const BinaryReportRecord& record) {
+    ExecutionReport report;
+    report.sequence = 0; // the order of the file is the order of the output
+    report.timestamp = record.timestamp;
+    report.order_id = record.order_id;
+    report.quantity = record.quantity;
+    report.price = record.price;
+    report.executed_quantity = record.executed_quantity;
+    report.execution_price = record.execution_price;
+    report.counterparty_id = record.counterparty_id;
+    report.symbol_id = record.symbol_id;
+    report.side = static_cast<Side>(record.side);
+    report.type = static_cast<OrderType>(record.type);
+    report.action = static_cast<OrderAction>(record.action);
+    report.status = static_cast<OrderStatus>(record.status);
+    return report;
+}
+
+BinaryRestingOrderRecord toSnapshotRecord(const Order& resting_order) {
+    BinaryRestingOrderRecord record{};
+    record.timestamp = resting_order.timestamp;
+    record.order_id = resting_order.order_id;
+    record.quantity = resting_order.quantity;
+    record.remaining_quantity = resting_order.remaining_quantity;
+    record.cumulative_executed_quantity = resting_order.cumulative_executed_quantity;
+    record.price = resting_order.price;
+    record.display_quantity = resting_order.display_quantity;
+    record.hidden_quantity = resting_order.hidden_quantity;
+    record.symbol_id = resting_order.symbol_id;
+    record.side = static_cast<uint8_t>(resting_order.side);
+    record.type = static_cast<uint8_t>(resting_order.type);
+    record.action = static_cast<uint8_t>(resting_order.action);
+    record.status = static_cast<uint8_t>(resting_order.status);
+    record.account_id = resting_order.account_id;
+    return record;
+}
+
+// check everything of the header that does not depend on the size of the file
+static bool checkHeader(const BinaryFileHeader& header, std::string& error) {
+    if (std::memcmp(header.magic, kBinaryMagic, sizeof(kBinaryMagic)) != 0) {
+        error = "not a binary order/report file";
+        return false;
+    }
+    if (header.version != kBinaryFormatVersion) {
+        error = "unsupported binary format version " + std::to_string(header.version) +
+                " (this engine reads version " + std::to_string(kBinaryFormatVersion) + ")";
+        return false;
+    }
+    if (header.kind != static_cast<uint32_t>(BinaryFileKind::ORDERS) &&
+        header.kind != static_cast<uint32_t>(BinaryFileKind::EXECUTION_REPORTS) &&
+        header.kind != static_cast<uint32_t>(BinaryFileKind::BOOK_SNAPSHOT)) {
+        error = "unknown kind of binary file " + std::to_string(header.kind);
+        return false;
+    }
+    if (header.record_size != recordSizeOf(static_cast<BinaryFileKind>(header.kind))) {
+        error = "unexpected record size " + std::to_string(header.record_size);
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------
+// writer
+
+BinaryFileWriter::BinaryFileWriter(BinaryFileKind kind, uint32_t record_size)
+    : kind_(kind), record_size_(record_size) {
+}
+
+BinaryFileWriter::~BinaryFileWriter() {
+    if (fd_ >= 0) {
+        ::close(fd_); // close() was not called: the file has no valid header and is unusable
+    }
+}
+
+bool BinaryFileWriter::open(const std::string& path, std::string& error) {
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    buffer_.resize(kBufferBytes); // only allocated for the writer really used
+    // room for the header, it is written over by close() once the counts are known
+    BinaryFileHeader placeholder{};
+    appendBytes(&placeholder, sizeof(placeholder));
+    return true;
+}
+
+void BinaryFileWriter::appendRecord(const void* record) {
+    appendBytes(record, record_size_);
+    record_count_++;
+}
+
+void BinaryFileWriter::appendBytes(const void* bytes, size_t size) {
+    const char* data = static_cast<const char*>(bytes);
+    while (size > 0) {
+        if (used_ == buffer_.size()) {
+            writeBuffer();
+        }
+        size_t chunk = std::min(size, buffer_.size() - used_);
+        std::memcpy(buffer_.data() + used_, data, chunk);
+        used_ += chunk;
+        data += chunk;
+        size -= chunk;
+        file_size_ += chunk;
+    }
+}
+
+void BinaryFileWriter::writeBuffer() {
+    size_t written = 0;
+    while (written < used_ && fd_ >= 0 && write_errno_ == 0) {
+        ssize_t result = ::write(fd_, buffer_.data() + written, used_ - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            write_errno_ = errno; // the rest of the file is dropped, close() reports it
+            break;
+        }
+        written += static_cast<size_t>(result);
+    }
+    used_ = 0;
+}
+
+bool BinaryFileWriter::close(const SymbolTable& symbols, std::string& error) {
+    if (fd_ < 0) {
+        error = "file is not open";
+        return false;
+    }
+
+    // symbol table, after the records
+    static constexpr char kPadding[kSectionAlignment] = {};
+    appendBytes(kPadding, static_cast<size_t>(alignUp(file_size_) - file_size_));
+    const uint64_t symbols_offset = file_size_;
+    const uint32_t symbol_count = static_cast<uint32_t>(symbols.size());
+    for (uint32_t symbol_id = 0; symbol_id < symbol_count; ++symbol_id) {
+        const std::string& name = symbols.name(symbol_id);
+        uint32_t length = static_cast<uint32_t>(name.size());
+        appendBytes(&length, sizeof(length));
+        appendBytes(name.data(), name.size());
+    }
+    writeBuffer();
+
+    // and the real header at the start of the file
+    BinaryFileHeader header{};
+    std::memcpy(header.magic, kBinaryMagic, sizeof(kBinaryMagic));
+    header.version = kBinaryFormatVersion;
+    header.kind = static_cast<uint32_t>(kind_);
+    header.record_size = record_size_;
+    header.symbol_count = symbol_count;
+    header.record_count = record_count_;
+    header.records_offset = sizeof(BinaryFileHeader);
+    header.symbols_offset = symbols_offset;
+    header.input_offset = input_offset_;
+    if (write_errno_ == 0 && ::pwrite(fd_, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+        write_errno_ = errno != 0 ? errno : EIO;
+    }
+
+    bool ok = write_errno_ == 0;
+    if (!ok) {
+        error = std::strerror(write_errno_);
+    }
+    if (::close(fd_) != 0 && ok) {
+        error = std::strerror(errno);
+        ok = false;
+    }
+    fd_ = -1;
+    return ok;
+}
+
+BinaryReportWriter::BinaryReportWriter(const SymbolTable& symbols)
+    : symbols_(symbols), file_(BinaryFileKind::EXECUTION_REPORTS, static_cast<uint32_t>(sizeof(BinaryReportRecord))) {
+}
+
+// ---------------------------------------------------------------------------------------------
+// reader
+
+bool BinaryFileReader::hasMagic(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    char magic[sizeof(kBinaryMagic)];
+    ssize_t result = ::read(fd, magic, sizeof(magic));
+    ::close(fd);
+    return result == static_cast<ssize_t>(sizeof(magic)) && std::memcmp(magic, kBinaryMagic, sizeof(magic)) == 0;
+}
+
+bool BinaryFileReader::readKind(const std::string& path, BinaryFileKind& kind, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    BinaryFileHeader header{};
+    ssize_t result = ::read(fd, &header, sizeof(header));
+    ::close(fd);
+    if (result != static_cast<ssize_t>(sizeof(header))) {
+        error = "not a binary order/report file";
+        return false;
+    }
+    if (!checkHeader(header, error)) {
+        return false;
+    }
+    kind = static_cast<BinaryFileKind>(header.kind);
+    return true;
+}
+
+bool BinaryFileReader::open(const std::string& path, BinaryFileKind expected_kind, std::string& error) {
+    if (!file_.open(path, error)) {
+        return false;
+    }
+    const std::string_view contents = file_.contents();
+    if (contents.size() < sizeof(BinaryFileHeader)) {
+        error = "file too small for a binary header";
+        return false;
+    }
+    std::memcpy(&header_, contents.data(), sizeof(header_));
+    if (!checkHeader(header_, error)) {
+        return false;
+    }
+    if (header_.kind != static_cast<uint32_t>(expected_kind)) {
+        error = std::string("this binary file does not contain ") + kindToString(expected_kind);
+        return false;
+    }
+
+    // every section must be inside the file (sizes are checked without overflowing)
+    const uint64_t file_size = contents.size();
+    if (header_.records_offset > file_size ||
+        header_.record_count > (file_size - header_.records_offset) / header_.record_size ||
+        header_.symbols_offset > file_size) {
+        error = "truncated or corrupted binary file";
+        return false;
+    }
+    records_ = contents.data() + header_.records_offset;
+
+    symbols_.clear();
+    symbols_.reserve(header_.symbol_count);
+    uint64_t position = header_.symbols_offset;
+    for (uint32_t i = 0; i < header_.symbol_count; ++i) {
+        uint32_t length = 0;
+        if (file_size - position < sizeof(length)) {
+            error = "truncated symbol table";
+            return false;
+        }
+        std::memcpy(&length, contents.data() + position, sizeof(length));
+        position += sizeof(length);
+        if (file_size - position < length) {
+            error = "truncated symbol table";
+            return false;
+        }
+        symbols_.push_back(contents.substr(static_cast<size_t>(position), length));
+        position += length;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------
+// orders of the engine
+
+bool readOrdersFromBinaryFile(const std::string& path, Logger& logger, OrderQueue& order_queue,
+                              const TickSizeTable& tick_sizes, SymbolTable& symbols,
+                              LatencyHistogram* parse_latency) {
+    // orders are pushed to the queue by batches
+    static constexpr size_t kPushBatchSize = 64;
+
+    BinaryFileReader file;
+    std::string error;
+    if (!file.open(path, BinaryFileKind::ORDERS, error)) {
+        logger.error("Cannot read binary order file '", path, "': ", error);
+        return false;
+    }
+    logger.info("Starting to read ", file.recordCount(), " orders from binary file (",
+                file.symbols().size(), " instruments)...");
+
+    // symbol id of the file -> id in the engine, and the tick size of each instrument
+    std::vector<uint32_t> symbol_ids;
+    std::vector<double> symbol_tick_sizes;
+    for (std::string_view name : file.symbols()) {
+        std::string instrument(name);
+        symbol_ids.push_back(symbols.intern(instrument));
+        symbol_tick_sizes.push_back(tick_sizes.tick_size_for(instrument));
+    }
+
+    std::vector<Order> batch(kPushBatchSize);
+    size_t batch_size = 0;
+    long int orders_read = 0;
+    BatchTimer parse_timer(parse_latency);
+    parse_timer.start();
+    for (size_t i = 0; i < file.recordCount(); ++i) {
+        const BinaryOrderRecord record = file.record<BinaryOrderRecord>(i);
+        Order& order = batch[batch_size];
+        order = Order();
+        // the converter only writes valid orders, but the file may come from anywhere
+        if (record.symbol_id >= symbol_ids.size() ||
+            record.side > static_cast<uint8_t>(Side::SELL) ||
+            record.type > static_cast<uint8_t>(OrderType::MARKET) ||
+            record.action > static_cast<uint8_t>(OrderAction::CANCEL) ||
+            !unpackOrderFlags(record.flags, order.time_in_force, order.post_only)) {
+            logger.warn("Skipping invalid binary order record number ", i, " (order id ", record.order_id, ")");
+            continue;
+        }
+
+        order.timestamp = record.timestamp;
+        order.order_id = record.order_id;
+        order.symbol_id = symbol_ids[record.symbol_id];
+        order.side = static_cast<Side>(record.side);
+        order.type = static_cast<OrderType>(record.type);
+        order.quantity = record.quantity;
+        order.price = record.price;
+        // same conversion as the CSV parsers (market orders keep 0 ticks)
+        if (order.type == OrderType::LIMIT) {
+            order.price_ticks = std::llround(order.price / symbol_tick_sizes[record.symbol_id]);
+        }
+        order.action = static_cast<OrderAction>(record.action);
+        order.display_quantity = record.display_quantity;
+        order.account_id = record.account_id;
+        if (const char* attributes_error = orderAttributesError(order)) {
+            logger.warn("Skipping binary order record number ", i, " (order id ", record.order_id, "): ", attributes_error);
+            continue;
+        }
+        order.remaining_quantity = order.quantity;
+        order.cumulative_executed_quantity = 0;
+        order.status = OrderStatus::UNKNOWN;
+        orders_read++;
+
+        if (++batch_size == kPushBatchSize) {
+            parse_timer.stop(batch_size);
+            order_queue.push_batch(batch.data(), batch_size); // waits while the queue is full
+            batch_size = 0;
+            parse_timer.start();
+        }
+    }
+    parse_timer.stop(batch_size);
+    order_queue.push_batch(batch.data(), batch_size);
+
+    logger.info("Finished reading binary orders. Orders read: ", orders_read);
+    return true;
+}
@@ -0,0 +1,112 @@
+#include "book_snapshot.hpp"
+#include "binary_format.hpp"
+
+#include <cerrno>
+#include <cmath>   // For std::llround
+#include <cstdio>  // For std::rename
+#include <cstring> // For std::strerror
+#include <vector>
+
+// this file saves the books into a snapshot file and loads them back
+
+bool writeBookSnapshot(const std::string& path, const WorkerPool& worker_pool, const SymbolTable& symbols,
+                       uint64_t input_offset, std::string& error) {
+    const std::string temporary_path = path + ".tmp";
+    BinaryFileWriter writer(BinaryFileKind::BOOK_SNAPSHOT, static_cast<uint32_t>(sizeof(BinaryRestingOrderRecord)));
+    if (!writer.open(temporary_path, error)) {
+        return false;
+    }
+
+    // book by book in symbol id order, so the file does not depend on the number of workers
+    std::vector<Order> resting_orders;
+    const size_t symbol_count = symbols.size();
+    for (size_t symbol_id = 0; symbol_id < symbol_count; ++symbol_id) {
+        const auto& books = worker_pool.getWorker(worker_pool.workerIndexFor(static_cast<uint32_t>(symbol_id))).getBooks();
+        if (symbol_id >= books.size() || !books[symbol_id]) {
+            continue; // no order of this instrument yet
+        }
+        resting_orders.clear();
+        books[symbol_id]->collectRestingOrders(resting_orders);
+        for (const Order& order : resting_orders) {
+            BinaryRestingOrderRecord record = toSnapshotRecord(order);
+            writer.appendRecord(&record);
+        }
+    }
+    writer.setInputOffset(input_offset);
+    if (!writer.close(symbols, error)) {
+        std::remove(temporary_path.c_str());
+        return false;
+    }
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool loadBookSnapshot(const std::string& path, WorkerPool& worker_pool, const TickSizeTable& tick_sizes,
+                      SymbolTable& symbols, uint64_t& input_offset, Logger& logger) {
+    BinaryFileReader file;
+    std::string error;
+    if (!file.open(path, BinaryFileKind::BOOK_SNAPSHOT, error)) {
+        logger.error("Cannot read book snapshot '", path, "': ", error);
+        return false;
+    }
+
+    // every record is checked before the first one is restored, so a bad file leaves the books empty
+    for (size_t i = 0; i < file.recordCount(); ++i) {
+        const BinaryRestingOrderRecord record = file.record<BinaryRestingOrderRecord>(i);
+        if (record.symbol_id >= file.symbols().size() ||
+            record.side > static_cast<uint8_t>(Side::SELL) ||
+            record.type != static_cast<uint8_t>(OrderType::LIMIT) || // only LIMIT orders rest in a book
+            record.action > static_cast<uint8_t>(OrderAction::CANCEL) ||
+            record.status > static_cast<uint8_t>(OrderStatus::UNKNOWN) ||
+            record.remaining_quantity + record.cumulative_executed_quantity != record.quantity ||
+            (record.hidden_quantity > 0 && record.hidden_quantity >= record.remaining_quantity)) { // an iceberg shows something
+            logger.error("Cannot read book snapshot '", path, "': invalid resting order record number ", i,
+                         " (order id ", record.order_id, ")");
+            return false;
+        }
+    }
+
+    // symbol id of the file -> id in the engine, and the tick size of each instrument
+    std::vector<uint32_t> symbol_ids;
+    std::vector<double> symbol_tick_sizes;
+    for (std::string_view name : file.symbols()) {
+        std::string instrument(name);
+        symbol_ids.push_back(symbols.intern(instrument));
+        symbol_tick_sizes.push_back(tick_sizes.tick_size_for(instrument));
+    }
+
+    size_t restored = 0;
+    for (size_t i = 0; i < file.recordCount(); ++i) {
+        const BinaryRestingOrderRecord record = file.record<BinaryRestingOrderRecord>(i);
+        Order order;
+        order.timestamp = record.timestamp;
+        order.order_id = record.order_id;
+        order.symbol_id = symbol_ids[record.symbol_id];
+        order.side = static_cast<Side>(record.side);
+        order.type = static_cast<OrderType>(record.type);
+        order.action = static_cast<OrderAction>(record.action);
+        order.status = static_cast<OrderStatus>(record.status);
+        order.quantity = record.quantity;
+        order.price = record.price;
+        // same conversion as the parsers, so the restored orders match the new ones tick for tick
+        order.price_ticks = std::llround(order.price / symbol_tick_sizes[record.symbol_id]);
+        order.remaining_quantity = record.remaining_quantity;
+        order.cumulative_executed_quantity = record.cumulative_executed_quantity;
+        order.display_quantity = record.display_quantity;
+        order.hidden_quantity = record.hidden_quantity;
+        order.account_id = record.account_id;
+        if (!worker_pool.restoreRestingOrder(order)) {
+            logger.warn("Resting order ", order.order_id, " of the snapshot does not fit in the book of ",
+                        symbols.name(order.symbol_id), ", it is dropped.");
+            continue;
+        }
+        restored++;
+    }
+    input_offset = file.header().input_offset;
+    logger.info("Restored ", restored, " resting orders of ", file.symbols().size(), " instruments from snapshot ",
+                path, " (input offset ", input_offset, ")");
+    return true;
+}
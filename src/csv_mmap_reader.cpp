@@ -0,0 +1,723 @@
+#include "csv_mmap_reader.hpp"
+#include "pipeline_stats.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <thread>
+#include <cmath>     // For std::llround, std::fabs
+#include <cstring>   // For std::memchr, std::strerror
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// this class reads the order file through a memory mapping, without copying the lines or the fields
+
+MappedFile::~MappedFile() {
+    if (mapping_ != nullptr) {
+        munmap(mapping_, size_);
+    }
+}
+
+bool MappedFile::open(const std::string& path, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        error = std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    // pipes, sockets... cannot be mapped
+    if (!S_ISREG(file_stat.st_mode)) {
+        error = "not a regular file";
+        ::close(fd);
+        return false;
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ == 0) {
+        ::close(fd); // nothing to map, contents() is an empty view
+        return true;
+    }
+    void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference to the file
+    if (mapping == MAP_FAILED) {
+        error = std::strerror(errno);
+        size_ = 0;
+        return false;
+    }
+    // the file is read once from the start to the end: let the kernel read ahead aggressively
+    madvise(mapping, size_, MADV_SEQUENTIAL);
+    mapping_ = mapping;
+    data_ = static_cast<const char*>(mapping);
+    return true;
+}
+
+// same characters as std::isspace in the "C" locale
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+std::string_view trimView(std::string_view text) {
+    size_t start = 0;
+    size_t end = text.size();
+    while (start < end && isBlank(text[start])) {
+        start++;
+    }
+    while (end > start && isBlank(text[end - 1])) {
+        end--;
+    }
+    return text.substr(start, end - start);
+}
+
+// the keywords of the side, type, action and extended order type columns, matched case insensitively as one
+// word each (replaces toUpper(...) == "BUY")
+namespace keywords {
+constexpr csv_simd::KeywordToken kBuy = csv_simd::keyword("BUY");
+constexpr csv_simd::KeywordToken kSell = csv_simd::keyword("SELL");
+constexpr csv_simd::KeywordToken kLimit = csv_simd::keyword("LIMIT");
+constexpr csv_simd::KeywordToken kMarket = csv_simd::keyword("MARKET");
+constexpr csv_simd::KeywordToken kNew = csv_simd::keyword("NEW");
+constexpr csv_simd::KeywordToken kModify = csv_simd::keyword("MODIFY");
+constexpr csv_simd::KeywordToken kCancel = csv_simd::keyword("CANCEL");
+constexpr csv_simd::KeywordToken kGtc = csv_simd::keyword("GTC");
+constexpr csv_simd::KeywordToken kIoc = csv_simd::keyword("IOC");
+constexpr csv_simd::KeywordToken kFok = csv_simd::keyword("FOK");
+constexpr csv_simd::KeywordToken kN = csv_simd::keyword("N");
+constexpr csv_simd::KeywordToken kNo = csv_simd::keyword("NO");
+constexpr csv_simd::KeywordToken kFalse = csv_simd::keyword("FALSE");
+constexpr csv_simd::KeywordToken kY = csv_simd::keyword("Y");
+constexpr csv_simd::KeywordToken kYes = csv_simd::keyword("YES");
+constexpr csv_simd::KeywordToken kTrue = csv_simd::keyword("TRUE");
+} // namespace keywords
+
+// Number conversions with the same rules as std::stoull / std::stoll / std::stod on a trimmed field:
+// an optional sign, then the longest valid prefix (trailing characters are ignored)
+enum class NumberStatus { OK, INVALID, OUT_OF_RANGE };
+
+static NumberStatus toStatus(std::errc ec) {
+    if (ec == std::errc::invalid_argument) return NumberStatus::INVALID;
+    if (ec == std::errc::result_out_of_range) return NumberStatus::OUT_OF_RANGE;
+    return NumberStatus::OK;
+}
+
+static NumberStatus parseUnsigned(std::string_view text, unsigned long long& value) {
+    const char* first = text.data();
+    const char* last = first + text.size();
+    bool negative = false;
+    if (first != last && (*first == '+' || *first == '-')) {
+        negative = (*first == '-');
+        ++first;
+    }
+    NumberStatus status = toStatus(std::from_chars(first, last, value).ec);
+    // strtoull accepts a minus sign and wraps the value around, so does this
+    if (status == NumberStatus::OK && negative) {
+        value = 0ULL - value;
+    }
+    return status;
+}
+
+static NumberStatus parseSigned(std::string_view text, long long& value) {
+    const char* first = text.data();
+    const char* last = first + text.size();
+    if (first != last && *first == '+') {
+        ++first;
+        if (first == last || *first < '0' || *first > '9') {
+            return NumberStatus::INVALID; // "+-5"
+        }
+    }
+    return toStatus(std::from_chars(first, last, value).ec);
+}
+
+static NumberStatus parseDouble(std::string_view text, double& value) {
+    const char* first = text.data();
+    const char* last = first + text.size();
+    if (first != last && *first == '+') {
+        ++first;
+        if (first == last || *first == '-' || *first == '+') {
+            return NumberStatus::INVALID;
+        }
+    }
+    return toStatus(std::from_chars(first, last, value).ec);
+}
+
+// Fast paths for the fields made only of digits (and one '.' for a price), which is every field of a normal
+// file: the digits are converted with csv_simd::parseDigits and give the same value as from_chars. Anything
+// else (a sign, an exponent, too many digits, an invalid field) goes to the exact conversions above.
+static constexpr uint64_t kPowersOf10[] = {1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+                                           100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+                                           1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+                                           1000000000000000ULL, 10000000000000000ULL};
+
+// up to 19 digits (always below 2^64): the last 16 digits, then the ones in front of them
+static bool parseDigitField(csv_simd::Level level, std::string_view text, uint64_t& value) {
+    const size_t size = text.size();
+    if (size == 0 || size > 19) {
+        return false;
+    }
+    const size_t low_digits = std::min<size_t>(size, 16);
+    uint64_t low = 0;
+    uint64_t high = 0;
+    if (!csv_simd::parseDigits(level, text.data() + size - low_digits, low_digits, low)) {
+        return false;
+    }
+    if (size > low_digits && !csv_simd::parseDigits(level, text.data(), size - low_digits, high)) {
+        return false;
+    }
+    value = high * kPowersOf10[16] + low;
+    return true;
+}
+
+static NumberStatus parseUnsignedField(csv_simd::Level level, std::string_view text, unsigned long long& value) {
+    uint64_t digits_value = 0;
+    if (parseDigitField(level, text, digits_value)) {
+        value = digits_value;
+        return NumberStatus::OK;
+    }
+    return parseUnsigned(text, value);
+}
+
+static NumberStatus parseSignedField(csv_simd::Level level, std::string_view text, long long& value) {
+    uint64_t digits_value = 0;
+    if (text.size() <= 18 && parseDigitField(level, text, digits_value)) { // 18 digits always fit a long long
+        value = static_cast<long long>(digits_value);
+        return NumberStatus::OK;
+    }
+    return parseSigned(text, value);
+}
+
+// "123.45": the digits without the dot are an exact integer below 2^53 and 10^decimals an exact double, so their
+// quotient, rounded once by the division, is the correctly rounded value from_chars gives
+static NumberStatus parseDoubleField(csv_simd::Level level, std::string_view text, double& value) {
+    const size_t dot = text.find('.');
+    const size_t integer_digits = (dot == std::string_view::npos) ? text.size() : dot;
+    const size_t decimals = (dot == std::string_view::npos) ? 0 : text.size() - dot - 1;
+    uint64_t integer_part = 0;
+    uint64_t decimal_part = 0;
+    if (integer_digits >= 1 && integer_digits + decimals <= 19 && decimals <= 16 &&
+        parseDigitField(level, text.substr(0, integer_digits), integer_part) &&
+        (decimals == 0 || parseDigitField(level, text.substr(dot + 1), decimal_part))) {
+        const uint64_t mantissa = integer_part * kPowersOf10[decimals] + decimal_part;
+        if (mantissa <= (1ULL << 53)) {
+            value = static_cast<double>(mantissa) / static_cast<double>(kPowersOf10[decimals]);
+            return NumberStatus::OK;
+        }
+    }
+    return parseDouble(text, value);
+}
+
+CsvLineScanner::CsvLineScanner(std::string_view text, csv_simd::Level level) : text_(text), level_(level) {
+    loadBlock(0);
+}
+
+void CsvLineScanner::loadBlock(size_t block_start) {
+    block_start_ = block_start;
+    if (block_start + 64 <= text_.size()) {
+        const csv_simd::BlockMasks masks = csv_simd::classifyBlock(level_, text_.data() + block_start);
+        commas_ = masks.commas;
+        newlines_ = masks.newlines;
+        return;
+    }
+    // the end of the text: never read past it
+    char tail[64] = {};
+    if (block_start < text_.size()) {
+        std::memcpy(tail, text_.data() + block_start, text_.size() - block_start);
+    }
+    const csv_simd::BlockMasks masks = csv_simd::classifyBlock(level_, tail);
+    commas_ = masks.commas;
+    newlines_ = masks.newlines;
+}
+
+bool CsvLineScanner::nextLine(std::string_view& line, std::vector<const char*>& commas) {
+    if (position_ >= text_.size()) {
+        return false;
+    }
+    commas.clear();
+    const size_t line_start = position_;
+    auto take_commas = [&](uint64_t mask) {
+        for (; mask != 0; mask &= mask - 1) {
+            commas.push_back(text_.data() + block_start_ + static_cast<size_t>(__builtin_ctzll(mask)));
+        }
+    };
+    while (true) {
+        if (newlines_ != 0) {
+            const size_t bit = static_cast<size_t>(__builtin_ctzll(newlines_));
+            const uint64_t before_newline = (uint64_t(1) << bit) - 1;
+            take_commas(commas_ & before_newline);
+            commas_ &= ~before_newline;
+            newlines_ &= newlines_ - 1;
+            const size_t line_end = block_start_ + bit;
+            line = text_.substr(line_start, line_end - line_start);
+            position_ = line_end + 1;
+            return true;
+        }
+        take_commas(commas_);
+        commas_ = 0;
+        if (block_start_ + 64 >= text_.size()) {
+            // last line, without a '\n'
+            line = text_.substr(line_start);
+            position_ = text_.size();
+            return true;
+        }
+        loadBlock(block_start_ + 64);
+    }
+}
+
+FastOrderParser::FastOrderParser(const TickSizeTable& tick_sizes, SymbolTable& symbols, Logger& logger)
+    : tick_sizes_(tick_sizes), symbols_(symbols), logger_(logger), level_(csv_simd::activeLevel()) {
+    columns_.position.fill(CsvColumnIndex::kMissing);
+}
+
+bool FastOrderParser::parseHeader(std::string_view header_line) {
+    static constexpr std::array<std::string_view, CsvColumnIndex::COLUMN_COUNT> kColumnNames = {
+        "timestamp", "order_id", "instrument", "side", "type", "quantity", "price", "action",
+        "time_in_force", "post_only", "display_quantity", "account"};
+
+    columns_.position.fill(CsvColumnIndex::kMissing);
+    // names already seen, to count the distinct columns like the header map of readOrdersFromStream
+    std::vector<std::string_view> names;
+    size_t field_start = 0;
+    size_t current_index = 0;
+    while (field_start < header_line.size()) {
+        size_t comma = header_line.find(',', field_start);
+        size_t field_end = (comma == std::string_view::npos) ? header_line.size() : comma;
+        std::string_view name = trimView(header_line.substr(field_start, field_end - field_start));
+        if (name.empty()) {
+            logger_.warn("Empty column name found in header at index ", current_index, ". Original header: '", header_line, "'");
+        }
+        bool already_seen = false;
+        for (std::string_view seen : names) {
+            already_seen = already_seen || (seen == name);
+        }
+        if (!already_seen) {
+            names.push_back(name);
+        }
+        // a repeated name points to its last column, like header_map[name] = index
+        for (size_t column = 0; column < CsvColumnIndex::COLUMN_COUNT; ++column) {
+            if (name == kColumnNames[column]) {
+                columns_.position[column] = current_index;
+            }
+        }
+        current_index++;
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        field_start = comma + 1;
+    }
+    columns_.field_count = names.size();
+    if (columns_.field_count == 0) {
+        logger_.critical("CSV header could not be parsed (all fields might be empty or missing). Aborting.");
+        return false;
+    }
+
+    // every column but the price and the extended order types is mandatory: without one of them no line could be parsed
+    bool all_mandatory_present = true;
+    for (size_t column = 0; column < CsvColumnIndex::COLUMN_COUNT; ++column) {
+        if (!CsvColumnIndex::isOptional(column) && columns_.position[column] == CsvColumnIndex::kMissing) {
+            logger_.critical("Mandatory column '", kColumnNames[column], "' not found in CSV header '", header_line, "'.");
+            all_mandatory_present = false;
+        }
+    }
+    if (!all_mandatory_present) {
+        return false;
+    }
+    logger_.info("Parsed header. Number of columns: ", columns_.field_count);
+    return true;
+}
+
+const FastOrderParser::SymbolInfo& FastOrderParser::symbolFor(std::string_view instrument) {
+    const SymbolInfo* cached = symbol_cache_.find(instrument);
+    if (cached != nullptr) {
+        return *cached;
+    }
+    // first time this parser sees the instrument: the only allocations of the parsing
+    std::string name(instrument);
+    SymbolInfo info{symbols_.intern(name), tick_sizes_.tick_size_for(name)};
+    return symbol_cache_.insert_or_assign(instrument, info);
+}
+
+bool FastOrderParser::parseLine(std::string_view line, const std::vector<const char*>& commas, long long line_number,
+                                Order& order) {
+    // split on the commas like std::getline(..., ','): a trailing comma does not make an extra empty field
+    fields_.clear();
+    const char* field_start = line.data();
+    for (const char* comma : commas) {
+        fields_.push_back(trimView(std::string_view(field_start, static_cast<size_t>(comma - field_start))));
+        field_start = comma + 1;
+    }
+    const char* line_end = line.data() + line.size();
+    if (field_start < line_end) {
+        fields_.push_back(trimView(std::string_view(field_start, static_cast<size_t>(line_end - field_start))));
+    }
+    if (fields_.size() != columns_.field_count) {
+        logger_.warn("Malformed data line (field count ", fields_.size(), " does not match header count ", columns_.field_count,
+                     ") at line ", line_number, ". Original line: '", line, "'");
+        return false;
+    }
+    // with repeated header names a column can point after the last field of the line
+    for (size_t column = 0; column < CsvColumnIndex::COLUMN_COUNT; ++column) {
+        size_t field_position = columns_.position[column];
+        if (!CsvColumnIndex::isOptional(column) && field_position >= fields_.size()) {
+            logger_.warn("Column index ", field_position, " is out of bounds for line ", line_number, " (", fields_.size(), " fields).");
+            return false;
+        }
+    }
+    auto field = [&](CsvColumnIndex::Column column) { return fields_[columns_.position[column]]; };
+    const bool has_price = columns_.position[CsvColumnIndex::PRICE] < fields_.size();
+
+    order = Order();
+
+    std::string_view text = field(CsvColumnIndex::TIMESTAMP);
+    NumberStatus status = parseUnsignedField(level_, text, order.timestamp);
+    if (status != NumberStatus::OK) {
+        logger_.error("Field 'timestamp' with value '", text, "' cannot be converted: ",
+                      status == NumberStatus::INVALID ? "invalid argument" : "out of range", ". Original line: '", line, "'");
+        return false;
+    }
+
+    text = field(CsvColumnIndex::ORDER_ID);
+    status = parseSignedField(level_, text, order.order_id);
+    if (status != NumberStatus::OK) {
+        logger_.error("Field 'order_id' with value '", text, "' cannot be converted: ",
+                      status == NumberStatus::INVALID ? "invalid argument" : "out of range", ". Original line: '", line, "'");
+        return false;
+    }
+
+    const SymbolInfo& symbol = symbolFor(field(CsvColumnIndex::INSTRUMENT));
+    order.symbol_id = symbol.symbol_id;
+
+    text = field(CsvColumnIndex::SIDE);
+    csv_simd::KeywordToken word = csv_simd::token(text);
+    if (word == keywords::kBuy) {
+        order.side = Side::BUY;
+    } else if (word == keywords::kSell) {
+        order.side = Side::SELL;
+    } else {
+        logger_.warn("Invalid 'side' value: '", text, "'. Expected BUY or SELL. Original line: '", line, "'");
+        return false;
+    }
+
+    text = field(CsvColumnIndex::TYPE);
+    word = csv_simd::token(text);
+    if (word == keywords::kLimit) {
+        order.type = OrderType::LIMIT;
+    } else if (word == keywords::kMarket) {
+        order.type = OrderType::MARKET;
+    } else {
+        logger_.warn("Invalid 'type' value: '", text, "'. Expected LIMIT or MARKET. Original line: '", line, "'");
+        return false;
+    }
+
+    text = field(CsvColumnIndex::QUANTITY);
+    status = parseUnsignedField(level_, text, order.quantity);
+    if (status != NumberStatus::OK) {
+        logger_.error("Field 'quantity' with value '", text, "' cannot be converted: ",
+                      status == NumberStatus::INVALID ? "invalid argument" : "out of range", ". Original line: '", line, "'");
+        return false;
+    }
+
+    // the action is read before the price so the price warnings know it
+    // (this does not change which lines are accepted)
+    std::string_view action_text = field(CsvColumnIndex::ACTION);
+    OrderAction action = OrderAction::UNKNOWN;
+    word = csv_simd::token(action_text);
+    if (word == keywords::kNew) {
+        action = OrderAction::NEW;
+    } else if (word == keywords::kModify) {
+        action = OrderAction::MODIFY;
+    } else if (word == keywords::kCancel) {
+        action = OrderAction::CANCEL;
+    }
+    if (order.quantity == 0 && (action == OrderAction::NEW || action == OrderAction::MODIFY)) {
+        logger_.warn("Field 'quantity' is zero for a NEW/MODIFY action. This might be invalid. Original line: '", line, "'");
+    }
+
+    if (!has_price) {
+        if (order.type == OrderType::LIMIT && action == OrderAction::NEW) {
+            logger_.warn("Field 'price' missing for NEW LIMIT order, price set to 0. Original line: '", line, "'");
+        }
+        order.price = 0.0;
+    } else if (order.type == OrderType::MARKET) {
+        // the market order is executed at the prices of the book, its own price is ignored
+        order.price = 0.0;
+        text = field(CsvColumnIndex::PRICE);
+        if (!text.empty() && text != "0" && text != "0.0") {
+            LOG_DEBUG(logger_, "Price field value '", text, "' ignored for MARKET order. Original line: '", line, "'");
+        }
+    } else {
+        text = field(CsvColumnIndex::PRICE);
+        status = parseDoubleField(level_, text, order.price);
+        if (status != NumberStatus::OK) {
+            logger_.error("Field 'price' with value '", text, "' cannot be converted: ",
+                          status == NumberStatus::INVALID ? "invalid argument" : "out of range", ". Original line: '", line, "'");
+            return false;
+        }
+        if (order.price <= 0 && action == OrderAction::NEW) {
+            logger_.warn("Field 'price' for NEW LIMIT order is zero or negative ('", text, "'). This might be unintentional. Original line: '", line, "'");
+        }
+        // convert the price once into integer ticks, the books compare and index prices with it
+        order.price_ticks = std::llround(order.price / symbol.tick_size);
+        if (std::fabs(static_cast<double>(order.price_ticks) * symbol.tick_size - order.price) > symbol.tick_size * 1e-6) {
+            logger_.warn("Field 'price' value '", text, "' is not a multiple of the tick size ", symbol.tick_size,
+                         " and is rounded to the nearest tick. Original line: '", line, "'");
+        }
+    }
+
+    if (action == OrderAction::UNKNOWN) {
+        logger_.warn("Invalid 'action' value: '", action_text, "'. Expected NEW, MODIFY, or CANCEL. Original line: '", line, "'");
+        return false;
+    }
+    order.action = action;
+
+    // the optional columns of the extended order types (same rules as parseCsvLineToOrder)
+    auto optional_field = [&](CsvColumnIndex::Column column, std::string_view& value) {
+        const size_t field_position = columns_.position[column];
+        if (field_position >= fields_.size()) {
+            return false;
+        }
+        value = fields_[field_position];
+        return true;
+    };
+    if (optional_field(CsvColumnIndex::TIME_IN_FORCE, text)) {
+        word = csv_simd::token(text);
+        if (text.empty() || word == keywords::kGtc) {
+            order.time_in_force = TimeInForce::GTC;
+        } else if (word == keywords::kIoc) {
+            order.time_in_force = TimeInForce::IOC;
+        } else if (word == keywords::kFok) {
+            order.time_in_force = TimeInForce::FOK;
+        } else {
+            logger_.warn("Invalid 'time_in_force' value: '", text, "'. Expected GTC, IOC or FOK. Original line: '", line, "'");
+            return false;
+        }
+    }
+    if (optional_field(CsvColumnIndex::POST_ONLY, text)) {
+        word = csv_simd::token(text);
+        if (text.empty() || text == "0" || word == keywords::kN || word == keywords::kNo || word == keywords::kFalse) {
+            order.post_only = false;
+        } else if (text == "1" || word == keywords::kY || word == keywords::kYes || word == keywords::kTrue) {
+            order.post_only = true;
+        } else {
+            logger_.warn("Invalid 'post_only' value: '", text, "'. Expected Y or N. Original line: '", line, "'");
+            return false;
+        }
+    }
+    if (optional_field(CsvColumnIndex::DISPLAY_QUANTITY, text) && !text.empty()) {
+        status = parseUnsignedField(level_, text, order.display_quantity);
+        if (status != NumberStatus::OK) {
+            logger_.error("Field 'display_quantity' with value '", text, "' cannot be converted: ",
+                          status == NumberStatus::INVALID ? "invalid argument" : "out of range", ". Original line: '", line, "'");
+            return false;
+        }
+    }
+    if (optional_field(CsvColumnIndex::ACCOUNT, text) && !text.empty()) {
+        unsigned long long account_id = 0;
+        status = parseUnsignedField(level_, text, account_id);
+        if (status == NumberStatus::OK && account_id > std::numeric_limits<uint32_t>::max()) {
+            status = NumberStatus::OUT_OF_RANGE;
+        }
+        if (status != NumberStatus::OK) {
+            logger_.error("Field 'account' with value '", text, "' cannot be converted: ",
+                          status == NumberStatus::INVALID ? "invalid argument" : "out of range", ". Original line: '", line, "'");
+            return false;
+        }
+        order.account_id = static_cast<uint32_t>(account_id);
+    }
+    if (const char* attributes_error = orderAttributesError(order)) {
+        logger_.warn("Invalid order attributes: ", attributes_error, ". Original line: '", line, "'");
+        return false;
+    }
+
+    order.remaining_quantity = order.quantity;
+    order.cumulative_executed_quantity = 0;
+    order.status = OrderStatus::UNKNOWN;
+    return true;
+}
+
+// next line of text from position, without its '\n' (same lines as std::getline)
+static bool nextLine(std::string_view text, size_t& position, std::string_view& line) {
+    if (position >= text.size()) {
+        return false;
+    }
+    const void* newline = std::memchr(text.data() + position, '\n', text.size() - position);
+    size_t line_end = (newline == nullptr) ? text.size()
+                                           : static_cast<size_t>(static_cast<const char*>(newline) - text.data());
+    line = text.substr(position, line_end - position);
+    position = line_end + 1;
+    return true;
+}
+
+// parse every data line of text (whole lines of the file) and give each order to on_order.
+// line_number is the number of the line before the first one, it is advanced line by line.
+// Returns the number of orders parsed
+template <typename OnOrder>
+static long int parseLines(FastOrderParser& parser, Logger& logger, std::string_view text,
+                           long long& line_number, OnOrder on_order) {
+    long int parsed_orders = 0;
+    CsvLineScanner scanner(text, parser.level());
+    std::string_view line;
+    std::vector<const char*> commas; // of the current line (trimming a line never removes one)
+    Order order;
+    while (scanner.nextLine(line, commas)) {
+        line_number++;
+        std::string_view trimmed_line = trimView(line);
+        if (trimmed_line.empty()) {
+            LOG_DEBUG(logger, "Skipping empty line at number: ", line_number);
+            continue;
+        }
+        if (parser.parseLine(trimmed_line, commas, line_number, order)) {
+            on_order(order);
+            parsed_orders++;
+        }
+    }
+    return parsed_orders;
+}
+
+// One parsing thread of the parallel mode, and the buffers it exchanges with the sequencer
+namespace {
+struct ChunkLane {
+    // number of chunk buffers of one lane: the parser can be that many chunks ahead of the sequencer
+    static constexpr size_t kBuffers = 3;
+
+    // chunks are big, so the waits are long: parking is the right strategy for both rings
+    SpscRing<std::vector<Order>> filled{kBuffers + 1, WaitStrategyType::PARK}; // parser -> sequencer, in chunk order
+    SpscRing<std::vector<Order>> empty{kBuffers + 1, WaitStrategyType::PARK};  // sequencer -> parser, recycled
+    long int parsed_orders = 0;
+    long long lines = 0;
+    LatencyHistogram parse_latency; // written by the parsing thread of the lane
+    std::thread thread;
+};
+}
+
+// Split the data lines into chunks at newline boundaries, parse chunk k on thread k % reader_threads,
+// and push the orders of chunk 0, then chunk 1, ... so the queue gets the same sequence as a single reader.
+static void parseChunksInParallel(std::string_view body, size_t reader_threads, const CsvColumnIndex& columns,
+                                  Logger& logger, OrderQueue& order_queue, const TickSizeTable& tick_sizes,
+                                  SymbolTable& symbols, long int& parsed_orders, long long& lines,
+                                  LatencyHistogram* parse_latency) {
+    // chunk boundaries, computed once so that every chunk is made of whole lines
+    std::vector<size_t> boundaries{0};
+    while (boundaries.back() < body.size()) {
+        size_t chunk_end = std::min(boundaries.back() + kParallelChunkBytes, body.size());
+        const void* newline = std::memchr(body.data() + chunk_end, '\n', body.size() - chunk_end);
+        chunk_end = (newline == nullptr) ? body.size()
+                                         : static_cast<size_t>(static_cast<const char*>(newline) - body.data()) + 1;
+        boundaries.push_back(chunk_end);
+    }
+    const size_t chunk_count = boundaries.size() - 1;
+    logger.info("Parsing ", chunk_count, " chunks on ", reader_threads,
+                " threads (line numbers in the parsing messages are counted from the start of their chunk).");
+
+    std::vector<ChunkLane> lanes(reader_threads);
+    for (size_t lane_index = 0; lane_index < reader_threads; ++lane_index) {
+        ChunkLane& lane = lanes[lane_index];
+        for (size_t i = 0; i < ChunkLane::kBuffers; ++i) {
+            lane.empty.push(std::vector<Order>());
+        }
+        lane.thread = std::thread([&, lane_index]() {
+            ChunkLane& my_lane = lanes[lane_index];
+            FastOrderParser parser(tick_sizes, symbols, logger);
+            parser.setColumns(columns);
+            for (size_t chunk = lane_index; chunk < chunk_count; chunk += reader_threads) {
+                std::vector<Order> orders = my_lane.empty.pop();
+                orders.clear();
+                std::string_view text = body.substr(boundaries[chunk], boundaries[chunk + 1] - boundaries[chunk]);
+                long long chunk_line_number = 0;
+                BatchTimer chunk_timer(&my_lane.parse_latency);
+                chunk_timer.start();
+                long int chunk_orders = parseLines(parser, logger, text, chunk_line_number,
+                                                   [&](Order& order) { orders.push_back(order); });
+                chunk_timer.stop(static_cast<size_t>(chunk_orders));
+                my_lane.parsed_orders += chunk_orders;
+                my_lane.lines += chunk_line_number;
+                my_lane.filled.push(std::move(orders));
+            }
+        });
+    }
+
+    // the sequencer: chunks leave in their order in the file
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        ChunkLane& lane = lanes[chunk % reader_threads];
+        std::vector<Order> orders = lane.filled.pop();
+        order_queue.push_batch(orders.data(), orders.size()); // waits while the queue is full
+        lane.empty.push(std::move(orders));
+    }
+
+    for (ChunkLane& lane : lanes) {
+        lane.thread.join();
+        parsed_orders += lane.parsed_orders;
+        lines += lane.lines;
+        if (parse_latency != nullptr) {
+            parse_latency->merge(lane.parse_latency);
+        }
+    }
+}
+
+bool readOrdersFromMappedFile(const std::string& path, Logger& logger, OrderQueue& order_queue,
+                              const TickSizeTable& tick_sizes, SymbolTable& symbols, size_t reader_threads,
+                              LatencyHistogram* parse_latency) {
+    // orders are pushed to the queue by batches
+    static constexpr size_t kPushBatchSize = 64;
+
+    MappedFile file;
+    std::string error;
+    if (!file.open(path, error)) {
+        logger.warn("Cannot memory-map input file '", path, "': ", error);
+        return false;
+    }
+    const std::string_view contents = file.contents();
+    logger.info("Starting to read orders from memory-mapped file (", contents.size(), " bytes)...");
+
+    FastOrderParser parser(tick_sizes, symbols, logger);
+    long long line_number = 0;
+    size_t position = 0;
+    std::string_view line;
+
+    if (!nextLine(contents, position, line)) {
+        logger.error("Could not read header line from stream (empty file or stream error).");
+        return true;
+    }
+    line_number++;
+    std::string_view header_line = trimView(line);
+    if (header_line.empty()) {
+        logger.critical("Header line is empty. Aborting.");
+        return true;
+    }
+    logger.info("Reading header line: ", header_line);
+    if (!parser.parseHeader(header_line)) {
+        return true;
+    }
+
+    const std::string_view body = contents.substr(std::min(position, contents.size()));
+    long int order_succcess_parsed = 0;
+    if (reader_threads > 1 && body.size() > kParallelChunkBytes) {
+        parseChunksInParallel(body, reader_threads, parser.columns(), logger, order_queue, tick_sizes, symbols,
+                              order_succcess_parsed, line_number, parse_latency);
+    } else {
+        std::vector<Order> batch(kPushBatchSize);
+        size_t batch_size = 0;
+        // the parsing of each batch is timed, the wait for room in the queue is not
+        BatchTimer parse_timer(parse_latency);
+        parse_timer.start();
+        order_succcess_parsed = parseLines(parser, logger, body, line_number, [&](Order& order) {
+            batch[batch_size] = order;
+            if (++batch_size == kPushBatchSize) {
+                parse_timer.stop(batch_size);
+                order_queue.push_batch(batch.data(), batch_size); // waits while the queue is full
+                batch_size = 0;
+                parse_timer.start();
+            }
+        });
+        parse_timer.stop(batch_size);
+        order_queue.push_batch(batch.data(), batch_size);
+    }
+
+    logger.info("Finished reading orders. Total lines processed (including header): ",
+        line_number,
+        "Orders successfully parsed: ", order_succcess_parsed);
+    return true;
+}
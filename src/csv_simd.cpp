@@ -0,0 +1,179 @@
+#include "csv_simd.hpp"
+
+#include <immintrin.h>
+
+#include <cstring>
+
+// build option ENGINE_CSV_SIMD (src/CMakeLists.txt): 0 scalar, 1 sse4.2, 2 avx2, 3 picked from the cpu
+#ifndef CSV_SIMD_BUILD_LEVEL
+#define CSV_SIMD_BUILD_LEVEL 3
+#endif
+
+namespace {
+
+csv_simd::Level best_supported_level() {
+    if (csv_simd::isSupported(csv_simd::Level::AVX2)) {
+        return csv_simd::Level::AVX2;
+    }
+    if (csv_simd::isSupported(csv_simd::Level::SSE42)) {
+        return csv_simd::Level::SSE42;
+    }
+    return csv_simd::Level::SCALAR;
+}
+
+csv_simd::Level active_level = csv_simd::defaultLevel();
+
+uint64_t combineMasks(int mask0, int mask1, int mask2, int mask3) {
+    return static_cast<uint64_t>(static_cast<uint16_t>(mask0)) |
+           static_cast<uint64_t>(static_cast<uint16_t>(mask1)) << 16 |
+           static_cast<uint64_t>(static_cast<uint16_t>(mask2)) << 32 |
+           static_cast<uint64_t>(static_cast<uint16_t>(mask3)) << 48;
+}
+
+csv_simd::BlockMasks classifyScalar(const char* block) {
+    csv_simd::BlockMasks masks{0, 0};
+    for (size_t i = 0; i < 64; ++i) {
+        masks.commas |= static_cast<uint64_t>(block[i] == ',') << i;
+        masks.newlines |= static_cast<uint64_t>(block[i] == '\n') << i;
+    }
+    return masks;
+}
+
+__attribute__((target("sse4.2")))
+csv_simd::BlockMasks classifySse(const char* block) {
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i bytes0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    const __m128i bytes1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16));
+    const __m128i bytes2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 32));
+    const __m128i bytes3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 48));
+    csv_simd::BlockMasks masks;
+    masks.commas = combineMasks(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes0, comma)), _mm_movemask_epi8(_mm_cmpeq_epi8(bytes1, comma)),
+                                _mm_movemask_epi8(_mm_cmpeq_epi8(bytes2, comma)), _mm_movemask_epi8(_mm_cmpeq_epi8(bytes3, comma)));
+    masks.newlines = combineMasks(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes0, newline)), _mm_movemask_epi8(_mm_cmpeq_epi8(bytes1, newline)),
+                                  _mm_movemask_epi8(_mm_cmpeq_epi8(bytes2, newline)), _mm_movemask_epi8(_mm_cmpeq_epi8(bytes3, newline)));
+    return masks;
+}
+
+__attribute__((target("avx2")))
+csv_simd::BlockMasks classifyAvx2(const char* block) {
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+    csv_simd::BlockMasks masks;
+    masks.commas = static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, comma)))) |
+                   static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, comma)))) << 32;
+    masks.newlines = static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, newline)))) |
+                     static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, newline)))) << 32;
+    return masks;
+}
+
+bool parseDigitsScalar(const char* digits, size_t count, uint64_t& value) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const unsigned digit = static_cast<unsigned>(static_cast<unsigned char>(digits[i])) - '0';
+        if (digit > 9) {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+    value = result;
+    return true;
+}
+
+// the digits are right-aligned in 16 bytes padded with '0' (leading zeros do not change the value), then
+// pairs of digits are multiplied-added (x10), the pairs of pairs (x100), and the two halves of 8 digits (x10000)
+__attribute__((target("sse4.2")))
+bool parseDigitsSse(const char* digits, size_t count, uint64_t& value) {
+    alignas(16) char buffer[16];
+    std::memset(buffer, '0', sizeof(buffer));
+    std::memcpy(buffer + sizeof(buffer) - count, digits, count);
+    const __m128i values = _mm_sub_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(buffer)), _mm_set1_epi8('0'));
+    // a digit is at most 9 once '0' is subtracted (the other bytes wrap around above it)
+    const __m128i nine = _mm_set1_epi8(9);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(values, nine), nine)) != 0xFFFF) {
+        return false;
+    }
+    const __m128i pairs = _mm_maddubs_epi16(values, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+    const __m128i quads = _mm_madd_epi16(pairs, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+    const __m128i packed = _mm_packus_epi32(quads, quads);
+    const __m128i halves = _mm_madd_epi16(packed, _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+    const uint64_t high = static_cast<uint32_t>(_mm_cvtsi128_si32(halves));
+    const uint64_t low = static_cast<uint32_t>(_mm_extract_epi32(halves, 1));
+    value = high * 100000000ULL + low;
+    return true;
+}
+
+} // namespace
+
+namespace csv_simd {
+
+const char* levelToString(Level level) {
+    switch (level) {
+        case Level::SCALAR: return "scalar";
+        case Level::SSE42: return "sse4.2";
+        case Level::AVX2: return "avx2";
+    }
+    return "scalar";
+}
+
+bool parseLevel(std::string_view text, Level& level) {
+    if (text == "scalar") {
+        level = Level::SCALAR;
+    } else if (text == "sse4.2") {
+        level = Level::SSE42;
+    } else if (text == "avx2") {
+        level = Level::AVX2;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool isSupported(Level level) {
+    __builtin_cpu_init(); // the level is also read by a static initializer, maybe before libgcc initialized it
+    switch (level) {
+        case Level::SCALAR: return true;
+        case Level::SSE42: return __builtin_cpu_supports("sse4.2");
+        case Level::AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("sse4.2");
+    }
+    return false;
+}
+
+Level defaultLevel() {
+#if CSV_SIMD_BUILD_LEVEL < 3
+    const Level build_level = static_cast<Level>(CSV_SIMD_BUILD_LEVEL);
+    return isSupported(build_level) ? build_level : best_supported_level();
+#else
+    return best_supported_level();
+#endif
+}
+
+Level setActiveLevel(Level level) {
+    active_level = isSupported(level) ? level : best_supported_level();
+    return active_level;
+}
+
+Level activeLevel() {
+    return active_level;
+}
+
+BlockMasks classifyBlock(Level level, const char* block) {
+    switch (level) {
+        case Level::AVX2: return classifyAvx2(block);
+        case Level::SSE42: return classifySse(block);
+        case Level::SCALAR: break;
+    }
+    return classifyScalar(block);
+}
+
+bool parseDigits(Level level, const char* digits, size_t count, uint64_t& value) {
+    // AVX2 adds nothing for 16 bytes: both SIMD levels use the SSE conversion
+    if (level != Level::SCALAR) {
+        return parseDigitsSse(digits, count, value);
+    }
+    return parseDigitsScalar(digits, count, value);
+}
+
+} // namespace csv_simd
@@ -0,0 +1,411 @@
+// DiffReplay: differential verification of the matching pipeline against the reference book.
+// One reader parses the order file once, and every order goes to two pipelines running side by side:
+//   engine     dispatcher -> worker pool (--workers, --book-type) -> output rings -> output merger
+//   reference  one thread matching every order inline in the map/list OrderBook (InlineEngine<OrderBook>)
+// This thread takes the events of both in the order of the input and compares them field by field, as
+// they stream: nothing is written as text and nothing is kept but a few events of context.
+// The merger makes the engine's events independent of the number of workers and of the thread scheduling,
+// so the two streams must be the same, event for event. At the first difference it prints the last events
+// both sides agreed on, the two events and the ones right after, and stops.
+//   DiffReplay <orders file> [--workers 4] [--book-type ladder] [--market-data -1] [--risk-limits ...]
+//              [--self-trade-prevention none] [--context 8]
+// Exit code: 0 if the streams are the same, 2 at the first divergence, 1 for a bad input or option.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "argparse.hpp"
+#include "binary_format.hpp"
+#include "csv_mmap_reader.hpp"
+#include "inline_engine.hpp"
+#include "logger.hpp"
+#include "market_data.hpp"
+#include "output_merger.hpp"
+#include "risk_checks.hpp"
+#include "wait_strategy.hpp"
+#include "worker_pool.hpp"
+
+namespace {
+
+constexpr size_t kReaderQueueCapacity = 1 << 16;
+constexpr size_t kReferenceQueueCapacity = 1 << 16;
+constexpr size_t kBatchSize = 256;  // orders or events moved at once between the stages
+constexpr int kExitDiverged = 2;
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// the events of the reference, back into records like the ones of the output rings, pushed by batches
+struct ReferenceSink : ExecutionSink {
+    OutputQueue* output = nullptr;
+    std::vector<ExecutionReport> batch;
+
+    void record(const ExecutionReport& report) {
+        batch.push_back(report);
+        if (batch.size() == kBatchSize) {
+            flush();
+        }
+    }
+    void flush() {
+        output->push_batch(batch.data(), batch.size());
+        batch.clear();
+    }
+    void onAccepted(const ExecutionReport& report) { record(report); }
+    void onFill(const ExecutionReport& report) { record(report); }
+    void onCanceled(const ExecutionReport& report) { record(report); }
+    void onCompleted(const ExecutionReport& report) { record(report); }
+    void onRejected(const ExecutionReport& report) { record(report); }
+    void onMarketData(const MarketDataUpdate& update) { record(makeMarketDataRecord(update)); }
+};
+
+// events of one pipeline, taken from its queue by batches
+template <typename Source>
+class EventStream {
+public:
+    explicit EventStream(Source& source) : source_(source), events_(kBatchSize) {}
+
+    // next event, or nullptr once the pipeline is done (waits for it)
+    const ExecutionReport* peek() {
+        if (position_ == size_ && !ended_) {
+            size_ = source_.pop_batch(events_.data(), events_.size());
+            position_ = 0;
+            ended_ = size_ == 0;
+        }
+        return position_ < size_ ? &events_[position_] : nullptr;
+    }
+    void next() { position_++; }
+
+private:
+    Source& source_;
+    std::vector<ExecutionReport> events_;
+    size_t position_ = 0;
+    size_t size_ = 0;
+    bool ended_ = false;
+};
+
+// names of the fields of a and b that are not the same ("" if none).
+// The prices are compared exactly: both books carry the prices of the input, they never compute one
+std::string differingFields(const ExecutionReport& a, const ExecutionReport& b) {
+    std::string fields;
+    auto check = [&fields](bool same, const char* name) {
+        if (!same) {
+            fields += fields.empty() ? name : std::string(", ") + name;
+        }
+    };
+    check(a.sequence == b.sequence, "sequence");
+    check(a.timestamp == b.timestamp, "timestamp");
+    check(a.order_id == b.order_id, "order_id");
+    check(a.symbol_id == b.symbol_id, "instrument");
+    check(a.side == b.side, "side");
+    check(a.type == b.type, "type");
+    check(a.quantity == b.quantity, "quantity");
+    check(a.price == b.price, "price");
+    check(a.action == b.action, "action");
+    check(a.status == b.status, "status");
+    check(a.executed_quantity == b.executed_quantity, "executed_quantity");
+    check(a.execution_price == b.execution_price, "execution_price");
+    check(a.counterparty_id == b.counterparty_id, "counterparty_id");
+    return fields;
+}
+
+// one line for an event, with the columns of the output files (report, or market data update)
+std::string describe(const ExecutionReport& event, const SymbolTable& symbols) {
+    std::ostringstream line;
+    line << std::setprecision(10) << "order #" << event.sequence << " " << symbols.name(event.symbol_id) << " ";
+    if (isMarketData(event)) {
+        const MarketDataUpdate update = readMarketDataRecord(event);
+        line << "market data #" << update.update_number << " " << marketDataKindToString(update.kind)
+             << " side " << sideToString(update.side) << " price " << update.price << " quantity " << update.quantity
+             << " orders " << update.order_count;
+        if (update.kind == MarketDataKind::BBO) {
+            line << " ask " << update.ask_price << " x " << update.ask_quantity;
+        }
+        return line.str();
+    }
+    line << "id " << event.order_id << " " << sideToString(event.side) << " " << orderTypeToString(event.type)
+         << " " << orderActionToString(event.action) << " " << orderStatusToString(event.status)
+         << " quantity " << event.quantity << " price " << event.price << " timestamp " << event.timestamp;
+    if (event.executed_quantity > 0) {
+        line << " executed " << event.executed_quantity << " @ " << event.execution_price
+             << " against " << event.counterparty_id;
+    }
+    return line.str();
+}
+
+struct CompareResult {
+    unsigned long long events = 0;       // events found the same in both streams
+    unsigned long long market_data = 0;  // of which market data updates
+    bool diverged = false;
+};
+
+// walk both streams side by side. At the first difference, print the context and return
+template <typename EngineSource, typename ReferenceSource>
+CompareResult compareStreams(EventStream<EngineSource>& engine, EventStream<ReferenceSource>& reference,
+                             const SymbolTable& symbols, size_t context) {
+    CompareResult result;
+    std::deque<ExecutionReport> agreed; // the last `context` events both sides had
+    for (;;) {
+        const ExecutionReport* engine_event = engine.peek();
+        const ExecutionReport* reference_event = reference.peek();
+        if (engine_event == nullptr && reference_event == nullptr) {
+            return result;
+        }
+        std::string fields;
+        if (engine_event != nullptr && reference_event != nullptr) {
+            fields = differingFields(*engine_event, *reference_event);
+            if (fields.empty()) {
+                result.events++;
+                result.market_data += isMarketData(*engine_event) ? 1 : 0;
+                if (context > 0) {
+                    if (agreed.size() == context) {
+                        agreed.pop_front();
+                    }
+                    agreed.push_back(*engine_event);
+                }
+                engine.next();
+                reference.next();
+                continue;
+            }
+        }
+
+        result.diverged = true;
+        std::cout << "DIVERGENCE at event " << result.events << " (the first " << result.events
+                  << " events are the same)\n";
+        if (!fields.empty()) {
+            std::cout << "  fields that differ: " << fields << "\n";
+        }
+        std::cout << "  last events of both:\n";
+        for (const ExecutionReport& event : agreed) {
+            std::cout << "    " << describe(event, symbols) << "\n";
+        }
+        // the two events and the next ones of each stream (the pipelines keep running until the exit)
+        auto printNext = [&](const char* name, auto& stream) {
+            std::cout << "  " << name << ":\n";
+            for (size_t i = 0; i <= context; ++i) {
+                const ExecutionReport* event = stream.peek();
+                if (event == nullptr) {
+                    std::cout << (i == 0 ? "  > " : "    ") << "(end of the events)\n";
+                    break;
+                }
+                std::cout << (i == 0 ? "  > " : "    ") << describe(*event, symbols) << "\n";
+                stream.next();
+            }
+        };
+        printNext("engine", engine);
+        printNext("reference", reference);
+        return result;
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    ArgumentParser parser("Replay an order file through the engine pipeline and the reference book, and compare their events");
+    parser.add_argument("input_file")
+        .help("Order file to replay (CSV, or binary from OrderFileConverter).")
+        .type_string();
+    parser.add_flag({"--workers"})
+        .help("Number of matching workers of the engine pipeline.")
+        .set_default(4)
+        .type_int();
+    parser.add_flag({"--book-type"})
+        .help("Order book implementation of the engine pipeline: 'map' or 'ladder' (the reference is always the map book).")
+        .set_default(std::string("ladder"))
+        .type_string();
+    parser.add_flag({"--tick-size"})
+        .help("Tick size of every instrument.")
+        .set_default(0.01)
+        .type_double();
+    parser.add_flag({"--wait-strategy"})
+        .help("How idle pipeline threads wait: 'spin', 'yield' or 'park'.")
+        .set_default(std::string("yield"))
+        .type_string();
+    parser.add_flag({"--market-data"})
+        .help("Compare the level 2 market data too, with a full depth snapshot every N orders of a book (0 = no snapshots, -1 = no market data).")
+        .set_default(-1)
+        .type_int();
+    parser.add_flag({"--risk-limits"})
+        .help("Default limits of every account for the risk checks of both pipelines, e.g. 'max_quantity=1000,price_band=0.05'.")
+        .set_default(std::string(""))
+        .type_string();
+    parser.add_flag({"--self-trade-prevention"})
+        .help("Self-trade prevention of both pipelines: 'none', 'cancel-resting', 'cancel-incoming' or 'cancel-both'.")
+        .set_default(std::string("none"))
+        .type_string();
+    parser.add_flag({"--context"})
+        .help("Events printed before and after the first divergence.")
+        .set_default(8)
+        .type_int();
+
+    std::string input_path, book_type, risk_limits, self_trade_prevention;
+    size_t worker_count = 1;
+    double tick_size = 0.01;
+    int market_data = -1;
+    size_t context = 0;
+    WaitStrategyType wait_strategy = WaitStrategyType::SPIN_YIELD;
+    try {
+        parser.parse_args(argc, argv);
+        input_path = parser.get<std::string>("input_file");
+        book_type = parser.get<std::string>("book_type");
+        if (book_type != "map" && book_type != "ladder") {
+            throw std::runtime_error("Invalid book type '" + book_type + "'. Expected 'map' or 'ladder'.");
+        }
+        int workers_arg = parser.get<int>("workers");
+        if (workers_arg < 1) {
+            throw std::runtime_error("Invalid value for --workers: it must be at least 1.");
+        }
+        worker_count = static_cast<size_t>(workers_arg);
+        tick_size = parser.get<double>("tick_size");
+        if (tick_size <= 0.0) {
+            throw std::runtime_error("Invalid value for --tick-size: it must be positive.");
+        }
+        std::optional<WaitStrategyType> parsed_wait_strategy = parseWaitStrategyType(parser.get<std::string>("wait_strategy"));
+        if (!parsed_wait_strategy) {
+            throw std::runtime_error("Invalid value for --wait-strategy. Expected 'spin', 'yield' or 'park'.");
+        }
+        wait_strategy = *parsed_wait_strategy;
+        market_data = parser.get<int>("market_data");
+        if (market_data < -1) {
+            throw std::runtime_error("Invalid value for --market-data: it must be -1 or more.");
+        }
+        risk_limits = parser.get<std::string>("risk_limits");
+        self_trade_prevention = parser.get<std::string>("self_trade_prevention");
+        if (!RiskConfig().parseSelfTradePrevention(self_trade_prevention)) {
+            throw std::runtime_error("Invalid value for --self-trade-prevention: '" + self_trade_prevention + "'.");
+        }
+        int context_arg = parser.get<int>("context");
+        if (context_arg < 0) {
+            throw std::runtime_error("Invalid value for --context: it cannot be negative.");
+        }
+        context = static_cast<size_t>(context_arg);
+    } catch (const std::runtime_error& err) {
+        std::cerr << "Error parsing arguments: " << err.what() << std::endl;
+        parser.print_help();
+        return 1;
+    }
+
+    Logger logger("DiffReplay");
+    logger.set_level(LogLevel::WARN); // the skipped lines are still reported
+
+    std::shared_ptr<RiskConfig> risk_config;
+    if (!risk_limits.empty() || self_trade_prevention != "none") {
+        risk_config = std::make_shared<RiskConfig>();
+        risk_config->parseSelfTradePrevention(self_trade_prevention);
+        if (!risk_limits.empty() && !risk_config->parseLimits(risk_limits, logger)) {
+            logger.critical("Invalid --risk-limits value: ", risk_limits);
+            return 1;
+        }
+    }
+
+    const bool binary_input = BinaryFileReader::hasMagic(input_path);
+    std::ifstream input_file_stream;
+    if (!binary_input) {
+        input_file_stream.open(input_path);
+        if (!input_file_stream.is_open()) {
+            logger.critical("Failed to open input order file: ", input_path);
+            return 1;
+        }
+    }
+
+    // the reference owns the symbols and the tick sizes: the reader interns into them, and the engine
+    // pipeline reads the same ids (both number the orders from 0 in the order of the input)
+    InlineEngine<OrderBook> reference(tick_size);
+    WorkerPool worker_pool(worker_count, book_type, reference.symbols(), wait_strategy, {}, logger);
+    if (market_data >= 0) {
+        worker_pool.enableMarketData(static_cast<unsigned long long>(market_data));
+        reference.enableMarketData(static_cast<unsigned long long>(market_data));
+    }
+    if (risk_config) {
+        worker_pool.enableRiskChecks(risk_config);
+        reference.enableRiskChecks(risk_config);
+    }
+
+    OrderQueue order_queue(kReaderQueueCapacity, wait_strategy);
+    OrderQueue reference_orders(kReferenceQueueCapacity, wait_strategy);
+    OutputQueue reference_events(kReferenceQueueCapacity, wait_strategy);
+
+    const uint64_t start_ns = nowNs();
+    worker_pool.start();
+    OutputMerger output_merger(worker_pool);
+
+    std::thread reader_thread([&]() {
+        if (binary_input) {
+            if (!readOrdersFromBinaryFile(input_path, logger, order_queue, reference.tickSizes(), reference.symbols())) {
+                logger.critical("No order could be read from the binary input file.");
+            }
+        } else if (!readOrdersFromMappedFile(input_path, logger, order_queue, reference.tickSizes(), reference.symbols())) {
+            readOrdersFromStream(input_file_stream, logger, order_queue, reference.tickSizes(), reference.symbols());
+        }
+        order_queue.close();
+    });
+
+    // every order to both pipelines, in the same order. The reference gets a batch first: the comparison
+    // waits for the engine only on orders the reference already had, so no ring can stay full for good
+    unsigned long long order_count = 0;
+    std::thread dispatcher_thread([&]() {
+        std::vector<Order> batch(kBatchSize);
+        size_t count;
+        while ((count = order_queue.pop_batch(batch.data(), batch.size())) > 0) {
+            reference_orders.push_batch(batch.data(), count);
+            for (size_t i = 0; i < count; ++i) {
+                worker_pool.dispatch(batch[i]);
+            }
+            worker_pool.flush();
+            order_count += count;
+        }
+        worker_pool.stop();
+        reference_orders.close();
+    });
+
+    std::thread reference_thread([&]() {
+        ReferenceSink sink;
+        sink.output = &reference_events;
+        sink.batch.reserve(kBatchSize);
+        std::vector<Order> batch(kBatchSize);
+        size_t count;
+        while ((count = reference_orders.pop_batch(batch.data(), batch.size())) > 0) {
+            for (size_t i = 0; i < count; ++i) {
+                reference.submit(batch[i], sink);
+            }
+            sink.flush();
+        }
+        reference_events.close();
+    });
+
+    EventStream<OutputMerger> engine_stream(output_merger);
+    EventStream<OutputQueue> reference_stream(reference_events);
+    const CompareResult result = compareStreams(engine_stream, reference_stream, reference.symbols(), context);
+    if (result.diverged) {
+        // the reader cannot be interrupted in the middle of the file: stop here rather than parse the rest of it
+        std::cout.flush();
+        std::_Exit(kExitDiverged);
+    }
+    reader_thread.join();
+    dispatcher_thread.join();
+    reference_thread.join();
+    const double seconds = static_cast<double>(nowNs() - start_ns) / 1e9;
+
+    std::cout << std::fixed
+              << "engine:             " << book_type << " book, " << worker_count << " worker(s)"
+              << (market_data >= 0 ? ", market data" : "") << (risk_config ? ", risk checks" : "") << "\n"
+              << "reference:          map book, inline on one thread\n"
+              << "orders:             " << order_count << " (" << reference.symbols().size() << " instruments)\n"
+              << "events compared:    " << result.events << " (" << result.market_data << " market data updates)\n"
+              << "elapsed:            " << std::setprecision(3) << seconds << " s, " << std::setprecision(0)
+              << (seconds > 0.0 ? static_cast<double>(order_count) / seconds : 0.0) << " orders/s\n"
+              << "result:             the same events, in the same order\n";
+    return 0;
+}
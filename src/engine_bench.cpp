@@ -0,0 +1,302 @@
+// EngineBench: end-to-end throughput and latency of the matching pipeline.
+// The order file (CSV or binary, see generate_synthetic_data.py --profile) is loaded into memory first,
+// then replayed through the same worker pool and output merger as the engine:
+//   dispatcher thread -> worker rings -> books -> output rings -> merger -> report writer (this thread)
+//   EngineBench <orders file> [--profile name] [--workers 1] [--book-type map] [--rate 0]
+//               [--output /dev/null] [--results engine_bench.csv]
+// Measured:
+// - sustained orders/sec, from the first dispatched order to the last written report
+// - latency of every order, from its ingest (the moment the dispatcher takes it, or with --rate the moment
+//   it was scheduled to arrive) to its first execution report reaching the writer
+// - peak RSS of the process and heap allocations per order during the replay
+// The result is printed and appended as one CSV line to the results file, so runs can be compared.
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "alloc_counter.hpp"
+#include "argparse.hpp"
+#include "bench_stats.hpp"
+#include "binary_format.hpp"
+#include "csv_mmap_reader.hpp"
+#include "logger.hpp"
+#include "order.hpp"
+#include "output_merger.hpp"
+#include "report_writer.hpp"
+#include "symbol_table.hpp"
+#include "tick_size.hpp"
+#include "wait_strategy.hpp"
+#include "worker_pool.hpp"
+
+namespace {
+
+constexpr size_t kLoaderQueueCapacity = 1 << 16;
+constexpr size_t kDispatchBatchSize = 256;  // orders dispatched between two flushes of the worker pool
+constexpr size_t kWriterBatchSize = 256;    // reports taken from the merger at once
+constexpr unsigned long long kNoSequence = ~0ULL;
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// read every order of the file into memory, with the readers of the engine
+bool loadOrders(const std::string& path, Logger& logger, const TickSizeTable& tick_sizes, SymbolTable& symbols,
+                std::vector<Order>& orders) {
+    OrderQueue order_queue(kLoaderQueueCapacity, WaitStrategyType::PARK);
+    bool loaded = true;
+    std::thread reader_thread([&]() {
+        if (BinaryFileReader::hasMagic(path)) {
+            loaded = readOrdersFromBinaryFile(path, logger, order_queue, tick_sizes, symbols);
+        } else {
+            std::ifstream input_file_stream(path);
+            if (!input_file_stream.is_open()) {
+                loaded = false;
+            } else if (!readOrdersFromMappedFile(path, logger, order_queue, tick_sizes, symbols)) {
+                readOrdersFromStream(input_file_stream, logger, order_queue, tick_sizes, symbols);
+            }
+        }
+        order_queue.close();
+    });
+    std::vector<Order> batch(kDispatchBatchSize);
+    size_t count;
+    while ((count = order_queue.pop_batch(batch.data(), batch.size())) > 0) {
+        orders.insert(orders.end(), batch.begin(), batch.begin() + static_cast<std::ptrdiff_t>(count));
+    }
+    reader_thread.join();
+    return loaded && !orders.empty();
+}
+
+struct RunResult {
+    double seconds = 0.0;
+    double orders_per_sec = 0.0;
+    LatencySummary latency;
+    unsigned long long reports = 0;
+    double allocations_per_order = 0.0;
+    long peak_rss_kb = 0;
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    ArgumentParser parser("End-to-end throughput and latency of the matching pipeline");
+    parser.add_argument("input_file")
+        .help("Order file to replay (CSV, or binary from OrderFileConverter).")
+        .type_string();
+    parser.add_flag({"--profile"})
+        .help("Name of the workload, only copied into the results (e.g. the generator profile).")
+        .set_default(std::string("custom"))
+        .type_string();
+    parser.add_flag({"--workers"})
+        .help("Number of matching workers.")
+        .set_default(1)
+        .type_int();
+    parser.add_flag({"--book-type"})
+        .help("Order book implementation: 'map' or 'ladder'.")
+        .set_default(std::string("map"))
+        .type_string();
+    parser.add_flag({"--tick-size"})
+        .help("Tick size of every instrument.")
+        .set_default(0.01)
+        .type_double();
+    parser.add_flag({"--wait-strategy"})
+        .help("How idle pipeline threads wait: 'spin', 'yield' or 'park'.")
+        .set_default(std::string("yield"))
+        .type_string();
+    parser.add_flag({"--rate"})
+        .help("Orders per second offered to the engine (open loop). 0 replays as fast as possible.")
+        .set_default(0.0)
+        .type_double();
+    parser.add_flag({"--output"})
+        .help("File receiving the execution reports (CSV).")
+        .set_default(std::string("/dev/null"))
+        .type_string();
+    parser.add_flag({"--results"})
+        .help("CSV file the result line is appended to (empty for none).")
+        .set_default(std::string("engine_bench.csv"))
+        .type_string();
+
+    std::string input_path, profile, book_type, output_path, results_path;
+    size_t worker_count = 1;
+    double tick_size = 0.01;
+    double rate = 0.0;
+    WaitStrategyType wait_strategy = WaitStrategyType::SPIN_YIELD;
+    try {
+        parser.parse_args(argc, argv);
+        input_path = parser.get<std::string>("input_file");
+        profile = parser.get<std::string>("profile");
+        book_type = parser.get<std::string>("book_type");
+        if (book_type != "map" && book_type != "ladder") {
+            throw std::runtime_error("Invalid book type '" + book_type + "'. Expected 'map' or 'ladder'.");
+        }
+        int workers_arg = parser.get<int>("workers");
+        if (workers_arg < 1) {
+            throw std::runtime_error("Invalid value for --workers: it must be at least 1.");
+        }
+        worker_count = static_cast<size_t>(workers_arg);
+        tick_size = parser.get<double>("tick_size");
+        if (tick_size <= 0.0) {
+            throw std::runtime_error("Invalid value for --tick-size: it must be positive.");
+        }
+        std::optional<WaitStrategyType> parsed_wait_strategy = parseWaitStrategyType(parser.get<std::string>("wait_strategy"));
+        if (!parsed_wait_strategy) {
+            throw std::runtime_error("Invalid value for --wait-strategy. Expected 'spin', 'yield' or 'park'.");
+        }
+        wait_strategy = *parsed_wait_strategy;
+        rate = parser.get<double>("rate");
+        if (rate < 0.0) {
+            throw std::runtime_error("Invalid value for --rate: it must be 0 or positive.");
+        }
+        output_path = parser.get<std::string>("output");
+        results_path = parser.get<std::string>("results");
+    } catch (const std::runtime_error& err) {
+        std::cerr << "Error parsing arguments: " << err.what() << std::endl;
+        parser.print_help();
+        return 1;
+    }
+
+    Logger logger("EngineBench");
+    logger.set_level(LogLevel::WARN); // the skipped lines are still reported
+
+    TickSizeTable tick_sizes(tick_size);
+    SymbolTable symbols;
+    std::vector<Order> orders;
+    if (!loadOrders(input_path, logger, tick_sizes, symbols, orders)) {
+        logger.critical("No order could be read from: ", input_path);
+        return 1;
+    }
+    const size_t order_count = orders.size();
+
+    ReportWriter report_writer(symbols);
+    std::string output_error;
+    if (!report_writer.open(output_path, output_error)) {
+        logger.critical("Failed to open output file: ", output_path, " (", output_error, ")");
+        return 1;
+    }
+
+    // everything the replay needs is allocated here, before the counters are read
+    std::vector<uint64_t> ingest_ns(order_count);
+    std::vector<uint64_t> latencies;
+    latencies.reserve(order_count);
+    std::vector<ExecutionReport> records(kWriterBatchSize);
+
+    const unsigned long long allocations_before = alloc_counter::total_allocations();
+    WorkerPool worker_pool(worker_count, book_type, symbols, wait_strategy, {}, logger);
+    worker_pool.start();
+    OutputMerger output_merger(worker_pool);
+
+    const uint64_t start_ns = nowNs();
+    std::thread dispatcher_thread([&]() {
+        // with --rate, order i is due at start + i / rate: its latency is counted from that moment,
+        // even when the engine is late, so a stall shows up in the latency of every order behind it
+        const double interval_ns = rate > 0.0 ? 1e9 / rate : 0.0;
+        size_t next = 0;
+        while (next < order_count) {
+            const uint64_t now = nowNs();
+            size_t due = order_count;
+            if (rate > 0.0) {
+                due = std::min(order_count, static_cast<size_t>(static_cast<double>(now - start_ns) / interval_ns) + 1);
+                if (due <= next) {
+                    std::this_thread::yield();
+                    continue;
+                }
+            }
+            due = std::min(due, next + kDispatchBatchSize);
+            for (size_t i = next; i < due; ++i) {
+                ingest_ns[i] = rate > 0.0 ? start_ns + static_cast<uint64_t>(static_cast<double>(i) * interval_ns) : now;
+                worker_pool.dispatch(orders[i]);
+            }
+            worker_pool.flush();
+            next = due;
+        }
+        worker_pool.stop();
+    });
+
+    // the sequence numbers of the pool are the indexes in `orders`, and the merger gives the reports in that order.
+    // ingest_ns[s] is written before order s is pushed to its ring, so it is visible here once its report is
+    report_writer.writeHeader();
+    unsigned long long last_sequence = kNoSequence;
+    unsigned long long report_count = 0;
+    uint64_t end_ns = start_ns;
+    size_t record_count;
+    while ((record_count = output_merger.pop_batch(records.data(), records.size())) > 0) {
+        const uint64_t now = nowNs();
+        for (size_t i = 0; i < record_count; ++i) {
+            const ExecutionReport& report = records[i];
+            if (report.sequence != last_sequence) {
+                last_sequence = report.sequence;
+                const uint64_t ingest = ingest_ns[report.sequence];
+                latencies.push_back(now > ingest ? now - ingest : 0);
+            }
+            report_writer.append(report);
+        }
+        report_count += record_count;
+        end_ns = now;
+    }
+    dispatcher_thread.join();
+    if (!report_writer.close(output_error)) {
+        logger.critical("Failed to write output file: ", output_path, " (", output_error, ")");
+        return 1;
+    }
+
+    RunResult result;
+    result.allocations_per_order = static_cast<double>(alloc_counter::total_allocations() - allocations_before)
+                                 / static_cast<double>(order_count);
+    result.seconds = static_cast<double>(end_ns - start_ns) / 1e9;
+    result.orders_per_sec = result.seconds > 0.0 ? static_cast<double>(order_count) / result.seconds : 0.0;
+    result.latency = summarizeLatencies(latencies);
+    result.reports = report_count;
+    struct rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        result.peak_rss_kb = usage.ru_maxrss; // kilobytes on Linux
+    }
+
+    std::cout << std::fixed
+              << "profile:            " << profile << "\n"
+              << "book type:          " << book_type << ", " << worker_pool.size() << " worker(s)\n"
+              << "orders:             " << order_count << " (" << symbols.size() << " instruments)\n"
+              << "offered rate:       " << (rate > 0.0 ? std::to_string(static_cast<long long>(rate)) + " orders/s" : std::string("unthrottled")) << "\n"
+              << "execution reports:  " << result.reports << "\n"
+              << "elapsed:            " << std::setprecision(3) << result.seconds << " s\n"
+              << "throughput:         " << std::setprecision(0) << result.orders_per_sec << " orders/s\n"
+              << "latency (ns):       mean " << std::setprecision(0) << result.latency.mean_ns
+              << ", p50 " << result.latency.p50_ns << ", p99 " << result.latency.p99_ns
+              << ", p99.9 " << result.latency.p999_ns << ", max " << result.latency.max_ns << "\n"
+              << "peak RSS:           " << result.peak_rss_kb << " KiB\n"
+              << "allocations/order:  " << std::setprecision(3) << result.allocations_per_order << "\n";
+
+    if (!results_path.empty()) {
+        // the header is written when the file is new (or empty)
+        bool write_header = true;
+        {
+            std::ifstream existing(results_path);
+            write_header = !existing.is_open() || existing.peek() == std::ifstream::traits_type::eof();
+        }
+        std::ofstream results_file(results_path, std::ios::app);
+        if (!results_file.is_open()) {
+            std::cerr << "Failed to open the result file: " << results_path << std::endl;
+            return 1;
+        }
+        if (write_header) {
+            results_file << "profile,book_type,workers,orders,instruments,rate,seconds,orders_per_sec,"
+                            "mean_ns,p50_ns,p99_ns,p999_ns,max_ns,peak_rss_kb,allocations_per_order\n";
+        }
+        results_file << std::fixed << profile << ',' << book_type << ',' << worker_pool.size() << ',' << order_count << ','
+                     << symbols.size() << ',' << std::setprecision(0) << rate << ','
+                     << std::setprecision(6) << result.seconds << ',' << std::setprecision(0) << result.orders_per_sec << ','
+                     << std::setprecision(1) << result.latency.mean_ns << ',' << result.latency.p50_ns << ','
+                     << result.latency.p99_ns << ',' << result.latency.p999_ns << ',' << result.latency.max_ns << ','
+                     << result.peak_rss_kb << ',' << std::setprecision(3) << result.allocations_per_order << '\n';
+        std::cout << "Result appended to " << results_path << "\n";
+    }
+    return 0;
+}
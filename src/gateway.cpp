@@ -0,0 +1,755 @@
+#include "gateway.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cmath>   // For std::llround
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
+
+// this class takes the orders from the network and sends the execution reports back
+
+// the error of the last system call, prefixed with what failed
+static bool systemError(std::string& error, const std::string& what) {
+    error = what + ": " + std::strerror(errno);
+    return false;
+}
+
+static std::string addressToString(const sockaddr_in& address) {
+    char text[INET_ADDRSTRLEN] = {};
+    inet_ntop(AF_INET, &address.sin_addr, text, sizeof(text));
+    return std::string(text) + ":" + std::to_string(static_cast<unsigned>(ntohs(address.sin_port)));
+}
+
+OrderGateway::OrderGateway(SymbolTable& symbols, const TickSizeTable& tick_sizes, Logger& logger)
+    : symbols_(symbols), tick_sizes_(tick_sizes), logger_(logger),
+      datagram_buffers_(kDatagramBatch * kDatagramBytes), datagram_headers_(kDatagramBatch),
+      datagram_vectors_(kDatagramBatch), datagram_peers_(kDatagramBatch),
+      send_headers_(kDatagramBatch), send_vectors_(kDatagramBatch),
+      reports_(kReportRingCapacity, WaitStrategyType::SPIN_YIELD), report_batch_(kReportBatchSize) {
+}
+
+OrderGateway::~OrderGateway() {
+    for (auto& entry : sessions_) {
+        if (entry.second->fd >= 0) {
+            ::close(entry.second->fd);
+        }
+    }
+    for (int fd : {listen_fd_, udp_fd_, signal_fd_, wake_fd_, epoll_fd_}) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+bool OrderGateway::blockStopSignals(std::string& error) {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    int result = pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    if (result != 0) {
+        error = std::strerror(result);
+        return false;
+    }
+    return true;
+}
+
+bool OrderGateway::open(const GatewayConfig& config, std::string& error) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        return systemError(error, "epoll_create1");
+    }
+    auto watch = [&](int fd, uint64_t id) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = id;
+        return epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == 0;
+    };
+
+    // the writer wakes the loop up when it hands reports over
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0 || !watch(wake_fd_, kWakeId)) {
+        return systemError(error, "eventfd");
+    }
+    // SIGINT / SIGTERM (blocked by blockStopSignals) are read like any other event
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    signal_fd_ = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd_ < 0 || !watch(signal_fd_, kSignalId)) {
+        return systemError(error, "signalfd");
+    }
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    if (inet_pton(AF_INET, config.bind_address.c_str(), &address.sin_addr) != 1) {
+        error = "invalid address '" + config.bind_address + "'";
+        return false;
+    }
+    const int enable = 1;
+
+    if (config.tcp_port > 0) {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            return systemError(error, "TCP socket");
+        }
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        sockaddr_in tcp_address = address;
+        tcp_address.sin_port = htons(static_cast<uint16_t>(config.tcp_port));
+        if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&tcp_address), sizeof(tcp_address)) != 0) {
+            return systemError(error, "bind TCP port " + std::to_string(config.tcp_port));
+        }
+        if (listen(listen_fd_, SOMAXCONN) != 0 || !watch(listen_fd_, kListenerId)) {
+            return systemError(error, "listen");
+        }
+        logger_.info("Gateway listening on TCP ", addressToString(tcp_address));
+    }
+
+    if (config.udp_port > 0) {
+        udp_fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (udp_fd_ < 0) {
+            return systemError(error, "UDP socket");
+        }
+        setsockopt(udp_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        // room for bursts while the loop is busy (the kernel may cap it)
+        const int receive_buffer = 8 << 20;
+        setsockopt(udp_fd_, SOL_SOCKET, SO_RCVBUF, &receive_buffer, sizeof(receive_buffer));
+        sockaddr_in udp_address = address;
+        udp_address.sin_port = htons(static_cast<uint16_t>(config.udp_port));
+        ip_mreq membership{};
+        if (!config.multicast_group.empty()) {
+            if (inet_pton(AF_INET, config.multicast_group.c_str(), &membership.imr_multiaddr) != 1) {
+                error = "invalid multicast group '" + config.multicast_group + "'";
+                return false;
+            }
+            membership.imr_interface = address.sin_addr;
+            udp_address.sin_addr.s_addr = htonl(INADDR_ANY); // the datagrams are sent to the group address
+        }
+        if (bind(udp_fd_, reinterpret_cast<const sockaddr*>(&udp_address), sizeof(udp_address)) != 0) {
+            return systemError(error, "bind UDP port " + std::to_string(config.udp_port));
+        }
+        if (!config.multicast_group.empty() &&
+            setsockopt(udp_fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0) {
+            return systemError(error, "join multicast group " + config.multicast_group);
+        }
+        if (!watch(udp_fd_, kUdpId)) {
+            return systemError(error, "epoll_ctl");
+        }
+        logger_.info("Gateway receiving on UDP ", addressToString(udp_address),
+                     config.multicast_group.empty() ? std::string() : "(multicast group " + config.multicast_group + ")");
+    }
+    return true;
+}
+
+OrderGateway::Session& OrderGateway::createSession(int fd, const sockaddr_in& peer) {
+    auto session = std::make_unique<Session>();
+    session->id = next_session_id_++;
+    session->fd = fd;
+    session->peer = peer;
+    session->send_buffer.resize(kReceiveBufferBytes);
+    if (fd >= 0) {
+        session->receive_buffer.resize(kReceiveBufferBytes);
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.u64 = session->id;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+    }
+    logger_.info("Gateway session ", session->id, " opened by ", addressToString(peer), fd >= 0 ? "(TCP)" : "(UDP)");
+    Session& result = *session;
+    sessions_[result.id] = std::move(session);
+    return result;
+}
+
+void OrderGateway::closeSession(Session& session, const char* reason) {
+    logger_.info("Gateway session ", session.id, " closed: ", reason);
+    if (session.fd >= 0) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, session.fd, nullptr);
+        ::close(session.fd);
+    } else {
+        udp_session_of_.erase((static_cast<uint64_t>(session.peer.sin_addr.s_addr) << 16) | session.peer.sin_port);
+    }
+    const uint32_t session_id = session.id;
+    sessions_.erase(session_id); // session is gone from here
+}
+
+OrderGateway::Session* OrderGateway::findSession(uint32_t session_id) {
+    auto found = sessions_.find(session_id);
+    return found == sessions_.end() ? nullptr : found->second.get();
+}
+
+void OrderGateway::updateEpoll(Session& session) {
+    epoll_event event{};
+    const bool reading = !session.input_closed && !input_stopped_ && !session.throttled;
+    event.events = (reading ? static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP) : 0u) |
+                   (session.want_write ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.u64 = session.id;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, session.fd, &event);
+}
+
+void OrderGateway::acceptConnections() {
+    while (true) {
+        sockaddr_in peer{};
+        socklen_t peer_length = sizeof(peer);
+        int fd = accept4(listen_fd_, reinterpret_cast<sockaddr*>(&peer), &peer_length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                logger_.warn("Gateway accept failed: ", std::strerror(errno));
+            }
+            return;
+        }
+        // the reports are small messages: send them right away
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        createSession(fd, peer);
+    }
+}
+
+void OrderGateway::readTcp(Session& session) {
+    ssize_t count = ::recv(session.fd, session.receive_buffer.data() + session.received,
+                           session.receive_buffer.size() - session.received, 0);
+    if (count == 0) {
+        // the client is done sending, its reports still go out
+        session.input_closed = true;
+        updateEpoll(session);
+        return;
+    }
+    if (count < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            closeSession(session, std::strerror(errno));
+        }
+        return;
+    }
+    session.received += static_cast<size_t>(count);
+    size_t used = 0;
+    if (!decodeMessages(session, session.receive_buffer.data(), session.received, used)) {
+        if (flushSession(session)) { // the REJECT saying why
+            closeSession(session, "protocol error");
+        }
+        return;
+    }
+    // a message cut by the end of the read waits for the next one
+    std::memmove(session.receive_buffer.data(), session.receive_buffer.data() + used, session.received - used);
+    session.received -= used;
+}
+
+void OrderGateway::readUdp() {
+    // a few batches at a time, so the TCP sessions and the reports get their turn
+    for (int round = 0; round < 16; ++round) {
+        for (size_t i = 0; i < kDatagramBatch; ++i) {
+            datagram_vectors_[i].iov_base = datagram_buffers_.data() + i * kDatagramBytes;
+            datagram_vectors_[i].iov_len = kDatagramBytes;
+            msghdr& header = datagram_headers_[i].msg_hdr;
+            header = msghdr{};
+            header.msg_name = &datagram_peers_[i];
+            header.msg_namelen = sizeof(sockaddr_in);
+            header.msg_iov = &datagram_vectors_[i];
+            header.msg_iovlen = 1;
+            datagram_headers_[i].msg_len = 0;
+        }
+        int count = recvmmsg(udp_fd_, datagram_headers_.data(), static_cast<unsigned int>(kDatagramBatch), MSG_DONTWAIT, nullptr);
+        if (count <= 0) {
+            if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                logger_.warn("Gateway recvmmsg failed: ", std::strerror(errno));
+            }
+            return;
+        }
+        for (size_t i = 0; i < static_cast<size_t>(count); ++i) {
+            const sockaddr_in& peer = datagram_peers_[i];
+            const uint64_t key = (static_cast<uint64_t>(peer.sin_addr.s_addr) << 16) | peer.sin_port;
+            auto found = udp_session_of_.find(key);
+            Session* session = found == udp_session_of_.end() ? nullptr : findSession(found->second);
+            if (session == nullptr) {
+                session = &createSession(-1, peer);
+                udp_session_of_[key] = session->id;
+            }
+            const char* data = datagram_buffers_.data() + i * kDatagramBytes;
+            const size_t size = datagram_headers_[i].msg_len;
+            size_t used = 0;
+            // a datagram only holds whole messages: what is left is a bad message
+            // (decodeMessages already rejected the message it could not read)
+            if ((datagram_headers_[i].msg_hdr.msg_flags & MSG_TRUNC) != 0 ||
+                (decodeMessages(*session, data, size, used) && used != size)) {
+                reject(*session, 0, GatewayRejectReason::BAD_MESSAGE);
+            }
+        }
+        if (static_cast<size_t>(count) < kDatagramBatch) {
+            return;
+        }
+    }
+}
+
+bool OrderGateway::decodeMessages(Session& session, const char* data, size_t size, size_t& used) {
+    used = 0;
+    while (size - used >= sizeof(GatewayMessageHeader)) {
+        GatewayMessageHeader header;
+        std::memcpy(&header, data + used, sizeof(header));
+        if (header.length < sizeof(header) || header.length > kGatewayMaxMessageBytes) {
+            reject(session, header.sequence, GatewayRejectReason::BAD_MESSAGE);
+            return false; // the next messages cannot be found any more
+        }
+        if (size - used < header.length) {
+            break;
+        }
+        if (!handleMessage(session, header, data + used) && session.fd >= 0) {
+            return false;
+        }
+        used += header.length;
+    }
+    return true;
+}
+
+bool OrderGateway::handleMessage(Session& session, const GatewayMessageHeader& header, const char* message) {
+    // per-session sequencing
+    if (header.sequence != session.next_in_sequence) {
+        if (session.fd >= 0) {
+            reject(session, header.sequence, GatewayRejectReason::SEQUENCE_GAP);
+            return false;
+        }
+        if (header.sequence < session.next_in_sequence) {
+            return true; // UDP: a duplicate
+        }
+        lost_messages_ += header.sequence - session.next_in_sequence;
+    }
+    session.next_in_sequence = header.sequence + 1;
+
+    switch (static_cast<GatewayMessageType>(header.type)) {
+    case GatewayMessageType::SYMBOL: {
+        if (header.length != sizeof(GatewaySymbolMessage)) {
+            break;
+        }
+        GatewaySymbolMessage symbol;
+        std::memcpy(&symbol, message, sizeof(symbol));
+        // ids are indexes of small tables: they must stay small
+        if (symbol.name_length == 0 || symbol.name_length > GatewaySymbolMessage::kMaxNameBytes ||
+            symbol.symbol_id >= (1u << 16)) {
+            reject(session, header.sequence, GatewayRejectReason::BAD_SYMBOL);
+            return true;
+        }
+        const std::string name(symbol.name, symbol.name_length);
+        const uint32_t engine_id = symbols_.intern(name);
+        if (symbol.symbol_id >= session.engine_symbol_of.size()) {
+            session.engine_symbol_of.resize(symbol.symbol_id + 1, SymbolTable::kInvalidSymbol);
+            session.tick_size_of.resize(symbol.symbol_id + 1, 0.0);
+        }
+        session.engine_symbol_of[symbol.symbol_id] = engine_id;
+        session.tick_size_of[symbol.symbol_id] = tick_sizes_.tick_size_for(name);
+        if (engine_id >= session.session_symbol_of.size()) {
+            session.session_symbol_of.resize(static_cast<size_t>(engine_id) + 1, SymbolTable::kInvalidSymbol);
+        }
+        session.session_symbol_of[engine_id] = symbol.symbol_id;
+        return true;
+    }
+    case GatewayMessageType::ORDER: {
+        if (header.length != sizeof(GatewayOrderMessage)) {
+            break;
+        }
+        GatewayOrderMessage order_message;
+        std::memcpy(&order_message, message, sizeof(order_message));
+        const BinaryOrderRecord& record = order_message.order;
+        if (record.symbol_id >= session.engine_symbol_of.size() ||
+            session.engine_symbol_of[record.symbol_id] == SymbolTable::kInvalidSymbol) {
+            reject(session, header.sequence, GatewayRejectReason::UNKNOWN_SYMBOL);
+            return true;
+        }
+        // same checks as the binary files
+        Order order;
+        if (record.side > static_cast<uint8_t>(Side::SELL) ||
+            record.type > static_cast<uint8_t>(OrderType::MARKET) ||
+            record.action > static_cast<uint8_t>(OrderAction::CANCEL) ||
+            !unpackOrderFlags(record.flags, order.time_in_force, order.post_only)) {
+            reject(session, header.sequence, GatewayRejectReason::INVALID_ORDER);
+            return true;
+        }
+        order.timestamp = record.timestamp;
+        order.order_id = record.order_id;
+        order.symbol_id = session.engine_symbol_of[record.symbol_id];
+        order.side = static_cast<Side>(record.side);
+        order.type = static_cast<OrderType>(record.type);
+        order.action = static_cast<OrderAction>(record.action);
+        order.quantity = record.quantity;
+        order.price = record.price;
+        order.display_quantity = record.display_quantity;
+        order.account_id = record.account_id;
+        if (orderAttributesError(order) != nullptr) {
+            reject(session, header.sequence, GatewayRejectReason::INVALID_ORDER);
+            return true;
+        }
+        // same conversion as the parsers (market orders keep 0 ticks)
+        if (order.type == OrderType::LIMIT) {
+            order.price_ticks = std::llround(order.price / session.tick_size_of[record.symbol_id]);
+        }
+        order.remaining_quantity = order.quantity;
+        order.status = OrderStatus::UNKNOWN;
+        pending_.push_back(order);
+
+        // where its reports go
+        routes_.push_back(Route{session.id, order.order_id});
+        if (order.action == OrderAction::NEW) {
+            owner_of_.emplace(order.order_id, Owner{session.id, next_route_sequence_});
+        }
+        next_route_sequence_++;
+        orders_received_++;
+        return true;
+    }
+    default:
+        break;
+    }
+    reject(session, header.sequence, GatewayRejectReason::BAD_MESSAGE);
+    return false;
+}
+
+void OrderGateway::reject(Session& session, uint32_t rejected_sequence, GatewayRejectReason reason) {
+    GatewayRejectMessage message{};
+    message.header.length = static_cast<uint16_t>(sizeof(message));
+    message.header.type = static_cast<uint8_t>(GatewayMessageType::REJECT);
+    message.header.sequence = session.next_out_sequence++;
+    message.rejected_sequence = rejected_sequence;
+    message.reason = static_cast<uint32_t>(reason);
+    rejects_++;
+    // (not closed here: the callers still use the session. A slow client is closed with its next report)
+    if (session.send_end - session.send_begin + sizeof(message) <= kMaxSendBufferBytes) {
+        queueMessage(session, &message, sizeof(message));
+    }
+}
+
+bool OrderGateway::queueMessage(Session& session, const void* message, size_t size) {
+    if (session.fd >= 0 && session.send_end - session.send_begin + size > kMaxSendBufferBytes) {
+        closeSession(session, "too many reports waiting (the client does not read them)");
+        return false;
+    }
+    if (session.send_end + size > session.send_buffer.size()) {
+        // move what is left to the front, and grow the buffer only if that is not enough
+        std::memmove(session.send_buffer.data(), session.send_buffer.data() + session.send_begin,
+                     session.send_end - session.send_begin);
+        session.send_end -= session.send_begin;
+        session.send_begin = 0;
+        if (session.send_end + size > session.send_buffer.size()) {
+            session.send_buffer.resize(std::max(session.send_buffer.size() * 2, session.send_end + size));
+        }
+    }
+    std::memcpy(session.send_buffer.data() + session.send_end, message, size);
+    session.send_end += size;
+    if (!session.dirty) {
+        session.dirty = true;
+        dirty_sessions_.push_back(session.id);
+    }
+    return true;
+}
+
+bool OrderGateway::flushSession(Session& session) {
+    // stop (or go on) reading the orders of the session depending on what is left to send
+    auto update_throttle = [&]() {
+        const bool throttled = session.send_end - session.send_begin >= kThrottleSendBytes;
+        if (throttled != session.throttled) {
+            session.throttled = throttled;
+            updateEpoll(session);
+        }
+    };
+    while (session.send_begin < session.send_end) {
+        ssize_t sent = ::send(session.fd, session.send_buffer.data() + session.send_begin,
+                              session.send_end - session.send_begin, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // the socket is full: EPOLLOUT tells when it takes more
+                if (!session.want_write) {
+                    session.want_write = true;
+                    updateEpoll(session);
+                }
+                update_throttle();
+                return true;
+            }
+            closeSession(session, std::strerror(errno));
+            return false;
+        }
+        session.send_begin += static_cast<size_t>(sent);
+    }
+    session.send_begin = 0;
+    session.send_end = 0;
+    if (session.want_write) {
+        session.want_write = false;
+        updateEpoll(session);
+    }
+    update_throttle();
+    return true;
+}
+
+void OrderGateway::flushUdp(Session& session) {
+    // whole messages packed into datagrams, sent by batches. UDP has no flow control:
+    // what the socket does not take is dropped (the client sees the gap in the sequence numbers)
+    while (session.send_begin < session.send_end) {
+        size_t datagram_count = 0;
+        size_t position = session.send_begin;
+        while (datagram_count < kDatagramBatch && position < session.send_end) {
+            const size_t start = position;
+            while (position < session.send_end) {
+                GatewayMessageHeader header;
+                std::memcpy(&header, session.send_buffer.data() + position, sizeof(header));
+                if (position + header.length - start > kDatagramBytes) {
+                    break;
+                }
+                position += header.length;
+            }
+            send_vectors_[datagram_count].iov_base = session.send_buffer.data() + start;
+            send_vectors_[datagram_count].iov_len = position - start;
+            msghdr& header = send_headers_[datagram_count].msg_hdr;
+            header = msghdr{};
+            header.msg_name = &session.peer;
+            header.msg_namelen = sizeof(session.peer);
+            header.msg_iov = &send_vectors_[datagram_count];
+            header.msg_iovlen = 1;
+            datagram_count++;
+        }
+        int sent = sendmmsg(udp_fd_, send_headers_.data(), static_cast<unsigned int>(datagram_count), MSG_DONTWAIT);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            // count the reports that are lost with this buffer
+            for (size_t offset = session.send_begin; offset < session.send_end;) {
+                GatewayMessageHeader header;
+                std::memcpy(&header, session.send_buffer.data() + offset, sizeof(header));
+                dropped_reports_ += header.type == static_cast<uint8_t>(GatewayMessageType::REPORT) ? 1 : 0;
+                offset += header.length;
+            }
+            break;
+        }
+        for (int i = 0; i < sent; ++i) {
+            session.send_begin += send_vectors_[static_cast<size_t>(i)].iov_len;
+        }
+    }
+    session.send_begin = 0;
+    session.send_end = 0;
+}
+
+void OrderGateway::deliverReports() {
+    size_t count;
+    while ((count = reports_.try_pop_batch(report_batch_.data(), report_batch_.size())) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+            const ExecutionReport& report = report_batch_[i];
+            // the reports come in sequence order: the routes of the orders before this one are not needed any more
+            while (!routes_.empty() && route_base_ < report.sequence) {
+                routes_.pop_front();
+                route_base_++;
+            }
+            if (routes_.empty() || route_base_ != report.sequence) {
+                dropped_reports_++; // not an order of the gateway
+                continue;
+            }
+            const Route& route = routes_.front();
+            uint32_t session_id = route.session_id;
+            auto owner = owner_of_.find(report.order_id);
+            if (report.order_id != route.order_id) {
+                // about a resting order hit by this one: it goes to the session of the resting order
+                session_id = owner == owner_of_.end() ? 0 : owner->second.session_id;
+            }
+            if (owner != owner_of_.end() &&
+                (report.status == OrderStatus::EXECUTED || report.status == OrderStatus::CANCELED ||
+                 (report.status == OrderStatus::REJECTED && owner->second.sequence == report.sequence))) {
+                owner_of_.erase(owner); // the order does not rest (any more)
+            }
+
+            Session* session = findSession(session_id);
+            if (session == nullptr) {
+                dropped_reports_++; // the client is gone
+                continue;
+            }
+            GatewayReportMessage message{};
+            message.header.length = static_cast<uint16_t>(sizeof(message));
+            message.header.type = static_cast<uint8_t>(GatewayMessageType::REPORT);
+            message.header.sequence = session->next_out_sequence++;
+            message.report = toBinaryRecord(report);
+            message.report.symbol_id = report.symbol_id < session->session_symbol_of.size()
+                                           ? session->session_symbol_of[report.symbol_id]
+                                           : SymbolTable::kInvalidSymbol;
+            if (queueMessage(*session, &message, sizeof(message))) {
+                reports_sent_++;
+            }
+        }
+    }
+
+    // one send per session for everything it got
+    for (uint32_t session_id : dirty_sessions_) {
+        Session* session = findSession(session_id);
+        if (session == nullptr) {
+            continue;
+        }
+        session->dirty = false;
+        if (session->fd >= 0) {
+            flushSession(*session);
+        } else {
+            flushUdp(*session);
+        }
+    }
+    dirty_sessions_.clear();
+}
+
+void OrderGateway::pushPending(OrderQueue& orders) {
+    if (pending_pushed_ < pending_.size()) {
+        pending_pushed_ += orders.try_push_batch(pending_.data() + pending_pushed_, pending_.size() - pending_pushed_);
+    }
+    if (pending_pushed_ == pending_.size()) {
+        pending_.clear();
+        pending_pushed_ = 0;
+    }
+}
+
+void OrderGateway::stopInput() {
+    if (input_stopped_) {
+        return;
+    }
+    input_stopped_ = true;
+    logger_.info("Gateway stops taking orders (", orders_received_, " received), sending the last reports.");
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+    if (udp_fd_ >= 0) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, udp_fd_, nullptr); // still used to send the reports
+    }
+    for (auto& entry : sessions_) {
+        if (entry.second->fd >= 0) {
+            updateEpoll(*entry.second);
+        }
+    }
+}
+
+void OrderGateway::stop() {
+    stop_requested_.store(true, std::memory_order_release);
+    wake();
+}
+
+void OrderGateway::wake() {
+    const uint64_t one = 1;
+    ssize_t result = ::write(wake_fd_, &one, sizeof(one));
+    (void)result; // the counter is only a wake-up, a full counter wakes the loop up too
+}
+
+void OrderGateway::publishReports(ExecutionReport* reports, size_t count) {
+    size_t done = 0;
+    while (done < count) {
+        const size_t pushed = reports_.try_push_batch(reports + done, count - done);
+        done += pushed;
+        if (pushed > 0) {
+            wake();
+        } else {
+            std::this_thread::yield(); // the gateway thread drains the ring
+        }
+    }
+}
+
+void OrderGateway::closeReports() {
+    reports_.close();
+    wake();
+}
+
+void OrderGateway::run(OrderQueue& orders) {
+    std::vector<epoll_event> events(kEpollEvents);
+    bool orders_closed = false;
+    while (true) {
+        // the reader ring was full: the sockets are not read until the decoded orders are pushed
+        const bool paused = !pending_.empty();
+        int event_count = epoll_wait(epoll_fd_, events.data(), kEpollEvents, paused ? 0 : -1);
+        if (event_count < 0 && errno != EINTR) {
+            logger_.critical("Gateway epoll_wait failed: ", std::strerror(errno));
+            stopInput();
+        }
+        for (int e = 0; e < event_count; ++e) {
+            const uint64_t id = events[static_cast<size_t>(e)].data.u64;
+            const uint32_t flags = events[static_cast<size_t>(e)].events;
+            if (id == kListenerId) {
+                if (!input_stopped_) {
+                    acceptConnections();
+                }
+            } else if (id == kUdpId) {
+                if (!paused && !input_stopped_) {
+                    readUdp();
+                }
+            } else if (id == kSignalId) {
+                signalfd_siginfo signal_info;
+                if (::read(signal_fd_, &signal_info, sizeof(signal_info)) == static_cast<ssize_t>(sizeof(signal_info))) {
+                    logger_.info("Gateway received signal ", signal_info.ssi_signo);
+                }
+                stopInput();
+            } else if (id == kWakeId) {
+                uint64_t counter;
+                ssize_t result = ::read(wake_fd_, &counter, sizeof(counter));
+                (void)result;
+            } else {
+                Session* session = findSession(static_cast<uint32_t>(id));
+                if (session == nullptr) {
+                    continue;
+                }
+                if ((flags & EPOLLERR) != 0) {
+                    closeSession(*session, "socket error");
+                    continue;
+                }
+                if ((flags & EPOLLOUT) != 0 && !flushSession(*session)) {
+                    continue;
+                }
+                if ((flags & (EPOLLIN | EPOLLRDHUP)) != 0 && !paused && !session->input_closed && !input_stopped_ &&
+                    !session->throttled) {
+                    readTcp(*session);
+                    session = findSession(static_cast<uint32_t>(id));
+                }
+                if (session != nullptr && (flags & EPOLLHUP) != 0 && (session->input_closed || input_stopped_)) {
+                    closeSession(*session, "closed by the client"); // both directions are closed
+                }
+            }
+        }
+
+        if (stop_requested_.load(std::memory_order_acquire)) {
+            stopInput();
+        }
+        pushPending(orders);
+        if (input_stopped_ && pending_.empty() && !orders_closed) {
+            orders.close(); // the dispatcher drains the ring and stops the pipeline
+            orders_closed = true;
+        }
+        // the writer closes the ring once it wrote the last report: what is in the ring is everything
+        const bool reports_done = reports_.is_closed();
+        deliverReports();
+        if (orders_closed && reports_done && reports_.empty()) {
+            break;
+        }
+        if (!pending_.empty()) {
+            std::this_thread::yield();
+        }
+    }
+
+    // last reports: the sockets are made blocking (with a timeout) so a client gets all of them
+    for (auto& entry : sessions_) {
+        Session& session = *entry.second;
+        if (session.fd < 0 || session.send_begin == session.send_end) {
+            continue;
+        }
+        timeval timeout{};
+        timeout.tv_sec = 1;
+        setsockopt(session.fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        fcntl(session.fd, F_SETFL, fcntl(session.fd, F_GETFL) & ~O_NONBLOCK);
+        while (session.send_begin < session.send_end) {
+            ssize_t sent = ::send(session.fd, session.send_buffer.data() + session.send_begin,
+                                  session.send_end - session.send_begin, MSG_NOSIGNAL);
+            if (sent <= 0) {
+                logger_.warn("Gateway session ", session.id, ": the last reports could not be sent");
+                break;
+            }
+            session.send_begin += static_cast<size_t>(sent);
+        }
+    }
+    logger_.info("Gateway closed: ", getSessionCount(), " sessions, ", orders_received_, " orders received, ",
+                 reports_sent_, " reports sent, ", rejects_, " rejects, ", lost_messages_, " lost UDP messages, ",
+                 dropped_reports_, " reports dropped");
+}
@@ -0,0 +1,321 @@
+// GatewayClient: sends an order file to the gateway of a running engine and writes the reports it gets back.
+//   GatewayClient <orders file> <reports.csv> --tcp 9000 [--host 127.0.0.1]
+//   GatewayClient <orders file> <reports.csv> --udp 9001 [--host 239.1.1.1]
+// The orders (CSV, or binary from OrderFileConverter) are read by the same parsers as the engine, declared
+// instrument by instrument with SYMBOL messages, then sent as ORDER messages (gateway_protocol.hpp).
+// The reports are written with the same CSV format as the engine: with one client, the file is the
+// output file of the engine. The client stops when the engine closes the connection, or once every order
+// is sent and no message came for --idle-ms.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "argparse.hpp"
+#include "binary_format.hpp"
+#include "csv_mmap_reader.hpp"
+#include "gateway_protocol.hpp"
+#include "logger.hpp"
+#include "order.hpp"
+#include "report_writer.hpp"
+#include "symbol_table.hpp"
+#include "tick_size.hpp"
+
+namespace {
+
+constexpr size_t kLoaderQueueCapacity = 1 << 16;
+constexpr size_t kLoaderBatchSize = 256;
+constexpr size_t kReceiveBufferBytes = 64 << 10;
+constexpr size_t kDatagramBytes = 1472; // same as the gateway
+constexpr size_t kSendChunkBytes = 64 << 10; // TCP: bytes handed to send() at once
+
+// every order of the file, through the parsers of the engine
+bool loadOrders(const std::string& path, Logger& logger, const TickSizeTable& tick_sizes, SymbolTable& symbols,
+                std::vector<Order>& orders) {
+    OrderQueue order_queue(kLoaderQueueCapacity, WaitStrategyType::PARK);
+    bool loaded = true;
+    std::thread reader_thread([&]() {
+        if (BinaryFileReader::hasMagic(path)) {
+            loaded = readOrdersFromBinaryFile(path, logger, order_queue, tick_sizes, symbols);
+        } else {
+            std::ifstream input_file_stream(path);
+            if (!input_file_stream.is_open()) {
+                loaded = false;
+            } else if (!readOrdersFromMappedFile(path, logger, order_queue, tick_sizes, symbols)) {
+                readOrdersFromStream(input_file_stream, logger, order_queue, tick_sizes, symbols);
+            }
+        }
+        order_queue.close();
+    });
+    std::vector<Order> batch(kLoaderBatchSize);
+    size_t count;
+    while ((count = order_queue.pop_batch(batch.data(), batch.size())) > 0) {
+        orders.insert(orders.end(), batch.begin(), batch.begin() + static_cast<std::ptrdiff_t>(count));
+    }
+    reader_thread.join();
+    return loaded && !orders.empty();
+}
+
+template <typename Message>
+void appendMessage(std::vector<char>& out, Message& message, GatewayMessageType type, uint32_t& sequence) {
+    message.header.length = static_cast<uint16_t>(sizeof(Message));
+    message.header.type = static_cast<uint8_t>(type);
+    message.header.sequence = sequence++;
+    const char* bytes = reinterpret_cast<const char*>(&message);
+    out.insert(out.end(), bytes, bytes + sizeof(Message));
+}
+
+// the messages of the orders, every instrument declared before its first order (with its symbol id as id)
+std::vector<char> encodeOrders(const std::vector<Order>& orders, const SymbolTable& symbols) {
+    std::vector<char> messages;
+    messages.reserve(orders.size() * sizeof(GatewayOrderMessage));
+    std::vector<bool> declared(symbols.size(), false);
+    uint32_t sequence = 1;
+    for (const Order& order : orders) {
+        if (!declared[order.symbol_id]) {
+            declared[order.symbol_id] = true;
+            const std::string& name = symbols.name(order.symbol_id);
+            GatewaySymbolMessage symbol{};
+            symbol.symbol_id = order.symbol_id;
+            symbol.name_length = static_cast<uint32_t>(std::min(name.size(), GatewaySymbolMessage::kMaxNameBytes));
+            std::memcpy(symbol.name, name.data(), symbol.name_length);
+            appendMessage(messages, symbol, GatewayMessageType::SYMBOL, sequence);
+        }
+        GatewayOrderMessage message{};
+        message.order = toBinaryRecord(order);
+        appendMessage(messages, message, GatewayMessageType::ORDER, sequence);
+    }
+    return messages;
+}
+
+// reads the messages of the engine
+class ReportReceiver {
+public:
+    ReportReceiver(ReportWriter& writer, Logger& logger) : writer_(writer), logger_(logger) {}
+
+    // whole messages of [data, data + size), returns the bytes used
+    size_t decode(const char* data, size_t size) {
+        size_t used = 0;
+        while (size - used >= sizeof(GatewayMessageHeader)) {
+            GatewayMessageHeader header;
+            std::memcpy(&header, data + used, sizeof(header));
+            if (header.length < sizeof(header) || size - used < header.length) {
+                break;
+            }
+            if (header.sequence != next_sequence_) {
+                lost_ += header.sequence > next_sequence_ ? header.sequence - next_sequence_ : 0;
+            }
+            next_sequence_ = header.sequence + 1;
+            if (header.type == static_cast<uint8_t>(GatewayMessageType::REPORT) &&
+                header.length == sizeof(GatewayReportMessage)) {
+                GatewayReportMessage message;
+                std::memcpy(&message, data + used, sizeof(message));
+                writer_.append(fromBinaryRecord(message.report));
+                reports_++;
+            } else if (header.type == static_cast<uint8_t>(GatewayMessageType::REJECT) &&
+                       header.length == sizeof(GatewayRejectMessage)) {
+                GatewayRejectMessage message;
+                std::memcpy(&message, data + used, sizeof(message));
+                logger_.warn("Message ", message.rejected_sequence, " rejected by the gateway (reason ", message.reason, ")");
+            }
+            used += header.length;
+        }
+        return used;
+    }
+
+    unsigned long long getReports() const { return reports_; }
+    unsigned long long getLost() const { return lost_; }
+
+private:
+    ReportWriter& writer_;
+    Logger& logger_;
+    uint32_t next_sequence_ = 1;
+    unsigned long long reports_ = 0;
+    unsigned long long lost_ = 0;
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    ArgumentParser parser("Sends an order file to the gateway of the matching engine and writes the reports");
+    parser.add_argument("input_file")
+        .help("Order file to send (CSV, or binary from OrderFileConverter).")
+        .type_string();
+    parser.add_argument("output_file")
+        .help("CSV file receiving the execution reports.")
+        .type_string();
+    parser.add_flag({"--host"})
+        .help("Address of the engine (or the multicast group with --udp).")
+        .set_default(std::string("127.0.0.1"))
+        .type_string();
+    parser.add_flag({"--tcp"})
+        .help("TCP port of the gateway (--gateway-tcp).")
+        .set_default(0)
+        .type_int();
+    parser.add_flag({"--udp"})
+        .help("UDP port of the gateway (--gateway-udp).")
+        .set_default(0)
+        .type_int();
+    parser.add_flag({"--udp-pace-us"})
+        .help("Pause between two datagrams, in microseconds (UDP has no flow control).")
+        .set_default(20)
+        .type_int();
+    parser.add_flag({"--idle-ms"})
+        .help("Stop once every order is sent and nothing came for this long.")
+        .set_default(2000)
+        .type_int();
+
+    std::string input_path, output_path, host;
+    int tcp_port = 0, udp_port = 0, pace_us = 0, idle_ms = 0;
+    try {
+        parser.parse_args(argc, argv);
+        input_path = parser.get<std::string>("input_file");
+        output_path = parser.get<std::string>("output_file");
+        host = parser.get<std::string>("host");
+        tcp_port = parser.get<int>("tcp");
+        udp_port = parser.get<int>("udp");
+        pace_us = parser.get<int>("udp_pace_us");
+        idle_ms = parser.get<int>("idle_ms");
+        if ((tcp_port > 0) == (udp_port > 0) || tcp_port < 0 || udp_port < 0 || tcp_port > 65535 || udp_port > 65535) {
+            throw std::runtime_error("Expected one of --tcp or --udp, with a port number.");
+        }
+        if (pace_us < 0 || idle_ms < 0) {
+            throw std::runtime_error("--udp-pace-us and --idle-ms cannot be negative.");
+        }
+    } catch (const std::runtime_error& err) {
+        std::cerr << "Error parsing arguments: " << err.what() << std::endl;
+        parser.print_help();
+        return 1;
+    }
+
+    Logger logger("GatewayClient");
+    TickSizeTable tick_sizes;
+    SymbolTable symbols;
+    std::vector<Order> orders;
+    if (!loadOrders(input_path, logger, tick_sizes, symbols, orders)) {
+        logger.critical("No order could be read from: ", input_path);
+        return 1;
+    }
+    const std::vector<char> messages = encodeOrders(orders, symbols);
+
+    ReportWriter report_writer(symbols);
+    std::string error;
+    if (!report_writer.open(output_path, error)) {
+        logger.critical("Failed to open output file: ", output_path, " (", error, ")");
+        return 1;
+    }
+    report_writer.writeHeader();
+    ReportReceiver receiver(report_writer, logger);
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(tcp_port > 0 ? tcp_port : udp_port));
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+        logger.critical("Invalid address: ", host);
+        return 1;
+    }
+    const bool udp = udp_port > 0;
+    int fd = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+    if (fd < 0 || (!udp && connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)) {
+        logger.critical("Cannot connect to ", host, ":", tcp_port, " (", std::strerror(errno), ")");
+        return 1;
+    }
+    if (!udp) {
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    }
+    logger.info("Sending ", orders.size(), " orders (", symbols.size(), " instruments) to ", host, udp ? " over UDP" : " over TCP");
+
+    // send and receive at the same time: the engine answers while the orders are still coming
+    std::vector<char> receive_buffer(kReceiveBufferBytes);
+    size_t received = 0;
+    size_t sent = 0;
+    bool closed = false;
+    auto last_message = std::chrono::steady_clock::now();
+    const auto start = last_message;
+    while (!closed) {
+        // UDP: whole messages per datagram
+        size_t chunk = std::min(messages.size() - sent, kSendChunkBytes);
+        if (udp) {
+            chunk = 0;
+            while (sent + chunk < messages.size()) {
+                GatewayMessageHeader header;
+                std::memcpy(&header, messages.data() + sent + chunk, sizeof(header));
+                if (chunk + header.length > kDatagramBytes) {
+                    break;
+                }
+                chunk += header.length;
+            }
+        }
+        pollfd poll_fd{};
+        poll_fd.fd = fd;
+        poll_fd.events = static_cast<short>(POLLIN | (chunk > 0 ? POLLOUT : 0));
+        int ready = poll(&poll_fd, 1, 100);
+        if (ready < 0 && errno != EINTR) {
+            logger.critical("poll failed: ", std::strerror(errno));
+            break;
+        }
+        if ((poll_fd.revents & POLLOUT) != 0 && chunk > 0) {
+            ssize_t count = udp ? sendto(fd, messages.data() + sent, chunk, 0, reinterpret_cast<const sockaddr*>(&address), sizeof(address))
+                                : send(fd, messages.data() + sent, chunk, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (count > 0) {
+                sent += static_cast<size_t>(count);
+                if (sent == messages.size() && !udp) {
+                    shutdown(fd, SHUT_WR); // everything is sent, the engine goes on sending the reports
+                }
+                if (udp && pace_us > 0) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(pace_us));
+                }
+            } else if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                logger.critical("send failed: ", std::strerror(errno));
+                break;
+            }
+        }
+        // everything that arrived (the engine must not wait for us)
+        while (!closed && (poll_fd.revents & (POLLIN | POLLHUP | POLLERR)) != 0) {
+            ssize_t count = recv(fd, receive_buffer.data() + received, receive_buffer.size() - received, MSG_DONTWAIT);
+            if (count == 0 && !udp) {
+                closed = true; // the engine stopped
+            } else if (count > 0) {
+                received += static_cast<size_t>(count);
+                const size_t used = receiver.decode(receive_buffer.data(), received);
+                std::memmove(receive_buffer.data(), receive_buffer.data() + used, received - used);
+                received -= used;
+                last_message = std::chrono::steady_clock::now();
+            } else {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    logger.warn("recv failed: ", std::strerror(errno));
+                    closed = true;
+                }
+                break;
+            }
+        }
+        if (sent == messages.size() &&
+            std::chrono::steady_clock::now() - last_message > std::chrono::milliseconds(idle_ms)) {
+            break;
+        }
+    }
+    close(fd);
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!report_writer.close(error)) {
+        logger.critical("Failed to write output file: ", output_path, " (", error, ")");
+        return 1;
+    }
+    logger.info("Sent ", sent, " bytes, received ", receiver.getReports(), " reports (", receiver.getLost(),
+                " messages lost) in ", seconds, " s");
+    return sent == messages.size() ? 0 : 1;
+}
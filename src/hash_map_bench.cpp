@@ -0,0 +1,277 @@
+// HashMapBench: FlatHashMap (flat_hash_map.hpp) against the node based containers, on the keys of the engine.
+// Three workloads, each one at several table sizes:
+//   order_ids   the order-id index: consecutive ids, every round adds the next id, looks up a random live one
+//               and removes a random live one (the table stays at the same size, like a book in steady state)
+//   symbols     the instrument tables: lookups of string_views of the symbols, a few hot ones (Zipf)
+//   accounts    the open-order counts of the risk checks: increments of Zipf distributed account ids
+//               (a dense vector indexed by the id is measured too, it is what the account limits use)
+//   HashMapBench [--sizes 100,10000,1000000] [--operations 1000000] [--output results.csv]
+// The operations are timed by batches of kBatch (one clock read per operation would cost more than a lookup),
+// the percentiles are those of the ns/op of the batches.
+
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "argparse.hpp"
+#include "bench_stats.hpp"
+#include "flat_hash_map.hpp"
+
+namespace {
+
+constexpr size_t kBatch = 256;
+
+// keeps the compiler from dropping the lookups
+volatile uint64_t g_sink = 0;
+
+// the same calls on every container: value of the key or nullptr
+template <typename Map, typename Key>
+auto lookup(Map& map, const Key& key) -> decltype(&map.begin()->second) {
+    auto it = map.find(key);
+    return it == map.end() ? nullptr : &it->second;
+}
+template <typename Key, typename Value, typename Hash>
+Value* lookup(FlatHashMap<Key, Value, Hash>& map, const Key& key) {
+    return map.find(key);
+}
+
+// times `operations` calls of step(i) by batches, returns the ns/op of every batch
+template <typename Step>
+std::vector<uint64_t> timeBatches(size_t operations, Step&& step) {
+    std::vector<uint64_t> samples;
+    samples.reserve(operations / kBatch + 1);
+    for (size_t done = 0; done < operations; done += kBatch) {
+        const size_t count = std::min(kBatch, operations - done);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = done; i < done + count; ++i) {
+            step(i);
+        }
+        auto end = std::chrono::steady_clock::now();
+        const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        samples.push_back(static_cast<uint64_t>(nanoseconds) / count);
+    }
+    return samples;
+}
+
+// ranks 0..size-1 drawn with the weight 1/(rank+1): a few keys take most of the traffic
+std::vector<size_t> zipfRanks(size_t size, size_t count, std::mt19937_64& rng) {
+    std::vector<double> weights(size);
+    for (size_t rank = 0; rank < size; ++rank) {
+        weights[rank] = 1.0 / static_cast<double>(rank + 1);
+    }
+    std::discrete_distribution<size_t> dist(weights.begin(), weights.end());
+    std::vector<size_t> ranks(count);
+    for (size_t& rank : ranks) {
+        rank = dist(rng);
+    }
+    return ranks;
+}
+
+// one round = insert of the next id, lookup of a random live id, erase of a random live id (3 operations)
+template <typename Map>
+std::vector<uint64_t> benchOrderIds(size_t size, size_t operations, std::mt19937_64& rng) {
+    Map map;
+    std::vector<long long> live; // the ids in the table, for the random picks
+    long long next_id = 1;
+    for (size_t i = 0; i < size; ++i) {
+        map[next_id] = static_cast<uint32_t>(i);
+        live.push_back(next_id++);
+    }
+    const size_t rounds = operations / 3;
+    std::vector<size_t> picks(rounds * 2);
+    for (size_t i = 0; i < picks.size(); ++i) {
+        picks[i] = static_cast<size_t>(rng() % (size + (i & 1))); // the erase sees the id just added
+    }
+    std::vector<uint64_t> samples = timeBatches(rounds, [&](size_t i) {
+        map[next_id] = static_cast<uint32_t>(i);
+        live.push_back(next_id++);
+        const uint32_t* slot = lookup(map, live[picks[2 * i]]);
+        g_sink = g_sink + (slot != nullptr ? *slot : 0);
+        const size_t victim = picks[2 * i + 1];
+        map.erase(live[victim]);
+        live[victim] = live.back();
+        live.pop_back();
+    });
+    for (uint64_t& sample : samples) {
+        sample /= 3;
+    }
+    return samples;
+}
+
+// lookups of symbols that are all in the table (the parser and the symbol table see known instruments)
+template <typename Map>
+std::vector<uint64_t> benchSymbols(size_t size, size_t operations, std::mt19937_64& rng) {
+    std::deque<std::string> names;
+    Map map;
+    for (size_t i = 0; i < size; ++i) {
+        names.push_back("SYM" + std::to_string(i * 7919 % 1000003)); // unordered, like real tickers
+        map[names.back()] = static_cast<uint32_t>(i);
+    }
+    // the lookups use other copies of the text, like the views into the input buffer
+    std::deque<std::string> input(names.begin(), names.end());
+    std::vector<std::string_view> keys;
+    keys.reserve(operations);
+    for (size_t rank : zipfRanks(size, operations, rng)) {
+        keys.push_back(input[rank]);
+    }
+    return timeBatches(operations, [&](size_t i) {
+        const uint32_t* id = lookup(map, keys[i]);
+        g_sink = g_sink + (id != nullptr ? *id : 0);
+    });
+}
+
+template <typename Map>
+std::vector<uint64_t> benchAccounts(size_t size, size_t operations, std::mt19937_64& rng) {
+    std::vector<uint32_t> accounts;
+    for (size_t rank : zipfRanks(size, operations, rng)) {
+        accounts.push_back(static_cast<uint32_t>(rank * 2654435761ULL % (size * 4))); // sparse ids
+    }
+    Map map;
+    return timeBatches(operations, [&](size_t i) { map[accounts[i]]++; });
+}
+
+// the account counts in a vector indexed by the id (no hashing, but as large as the biggest id)
+std::vector<uint64_t> benchAccountsVector(size_t size, size_t operations, std::mt19937_64& rng) {
+    std::vector<uint32_t> accounts;
+    for (size_t rank : zipfRanks(size, operations, rng)) {
+        accounts.push_back(static_cast<uint32_t>(rank * 2654435761ULL % (size * 4)));
+    }
+    std::vector<uint32_t> counts(size * 4, 0);
+    std::vector<uint64_t> samples = timeBatches(operations, [&](size_t i) { counts[accounts[i]]++; });
+    g_sink = g_sink + counts[accounts[0]];
+    return samples;
+}
+
+struct BenchResult {
+    std::string workload;
+    std::string container;
+    size_t size;
+    LatencySummary latency;
+};
+
+bool parseSizeList(const std::string& text, std::vector<size_t>& values) {
+    values.clear();
+    std::stringstream ss(text);
+    std::string entry;
+    while (std::getline(ss, entry, ',')) {
+        if (entry.empty()) {
+            continue;
+        }
+        try {
+            size_t parsed_chars = 0;
+            unsigned long value = std::stoul(entry, &parsed_chars);
+            if (parsed_chars != entry.size() || value == 0) {
+                return false;
+            }
+            values.push_back(static_cast<size_t>(value));
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return !values.empty();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    ArgumentParser parser("FlatHashMap against std::unordered_map and std::map on the keys of the engine");
+    parser.add_flag({"--sizes"})
+        .help("Comma-separated table sizes (live orders, symbols or accounts).")
+        .set_default(std::string("100,10000,1000000"))
+        .type_string();
+    parser.add_flag({"--operations"})
+        .help("Measured operations per workload, container and size.")
+        .set_default(1000000)
+        .type_int();
+    parser.add_flag({"--seed"})
+        .help("Seed of the random keys.")
+        .set_default(42)
+        .type_int();
+    parser.add_flag({"--output"})
+        .help("CSV file receiving the results.")
+        .set_default(std::string("hash_map_bench.csv"))
+        .type_string();
+
+    std::vector<size_t> sizes;
+    size_t operations = 0;
+    unsigned int seed = 0;
+    std::string output_path;
+    try {
+        parser.parse_args(argc, argv);
+        if (!parseSizeList(parser.get<std::string>("sizes"), sizes)) {
+            throw std::runtime_error("Invalid value for --sizes: expected a list like '100,10000'.");
+        }
+        int operations_arg = parser.get<int>("operations");
+        if (operations_arg < 3) {
+            throw std::runtime_error("Invalid value for --operations: it must be at least 3.");
+        }
+        operations = static_cast<size_t>(operations_arg);
+        seed = static_cast<unsigned int>(parser.get<int>("seed"));
+        output_path = parser.get<std::string>("output");
+    } catch (const std::runtime_error& err) {
+        std::cerr << "Error parsing arguments: " << err.what() << std::endl;
+        parser.print_help();
+        return 1;
+    }
+
+    struct Run {
+        std::string workload;
+        std::string container;
+        std::function<std::vector<uint64_t>(size_t, size_t, std::mt19937_64&)> run;
+    };
+    const std::vector<Run> runs = {
+        {"order_ids", "flat", benchOrderIds<FlatHashMap<long long, uint32_t>>},
+        {"order_ids", "unordered_map", benchOrderIds<std::unordered_map<long long, uint32_t>>},
+        {"order_ids", "map", benchOrderIds<std::map<long long, uint32_t>>},
+        {"symbols", "flat", benchSymbols<FlatHashMap<std::string_view, uint32_t>>},
+        {"symbols", "unordered_map", benchSymbols<std::unordered_map<std::string_view, uint32_t>>},
+        {"symbols", "map", benchSymbols<std::map<std::string, uint32_t, std::less<>>>},
+        {"accounts", "flat", benchAccounts<FlatHashMap<uint32_t, uint32_t>>},
+        {"accounts", "unordered_map", benchAccounts<std::unordered_map<uint32_t, uint32_t>>},
+        {"accounts", "map", benchAccounts<std::map<uint32_t, uint32_t>>},
+        {"accounts", "vector", benchAccountsVector},
+    };
+
+    std::vector<BenchResult> results;
+    std::cout << std::left << std::setw(11) << "workload" << std::setw(15) << "container" << std::right
+              << std::setw(9) << "size" << std::setw(10) << "mean_ns" << std::setw(7) << "p50"
+              << std::setw(7) << "p90" << std::setw(7) << "p99" << std::setw(8) << "max" << "\n";
+    for (const Run& run : runs) {
+        for (size_t size : sizes) {
+            std::mt19937_64 rng(seed);
+            std::vector<uint64_t> samples = run.run(size, operations, rng);
+            BenchResult result{run.workload, run.container, size, summarizeLatencies(samples)};
+            std::cout << std::left << std::setw(11) << result.workload << std::setw(15) << result.container
+                      << std::right << std::setw(9) << size << std::setw(10) << std::fixed << std::setprecision(1)
+                      << result.latency.mean_ns << std::setw(7) << result.latency.p50_ns << std::setw(7)
+                      << result.latency.p90_ns << std::setw(7) << result.latency.p99_ns << std::setw(8)
+                      << result.latency.max_ns << "\n";
+            results.push_back(result);
+        }
+    }
+
+    std::ofstream output_file(output_path);
+    if (!output_file.is_open()) {
+        std::cerr << "Failed to open the result file: " << output_path << std::endl;
+        return 1;
+    }
+    output_file << "workload,container,size,batches,mean_ns,p50_ns,p90_ns,p99_ns,max_ns\n";
+    for (const BenchResult& result : results) {
+        output_file << result.workload << ',' << result.container << ',' << result.size << ','
+                    << result.latency.count << ',' << std::fixed << std::setprecision(1) << result.latency.mean_ns
+                    << ',' << result.latency.p50_ns << ',' << result.latency.p90_ns << ',' << result.latency.p99_ns
+                    << ',' << result.latency.max_ns << '\n';
+    }
+    std::cout << "Results written to " << output_path << "\n";
+    return 0;
+}
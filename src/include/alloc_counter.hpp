@@ -0,0 +1,14 @@
+#pragma once
+
+// Counts the heap allocations (every call of the global operator new) made by each thread.
+// The counting operator new/delete are defined in alloc_counter.cpp, so every binary that links
+// it gets the counter; the order books use it to prove that their hot path does not allocate.
+namespace alloc_counter {
+
+// number of allocations made so far by the calling thread
+unsigned long long thread_allocations();
+
+// number of allocations made so far by all the threads
+unsigned long long total_allocations();
+
+} // namespace alloc_counter
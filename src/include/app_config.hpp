@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 #include "argparse.hpp" // Assuming argparse.h is in the include path
+#include "wait_strategy.hpp"
+#include "risk_checks.hpp"
 
 class AppConfig {
 public:
@@ -20,9 +22,44 @@ public:
     const std::string& get_log_level() const;
     const std::string& get_log_file() const; // Empty string means log to stdout
     bool is_log_to_stdout() const;
+    bool is_async_logging() const; // --log-mode async: the lines are written by a background thread
     const std::string& get_order_input_file() const;
     const std::string& get_order_result_output_file() const;
     long int get_queue_size() const;
+    const std::string& get_book_type() const; // "map" (reference std::map book) or "ladder" (flat tick ladder)
+    const std::string& get_book_memory() const; // "heap" or "huge-pages" (pool_memory.hpp)
+    double get_tick_size() const; // default tick size of every instrument
+    const std::string& get_tick_size_overrides() const; // "INSTRUMENT=TICK,..." per-instrument tick sizes
+    const std::string& get_input_mode() const; // "mmap" (memory-mapped parser) or "stream" (std::istream)
+    const std::string& get_csv_simd() const; // "auto", "avx2", "sse4.2" or "scalar" (csv_simd.hpp)
+    size_t get_reader_threads() const; // threads parsing the input in chunks (mmap mode)
+    const std::string& get_input_format() const; // "csv" or "binary" (see binary_format.hpp)
+    const std::string& get_output_format() const; // "csv" or "binary"
+    const std::string& get_output_io() const; // "sync", "pwrite" or "io_uring" (output_file.hpp)
+    bool is_output_direct() const; // --output-cache direct: O_DIRECT output files
+    WaitStrategyType get_wait_strategy() const; // how the pipeline threads wait for their queues
+    size_t get_worker_count() const; // number of matching threads (0 = one per core)
+    const std::vector<int>& get_worker_cpus() const; // cpus of the matching threads (empty = not pinned)
+    int get_stats_interval() const; // milliseconds between two dumps of the pipeline stats (0 = no dumps)
+    const std::string& get_snapshot_in() const;  // snapshot loaded at startup (empty = start with empty books)
+    const std::string& get_snapshot_out() const; // snapshot written at the end (empty = none)
+    unsigned long long get_snapshot_every() const; // input orders between two snapshots while running (0 = end only)
+    const std::string& get_journal() const;      // write-ahead journal of the input orders (empty = none)
+    int get_journal_commit_us() const;           // latency budget of a journal group commit, in microseconds
+    const std::string& get_market_data() const;  // level 2 market data file (empty = none)
+    unsigned long long get_market_data_snapshot_every() const; // orders of a book between two depth snapshots (0 = none)
+    bool is_gateway_enabled() const;             // orders from the network (gateway.hpp) instead of the input file
+    int get_gateway_tcp_port() const;            // 0 = no TCP listener
+    int get_gateway_udp_port() const;            // 0 = no UDP socket
+    const std::string& get_gateway_multicast() const;
+    const std::string& get_gateway_address() const;
+    const std::string& get_risk_limits() const;         // default limits of the accounts (empty = none)
+    const std::string& get_risk_account_limits() const; // CSV file of per-account limits (empty = none)
+    uint32_t get_risk_max_accounts() const;             // size of the per-account tables
+    const std::string& get_self_trade_prevention() const; // "none", "cancel-resting", "cancel-incoming", "cancel-both"
+    bool is_risk_enabled() const { return !risk_limits_.empty() || !risk_account_limits_.empty(); }
+    const std::vector<std::string>& get_shards() const; // matching processes of the front-end (empty = local workers)
+    const std::string& get_shard_listen() const;        // endpoint of this matching process (empty = not a shard)
 
 private:
     ArgumentParser parser_; // The argument parser instance
@@ -30,9 +67,42 @@ private:
     // Member variables to store the parsed values
     std::string log_level_;
     std::string log_file_; // An empty string will represent "none" / stdout
+    std::string log_mode_; // "sync" or "async"
     std::string order_input_file_;
     std::string order_result_output_file_;
     long int queue_size_;
+    std::string book_type_;
+    std::string book_memory_;
+    double tick_size_;
+    std::string tick_size_overrides_;
+    std::string wait_strategy_;
+    std::string input_mode_;
+    std::string csv_simd_;
+    int reader_threads_ = 1;
+    std::string input_format_;
+    std::string output_format_;
+    std::string output_io_;
+    std::string output_cache_;
+    int worker_count_ = 0;
+    std::vector<int> worker_cpus_;
+    int stats_interval_ = 0;
+    std::string snapshot_in_;
+    std::string snapshot_out_;
+    int snapshot_every_ = 0;
+    std::string journal_;
+    int journal_commit_us_ = 1000;
+    std::string market_data_;
+    int market_data_snapshot_every_ = 10000;
+    int gateway_tcp_port_ = 0;
+    int gateway_udp_port_ = 0;
+    std::string gateway_multicast_;
+    std::string gateway_address_;
+    std::string risk_limits_;
+    std::string risk_account_limits_;
+    int risk_max_accounts_ = 4096;
+    std::string self_trade_prevention_ = "none";
+    std::vector<std::string> shards_;
+    std::string shard_listen_;
 
     // Flag to indicate if parsing was successful and values are populated
     bool successfully_parsed_ = false;
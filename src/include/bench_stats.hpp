@@ -0,0 +1,42 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Summary of a set of latency samples (nanoseconds), used by the benchmark programs
+struct LatencySummary {
+    size_t count = 0;
+    double mean_ns = 0.0;
+    uint64_t p50_ns = 0;
+    uint64_t p90_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+    uint64_t max_ns = 0;
+};
+
+// sorts the samples in place. Percentiles are the nearest-rank sample (no interpolation)
+inline LatencySummary summarizeLatencies(std::vector<uint64_t>& samples) {
+    LatencySummary summary;
+    summary.count = samples.size();
+    if (samples.empty()) {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](double fraction) {
+        size_t rank = static_cast<size_t>(fraction * static_cast<double>(samples.size()));
+        return samples[std::min(rank, samples.size() - 1)];
+    };
+    double total = 0.0;
+    for (uint64_t sample : samples) {
+        total += static_cast<double>(sample);
+    }
+    summary.mean_ns = total / static_cast<double>(samples.size());
+    summary.p50_ns = percentile(0.50);
+    summary.p90_ns = percentile(0.90);
+    summary.p99_ns = percentile(0.99);
+    summary.p999_ns = percentile(0.999);
+    summary.max_ns = samples.back();
+    return summary;
+}
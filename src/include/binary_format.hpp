@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>   // For std::memcpy
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "logger.hpp"
+#include "order.hpp"
+#include "orderbook.hpp"       // For ExecutionReport
+#include "symbol_table.hpp"
+#include "tick_size.hpp"
+#include "csv_mmap_reader.hpp" // For MappedFile
+
+// Compact binary files of orders ("--input-format binary"), of execution reports ("--output-format binary")
+// and of the state of the books (snapshots, see book_snapshot.hpp).
+// A file is made of three sections, every one starting at a multiple of 8 bytes:
+//   BinaryFileHeader   fixed size: magic, version, kind of records, record size, counts and section offsets
+//   records            record_count fixed-width records (BinaryOrderRecord, BinaryReportRecord or BinaryRestingOrderRecord)
+//   symbol table       symbol_count entries "uint32 length + name bytes", in symbol id order
+// Records carry the instrument as an index in the symbol table instead of repeating its name.
+// The symbol table is stored after the records so that a file can be written in one streaming pass;
+// the header gives its offset, so a reader maps the file and looks it up first.
+// Numbers are stored in the byte order of the machine (little-endian on every target we build for).
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+#error "the binary order/report format is little-endian"
+#endif
+
+constexpr char kBinaryMagic[8] = {'M', 'E', 'B', 'I', 'N', 'A', 'R', 'Y'};
+// bump it whenever a record or the header changes
+constexpr uint32_t kBinaryFormatVersion = 3; // 2: time in force, post-only and iceberg fields. 3: account
+
+enum class BinaryFileKind : uint32_t {
+    ORDERS = 1,
+    EXECUTION_REPORTS = 2,
+    BOOK_SNAPSHOT = 3
+};
+
+struct BinaryFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;          // BinaryFileKind
+    uint32_t record_size;   // sizeof the record of this kind, checked by the reader
+    uint32_t symbol_count;
+    uint64_t record_count;
+    uint64_t records_offset;
+    uint64_t symbols_offset;
+    uint64_t input_offset;  // BOOK_SNAPSHOT: number of input orders already applied to the books (0 otherwise)
+    uint64_t reserved;
+};
+static_assert(sizeof(BinaryFileHeader) == 64, "the binary header layout is part of the file format");
+
+// One order of the input (the fields of the CSV line, already validated by the parser)
+struct BinaryOrderRecord {
+    uint64_t timestamp;
+    int64_t order_id;
+    uint64_t quantity;
+    double price;        // kept as it was written, it is converted into ticks when the file is loaded
+    uint64_t display_quantity; // iceberg: quantity shown in the book (0 = all of it)
+    uint32_t symbol_id;  // index in the symbol table of the file
+    uint8_t side;        // Side
+    uint8_t type;        // OrderType
+    uint8_t action;      // OrderAction
+    uint8_t flags;       // time in force and post-only (packOrderFlags)
+    uint32_t account_id; // 0 = no account
+    uint32_t reserved;
+};
+static_assert(sizeof(BinaryOrderRecord) == 56, "the binary order layout is part of the file format");
+
+// One line of the output (same fields as ExecutionReport)
+struct BinaryReportRecord {
+    uint64_t timestamp;
+    int64_t order_id;
+    uint64_t quantity;
+    double price;
+    uint64_t executed_quantity;
+    double execution_price;
+    int64_t counterparty_id;
+    uint32_t symbol_id;  // index in the symbol table of the file
+    uint8_t side;        // Side
+    uint8_t type;        // OrderType
+    uint8_t action;      // OrderAction
+    uint8_t status;      // OrderStatus
+};
+static_assert(sizeof(BinaryReportRecord) == 64, "the binary report layout is part of the file format");
+
+// One resting order of a book snapshot. The records of a book are in priority order:
+// bids then asks, best price first, and oldest first within a price level
+struct BinaryRestingOrderRecord {
+    uint64_t timestamp;          // time priority of the order (the timestamp of its last NEW or MODIFY)
+    int64_t order_id;
+    uint64_t quantity;           // total quantity of the order
+    uint64_t remaining_quantity;
+    uint64_t cumulative_executed_quantity;
+    double price;                // converted into ticks again when the snapshot is loaded
+    uint64_t display_quantity;   // iceberg: size of the shown part (0 = all of it)
+    uint64_t hidden_quantity;    // iceberg: part of remaining_quantity not shown (the reserve)
+    uint32_t symbol_id;          // index in the symbol table of the file
+    uint8_t side;                // Side
+    uint8_t type;                // OrderType
+    uint8_t action;              // OrderAction (the last action, printed in the reports of the order)
+    uint8_t status;              // OrderStatus
+    uint32_t account_id;         // 0 = no account
+    uint32_t reserved;
+};
+static_assert(sizeof(BinaryRestingOrderRecord) == 80, "the binary snapshot layout is part of the file format");
+
+BinaryOrderRecord toBinaryRecord(const Order& order);
+BinaryReportRecord toBinaryRecord(const ExecutionReport& report);
+ExecutionReport fromBinaryRecord(const BinaryReportRecord& record);
+BinaryRestingOrderRecord toSnapshotRecord(const Order& resting_order);
+
+// Writes a binary file record by record through a buffer, then the symbol table and the header on close()
+class BinaryFileWriter {
+public:
+    // size of the buffer, flushed with one write() when it is full
+    static constexpr size_t kBufferBytes = 1 << 20;
+
+    BinaryFileWriter(BinaryFileKind kind, uint32_t record_size);
+    ~BinaryFileWriter();
+
+    BinaryFileWriter(const BinaryFileWriter&) = delete;
+    BinaryFileWriter& operator=(const BinaryFileWriter&) = delete;
+
+    // create (or truncate) the file, returns false (and the reason in error) on failure
+    bool open(const std::string& path, std::string& error);
+    // copy one record of record_size bytes
+    void appendRecord(const void* record);
+    // write the symbol table (every name of symbols, by id) and the header, then close the file
+    bool close(const SymbolTable& symbols, std::string& error);
+    // written in the header by close() (snapshots only)
+    void setInputOffset(uint64_t input_offset) { input_offset_ = input_offset; }
+
+    uint64_t getRecordCount() const { return record_count_; }
+
+private:
+    void appendBytes(const void* bytes, size_t size);
+    void writeBuffer();
+
+    BinaryFileKind kind_;
+    uint32_t record_size_;
+    std::vector<char> buffer_;
+    size_t used_ = 0;
+    int fd_ = -1;
+    int write_errno_ = 0; // errno of the first failed write
+    uint64_t file_size_ = 0; // bytes appended so far, header included
+    uint64_t record_count_ = 0;
+    uint64_t input_offset_ = 0;
+};
+
+// Same interface as ReportWriter, for --output-format binary
+class BinaryReportWriter {
+public:
+    explicit BinaryReportWriter(const SymbolTable& symbols);
+
+    bool open(const std::string& path, std::string& error) { return file_.open(path, error); }
+    void writeHeader() {} // the header is written by close(), once the counts are known
+    void append(const ExecutionReport& report) {
+        BinaryReportRecord record = toBinaryRecord(report);
+        file_.appendRecord(&record);
+    }
+    bool close(std::string& error) { return file_.close(symbols_, error); }
+
+private:
+    const SymbolTable& symbols_;
+    BinaryFileWriter file_;
+};
+
+// Memory-mapped binary file: the records are read in place, nothing is parsed
+class BinaryFileReader {
+public:
+    // map the file and check its header and sections. Returns false (and the reason in error) if it is unusable
+    bool open(const std::string& path, BinaryFileKind expected_kind, std::string& error);
+
+    const BinaryFileHeader& header() const { return header_; }
+    size_t recordCount() const { return static_cast<size_t>(header_.record_count); }
+    // names of the symbol table, by symbol id of the file (views into the mapping)
+    const std::vector<std::string_view>& symbols() const { return symbols_; }
+
+    // copy of the index-th record (the mapping gives no alignment guarantee to the compiler)
+    template <typename Record>
+    Record record(size_t index) const;
+
+    // true if the file starts with the binary magic (whatever its version)
+    static bool hasMagic(const std::string& path);
+    // read the header of a file to know which kind of binary file it is.
+    // Returns false (and the reason in error) if it is not a binary file of this version
+    static bool readKind(const std::string& path, BinaryFileKind& kind, std::string& error);
+
+private:
+    MappedFile file_;
+    BinaryFileHeader header_{};
+    const char* records_ = nullptr;
+    std::vector<std::string_view> symbols_;
+};
+
+template <typename Record>
+Record BinaryFileReader::record(size_t index) const {
+    Record result;
+    std::memcpy(&result, records_ + index * sizeof(Record), sizeof(Record));
+    return result;
+}
+
+// Map a binary order file and push its orders into the queue (the queue is not closed here).
+// The instruments of the symbol table are interned first, then every record is turned into an Order
+// (the only work is the conversion of the price into ticks).
+// Returns false without reading anything if the file cannot be used.
+// parse_latency, if given, receives the conversion time per order (measured per batch)
+bool readOrdersFromBinaryFile(const std::string& path, Logger& logger, OrderQueue& order_queue,
+                              const TickSizeTable& tick_sizes, SymbolTable& symbols,
+                              LatencyHistogram* parse_latency = nullptr);
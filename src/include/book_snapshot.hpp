@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "logger.hpp"
+#include "symbol_table.hpp"
+#include "tick_size.hpp"
+#include "worker_pool.hpp"
+
+// Snapshots of the state of every book, for a warm restart without replaying the whole input.
+// A snapshot is a binary file of kind BOOK_SNAPSHOT (binary_format.hpp):
+//   - one BinaryRestingOrderRecord per resting order, book by book (in symbol id order),
+//     each book in priority order (bids then asks, best price first, oldest first within a level)
+//   - the names of the instruments in the symbol table section
+//   - the input offset in the header: how many orders of the input the books already contain
+// Restoring the records in that order rebuilds the same price levels and the same FIFO queues,
+// whatever the book type and the number of workers of either run.
+// The counters of the books (processed orders, fills...) are statistics of one run, they are not saved.
+
+// Write the resting orders of every book of the pool and the input offset.
+// The workers must not be processing orders (not started, stopped, or WorkerPool::waitUntilIdle()).
+// The file is written next to path and renamed over it once complete, so a crash while writing
+// never leaves a truncated snapshot behind. Returns false (and the reason in error) on failure
+bool writeBookSnapshot(const std::string& path, const WorkerPool& worker_pool, const SymbolTable& symbols,
+                       uint64_t input_offset, std::string& error);
+
+// Load a snapshot into the books of the pool (before WorkerPool::start()).
+// The instruments are interned into symbols and the prices converted into ticks with tick_sizes,
+// like the orders of a binary input file. input_offset receives the number of input orders to skip.
+// Returns false if the file cannot be used (the books are then left empty)
+bool loadBookSnapshot(const std::string& path, WorkerPool& worker_pool, const TickSizeTable& tick_sizes,
+                      SymbolTable& symbols, uint64_t& input_offset, Logger& logger);
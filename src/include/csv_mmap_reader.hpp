@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "csv_simd.hpp"
+#include "flat_hash_map.hpp"
+#include "logger.hpp"
+#include "order.hpp"
+#include "symbol_table.hpp"
+#include "tick_size.hpp"
+#include "ring_buffer.hpp"
+
+// Fast ingestion of the CSV order file ("--input-mode mmap").
+// The whole file is memory-mapped and parsed in place with std::string_view:
+// no std::getline, no stringstream, no std::string per field, and the header is resolved once
+// into a fixed array of column positions. Once the symbol cache is warm, a line is parsed
+// without any heap allocation.
+// The delimiters are found 64 bytes at a time and the numbers converted with SIMD fast paths
+// (csv_simd.hpp); a field the fast paths do not handle goes through std::from_chars.
+// It accepts the same files and produces the same orders as readOrdersFromStream.
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // map the file, returns false (and the reason in error) if it cannot be opened or mapped
+    bool open(const std::string& path, std::string& error);
+
+    std::string_view contents() const { return std::string_view(data_, size_); }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    void* mapping_ = nullptr;
+};
+
+// Position of each known column in a CSV line, resolved once from the header
+struct CsvColumnIndex {
+    // the columns from TIME_IN_FORCE on are optional (extended order types, account), like PRICE
+    enum Column : size_t { TIMESTAMP, ORDER_ID, INSTRUMENT, SIDE, TYPE, QUANTITY, PRICE, ACTION,
+                           TIME_IN_FORCE, POST_ONLY, DISPLAY_QUANTITY, ACCOUNT, COLUMN_COUNT };
+    static constexpr size_t kMissing = std::numeric_limits<size_t>::max();
+    static constexpr bool isOptional(size_t column) { return column == PRICE || column >= TIME_IN_FORCE; }
+
+    std::array<size_t, COLUMN_COUNT> position{};
+    // number of distinct column names of the header: every data line must have this many fields
+    size_t field_count = 0;
+};
+
+// Cuts whole lines of the file into lines, and finds the commas of every line on the way: the delimiters
+// are classified by blocks of 64 bytes (csv_simd.hpp), so every byte of the input is compared only once
+class CsvLineScanner {
+public:
+    CsvLineScanner(std::string_view text, csv_simd::Level level);
+
+    // next line without its '\n' (the same lines as std::getline), and the position of each of its commas.
+    // Returns false at the end of the text
+    bool nextLine(std::string_view& line, std::vector<const char*>& commas);
+
+private:
+    // classify the 64 bytes from block_start (zero padded past the end of the text)
+    void loadBlock(size_t block_start);
+
+    std::string_view text_;
+    csv_simd::Level level_;
+    size_t position_ = 0;    // start of the next line
+    size_t block_start_ = 0; // offset of the classified block in text_
+    uint64_t commas_ = 0;    // delimiters of the block after position_
+    uint64_t newlines_ = 0;
+};
+
+// Parses the (already trimmed) lines of the order file into Orders.
+// One parser per thread: it keeps a cache of the instruments it has seen (views into the mapped file).
+class FastOrderParser {
+public:
+    FastOrderParser(const TickSizeTable& tick_sizes, SymbolTable& symbols, Logger& logger);
+
+    // read the header line. Returns false (and logs the reason) if it is unusable
+    bool parseHeader(std::string_view header_line);
+    const CsvColumnIndex& columns() const { return columns_; }
+    void setColumns(const CsvColumnIndex& columns) { columns_ = columns; }
+
+    // parse one non-empty trimmed data line, with the positions of its commas (CsvLineScanner).
+    // Returns false if the line is skipped (the reason is logged)
+    bool parseLine(std::string_view line, const std::vector<const char*>& commas, long long line_number, Order& order);
+
+    // SIMD level of the tokenizer (csv_simd::activeLevel() when the parser was created)
+    csv_simd::Level level() const { return level_; }
+
+private:
+    struct SymbolInfo {
+        uint32_t symbol_id = 0;
+        double tick_size = 0.0;
+    };
+    const SymbolInfo& symbolFor(std::string_view instrument);
+
+    const TickSizeTable& tick_sizes_;
+    SymbolTable& symbols_;
+    Logger& logger_;
+    csv_simd::Level level_;
+    CsvColumnIndex columns_;
+    std::vector<std::string_view> fields_; // fields of the current line (reused, so no allocation)
+    FlatHashMap<std::string_view, SymbolInfo> symbol_cache_;
+};
+
+// delete the blank characters at both ends of a view (same characters as std::isspace)
+std::string_view trimView(std::string_view text);
+
+// size of the chunks of the parallel mode (a chunk is extended to the end of its last line)
+constexpr size_t kParallelChunkBytes = 1 << 20;
+
+// Map the file and push its orders into the queue (the queue is not closed here).
+// With reader_threads > 1 the data lines are cut into chunks at newline boundaries and parsed in parallel;
+// the chunks are then pushed back in their order in the file, so the queue receives exactly the same
+// sequence of orders as with a single reader.
+// Returns false without reading anything if the file cannot be mapped (the caller can fall back
+// to readOrdersFromStream).
+// parse_latency, if given, receives the parsing time per order (measured per batch, or per chunk
+// in the parallel mode, where it is filled once every chunk is parsed)
+bool readOrdersFromMappedFile(const std::string& path, Logger& logger, OrderQueue& order_queue,
+                              const TickSizeTable& tick_sizes, SymbolTable& symbols, size_t reader_threads = 1,
+                              LatencyHistogram* parse_latency = nullptr);
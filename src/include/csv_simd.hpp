@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Vectorized pieces of the CSV parser of the mmap input mode (csv_mmap_reader.hpp):
+//   - the delimiters (',' and '\n') of 64 bytes of input are found at once, as two bit masks:
+//     two 32-byte compares with AVX2, four 16-byte compares with SSE, a byte loop otherwise
+//   - a field of up to 16 digits is checked and converted in a few SSE instructions
+//     (multiply-adds of the digit pairs, then of the pairs of pairs...)
+//   - the side / type / action keywords are compared as one 64-bit word
+// The level is picked at runtime from the cpu (the functions of each level are compiled with their own target
+// attribute, so one binary runs everywhere), unless the build pins it (cmake -DENGINE_CSV_SIMD=SCALAR, SSE42 or
+// AVX2) or --csv-simd selects one. Every level gives exactly the same orders.
+namespace csv_simd {
+
+enum class Level : uint8_t {
+    SCALAR,
+    SSE42,
+    AVX2
+};
+
+const char* levelToString(Level level); // "scalar", "sse4.2", "avx2"
+// "scalar", "sse4.2" or "avx2". Returns false for anything else ("auto" is handled by the caller)
+bool parseLevel(std::string_view text, Level& level);
+
+// true if this cpu can run the level
+bool isSupported(Level level);
+// the level of the build option, or the best one of this cpu
+Level defaultLevel();
+
+// level used by the parsers created from now on (the default level until this is called).
+// A level the cpu does not support is lowered to the best supported one, which is returned
+Level setActiveLevel(Level level);
+Level activeLevel();
+
+// bit i of commas / newlines is set if block[i] is ',' / '\n'. The 64 bytes of block must be readable
+struct BlockMasks {
+    uint64_t commas;
+    uint64_t newlines;
+};
+BlockMasks classifyBlock(Level level, const char* block);
+
+// value of count (1 to 16) ASCII digits. Returns false if one of the bytes is not a digit
+bool parseDigits(Level level, const char* digits, size_t count, uint64_t& value);
+
+// A keyword of at most 8 letters as one word: a token is the keyword if it has the same size and the same bytes
+// once upper-cased. Bit 5 of every byte is cleared instead of calling toupper: for a keyword made of letters
+// only, the two cases of each letter are the only bytes that give the same value.
+struct KeywordToken {
+    uint64_t word;
+    size_t size;
+
+    bool operator==(const KeywordToken& other) const { return word == other.word && size == other.size; }
+};
+
+constexpr uint64_t kCaseBits = 0x2020202020202020ULL;
+
+// an upper case keyword, at compile time
+constexpr KeywordToken keyword(std::string_view upper_keyword) {
+    uint64_t word = 0;
+    for (size_t i = 0; i < upper_keyword.size() && i < 8; ++i) {
+        word |= static_cast<uint64_t>(static_cast<unsigned char>(upper_keyword[i])) << (8 * i);
+    }
+    return KeywordToken{word & ~kCaseBits, upper_keyword.size()};
+}
+
+// a field of the input (longer than 8 bytes: matches no keyword)
+inline KeywordToken token(std::string_view text) {
+    if (text.size() > 8) {
+        return KeywordToken{0, text.size()};
+    }
+    uint64_t word = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        word |= static_cast<uint64_t>(static_cast<unsigned char>(text[i])) << (8 * i);
+    }
+    return KeywordToken{word & ~kCaseBits, text.size()};
+}
+
+} // namespace csv_simd
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Hash of the keys of FlatHashMap. Integer keys are mixed (order ids and account ids are often consecutive,
+// their low bits alone would fill neighbouring slots), strings go through FNV-1a.
+template <typename Key, typename Enable = void>
+struct FlatHash;
+
+template <typename Key>
+struct FlatHash<Key, std::enable_if_t<std::is_integral_v<Key>>> {
+    size_t operator()(Key key) const {
+        uint64_t x = static_cast<uint64_t>(key);
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        return static_cast<size_t>(x);
+    }
+};
+
+template <>
+struct FlatHash<std::string_view> {
+    size_t operator()(std::string_view text) const {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (char c : text) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 0x100000001b3ULL;
+        }
+        return static_cast<size_t>(hash ^ (hash >> 32)); // the low bits pick the slot: fold the high ones in
+    }
+};
+
+// Open-addressing hash map in one flat array: the keys and the values are stored in the slots themselves,
+// so a lookup is a hash and a few contiguous reads, and an insertion never allocates a node.
+//   - the capacity is a power of two (the slot is the low bits of the hash) and the table doubles when it is
+//     3/4 full; it never shrinks, so a warm table does not allocate any more
+//   - Robin Hood probing: every slot keeps its distance to the home slot of its key, and an insertion takes the
+//     slot of a key that is closer to its own home. The probe lengths stay short and even, and a lookup
+//     stops as soon as it meets a key closer to home than it would be (no full scan of a cluster for a miss)
+//   - erase shifts the following keys of the cluster back by one: no tombstones
+// Key and Value must be default constructible and copyable (ids, small structs, string_views into storage that
+// outlives the map). The pointers and references returned stay valid until the next insertion or erase.
+template <typename Key, typename Value, typename Hash = FlatHash<Key>>
+class FlatHashMap {
+public:
+    explicit FlatHashMap(size_t initial_capacity = 16) { allocate(capacityFor(initial_capacity)); }
+
+    // value of the key, or nullptr
+    Value* find(const Key& key) {
+        const size_t pos = findPosition(key);
+        return pos == kNoPosition ? nullptr : &slots_[pos].value;
+    }
+    const Value* find(const Key& key) const {
+        const size_t pos = findPosition(key);
+        return pos == kNoPosition ? nullptr : &slots_[pos].value;
+    }
+    bool contains(const Key& key) const { return findPosition(key) != kNoPosition; }
+
+    // adds the key, or replaces its value. Returns the value in the table
+    Value& insert_or_assign(const Key& key, const Value& value) {
+        Value* existing = find(key);
+        if (existing != nullptr) {
+            *existing = value;
+            return *existing;
+        }
+        return insertNew(key, value);
+    }
+
+    // value of the key, added with a default value if the key is not there
+    Value& operator[](const Key& key) {
+        Value* existing = find(key);
+        return existing != nullptr ? *existing : insertNew(key, Value());
+    }
+
+    // removes the key, returns false if it was not there
+    bool erase(const Key& key) {
+        const size_t pos = findPosition(key);
+        if (pos == kNoPosition) {
+            return false;
+        }
+        eraseAt(pos);
+        return true;
+    }
+
+    // removes the key and copies its value into erased_value, returns false if the key was not there
+    bool extract(const Key& key, Value& erased_value) {
+        const size_t pos = findPosition(key);
+        if (pos == kNoPosition) {
+            return false;
+        }
+        erased_value = slots_[pos].value;
+        eraseAt(pos);
+        return true;
+    }
+
+    // removes the key only if predicate(value) is true, returns true if it was removed
+    template <typename Predicate>
+    bool eraseIf(const Key& key, Predicate&& predicate) {
+        const size_t pos = findPosition(key);
+        if (pos == kNoPosition || !predicate(slots_[pos].value)) {
+            return false;
+        }
+        eraseAt(pos);
+        return true;
+    }
+
+    void clear() {
+        for (Slot& slot : slots_) {
+            slot = Slot();
+        }
+        size_ = 0;
+    }
+
+    // room for count keys without growing
+    void reserve(size_t count) {
+        const size_t capacity = capacityFor(count);
+        if (capacity > slots_.size()) {
+            rehash(capacity);
+        }
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    size_t capacity() const { return slots_.size(); }
+    size_t bytes() const { return slots_.capacity() * sizeof(Slot); }
+
+    // function(key, value) for every key, in slot order
+    template <typename Function>
+    void forEach(Function&& function) const {
+        for (const Slot& slot : slots_) {
+            if (slot.distance != 0) {
+                function(slot.key, slot.value);
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        Key key{};
+        Value value{};
+        uint32_t distance = 0; // 1 + distance to the home slot of the key, 0 = empty
+    };
+    static constexpr size_t kNoPosition = ~size_t{0};
+
+    // smallest power of two holding count keys under the 3/4 load
+    static size_t capacityFor(size_t count) {
+        size_t capacity = 16;
+        while (capacity * 3 < count * 4) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    size_t home(const Key& key) const { return Hash()(key) & mask_; }
+
+    size_t findPosition(const Key& key) const {
+        size_t pos = home(key);
+        for (uint32_t distance = 1;; ++distance, pos = (pos + 1) & mask_) {
+            const Slot& slot = slots_[pos];
+            if (slot.distance < distance) {
+                return kNoPosition; // empty, or a key closer to its home than ours would be: ours is not here
+            }
+            if (slot.key == key) {
+                return pos;
+            }
+        }
+    }
+
+    // add a key that is not in the table
+    Value& insertNew(Key key, Value value) {
+        if ((size_ + 1) * 4 > slots_.size() * 3) {
+            rehash(slots_.size() * 2);
+        }
+        Value* inserted = nullptr; // where the new key ended up (it may move on while others are displaced)
+        size_t pos = home(key);
+        for (uint32_t distance = 1;; ++distance, pos = (pos + 1) & mask_) {
+            Slot& slot = slots_[pos];
+            if (slot.distance == 0) {
+                slot.key = std::move(key);
+                slot.value = std::move(value);
+                slot.distance = distance;
+                size_++;
+                return inserted != nullptr ? *inserted : slot.value;
+            }
+            if (slot.distance < distance) {
+                // the key here is closer to its home: it gives its slot and goes on looking for another one
+                std::swap(key, slot.key);
+                std::swap(value, slot.value);
+                std::swap(distance, slot.distance);
+                if (inserted == nullptr) {
+                    inserted = &slot.value;
+                }
+            }
+        }
+    }
+
+    // backward shift deletion: the next keys of the cluster move back, until an empty slot or a key at home
+    void eraseAt(size_t pos) {
+        for (size_t next = (pos + 1) & mask_; slots_[next].distance > 1; pos = next, next = (next + 1) & mask_) {
+            slots_[pos] = std::move(slots_[next]);
+            slots_[pos].distance--;
+        }
+        slots_[pos] = Slot();
+        size_--;
+    }
+
+    void allocate(size_t capacity) {
+        slots_.assign(capacity, Slot());
+        mask_ = capacity - 1;
+        size_ = 0;
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<Slot> old_slots;
+        old_slots.swap(slots_);
+        allocate(capacity);
+        for (Slot& slot : old_slots) {
+            if (slot.distance != 0) {
+                insertNew(std::move(slot.key), std::move(slot.value));
+            }
+        }
+    }
+
+    std::vector<Slot> slots_;
+    size_t mask_ = 0;
+    size_t size_ = 0;
+};
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <netinet/in.h> // For sockaddr_in
+#include <string>
+#include <sys/socket.h> // For mmsghdr
+#include <sys/uio.h>    // For iovec
+#include <unordered_map>
+#include <vector>
+
+#include "gateway_protocol.hpp"
+#include "logger.hpp"
+#include "order.hpp"
+#include "orderbook.hpp" // For ExecutionReport
+#include "ring_buffer.hpp"
+#include "symbol_table.hpp"
+#include "tick_size.hpp"
+
+// Live order input over the network ("--gateway-tcp" / "--gateway-udp"), instead of the input file.
+// The gateway runs on its own thread, in the place of the reader: one epoll loop over
+//   - a TCP listening socket and its sessions (one per connection)
+//   - a UDP socket, optionally joined to a multicast group: each source address is a session,
+//     its datagrams are read by batches with recvmmsg
+// It decodes the messages of gateway_protocol.hpp straight into Orders and pushes them into the reader ring
+// of the dispatcher. The writer hands every execution report back (publishReports), and the gateway
+// sends it to the session that owns the order it is about: the order that caused it, or the resting order
+// it fills. Every session keeps fixed buffers, nothing is allocated per message.
+// The gateway never blocks on the pipeline: when the reader ring is full it stops reading its sockets
+// (TCP then slows the clients down) but keeps sending the reports, so the pipeline always drains.
+// It stops on SIGINT or SIGTERM (blockStopSignals): no more input, every pending report is sent, then
+// the sockets are closed.
+struct GatewayConfig {
+    int tcp_port = 0;             // 0 = no TCP listener
+    int udp_port = 0;             // 0 = no UDP socket
+    std::string multicast_group;  // joined by the UDP socket (empty = unicast only)
+    std::string bind_address = "0.0.0.0"; // address of the listeners (and interface of the multicast group)
+};
+
+class OrderGateway {
+public:
+    // bytes read from a TCP session at once (and the most a session can have buffered)
+    static constexpr size_t kReceiveBufferBytes = 64 << 10;
+    // a TCP session with this many bytes of reports not sent yet is not read until they are sent:
+    // a client that does not read its reports is slowed down by its own orders
+    static constexpr size_t kThrottleSendBytes = 1 << 20;
+    // a TCP client that still lets more than this pile up (the fills of its resting orders) is disconnected
+    static constexpr size_t kMaxSendBufferBytes = 16 << 20;
+    // datagrams taken by one recvmmsg (or sent by one sendmmsg), and their largest size
+    static constexpr size_t kDatagramBatch = 64;
+    static constexpr size_t kDatagramBytes = 1472; // one Ethernet frame
+    // reports between the writer and the gateway thread
+    static constexpr size_t kReportRingCapacity = 1 << 16;
+    static constexpr size_t kReportBatchSize = 256;
+    static constexpr int kEpollEvents = 64;
+
+    OrderGateway(SymbolTable& symbols, const TickSizeTable& tick_sizes, Logger& logger);
+    ~OrderGateway();
+
+    OrderGateway(const OrderGateway&) = delete;
+    OrderGateway& operator=(const OrderGateway&) = delete;
+
+    // block SIGINT and SIGTERM in the calling thread and the threads it starts afterwards, so the gateway
+    // thread gets them (through a signalfd). Call it before starting any thread
+    static bool blockStopSignals(std::string& error);
+
+    // open the sockets. Returns false (and the reason in error) if one cannot be opened
+    bool open(const GatewayConfig& config, std::string& error);
+
+    // the gateway loop (on its own thread): the decoded orders go into orders, closed once the gateway stops
+    // taking input (signal or stop()). Returns once every report was sent, after closeReports().
+    // The orders are numbered by the dispatcher in the order of the ring: it must not skip any
+    void run(OrderQueue& orders);
+    // stop taking input, like a signal would (any thread)
+    void stop();
+
+    // writer side (one thread): the reports of the engine, in the order of the input.
+    // Waits while the ring is full (the gateway always drains it)
+    void publishReports(ExecutionReport* reports, size_t count);
+    // no report comes after this
+    void closeReports();
+
+    // counters (read them after run() returned)
+    uint64_t getSessionCount() const { return next_session_id_ - kFirstSessionId; }
+    uint64_t getOrdersReceived() const { return orders_received_; }
+    uint64_t getReportsSent() const { return reports_sent_; }
+    uint64_t getRejects() const { return rejects_; }
+    uint64_t getLostMessages() const { return lost_messages_; }
+    uint64_t getDroppedReports() const { return dropped_reports_; }
+
+private:
+    // epoll ids below this are the sockets of the gateway itself, sessions come after
+    static constexpr uint64_t kListenerId = 0;
+    static constexpr uint64_t kUdpId = 1;
+    static constexpr uint64_t kSignalId = 2;
+    static constexpr uint64_t kWakeId = 3;
+    static constexpr uint32_t kFirstSessionId = 16;
+
+    struct Session {
+        uint32_t id = 0;
+        int fd = -1;                 // TCP socket, -1 for a UDP session
+        sockaddr_in peer{};          // UDP: where its reports go
+        bool input_closed = false;   // TCP: the client shut its side down
+        bool want_write = false;     // TCP: EPOLLOUT is registered (the socket was full)
+        bool dirty = false;          // in dirty_sessions_
+        bool throttled = false;      // TCP: not read, too many reports waiting (kThrottleSendBytes)
+        std::vector<char> receive_buffer; // TCP only, kReceiveBufferBytes
+        size_t received = 0;
+        std::vector<char> send_buffer;    // messages not sent yet, from send_begin
+        size_t send_begin = 0;
+        size_t send_end = 0;
+        uint32_t next_in_sequence = 1;
+        uint32_t next_out_sequence = 1;
+        std::vector<uint32_t> engine_symbol_of;  // session symbol id -> engine symbol id
+        std::vector<double> tick_size_of;        // session symbol id -> tick size of the instrument
+        std::vector<uint32_t> session_symbol_of; // engine symbol id -> session symbol id
+    };
+
+    // who gets the reports of an order: the session that sent it
+    struct Route {
+        uint32_t session_id;
+        long long order_id;
+    };
+    struct Owner {
+        uint32_t session_id;
+        unsigned long long sequence; // of the NEW order that created the entry
+    };
+
+    Session& createSession(int fd, const sockaddr_in& peer);
+    void closeSession(Session& session, const char* reason);
+    Session* findSession(uint32_t session_id);
+
+    void acceptConnections();
+    void readTcp(Session& session);
+    void readUdp();
+    // decode the messages of [data, data + size) (whole messages, returns the bytes used).
+    // Returns false on a protocol error (a TCP session is then closed)
+    bool decodeMessages(Session& session, const char* data, size_t size, size_t& used);
+    bool handleMessage(Session& session, const GatewayMessageHeader& header, const char* message);
+    void reject(Session& session, uint32_t rejected_sequence, GatewayRejectReason reason);
+
+    // reports of the writer -> send buffers of their sessions
+    void deliverReports();
+    // append a message to the send buffer. Returns false if the session was closed (too far behind)
+    bool queueMessage(Session& session, const void* message, size_t size);
+    // send what the socket takes. Returns false if the session was closed
+    bool flushSession(Session& session);
+    void flushUdp(Session& session);
+    void updateEpoll(Session& session);
+    // push the decoded orders into the reader ring (as many as fit)
+    void pushPending(OrderQueue& orders);
+    void stopInput();
+    void wake();
+
+    SymbolTable& symbols_;
+    const TickSizeTable& tick_sizes_;
+    Logger& logger_;
+
+    int epoll_fd_ = -1;
+    int listen_fd_ = -1;
+    int udp_fd_ = -1;
+    int signal_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> stop_requested_{false};
+    bool input_stopped_ = false;
+
+    std::unordered_map<uint32_t, std::unique_ptr<Session>> sessions_;
+    std::unordered_map<uint64_t, uint32_t> udp_session_of_; // address:port -> session id
+    std::vector<uint32_t> dirty_sessions_;                   // sessions with reports to send
+    uint32_t next_session_id_ = kFirstSessionId;
+
+    // orders decoded and not pushed yet, and the route of every pushed order whose reports may still come.
+    // The dispatcher numbers the orders from 0 in the order of the ring, so the route of sequence s
+    // is routes_[s - route_base_]
+    std::vector<Order> pending_;
+    size_t pending_pushed_ = 0;
+    std::deque<Route> routes_;
+    unsigned long long route_base_ = 0;
+    unsigned long long next_route_sequence_ = 0;
+    std::unordered_map<long long, Owner> owner_of_; // resting orders: order id -> session
+
+    // UDP receive buffers, reused by every recvmmsg
+    std::vector<char> datagram_buffers_;
+    std::vector<mmsghdr> datagram_headers_;
+    std::vector<iovec> datagram_vectors_;
+    std::vector<sockaddr_in> datagram_peers_;
+    // and the ones of sendmmsg (they point into the send buffer of a session)
+    std::vector<mmsghdr> send_headers_;
+    std::vector<iovec> send_vectors_;
+
+    SpscRing<ExecutionReport> reports_;
+    std::vector<ExecutionReport> report_batch_;
+
+    uint64_t orders_received_ = 0;
+    uint64_t reports_sent_ = 0;
+    uint64_t rejects_ = 0;
+    uint64_t lost_messages_ = 0;
+    uint64_t dropped_reports_ = 0;
+};
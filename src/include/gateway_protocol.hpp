@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "binary_format.hpp" // For BinaryOrderRecord, BinaryReportRecord
+
+// Messages of the order gateway (gateway.hpp), over TCP or UDP.
+// They reuse the records of the binary files: an ORDER message is a BinaryOrderRecord, a REPORT message a
+// BinaryReportRecord, behind a small header. Like in a file, the instrument of a record is a small id:
+// a client declares its instruments with SYMBOL messages before their first order, with ids of its choice,
+// and the reports it gets back use the same ids.
+//
+// Every message starts with a GatewayMessageHeader. Each direction of a session numbers its messages
+// from 1 (per-session sequencing):
+//   - TCP: the messages of a client must come in sequence, a gap or a malformed message ends the session
+//     (after a REJECT message saying why). An order or symbol that cannot be used is only rejected
+//   - UDP: a datagram holds one or more whole messages. Old (duplicate) messages are ignored,
+//     a gap is counted as lost messages and the session goes on after it
+// Numbers are in the byte order of the machine, like the binary files (little-endian).
+
+enum class GatewayMessageType : uint8_t {
+    SYMBOL = 1, // client -> engine: declare an instrument
+    ORDER = 2,  // client -> engine: one order
+    REPORT = 3, // engine -> client: one execution report
+    REJECT = 4  // engine -> client: a message of the client could not be used
+};
+
+struct GatewayMessageHeader {
+    uint16_t length;   // bytes of the whole message, header included
+    uint8_t type;      // GatewayMessageType
+    uint8_t reserved;
+    uint32_t sequence; // number of the message in its session and direction, from 1
+};
+static_assert(sizeof(GatewayMessageHeader) == 8, "the gateway header layout is part of the protocol");
+
+struct GatewaySymbolMessage {
+    static constexpr size_t kMaxNameBytes = 48;
+    GatewayMessageHeader header;
+    uint32_t symbol_id;   // id used by the ORDER messages of this session (chosen by the client)
+    uint32_t name_length;
+    char name[kMaxNameBytes];
+};
+static_assert(sizeof(GatewaySymbolMessage) == 64, "the gateway symbol layout is part of the protocol");
+
+struct GatewayOrderMessage {
+    GatewayMessageHeader header;
+    BinaryOrderRecord order; // symbol_id: an id of a SYMBOL message of the session
+};
+static_assert(sizeof(GatewayOrderMessage) == 64, "the gateway order layout is part of the protocol");
+
+struct GatewayReportMessage {
+    GatewayMessageHeader header;
+    BinaryReportRecord report; // symbol_id: the id the client gave to the instrument
+};
+static_assert(sizeof(GatewayReportMessage) == 72, "the gateway report layout is part of the protocol");
+
+enum class GatewayRejectReason : uint32_t {
+    BAD_MESSAGE = 1,    // unknown type or wrong length
+    SEQUENCE_GAP = 2,   // TCP: the message is not the next one of the session
+    BAD_SYMBOL = 3,     // SYMBOL: empty or too long name
+    UNKNOWN_SYMBOL = 4, // ORDER: no SYMBOL message for its instrument
+    INVALID_ORDER = 5   // ORDER: side, type, action or flags out of range, or attributes that do not go together
+};
+
+struct GatewayRejectMessage {
+    GatewayMessageHeader header;
+    uint32_t rejected_sequence; // sequence of the client message
+    uint32_t reason;            // GatewayRejectReason
+};
+static_assert(sizeof(GatewayRejectMessage) == 16, "the gateway reject layout is part of the protocol");
+
+// no message is longer than this
+constexpr size_t kGatewayMaxMessageBytes = 256;
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ladder_orderbook.hpp"
+#include "market_data.hpp"
+#include "order.hpp"
+#include "orderbook.hpp"
+#include "symbol_table.hpp"
+#include "tick_size.hpp"
+
+// Library API of the matching (CMake target MatchingEngineCore): the books driven straight from the
+// caller's thread, for an embedder like a strategy simulator. No reader, no worker thread, no ring and
+// no text: submit() numbers the order, matches it inline in the book of its instrument and hands every
+// execution event of the order to the sink before it returns.
+//
+// The sink is a template parameter, so its handlers are direct (inlinable) calls. It can derive from
+// ExecutionSink and only hide the handlers it needs:
+//   struct MySink : ExecutionSink {
+//       void onFill(const ExecutionReport& fill) { ... }
+//   };
+//   InlineEngine<LadderOrderBook> engine;
+//   uint32_t symbol_id = engine.addInstrument("AAPL", 0.01);
+//   engine.submit(order, sink);   // order.symbol_id = symbol_id
+// The events of an order are the lines the engine would write for it, in the same order (the books are the
+// same code), so a replay through submit() gives the output file of the engine, line for line.
+// One InlineEngine is used by one thread at a time.
+
+// Default handlers: they ignore the event
+struct ExecutionSink {
+    // the order rests in the book (NEW, or MODIFY that did not trade right away)
+    void onAccepted(const ExecutionReport&) {}
+    // one side of a trade: executed_quantity at execution_price against counterparty_id
+    // (every trade gives one fill for each of its two orders)
+    void onFill(const ExecutionReport&) {}
+    // the order left the book: CANCEL, MODIFY to a quantity of 0, the rest of an IOC order after its sweep,
+    // or the self-trade prevention
+    void onCanceled(const ExecutionReport&) {}
+    // a MODIFY lowered the quantity to what was already executed: the order is done
+    void onCompleted(const ExecutionReport&) {}
+    // the order could not be used (unknown id for MODIFY/CANCEL, MARKET order with no liquidity,
+    // post-only order that would trade, FOK order that cannot be filled completely, risk check, ...)
+    void onRejected(const ExecutionReport&) {}
+    // level 2 update of the book (only after enableMarketData, see market_data.hpp)
+    void onMarketData(const MarketDataUpdate&) {}
+};
+
+// call the handler of the sink that matches the record
+template <typename Sink>
+inline void deliverExecutionEvent(const ExecutionReport& record, Sink& sink) {
+    if (isMarketData(record)) {
+        sink.onMarketData(readMarketDataRecord(record));
+    } else if (record.executed_quantity > 0) {
+        sink.onFill(record);
+    } else if (record.status == OrderStatus::PENDING) {
+        sink.onAccepted(record);
+    } else if (record.status == OrderStatus::CANCELED) {
+        sink.onCanceled(record);
+    } else if (record.status == OrderStatus::REJECTED) {
+        sink.onRejected(record);
+    } else {
+        sink.onCompleted(record);
+    }
+}
+
+// Book: OrderBook (reference std::map book) or LadderOrderBook (flat tick ladder)
+template <typename Book>
+class InlineEngine {
+public:
+    explicit InlineEngine(double default_tick_size = 0.01) : tick_sizes_(default_tick_size) {
+        report_buffer_.reserve(kInitialReportCapacity);
+    }
+
+    InlineEngine(const InlineEngine&) = delete;
+    InlineEngine& operator=(const InlineEngine&) = delete;
+
+    // id of an instrument (created on first use), with its tick size (<= 0 keeps the current one)
+    uint32_t addInstrument(const std::string& name, double tick_size = 0.0) {
+        if (tick_size > 0.0) {
+            tick_sizes_.set_tick_size(name, tick_size);
+        }
+        uint32_t symbol_id = symbols_.intern(name);
+        bookFor(symbol_id); // so the tick size is read now, not on the first order
+        return symbol_id;
+    }
+
+    // the symbols and tick sizes of the engine, e.g. to parse an order file into orders for submit()
+    SymbolTable& symbols() { return symbols_; }
+    TickSizeTable& tickSizes() { return tick_sizes_; }
+
+    // every book (existing and future) publishes its level 2 market data to the sinks (0 = no depth snapshots)
+    void enableMarketData(unsigned long long snapshot_interval) {
+        market_data_enabled_ = true;
+        market_data_snapshot_interval_ = snapshot_interval;
+        for (auto& book : books_) {
+            if (book) {
+                book->enableMarketData(snapshot_interval);
+            }
+        }
+    }
+
+    // every book (existing and future) runs the pre-trade checks and the self-trade prevention of the config
+    // (risk_checks.hpp). Call it before the first order
+    void enableRiskChecks(const std::shared_ptr<const RiskConfig>& config) {
+        risk_config_ = config;
+        for (auto& book : books_) {
+            if (book) {
+                book->enableRiskChecks(config);
+            }
+        }
+    }
+
+    // match one order of an instrument added with addInstrument (or interned in symbols()) and deliver its events.
+    // Its price is converted into ticks here, sequence is the next input sequence number (returned)
+    template <typename Sink>
+    unsigned long long submit(const Order& order, Sink& sink) {
+        Order incoming_order = order;
+        incoming_order.sequence = next_sequence_++;
+        incoming_order.dispatch_ns = 0;
+        Book& book = bookFor(incoming_order.symbol_id);
+        if (incoming_order.type != OrderType::MARKET) {
+            incoming_order.price_ticks = std::llround(incoming_order.price / tick_size_of_[incoming_order.symbol_id]);
+        }
+        book.template processOrderAs<Book>(incoming_order);
+        for (const ExecutionReport& record : report_buffer_) {
+            deliverExecutionEvent(record, sink);
+        }
+        report_buffer_.clear();
+        return incoming_order.sequence;
+    }
+
+    // book of an instrument (nullptr if it has no book yet)
+    const Book* book(uint32_t symbol_id) const {
+        return symbol_id < books_.size() ? books_[symbol_id].get() : nullptr;
+    }
+    unsigned long long getSubmittedOrders() const { return next_sequence_; }
+
+private:
+    // events of one order before they are delivered (a deep sweep may need more, the vector then grows once)
+    static constexpr size_t kInitialReportCapacity = 1024;
+
+    Book& bookFor(uint32_t symbol_id) {
+        if (symbol_id >= books_.size()) {
+            books_.resize(static_cast<size_t>(symbol_id) + 1);
+            tick_size_of_.resize(static_cast<size_t>(symbol_id) + 1, 0.0);
+        }
+        std::unique_ptr<Book>& book = books_[symbol_id];
+        if (!book) {
+            const std::string& name = symbols_.name(symbol_id);
+            book = std::make_unique<Book>(name, symbol_id);
+            book->set_report_buffer(&report_buffer_);
+            if (market_data_enabled_) {
+                book->enableMarketData(market_data_snapshot_interval_);
+            }
+            if (risk_config_) {
+                book->enableRiskChecks(risk_config_);
+            }
+            tick_size_of_[symbol_id] = tick_sizes_.tick_size_for(name);
+        }
+        return *book;
+    }
+
+    SymbolTable symbols_;
+    TickSizeTable tick_sizes_;
+    std::vector<std::unique_ptr<Book>> books_;   // by symbol id
+    std::vector<double> tick_size_of_;           // by symbol id, read once per book
+    std::vector<ExecutionReport> report_buffer_; // events of the order being submitted
+    unsigned long long next_sequence_ = 0;
+    bool market_data_enabled_ = false;
+    unsigned long long market_data_snapshot_interval_ = 0;
+    std::shared_ptr<const RiskConfig> risk_config_;
+};
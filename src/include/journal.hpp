@@ -0,0 +1,156 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "logger.hpp"
+#include "order.hpp"
+#include "pipeline_stats.hpp"
+#include "symbol_table.hpp"
+#include "tick_size.hpp"
+
+// Write-ahead journal of the incoming orders ("--journal").
+// It is a stage of its own between the reader and the dispatcher: an order only goes on to the books
+// once its record is on disk. Calling fdatasync for every order would cap the engine at a few thousand
+// orders per second, so the journal uses group commit: it gathers the orders that arrive within the latency
+// budget (--journal-commit-us) or until its buffer is full, and a single write + fdatasync covers all of them.
+//
+// File layout:
+//   block 0            JournalFileHeader (one 4 KiB block)
+//   then               64-byte JournalRecords, up to the first free (all zero) or invalid record
+// Every write starts at a 4 KiB boundary of the file, from a 4 KiB aligned buffer, and covers whole blocks
+// (the last, partial block is written again by the next commit), so the file can be opened with O_DIRECT.
+// The file is preallocated in big chunks ahead of the writes: fdatasync then does not have to update
+// the size of the file for every commit. A clean close cuts the file back to its records.
+//
+// Records carry the input position of their order (the same offset as the book snapshots), and the
+// instruments are journaled once, in SYMBOL records, before their first order. On open, the records of an
+// existing journal are read back, so together with a snapshot they rebuild the state of a crashed run:
+// load the snapshot, replay the journaled orders after its offset, then go on with the input.
+
+// header of the journal file (padded to a whole block in the file)
+struct JournalFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t reserved[6];
+};
+static_assert(sizeof(JournalFileHeader) == 64, "the journal header layout is part of the file format");
+
+enum class JournalRecordKind : uint8_t {
+    FREE = 0,        // never written (preallocated space): the end of the journal
+    ORDER = 1,       // one input order
+    SYMBOL = 2,      // an instrument name, with a journal id used by the ORDER records
+    SYMBOL_NAME = 3  // the rest of a name longer than the SYMBOL record can hold
+};
+
+// One record of the journal: a small common header and a payload whose meaning depends on the kind
+struct JournalRecord {
+    static constexpr size_t kPayloadBytes = 48;
+
+    uint8_t kind;       // JournalRecordKind
+    uint8_t side;       // ORDER: Side
+    uint8_t type;       // ORDER: OrderType
+    uint8_t action;     // ORDER: OrderAction
+    uint32_t checksum;  // FNV-1a of the record with this field at 0 (torn writes are detected)
+    uint64_t sequence;  // ORDER: input position of the order. SYMBOL: journal id of the instrument
+    unsigned char payload[kPayloadBytes];
+};
+static_assert(sizeof(JournalRecord) == 64, "the journal record layout is part of the file format");
+
+// payload of an ORDER record
+struct JournalOrderPayload {
+    uint64_t timestamp;
+    int64_t order_id;
+    uint64_t quantity;
+    double price;       // as it was read, converted into ticks again when the journal is replayed
+    uint32_t symbol_id; // journal id of the instrument (from a SYMBOL record before it)
+    uint8_t flags;      // time in force and post-only (packOrderFlags), 0 in the journals written before them
+    uint8_t reserved[3];
+    uint32_t display_quantity; // iceberg: quantity shown in the book (0 = all of it, at most kMaxDisplayQuantity)
+    uint32_t account_id;       // 0 = no account (and in the journals written before the accounts)
+};
+static_assert(sizeof(JournalOrderPayload) == JournalRecord::kPayloadBytes, "an order must fill the payload");
+
+// payload of a SYMBOL record (the name goes on in SYMBOL_NAME records, kPayloadBytes per record)
+struct JournalSymbolPayload {
+    static constexpr size_t kInlineNameBytes = 44;
+    uint32_t name_length;
+    char name[kInlineNameBytes];
+};
+static_assert(sizeof(JournalSymbolPayload) == JournalRecord::kPayloadBytes, "a symbol must fill the payload");
+
+class OrderJournal {
+public:
+    // writes start at multiples of this, and have a multiple of it as length
+    static constexpr size_t kBlockSize = 4096;
+    // most bytes of records gathered in one group commit
+    static constexpr size_t kBufferBytes = 1 << 20;
+    // the file is grown by this much at a time, ahead of the writes
+    static constexpr uint64_t kPreallocateBytes = 64ULL << 20;
+    // orders taken from the reader ring at once
+    static constexpr size_t kBatchSize = 256;
+
+    OrderJournal(Logger& logger, PipelineStats* stats = nullptr);
+    ~OrderJournal();
+
+    OrderJournal(const OrderJournal&) = delete;
+    OrderJournal& operator=(const OrderJournal&) = delete;
+
+    // Open the journal, creating it if it does not exist.
+    // The orders of an existing journal are read back into recovered (instruments interned into symbols,
+    // prices converted with tick_sizes, input position in Order::sequence), up to its first torn or free record,
+    // and the next records go right after them. Returns false (and the reason in error) if it cannot be used
+    bool open(const std::string& path, SymbolTable& symbols, const TickSizeTable& tick_sizes,
+              std::vector<Order>& recovered, std::string& error);
+
+    // input position after the last journaled order (0 for a new journal)
+    uint64_t nextSequence() const { return next_sequence_; }
+
+    // The stage itself (on its own thread): first the replay orders are sent on as they are (they are already
+    // in the journal), then every order of input at an input position >= skip_before is journaled and, once its
+    // group is committed, pushed to output with its input position in Order::sequence
+    // (the orders before skip_before are already in the books or in the journal: they are dropped).
+    // output is closed at the end. Returns false if a write failed: the orders after the failure are not
+    // sent on (they are not durable), the input is still drained so the reader does not block
+    bool run(OrderQueue& input, OrderQueue& output, const std::vector<Order>& replay, uint64_t skip_before,
+             std::chrono::microseconds commit_budget);
+
+    // write what is left, cut the preallocated space and close the file. Returns false if a write failed
+    bool close(std::string& error);
+
+    // counters of the stage (read them after run() returned)
+    uint64_t getJournaledOrders() const { return journaled_orders_; }
+    uint64_t getCommitCount() const { return commit_count_; }
+
+private:
+    // put one order (and, the first time, the SYMBOL records of its instrument) into the buffer
+    void appendOrder(const Order& order, uint64_t input_position);
+    void appendRecord(JournalRecord& record);
+    // bytes of records appendOrder() adds for this order
+    size_t bytesFor(const Order& order) const;
+    // write the buffer (whole blocks) and fdatasync: every order appended so far is durable
+    bool commit();
+    bool writeAt(const char* data, size_t size, uint64_t offset);
+
+    Logger& logger_;
+    PipelineStats* stats_;
+    std::string path_;
+    int fd_ = -1;
+    char* buffer_ = nullptr;       // kBufferBytes, aligned to kBlockSize
+    size_t used_ = 0;              // bytes of records in the buffer
+    uint64_t buffer_offset_ = 0;   // file offset of buffer_[0] (a multiple of kBlockSize)
+    uint64_t preallocated_ = 0;    // the file is allocated up to here
+    int write_errno_ = 0;          // errno of the first failed write or sync
+
+    uint64_t next_sequence_ = 0;
+    uint32_t next_journal_symbol_ = 0;
+    const SymbolTable* symbols_ = nullptr;
+    std::vector<uint32_t> journal_symbol_of_; // engine symbol id -> journal id (kInvalidSymbol = not journaled yet)
+
+    uint64_t journaled_orders_ = 0;
+    uint64_t commit_count_ = 0;
+};
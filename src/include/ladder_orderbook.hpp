@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+
+#include "orderbook.hpp"
+#include "order_pool.hpp"
+#include "order_id_index.hpp"
+
+// Order book on a flat price ladder.
+// Prices are integer ticks (Order::price_ticks); every tick between the lowest and the highest price
+// seen so far has a slot in one contiguous array, shared by both sides: because the book is never
+// left crossed, all the bid levels are below the best ask and all the ask levels are above the best bid.
+// Each level is an intrusive FIFO queue of compact RestingOrder records taken from a per-book OrderPool,
+// the order index is a flat open-addressing table, and two cursors point to the best bid and the best ask.
+// A two-level bitmap of the non-empty levels lets the cursors jump over empty ticks 64 (and 4096) at a time.
+// Once the pool, the index and the ladder have grown to the size of the book, NEW/MATCH/CANCEL do not allocate.
+// It produces exactly the same output records as the reference map-based OrderBook.
+class LadderOrderBook final : public OrderBookBase {
+    friend class OrderBookBase; // processOrderAs calls processSingleOrder directly
+public:
+    LadderOrderBook(const std::string& instrument_name, uint32_t symbol_id);
+
+    void collectRestingOrders(std::vector<Order>& out) const override;
+    bool restoreRestingOrder(const Order& order) override;
+
+    size_t getLevelCount() const override;
+    // number of resting orders and size of the pool (for the memory reports)
+    size_t getRestingOrderCount() const override { return pool_.in_use(); }
+    size_t getPoolCapacity() const { return pool_.capacity(); }
+    BookMemoryStats getMemoryStats() const override;
+
+private:
+    static constexpr uint32_t kNoSlot = OrderPool::kNoSlot;
+    // number of price levels allocated around the first price seen by the book
+    // (the ladder always grows by a multiple of 64 levels, so the bitmap words just shift)
+    static constexpr long long kInitialLevels = 1024;
+    // maximum span of the ladder, orders priced outside of it are rejected
+    static constexpr long long kMaxLevels = 1LL << 24;
+    static_assert(kMaxLevels <= std::numeric_limits<int32_t>::max(), "a level offset must fit RestingOrderInfo");
+
+    // one price level: FIFO queue of resting orders (oldest at head)
+    struct Level {
+        uint32_t head = kNoSlot;
+        uint32_t tail = kNoSlot;
+        uint32_t order_count = 0;
+        unsigned long long total_quantity = 0;  // sum of the remaining quantities of the level
+        unsigned long long hidden_quantity = 0; // the part of it in iceberg reserves (not in the market data)
+    };
+
+    void processSingleOrder(Order& order) override;
+    void readLevel(LevelState& level) const override;
+    void readBestLevels(LevelState& best_bid, LevelState& best_ask) const override;
+    void collectLevels(std::vector<LevelState>& out) const override;
+    // market data state of a non-empty level
+    LevelState levelState(Side side, size_t level_index) const;
+
+    // true if the ladder can hold this price (grows the array if needed)
+    bool reserveLevel(long long price_ticks);
+    Level& levelAt(long long price_ticks) { return levels_[static_cast<size_t>(price_ticks - base_ticks_)]; }
+
+    // put an order at the back of its level, update the best price cursor and the index
+    void restOrder(const Order& order);
+    // unlink a slot from the queue of its level (does not release the slot)
+    void unlinkSlot(uint32_t slot);
+    // move a slot of a level to the back of its queue (an iceberg that got a new slice)
+    void moveSlotToBack(Level& level, uint32_t slot);
+    // false for a post-only order that would trade right away and for a FOK order that cannot trade
+    // completely right away (read from the total quantities of the levels, nothing is matched)
+    bool passesEntryChecks(const Order& order, bool is_market) const;
+    // find a resting order by id, copy it into removed_order and take it out of the book
+    bool removeRestingOrder(long long order_id, Order& removed_order);
+    // the compact record of a slot expanded back into a full Order
+    void expandSlot(uint32_t slot, Order& order) const;
+    // move the best bid (or best ask) cursor to the next non-empty level after its level got empty
+    void advanceBestBid();
+    void advanceBestAsk();
+
+    // occupancy bitmap of the levels (one bit per level, one summary bit per word of 64 levels)
+    static constexpr size_t kNoLevel = static_cast<size_t>(-1);
+    void markLevelOccupied(size_t level_index);
+    void markLevelEmpty(size_t level_index);
+    void rebuildOccupancySummary();
+    // first non-empty level at or above level_index / last one at or below it (kNoLevel if none)
+    size_t nextOccupiedLevel(size_t level_index) const;
+    size_t prevOccupiedLevel(size_t level_index) const;
+
+    // match an incoming order against the opposite side, level by level.
+    // LIMIT orders stop at their limit price, MARKET orders sweep until filled or the side is empty
+    // returns the number of fills
+    size_t sweep(Order& incoming_order, bool is_market, unsigned long long event_timestamp);
+    // apply one fill to both orders and add its two output records to the batch of the sweep
+    void recordFill(Order& incoming_order, uint32_t resting_slot, unsigned long long match_qty, double match_price,
+                    bool incoming_reported_first, unsigned long long event_timestamp, FillBatch& fills_batch);
+
+    OrderPool pool_;
+    OrderIdIndex order_index_; // order_id -> slot of the resting order
+
+    std::vector<Level> levels_;
+    long long base_ticks_ = 0; // price in ticks of levels_[0]
+    // first price of the book: the ladder always spans it, so the price of a resting order is a 32 bit
+    // offset from it (RestingOrderInfo::level_offset)
+    long long origin_ticks_ = 0;
+    std::vector<uint64_t> occupied_words_;   // bit i of word w: level w*64+i is not empty
+    std::vector<uint64_t> occupied_summary_; // bit i of word w: occupied_words_[w*64+i] is not zero
+
+    bool has_bids_ = false;
+    bool has_asks_ = false;
+    long long best_bid_ticks_ = 0;
+    long long best_ask_ticks_ = 0;
+};
@@ -7,6 +7,16 @@
 #include <sstream>   // For std::ostringstream to build messages
 #include <mutex>     // For std::mutex and std::lock_guard (thread safety)
 #include <memory>    // For std::unique_ptr to manage ofstream
+#include <algorithm> // For std::transform in to_upper
+#include <cctype>    // For std::toupper
+#include <atomic>
+#include <cstdint>
+#include <cstring>   // For std::memcpy
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "ring_buffer.hpp" // For the per-thread rings of the asynchronous mode
 
 // Enum for log levels, similar to spdlog
 enum class LogLevel {
@@ -19,6 +29,14 @@ enum class LogLevel {
     OFF = 6 // To disable all logging
 };
 
+// Compile-time minimum level: the calls below it are removed by the compiler (their arguments too,
+// with the LOG_TRACE / LOG_DEBUG macros). The build sets it with -DENGINE_MIN_LOG_LEVEL=... (see CMakeLists.txt),
+// without a definition every level is compiled in.
+#ifndef LOGGER_COMPILED_MIN_LEVEL
+#define LOGGER_COMPILED_MIN_LEVEL 0
+#endif
+constexpr LogLevel kCompiledMinLogLevel = static_cast<LogLevel>(LOGGER_COMPILED_MIN_LEVEL);
+
 // Helper to convert LogLevel to its string representation
 inline const char* level_to_string(LogLevel level) {
     switch (level) {
@@ -66,8 +84,114 @@ inline LogLevel string_to_level(const std::string& level_str) {
     }
 }
 
+// One log call of the asynchronous mode, as a small binary record: the level, the time and the arguments.
+// Numbers are stored as they are; text (string literals, std::string, string_view) is copied into the
+// record; any other type is formatted with operator<< by the caller. The background thread of the logger
+// turns the record into the same line as the synchronous mode.
+struct LogRecord {
+    static constexpr size_t kMaxArgs = 16;
+    static constexpr size_t kTextBytes = 256; // longer text is cut
+
+    enum class ArgKind : uint8_t { SIGNED, UNSIGNED, FLOATING, BOOLEAN, CHARACTER, TEXT };
+    union ArgValue {
+        long long signed_value;
+        unsigned long long unsigned_value;
+        double floating_value;
+        struct { uint16_t offset; uint16_t length; } text;
+    };
+
+    int64_t time_ns;    // system_clock, nanoseconds since the epoch
+    LogLevel level;
+    uint8_t arg_count;
+    uint16_t text_used;
+    ArgKind kinds[kMaxArgs];
+    ArgValue values[kMaxArgs];
+    char text[kTextBytes];
+
+    void clear() {
+        arg_count = 0;
+        text_used = 0;
+    }
+
+    void addText(std::string_view value) {
+        const size_t length = std::min(value.size(), kTextBytes - text_used);
+        std::memcpy(text + text_used, value.data(), length);
+        kinds[arg_count] = ArgKind::TEXT;
+        values[arg_count].text = {text_used, static_cast<uint16_t>(length)};
+        text_used = static_cast<uint16_t>(text_used + length);
+        arg_count++;
+    }
+
+    template <typename T>
+    void add(const T& value) {
+        if (arg_count == kMaxArgs) {
+            // no slot left: the extra arguments join the last text argument... or are formatted now
+            std::ostringstream oss;
+            oss << ' ' << value;
+            appendToLast(oss.str());
+            return;
+        }
+        if constexpr (std::is_same_v<T, bool>) {
+            kinds[arg_count] = ArgKind::BOOLEAN;
+            values[arg_count++].unsigned_value = value ? 1 : 0;
+        } else if constexpr (std::is_same_v<T, char>) {
+            kinds[arg_count] = ArgKind::CHARACTER;
+            values[arg_count++].signed_value = value;
+        } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+            kinds[arg_count] = ArgKind::SIGNED;
+            values[arg_count++].signed_value = value;
+        } else if constexpr (std::is_integral_v<T>) {
+            kinds[arg_count] = ArgKind::UNSIGNED;
+            values[arg_count++].unsigned_value = value;
+        } else if constexpr (std::is_floating_point_v<T>) {
+            kinds[arg_count] = ArgKind::FLOATING;
+            values[arg_count++].floating_value = static_cast<double>(value);
+        } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            addText(std::string_view(value));
+        } else {
+            std::ostringstream oss; // anything else is formatted by the caller
+            oss << value;
+            addText(oss.str());
+        }
+    }
+
+    // the message, formatted like the synchronous mode (a space after each argument but the last)
+    void formatMessage(std::ostream& out) const {
+        for (size_t i = 0; i < arg_count; ++i) {
+            if (i > 0) {
+                out << ' ';
+            }
+            const ArgValue& value = values[i];
+            switch (kinds[i]) {
+                case ArgKind::SIGNED:    out << value.signed_value; break;
+                case ArgKind::UNSIGNED:  out << value.unsigned_value; break;
+                case ArgKind::FLOATING:  out << value.floating_value; break;
+                case ArgKind::BOOLEAN:   out << (value.unsigned_value != 0); break;
+                case ArgKind::CHARACTER: out << static_cast<char>(value.signed_value); break;
+                case ArgKind::TEXT:      out << std::string_view(text + value.text.offset, value.text.length); break;
+            }
+        }
+    }
+
+private:
+    void appendToLast(const std::string& extra) {
+        if (kinds[kMaxArgs - 1] != ArgKind::TEXT ||
+            values[kMaxArgs - 1].text.offset + values[kMaxArgs - 1].text.length != text_used) {
+            return; // the record is full, the argument is dropped
+        }
+        const size_t length = std::min(extra.size(), kTextBytes - text_used);
+        std::memcpy(text + text_used, extra.data(), length);
+        values[kMaxArgs - 1].text.length = static_cast<uint16_t>(values[kMaxArgs - 1].text.length + length);
+        text_used = static_cast<uint16_t>(text_used + length);
+    }
+};
+static_assert(std::is_trivially_copyable<LogRecord>::value, "LogRecord is copied through rings");
+
 class Logger {
 public:
+    // capacity of the ring of each thread in the asynchronous mode
+    static constexpr size_t kAsyncRingCapacity = 1024;
+
     // Constructor for console logging
     Logger(std::string name, LogLevel level = LogLevel::INFO)
         : logger_name_(std::move(name)),
@@ -98,6 +222,7 @@ public:
 
 
     ~Logger() {
+        set_async(false); // everything still in the rings is written first
         // std::unique_ptr will automatically close the file stream if it's open.
     }
 
@@ -106,51 +231,91 @@ public:
     Logger& operator=(const Logger&) = delete;
 
     // Set the minimum log level that this logger will output
+    // (the levels below kCompiledMinLogLevel are not in the program at all)
     void set_level(LogLevel level) {
-        std::lock_guard<std::mutex> lock(log_mutex_);
-        min_level_ = level;
+        min_level_.store(level, std::memory_order_relaxed);
     }
 
     LogLevel get_level() const {
-        std::lock_guard<std::mutex> lock(log_mutex_); // const method but needs lock if min_level_ can change
-        return min_level_;
+        return min_level_.load(std::memory_order_relaxed);
+    }
+
+    // true if a message of this level would be written: one relaxed load, no lock
+    bool should_log(LogLevel msg_level) const {
+        const LogLevel min_level = min_level_.load(std::memory_order_relaxed);
+        return msg_level >= kCompiledMinLogLevel && msg_level >= min_level && min_level != LogLevel::OFF;
+    }
+
+    // Asynchronous mode: a log call only copies its arguments into a LogRecord and pushes it into a ring
+    // of its own thread (no lock, no formatting, no I/O); a background thread formats and writes the lines.
+    // When the ring of a thread is full the record is dropped (and counted) instead of waiting.
+    // set_async(false) writes what is left in the rings and stops the thread (the destructor does it too).
+    // Switch it while the other threads do not log (at startup, and after they are joined).
+    void set_async(bool enabled) {
+        if (enabled == (async_thread_.joinable())) {
+            return;
+        }
+        if (enabled) {
+            async_stop_.store(false, std::memory_order_relaxed);
+            async_enabled_.store(true, std::memory_order_release);
+            async_thread_ = std::thread([this]() { runAsyncWriter(); });
+            return;
+        }
+        async_enabled_.store(false, std::memory_order_release);
+        async_stop_.store(true, std::memory_order_release);
+        async_thread_.join();
     }
+    bool is_async() const { return async_enabled_.load(std::memory_order_acquire); }
 
     // --- Logging API methods (variadic templates) ---
     template<typename... Args>
     void trace(const Args&... args) {
-        log_(LogLevel::TRACE, args...);
+        if constexpr (LogLevel::TRACE >= kCompiledMinLogLevel) {
+            log_(LogLevel::TRACE, args...);
+        }
     }
 
     template<typename... Args>
     void debug(const Args&... args) {
-        log_(LogLevel::DEBUG, args...);
+        if constexpr (LogLevel::DEBUG >= kCompiledMinLogLevel) {
+            log_(LogLevel::DEBUG, args...);
+        }
     }
 
     template<typename... Args>
     void info(const Args&... args) {
-        log_(LogLevel::INFO, args...);
+        if constexpr (LogLevel::INFO >= kCompiledMinLogLevel) {
+            log_(LogLevel::INFO, args...);
+        }
     }
 
     template<typename... Args>
     void warn(const Args&... args) {
-        log_(LogLevel::WARN, args...);
+        if constexpr (LogLevel::WARN >= kCompiledMinLogLevel) {
+            log_(LogLevel::WARN, args...);
+        }
     }
 
     template<typename... Args>
     void error(const Args&... args) {
-        log_(LogLevel::ERROR, args...);
+        if constexpr (LogLevel::ERROR >= kCompiledMinLogLevel) {
+            log_(LogLevel::ERROR, args...);
+        }
     }
 
     template<typename... Args>
     void critical(const Args&... args) {
-        log_(LogLevel::CRITICAL, args...);
+        if constexpr (LogLevel::CRITICAL >= kCompiledMinLogLevel) {
+            log_(LogLevel::CRITICAL, args...);
+        }
     }
 
 private:
     // Generates a timestamp string (e.g., "YYYY-MM-DD HH:MM:SS.milliseconds")
     std::string get_current_timestamp_() const {
-        auto now = std::chrono::system_clock::now();
+        return format_timestamp_(std::chrono::system_clock::now());
+    }
+    std::string format_timestamp_(std::chrono::system_clock::time_point now) const {
         auto now_as_time_t = std::chrono::system_clock::to_time_t(now);
         auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
 
@@ -189,15 +354,32 @@ private:
     // The core logging function
     template<typename... Args>
     void log_(LogLevel msg_level, const Args&... args) {
-        // Check level before acquiring the lock for a minor optimization,
-        // but must re-check after acquiring lock if level can change concurrently.
-        // For simplicity and correctness, lock first.
-        std::lock_guard<std::mutex> lock(log_mutex_);
-
-        if (msg_level < min_level_ || min_level_ == LogLevel::OFF) {
+        // the level is an atomic: filtered messages never take the lock
+        if (!should_log(msg_level)) {
+            return;
+        }
+        if (async_enabled_.load(std::memory_order_acquire)) {
+            LogRing* ring = ringOfThisThread();
+            LogRecord record;
+            record.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            record.level = msg_level;
+            record.clear();
+            (record.add(args), ...);
+            if (!ring->records.try_push(std::move(record))) {
+                ring->dropped.store(ring->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
             return;
         }
 
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        write_line_(msg_level, std::chrono::system_clock::now(), format_user_message_(args...));
+    }
+
+    // writes one complete line to the stream of the logger (log_mutex_ held)
+    // (the asynchronous writer passes flush_line = false and flushes once per pass)
+    void write_line_(LogLevel msg_level, std::chrono::system_clock::time_point time, const std::string& message,
+                     bool flush_line = true) {
         std::ostream* target_stream = output_stream_;
 
         // For console loggers (not file loggers):
@@ -215,23 +397,129 @@ private:
 
         // Construct the full log line: [timestamp] [logger_name] [LEVEL] user_message
         std::ostringstream complete_message_stream;
-        complete_message_stream << "[" << get_current_timestamp_() << "] ";
+        complete_message_stream << "[" << format_timestamp_(time) << "] ";
         complete_message_stream << "[" << logger_name_ << "] ";
         complete_message_stream << "[" << level_to_string(msg_level) << "] ";
-        complete_message_stream << format_user_message_(args...); // Add user's message parts
+        complete_message_stream << message; // Add user's message parts
+
+        *target_stream << complete_message_stream.str() << '\n';
+        if (flush_line) {
+            target_stream->flush();
+        }
+    }
+
+    // --- Asynchronous mode ---
+    // the ring of one thread (single producer: that thread, single consumer: the writer thread)
+    struct LogRing {
+        SpscRing<LogRecord> records{kAsyncRingCapacity, WaitStrategyType::SPIN_YIELD};
+        std::atomic<uint64_t> dropped{0};  // written by the producer only
+        uint64_t reported_dropped = 0;     // writer thread only
+    };
+
+    // the ring of the calling thread for this logger, created the first time the thread logs.
+    // The thread_local cache is keyed by the unique id of the logger, never by its address
+    LogRing* ringOfThisThread() {
+        struct CacheEntry {
+            uint64_t logger_id;
+            LogRing* ring;
+        };
+        thread_local std::vector<CacheEntry> cache;
+        for (const CacheEntry& entry : cache) {
+            if (entry.logger_id == logger_id_) {
+                return entry.ring;
+            }
+        }
+        LogRing* ring;
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            async_rings_.push_back(std::make_unique<LogRing>());
+            ring = async_rings_.back().get();
+        }
+        cache.push_back({logger_id_, ring});
+        return ring;
+    }
 
-        *target_stream << complete_message_stream.str() << std::endl;
+    // background thread: takes the records of every ring, writes them in time order, sleeps when idle
+    void runAsyncWriter() {
+        std::vector<LogRecord> pending;
+        std::vector<LogRecord> batch(64);
+        while (true) {
+            const bool stopping = async_stop_.load(std::memory_order_acquire);
+            pending.clear();
+            std::vector<LogRing*> rings;
+            {
+                std::lock_guard<std::mutex> lock(rings_mutex_);
+                for (const auto& ring : async_rings_) {
+                    rings.push_back(ring.get());
+                }
+            }
+            std::unique_lock<std::mutex> lock(log_mutex_);
+            for (LogRing* ring : rings) {
+                size_t count;
+                while ((count = ring->records.try_pop_batch(batch.data(), batch.size())) > 0) {
+                    pending.insert(pending.end(), batch.begin(), batch.begin() + static_cast<std::ptrdiff_t>(count));
+                }
+                const uint64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+                if (dropped != ring->reported_dropped) {
+                    write_line_(LogLevel::WARN, std::chrono::system_clock::now(),
+                                "Asynchronous log ring full: " + std::to_string(dropped - ring->reported_dropped) +
+                                " messages dropped", false);
+                    ring->reported_dropped = dropped;
+                }
+            }
+            // the rings of the threads are merged by time (a ring is already in order)
+            std::stable_sort(pending.begin(), pending.end(),
+                             [](const LogRecord& a, const LogRecord& b) { return a.time_ns < b.time_ns; });
+            for (const LogRecord& record : pending) {
+                std::ostringstream message;
+                record.formatMessage(message);
+                write_line_(record.level,
+                            std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                                std::chrono::nanoseconds(record.time_ns))),
+                            message.str(), false);
+            }
+            if (!pending.empty() && output_stream_ != nullptr) {
+                output_stream_->flush();
+                std::cerr.flush();
+            }
+            lock.unlock(); // not held while sleeping
+            if (stopping) {
+                return; // everything pushed before set_async(false) was taken by this last pass
+            }
+            if (pending.empty()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
     }
 
     std::string logger_name_;
-    LogLevel min_level_;
+    std::atomic<LogLevel> min_level_;
     
     std::ostream* output_stream_; // Points to std::cout, std::cerr, or file_output_stream_.get()
     std::unique_ptr<std::ofstream> file_output_stream_; // Manages the file stream if created
     bool is_file_logger_;
 
     mutable std::mutex log_mutex_; // Mutable to allow locking in const methods if they were to access shared mutable state.
-                                   // Here, it's primarily for log_() and set_level()/get_level().
+                                   // Here, it's for the writing of the lines.
+
+    // asynchronous mode
+    static uint64_t nextLoggerId() {
+        static std::atomic<uint64_t> next_id{1};
+        return next_id.fetch_add(1, std::memory_order_relaxed);
+    }
+    const uint64_t logger_id_ = nextLoggerId();
+    std::atomic<bool> async_enabled_{false};
+    std::atomic<bool> async_stop_{false};
+    std::thread async_thread_;
+    std::mutex rings_mutex_; // protects async_rings_ (a thread registers its ring once)
+    std::vector<std::unique_ptr<LogRing>> async_rings_;
 };
 
+// Log macros for the hot paths: below the compiled level the whole call, arguments included, disappears,
+// and below the runtime level the arguments are not even evaluated.
+#define LOG_TRACE(logger, ...) \
+    do { if constexpr (LogLevel::TRACE >= kCompiledMinLogLevel) { if ((logger).should_log(LogLevel::TRACE)) (logger).trace(__VA_ARGS__); } } while (0)
+#define LOG_DEBUG(logger, ...) \
+    do { if constexpr (LogLevel::DEBUG >= kCompiledMinLogLevel) { if ((logger).should_log(LogLevel::DEBUG)) (logger).debug(__VA_ARGS__); } } while (0)
+
 
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "order.hpp" // For Side
+
+// Level 2 market data of the books ("--market-data FILE").
+// After every order it processes, a book publishes what changed in its depth, coalesced over the whole order:
+// one update per price level that changed (however many fills touched it), then one BBO update if the best
+// bid or the best ask changed. Every few orders (--market-data-snapshot-every) it also publishes its full depth,
+// so a consumer that joins late (or lost updates) can rebuild the book without the whole history.
+// The updates of a book are numbered from 1 (update_number), a consumer sees a gap if it missed one.
+// A level is identified by its side and its price; its quantity is the sum of the remaining quantities
+// of its resting orders. Every book keeps that sum up to date, so an update never walks the orders of a level.
+enum class MarketDataKind : uint8_t {
+    LEVEL_ADD,      // a new price level: quantity and order_count of the level
+    LEVEL_CHANGE,   // the quantity or the number of orders of a level changed
+    LEVEL_DELETE,   // the last order of a level left (quantity and order_count are 0)
+    BBO,            // best bid (price, quantity) and best ask (ask_price, ask_quantity), 0 for an empty side
+    SNAPSHOT_BEGIN, // a full depth snapshot follows: order_count is its number of levels
+    SNAPSHOT_LEVEL  // one level of the snapshot: bids best first, then asks best first
+};
+
+struct MarketDataUpdate {
+    unsigned long long sequence;      // input sequence number of the order that caused the update
+    unsigned long long timestamp;     // timestamp of that order
+    unsigned long long update_number; // per book, from 1
+    uint32_t symbol_id;
+    MarketDataKind kind;
+    Side side;                        // side of the level (UNKNOWN for BBO and SNAPSHOT_BEGIN)
+    double price;                     // price of the level (BBO: best bid)
+    unsigned long long quantity;      // total remaining quantity of the level (BBO: at the best bid)
+    unsigned long long order_count;   // resting orders of the level
+    double ask_price;                 // BBO only
+    unsigned long long ask_quantity;  // BBO only
+};
+
+// name of the kind in the market data file
+inline std::string_view marketDataKindToString(MarketDataKind kind) {
+    switch (kind) {
+        case MarketDataKind::LEVEL_ADD: return "ADD";
+        case MarketDataKind::LEVEL_CHANGE: return "CHANGE";
+        case MarketDataKind::LEVEL_DELETE: return "DELETE";
+        case MarketDataKind::BBO: return "BBO";
+        case MarketDataKind::SNAPSHOT_BEGIN: return "SNAPSHOT";
+        case MarketDataKind::SNAPSHOT_LEVEL: return "SNAPSHOT_LEVEL";
+        default: return "UNKNOWN_KIND";
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include "pool_memory.hpp"
+
+// Per-book free lists of the small nodes of the standard containers of the map book (the nodes of its
+// std::map price levels, of the std::list queues and of the std::unordered_map order index).
+// A released node goes on the free list of its size and the next node of that size reuses it, so a level
+// that gets empty and comes back, or an order that leaves and the next one that rests, do not go through
+// the heap: once the book is at its peak size nothing is allocated or freed any more.
+// The nodes are cut out of chunks of pool_memory (huge pages in the huge page mode), which are only given
+// back when the book is destroyed. Like the book, a pool is only used by one thread at a time.
+class NodePool {
+public:
+    static constexpr size_t kGranularity = 16;   // node sizes are rounded up to this
+    static constexpr size_t kMaxNodeBytes = 256; // bigger requests (bucket arrays) go to the heap
+    static constexpr size_t kChunkBytes = 64 << 10;
+
+    NodePool() = default;
+    ~NodePool() {
+        for (char* chunk : chunks_) {
+            pool_memory::releaseBlock(chunk, kChunkBytes);
+        }
+    }
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    static bool handles(size_t bytes) { return bytes <= kMaxNodeBytes; }
+
+    void* allocate(size_t bytes) {
+        const size_t size_class = sizeClass(bytes);
+        in_use_bytes_ += size_class * kGranularity;
+        FreeNode*& free_head = free_lists_[size_class];
+        if (free_head != nullptr) {
+            FreeNode* node = free_head;
+            free_head = node->next;
+            return node;
+        }
+        const size_t node_bytes = size_class * kGranularity;
+        if (chunk_used_ + node_bytes > kChunkBytes || chunks_.empty()) {
+            chunks_.reserve(chunks_.size() + 1);
+            chunks_.push_back(static_cast<char*>(pool_memory::allocateBlock(kChunkBytes)));
+            chunk_used_ = 0;
+        }
+        void* node = chunks_.back() + chunk_used_;
+        chunk_used_ += node_bytes;
+        return node;
+    }
+
+    void release(void* node, size_t bytes) {
+        const size_t size_class = sizeClass(bytes);
+        in_use_bytes_ -= size_class * kGranularity;
+        FreeNode* free_node = static_cast<FreeNode*>(node);
+        free_node->next = free_lists_[size_class];
+        free_lists_[size_class] = free_node;
+    }
+
+    // bytes of the chunks, and of the nodes in use
+    size_t bytes() const { return chunks_.size() * kChunkBytes; }
+    size_t used_bytes() const { return in_use_bytes_; }
+
+private:
+    struct FreeNode {
+        FreeNode* next;
+    };
+    static size_t sizeClass(size_t bytes) { return (bytes + kGranularity - 1) / kGranularity; }
+
+    FreeNode* free_lists_[kMaxNodeBytes / kGranularity + 1] = {};
+    std::vector<char*> chunks_;
+    size_t chunk_used_ = 0; // bytes of the last chunk already cut into nodes
+    size_t in_use_bytes_ = 0;
+};
+
+// Allocator of the containers of the map book: single nodes come from the NodePool of the book,
+// anything else (the bucket arrays of an unordered_map) from the heap.
+// Every allocator of one pool compares equal, so the lists of a book can splice their nodes.
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(NodePool& pool) : pool_(&pool) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) : pool_(other.pool()) {}
+
+    T* allocate(size_t count) {
+        if (count == 1 && NodePool::handles(sizeof(T))) {
+            return static_cast<T*>(pool_->allocate(sizeof(T)));
+        }
+        return static_cast<T*>(::operator new(count * sizeof(T)));
+    }
+    void deallocate(T* pointer, size_t count) {
+        if (count == 1 && NodePool::handles(sizeof(T))) {
+            pool_->release(pointer, sizeof(T));
+        } else {
+            ::operator delete(pointer);
+        }
+    }
+
+    NodePool* pool() const { return pool_; }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& other) const { return pool_ == other.pool(); }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>& other) const { return pool_ != other.pool(); }
+
+private:
+    NodePool* pool_;
+};
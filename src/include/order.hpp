@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <optional>
 #include <iostream>
@@ -9,6 +10,10 @@
 #include <cctype>    // Required for std::toupper for toUpper in cpp, not strictly here
 #include "logger.hpp" // Assuming a Logger class is defined for logging
 #include "thread_safe_queue.hpp"
+#include "ring_buffer.hpp"
+#include "tick_size.hpp"
+#include "symbol_table.hpp"
+#include <cstdint>
 #include <thread>
 #include <time.h>
 #include <atomic>
@@ -16,21 +21,28 @@
 
 
 // Enum for Order Side
-enum class Side {
+enum class Side : uint8_t {
     BUY,
     SELL,
     UNKNOWN // For invalid parsing or default state
 };
 
 // Enum for Order Type
-enum class OrderType {
+enum class OrderType : uint8_t {
     LIMIT,
     MARKET,
     UNKNOWN // For invalid parsing or default state
 };
 
+// How long the unfilled part of an order stays in the book (optional "time_in_force" column)
+enum class TimeInForce : uint8_t {
+    GTC, // good till canceled: the rest of the order rests in the book (default)
+    IOC, // immediate or cancel: whatever does not trade right away is canceled
+    FOK  // fill or kill: the order trades completely right away, or not at all
+};
+
 // Enum for Order Action
-enum class OrderAction {
+enum class OrderAction : uint8_t {
     NEW,
     MODIFY,
     CANCEL,
@@ -38,7 +50,7 @@ enum class OrderAction {
 };
 
 // Enum for Order Status (used by the matching engine)
-enum class OrderStatus {
+enum class OrderStatus : uint8_t {
     PENDING,
     PARTIALLY_EXECUTED,
     EXECUTED,
@@ -47,8 +59,9 @@ enum class OrderStatus {
     UNKNOWN // Default/error state
 };
 
-// Helper functions to convert enums to strings (for printing/logging)
-inline std::string sideToString(Side side) {
+// Helper functions to convert enums to strings (for printing/logging, and for the output file).
+// They return views of string literals, so they never allocate.
+inline std::string_view sideToString(Side side) {
     switch (side) {
         case Side::BUY: return "BUY";
         case Side::SELL: return "SELL";
@@ -56,7 +69,7 @@ inline std::string sideToString(Side side) {
     }
 }
 
-inline std::string orderTypeToString(OrderType type) {
+inline std::string_view orderTypeToString(OrderType type) {
     switch (type) {
         case OrderType::LIMIT: return "LIMIT";
         case OrderType::MARKET: return "MARKET";
@@ -64,7 +77,16 @@ inline std::string orderTypeToString(OrderType type) {
     }
 }
 
-inline std::string orderActionToString(OrderAction action) {
+inline std::string_view timeInForceToString(TimeInForce time_in_force) {
+    switch (time_in_force) {
+        case TimeInForce::GTC: return "GTC";
+        case TimeInForce::IOC: return "IOC";
+        case TimeInForce::FOK: return "FOK";
+        default: return "UNKNOWN_TIF";
+    }
+}
+
+inline std::string_view orderActionToString(OrderAction action) {
     switch (action) {
         case OrderAction::NEW: return "NEW";
         case OrderAction::MODIFY: return "MODIFY";
@@ -73,7 +95,7 @@ inline std::string orderActionToString(OrderAction action) {
     }
 }
 
-inline std::string orderStatusToString(OrderStatus status) {
+inline std::string_view orderStatusToString(OrderStatus status) {
     switch (status) {
         case OrderStatus::PENDING: return "PENDING";
         case OrderStatus::PARTIALLY_EXECUTED: return "PARTIALLY_EXECUTED";
@@ -84,32 +106,75 @@ inline std::string orderStatusToString(OrderStatus status) {
     }
 }
 
+// The time in force and the post-only flag of an order in one byte, for the fixed-width records
+// (binary files, gateway messages, journal)
+constexpr uint8_t kOrderFlagTimeInForceMask = 0x03; // TimeInForce in the low two bits
+constexpr uint8_t kOrderFlagPostOnly = 0x04;
+inline uint8_t packOrderFlags(TimeInForce time_in_force, bool post_only) {
+    return static_cast<uint8_t>(static_cast<uint8_t>(time_in_force) | (post_only ? kOrderFlagPostOnly : 0));
+}
+// false if the byte is not one packOrderFlags can write
+inline bool unpackOrderFlags(uint8_t flags, TimeInForce& time_in_force, bool& post_only) {
+    const uint8_t tif_bits = static_cast<uint8_t>(flags & kOrderFlagTimeInForceMask);
+    if ((flags & ~(kOrderFlagTimeInForceMask | kOrderFlagPostOnly)) != 0 || tif_bits > static_cast<uint8_t>(TimeInForce::FOK)) {
+        return false;
+    }
+    time_in_force = static_cast<TimeInForce>(tif_bits);
+    post_only = (flags & kOrderFlagPostOnly) != 0;
+    return true;
+}
+
+// largest display quantity of an iceberg (the journal keeps it in 32 bits, next to the account)
+constexpr unsigned long long kMaxDisplayQuantity = 0xFFFFFFFFULL;
+
 struct Order {
     // Fields from CSV
+    // (the small fields are grouped after symbol_id, so the struct has only one padding hole, after post_only)
     unsigned long long timestamp;
     long long order_id;
-    std::string instrument;
+    uint32_t symbol_id; // interned instrument name (see SymbolTable)
+    // optional "account" column: owner of the order for the risk checks and the self-trade prevention
+    // (risk_checks.hpp). 0 = no account
+    uint32_t account_id;
     Side side;
     OrderType type;
+    OrderAction action;
+    // Field for matching engine state tracking
+    OrderStatus status;
+    TimeInForce time_in_force; // optional column, GTC when the input has none
+    bool post_only;            // LIMIT GTC only: rejected instead of trading if it would cross the book
     unsigned long long quantity; // Original total quantity of the order
     double price;
-    OrderAction action;
+    long long price_ticks; // price converted once into integer ticks of the instrument (0 for MARKET)
+    // iceberg order (LIMIT GTC only): the book shows at most this much of the order, the rest is a hidden
+    // reserve that refills the shown part each time it is fully traded. 0 = the whole order is shown
+    unsigned long long display_quantity;
 
     // Fields for matching engine state tracking
     unsigned long long remaining_quantity;
     unsigned long long cumulative_executed_quantity;
-    OrderStatus status;
+    // resting iceberg: the part of remaining_quantity that is not shown (the shown part is the difference)
+    unsigned long long hidden_quantity;
+    // position of the order in the input, given by the dispatcher. The execution reports carry it
+    // so the writer can put the output of every worker back in the order of the input
+    unsigned long long sequence;
+    // statsNowNs() when the dispatcher staged the order, for one order out of kLatencySamplePeriod
+    // (0 for the others): the worker measures the queueing time of those (see pipeline_stats.hpp)
+    unsigned long long dispatch_ns;
 
     // Default constructor
-    Order() : timestamp(0), order_id(0), instrument(""), side(Side::UNKNOWN), 
-              type(OrderType::UNKNOWN), quantity(0), price(0.0), action(OrderAction::UNKNOWN),
-              remaining_quantity(0), cumulative_executed_quantity(0), status(OrderStatus::UNKNOWN) {}
+    Order() : timestamp(0), order_id(0), symbol_id(SymbolTable::kInvalidSymbol), account_id(0), side(Side::UNKNOWN), 
+              type(OrderType::UNKNOWN), action(OrderAction::UNKNOWN), status(OrderStatus::UNKNOWN),
+              time_in_force(TimeInForce::GTC), post_only(false),
+              quantity(0), price(0.0), price_ticks(0), display_quantity(0),
+              remaining_quantity(0), cumulative_executed_quantity(0), hidden_quantity(0), sequence(0), dispatch_ns(0) {}
 
     // Overloaded operator<< for easy printing/logging
     friend std::ostream& operator<<(std::ostream& os, const Order& order) {
         os << "Timestamp: " << order.timestamp
            << ", Order ID: " << order.order_id
-           << ", Instrument: " << order.instrument
+           << ", Symbol ID: " << order.symbol_id
+           << ", Account: " << order.account_id
            << ", Side: " << sideToString(order.side)
            << ", Type: " << orderTypeToString(order.type)
            << ", OrigQty: " << order.quantity // Renamed for clarity if needed, but 'quantity' is fine
@@ -119,6 +184,13 @@ struct Order {
         } else {
             os << order.price;
         }
+        os << ", TIF: " << timeInForceToString(order.time_in_force);
+        if (order.post_only) {
+            os << ", Post-only";
+        }
+        if (order.display_quantity > 0) {
+            os << ", Display: " << order.display_quantity;
+        }
         os << ", Action: " << orderActionToString(order.action)
            << ", Status: " << orderStatusToString(order.status)
            << ", RemQty: " << order.remaining_quantity
@@ -127,12 +199,27 @@ struct Order {
     }
 };
 
+// Queue of orders between two stages of the pipeline (reader -> dispatcher, dispatcher -> book).
+// Each of these queues has one producer and one consumer, so a lock-free SPSC ring is enough;
+// ThreadSafeQueue<Order> has the same interface and can be put back here.
+using OrderQueue = SpscRing<Order>;
+
+class LatencyHistogram; // pipeline_stats.hpp
+
 // Forward declarations for functions in order.cpp (or wherever they are defined)
 
 // Sanitizer functions
 std::optional<Side> sanitizeSide(const std::string& side_str_raw, Logger& logger, const std::string& original_line);
 std::optional<OrderType> sanitizeOrderType(const std::string& type_str_raw, Logger& logger, const std::string& original_line);
 std::optional<OrderAction> sanitizeOrderAction(const std::string& action_str_raw, Logger& logger, const std::string& original_line);
+std::optional<TimeInForce> sanitizeTimeInForce(const std::string& tif_str_raw, Logger& logger, const std::string& original_line);
+std::optional<bool> sanitizePostOnly(const std::string& post_only_str_raw, Logger& logger, const std::string& original_line);
+
+// the time in force, post-only and display quantity of a NEW or MODIFY order that cannot go together
+// (post-only or iceberg on a MARKET order or with IOC/FOK, display quantity above kMaxDisplayQuantity).
+// Returns nullptr if they are fine.
+// Every reader of orders (CSV, binary file, gateway) skips the orders with such a combination
+const char* orderAttributesError(const Order& order);
 
 // CSV parsing utility
 std::optional<std::string> get_field_by_header(
@@ -146,10 +233,14 @@ std::optional<Order> parseCsvLineToOrder(
     const std::vector<std::string>& fields,
     const std::map<std::string, size_t>& header_map,
     Logger& logger,
-    const std::string& original_line
+    const std::string& original_line,
+    const TickSizeTable& tick_sizes,
+    SymbolTable& symbols
 );
 
 // Main processing function (if it's considered part of the "order" module)
-void readOrdersFromStream(std::istream& stream, Logger& logger, ThreadSafeQueue<Order>& order_queue,
-long int  max_queue_size_allowed);
+// (the order queue is bounded: the reader waits while it is full. It is not closed here.)
+// parse_latency, if given, receives the parsing time per order, measured by batches of orders
+void readOrdersFromStream(std::istream& stream, Logger& logger, OrderQueue& order_queue,
+const TickSizeTable& tick_sizes, SymbolTable& symbols, LatencyHistogram* parse_latency = nullptr);
 
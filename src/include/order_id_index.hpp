@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+
+#include "flat_hash_map.hpp"
+
+// order_id -> pool slot of the resting order.
+// A FlatHashMap (flat_hash_map.hpp): the ids and the slots are inline in one flat array, a lookup is a hash and
+// a few contiguous reads, and unlike std::unordered_map an insertion does not allocate a node.
+// The array only grows, so a warm index never allocates.
+class OrderIdIndex {
+public:
+    static constexpr uint32_t kNotFound = std::numeric_limits<uint32_t>::max();
+
+    explicit OrderIdIndex(size_t initial_capacity = 1024) : slots_(initial_capacity) {}
+
+    // Returns the slot of the order, or kNotFound
+    uint32_t find(long long order_id) const {
+        const uint32_t* slot = slots_.find(order_id);
+        return slot != nullptr ? *slot : kNotFound;
+    }
+
+    // Adds the order, or replaces its slot if the id is already there
+    void insert_or_assign(long long order_id, uint32_t slot) { slots_.insert_or_assign(order_id, slot); }
+
+    // Removes the order only if it still points to this slot
+    // (a newer order may have reused the same id)
+    bool erase_if_slot(long long order_id, uint32_t slot) {
+        return slots_.eraseIf(order_id, [slot](uint32_t current) { return current == slot; });
+    }
+
+    // Removes the order, returns its slot (or kNotFound)
+    uint32_t erase(long long order_id) {
+        uint32_t slot = kNotFound;
+        slots_.extract(order_id, slot);
+        return slot;
+    }
+
+    size_t size() const { return slots_.size(); }
+    size_t capacity() const { return slots_.capacity(); }
+    size_t bytes() const { return slots_.bytes(); }
+
+private:
+    FlatHashMap<long long, uint32_t> slots_;
+};
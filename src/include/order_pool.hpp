@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <limits>
+#include <type_traits>
+
+#include "order.hpp"
+#include "pool_memory.hpp"
+
+// Compact record of a resting order: only the fields read and written while matching.
+// 32 bytes, so a cache line holds two orders of a price level. Its price is the price of its level
+// (the sweep knows it), the cold part has its level for the cancels and modifies.
+struct RestingOrder {
+    long long order_id;
+    unsigned long long remaining_quantity;
+    uint32_t prev; // neighbours in the FIFO queue of the price level (slots of the pool)
+    uint32_t next; // also links the free slots of the pool
+    Side side;
+    OrderType type;
+    OrderAction action;
+    OrderStatus status;
+};
+
+// Cold part of a resting order: only needed to write the output records (and to match an iceberg or check its account).
+// The executed quantity is not stored, it is always quantity - remaining_quantity.
+struct RestingOrderInfo {
+    unsigned long long timestamp;
+    unsigned long long quantity; // total quantity of the order
+    double price;                // price as it was read in the input, for the output records
+    unsigned long long display_quantity; // iceberg: size of a shown slice (0 = not an iceberg)
+    unsigned long long hidden_quantity;  // iceberg: the part of remaining_quantity that is not shown
+    uint32_t account_id;                 // for the self-trade prevention and the open orders of the risk checks
+    int32_t level_offset;                // price in ticks of the order minus a fixed origin of the book (to find its level)
+};
+static_assert(sizeof(RestingOrderInfo) == 48, "the level offset fills the hole after account_id");
+static_assert(sizeof(RestingOrder) == 32, "two resting orders per cache line");
+
+// Per-book pool of resting orders.
+// Memory comes in slabs of kSlabSize orders that are never given back while the book lives:
+// released slots go to a free list and are reused by the next orders, so once the pool has
+// grown to the peak number of resting orders, adding or removing an order never allocates.
+// Hot and cold parts live in two separate arrays of the same slab (same slot number).
+// The slabs are blocks of pool_memory (huge pages in the huge page mode).
+class OrderPool {
+public:
+    static constexpr uint32_t kNoSlot = std::numeric_limits<uint32_t>::max();
+    static constexpr uint32_t kSlabBits = 12;
+    static constexpr uint32_t kSlabSize = 1u << kSlabBits;
+    static constexpr uint32_t kSlabMask = kSlabSize - 1;
+
+    OrderPool() = default;
+    ~OrderPool() {
+        for (Slab* slab : slabs_) {
+            pool_memory::releaseBlock(slab, sizeof(Slab));
+        }
+    }
+    OrderPool(const OrderPool&) = delete;
+    OrderPool& operator=(const OrderPool&) = delete;
+
+    // Returns a free slot (its content is not initialized)
+    uint32_t allocate() {
+        uint32_t slot;
+        if (free_head_ != kNoSlot) {
+            slot = free_head_;
+            free_head_ = hot(slot).next;
+        } else {
+            if ((next_unused_ & kSlabMask) == 0 && (next_unused_ >> kSlabBits) == slabs_.size()) {
+                slabs_.reserve(slabs_.size() + 1);
+                slabs_.push_back(static_cast<Slab*>(pool_memory::allocateBlock(sizeof(Slab))));
+            }
+            slot = next_unused_++;
+        }
+        in_use_++;
+        return slot;
+    }
+
+    // Gives a slot back to the pool
+    void release(uint32_t slot) {
+        hot(slot).prev = kNoSlot;
+        hot(slot).next = free_head_;
+        free_head_ = slot;
+        in_use_--;
+    }
+
+    RestingOrder& hot(uint32_t slot) { return slabs_[slot >> kSlabBits]->hot[slot & kSlabMask]; }
+    const RestingOrder& hot(uint32_t slot) const { return slabs_[slot >> kSlabBits]->hot[slot & kSlabMask]; }
+    RestingOrderInfo& cold(uint32_t slot) { return slabs_[slot >> kSlabBits]->cold[slot & kSlabMask]; }
+    const RestingOrderInfo& cold(uint32_t slot) const { return slabs_[slot >> kSlabBits]->cold[slot & kSlabMask]; }
+
+    size_t in_use() const { return in_use_; }
+    size_t capacity() const { return slabs_.size() * kSlabSize; }
+    // bytes of the slabs, and of the slots in use
+    size_t bytes() const { return slabs_.size() * sizeof(Slab); }
+    size_t used_bytes() const { return in_use_ * (sizeof(RestingOrder) + sizeof(RestingOrderInfo)); }
+
+private:
+    struct Slab {
+        RestingOrder hot[kSlabSize];
+        RestingOrderInfo cold[kSlabSize];
+    };
+
+    // plain structs in raw blocks: a slab is never constructed, every slot is written before it is read
+    static_assert(std::is_trivially_copyable<RestingOrder>::value && std::is_trivially_copyable<RestingOrderInfo>::value,
+                  "the slabs are raw memory");
+    std::vector<Slab*> slabs_;
+    uint32_t free_head_ = kNoSlot; // first released slot
+    uint32_t next_unused_ = 0;     // slots above it were never handed out
+    size_t in_use_ = 0;
+};
@@ -5,118 +5,420 @@
 #include <map>
 #include <list>
 #include <functional> // For std::greater
-#include <iostream>   // For ostream in OutputRecord, cerr
+#include <iostream>   // For cerr
+#include <type_traits> // For the ExecutionReport check
 #include <algorithm>  // For std::min
-#include <set>        // For ids_traded_this_event_
 #include <atomic>
+#include <memory>     // For std::unique_ptr, std::shared_ptr
 
 // Assumes order.hpp defines:
-// - struct Order (with all fields: timestamp, order_id, instrument, side, type, quantity, price, action,
+// - struct Order (with all fields: timestamp, order_id, symbol_id, side, type, quantity, price, action,
 //                 remaining_quantity, cumulative_executed_quantity, status)
 // - enum class Side, OrderType, OrderAction, OrderStatus
 // - helper functions: sideToString, orderTypeToString, orderActionToString, orderStatusToString
 #include "order.hpp" 
+#include "alloc_counter.hpp"
+#include "market_data.hpp"
+#include "risk_checks.hpp"
+#include "node_pool.hpp"
+#include "flat_hash_map.hpp"
+#include "pool_memory.hpp"
 
-// Structure for CSV output, matching the PDF specification
-struct OutputRecord {
+// One line of the CSV output (matching the PDF specification), in binary form.
+// It is a plain fixed-size struct: the books copy it into the output ring without any allocation,
+// and only the writer turns it into text (report_writer.hpp). The instrument is carried as its
+// interned id, and the prices stay doubles so the file is printed exactly like before.
+struct ExecutionReport {
+    unsigned long long sequence;          // input sequence number of the order that caused this event
     unsigned long long timestamp;
     long long order_id;
-    std::string instrument;
-    std::string side_str; 
-    std::string type_str; 
-    unsigned long long original_quantity_or_remaining; // Renamed for clarity based on usage
-    double price; 
-    std::string action_str; 
-    std::string status_str; 
-    unsigned long long executed_this_event_quantity; 
+    unsigned long long quantity;          // original or remaining quantity, depending on the status
+    double price;
+    unsigned long long executed_quantity; // quantity traded by this event
     double execution_price;
-    long long counterparty_id; 
-
-    OutputRecord(unsigned long long ts, long long oid, const std::string& instr,
-                 Side s, OrderType ot, unsigned long long oq_or_rem, double p, OrderAction oa,
-                 OrderStatus st, unsigned long long eq, double ep, long long cpid)
-        : timestamp(ts), order_id(oid), instrument(instr),
-          side_str(sideToString(s)), type_str(orderTypeToString(ot)),
-          original_quantity_or_remaining(oq_or_rem), price(p), action_str(orderActionToString(oa)),
-          status_str(orderStatusToString(st)), executed_this_event_quantity(eq),
-          execution_price(ep), counterparty_id(cpid) {}
-
-    friend std::ostream& operator<<(std::ostream& os, const OutputRecord& orc) {
-        os << orc.timestamp << ","
-           << orc.order_id << ","
-           << orc.instrument << ","
-           << orc.side_str << ","
-           << orc.type_str << ","
-           << orc.original_quantity_or_remaining << "," // This is the 6th column
-           << orc.price << ","
-           << orc.action_str << ","
-           << orc.status_str << ","
-           << orc.executed_this_event_quantity << ","
-           << orc.execution_price << ","
-           << orc.counterparty_id;
-        return os;
-    }
+    long long counterparty_id;
+    uint32_t symbol_id;
+    Side side;
+    OrderType type;
+    OrderAction action;
+    OrderStatus status;
 };
+static_assert(std::is_trivially_copyable<ExecutionReport>::value, "ExecutionReport must stay a plain struct");
+
+// The market data updates of a book travel in the output ring of its worker, between its execution reports,
+// so the writer gets them in the order of the input too (whatever the number of workers).
+// Like a watermark (output_merger.hpp) they are pseudo reports: the books never report the UNKNOWN status,
+// and the fields of the update are stored in the report fields of the same type.
+inline ExecutionReport makeMarketDataRecord(const MarketDataUpdate& update) {
+    ExecutionReport record{};
+    record.sequence = update.sequence;
+    record.timestamp = update.timestamp;
+    record.order_id = static_cast<long long>(update.update_number);
+    record.quantity = update.quantity;
+    record.price = update.price;
+    record.executed_quantity = update.order_count;
+    record.execution_price = update.ask_price;
+    record.counterparty_id = static_cast<long long>(update.ask_quantity);
+    record.symbol_id = update.symbol_id;
+    record.side = update.side;
+    record.type = OrderType::UNKNOWN;
+    record.action = static_cast<OrderAction>(update.kind);
+    record.status = OrderStatus::UNKNOWN;
+    return record;
+}
+
+inline bool isMarketData(const ExecutionReport& record) {
+    return record.status == OrderStatus::UNKNOWN;
+}
+
+inline MarketDataUpdate readMarketDataRecord(const ExecutionReport& record) {
+    MarketDataUpdate update;
+    update.sequence = record.sequence;
+    update.timestamp = record.timestamp;
+    update.update_number = static_cast<unsigned long long>(record.order_id);
+    update.symbol_id = record.symbol_id;
+    update.kind = static_cast<MarketDataKind>(record.action);
+    update.side = record.side;
+    update.price = record.price;
+    update.quantity = record.quantity;
+    update.order_count = record.executed_quantity;
+    update.ask_price = record.execution_price;
+    update.ask_quantity = static_cast<unsigned long long>(record.counterparty_id);
+    return update;
+}
+
 
+// Queue of the execution reports of one matching worker: its books push into it, only the writer pops (SPSC).
+// The writer merges the queues of all the workers back into the order of the input (output_merger.hpp)
+using OutputQueue = SpscRing<ExecutionReport>;
 
-class OrderBook {
+// Common part of every order book implementation: the counters and the creation of the output records.
+// Each implementation only has to provide processSingleOrder (the matching logic itself).
+// A book has no thread of its own: it is owned by one BookWorker (worker_pool.hpp),
+// which calls processOrder for every order of its instrument.
+class OrderBookBase {
 public:
-    explicit OrderBook(const std::string& instrument_name);
-
-    
-    void startProcessingThread(){
-        processing_thread_ = std::thread([this]() {
-            while (!stop_processing_ || !order_queue_.empty()) {
-                Order order;
-                if (order_queue_.try_pop(order)) {
-                    processSingleOrder(order);
-                } else {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1)); // Sleep briefly to avoid busy-waiting
-                }
-            }
-        });
-    }
+    OrderBookBase(const std::string& instrument_name, uint32_t symbol_id);
+    virtual ~OrderBookBase() = default;
 
-    void set_output_log_queue(std::shared_ptr<ThreadSafeQueue<std::string>>& output_log_queue) {
-        output_log_queue_ = output_log_queue; // Set the output log queue for logging output records
-    }
+    OrderBookBase(const OrderBookBase&) = delete;
+    OrderBookBase& operator=(const OrderBookBase&) = delete;
 
-    void stopProcessingThread() {
-        stop_processing_ = true;
-        if (processing_thread_.joinable()) {
-            processing_thread_.join();
-        }
-    }
+    // process one order of this instrument (only called from the thread of the owning worker)
+    void processOrder(Order& order) { runOrder<OrderBookBase>(order); }
 
-    void addOrder(Order &order){
-        order_queue_.push(std::move(order)); // Push the order into the thread-safe queue
+    // same, for a caller that knows the exact type of the book (Book is OrderBook or LadderOrderBook,
+    // see inline_engine.hpp): the matching of Book is called directly, not through the virtual table
+    template <typename Book>
+    void processOrderAs(Order& order) { runOrder<Book>(order); }
+
+    void set_output_log_queue(std::shared_ptr<OutputQueue>& output_log_queue) {
+        output_log_queue_ = output_log_queue; // Set the output log queue for logging output records
     }
+    // instead of the output ring: the reports (and market data) are appended to this vector,
+    // which the caller empties after each order (inline_engine.hpp). nullptr goes back to the ring
+    void set_report_buffer(std::vector<ExecutionReport>* report_buffer) { report_buffer_ = report_buffer; }
 
-    const std::vector<OutputRecord>& getOutputRecords() const;
     const std::string& getInstrumentName() const;
-    void printOrderBookSnapshot() const;
 
-private:
-std::shared_ptr<ThreadSafeQueue<std::string>> output_log_queue_; // Optional: for logging output records in a thread-safe manner
-    ThreadSafeQueue<Order> order_queue_; // Thread-safe queue for incoming orders
-    std::atomic<bool> stop_processing_{false}; // Flag to stop processing thread
-    std::thread processing_thread_; // Thread for processing orders
-    void processSingleOrder(Order& order);
+    // Level 2 market data (market_data.hpp), off until this is called (before the first order).
+    // A full depth snapshot is published every snapshot_interval orders of the book (0 = never)
+    void enableMarketData(unsigned long long snapshot_interval);
+    // the book was filled without orders (restoreRestingOrder): publish its full depth before its next order,
+    // instead of updates for the restored levels
+    void requestMarketDataSnapshot();
+
+    // Pre-trade risk checks and self-trade prevention (risk_checks.hpp), off until this is called (before the
+    // first order and any restore). The book keeps the open orders of every account of the config
+    void enableRiskChecks(const std::shared_ptr<const RiskConfig>& config);
+
+    // State of the book for the snapshots (book_snapshot.hpp). Only call them while the owning worker
+    // is not processing orders (before it starts, or once it is idle).
+    // append every resting order to out, in priority order: bids then asks, best price first,
+    // oldest first within a price level
+    virtual void collectRestingOrders(std::vector<Order>& out) const = 0;
+    // put a resting order of a snapshot back, at the back of its price level (so restoring the orders
+    // in the order collectRestingOrders gave them rebuilds the same queues). No report is written.
+    // Returns false if the book cannot hold it
+    virtual bool restoreRestingOrder(const Order& order) = 0;
+
+    // counters of the processing (read them after the worker is stopped)
+    unsigned long long getProcessedOrders() const { return processed_orders_; }
+    // heap allocations made while matching, output formatting excluded
+    unsigned long long getMatchingAllocations() const { return matching_allocations_; }
+    // heap allocations made while queueing the execution reports (the text is formatted by the writer)
+    unsigned long long getOutputAllocations() const { return output_allocations_; }
+    // trades (each one is reported for both of its orders), cancels and rejects reported by this book
+    unsigned long long getFillCount() const { return execution_reports_ / 2; }
+    unsigned long long getCancelCount() const { return cancel_reports_; }
+    unsigned long long getRejectCount() const { return reject_reports_; }
+    // orders rejected by one risk check (they are in getRejectCount too), and trades stopped by the
+    // self-trade prevention
+    unsigned long long getRiskRejectCount(RiskCheck check) const { return risk_rejects_[static_cast<size_t>(check)]; }
+    unsigned long long getSelfTradeCount() const { return self_trades_prevented_; }
+    // current shape of the book: non-empty price levels (both sides) and resting orders
+    virtual size_t getLevelCount() const = 0;
+    virtual size_t getRestingOrderCount() const = 0;
+    // memory held by the book: its pools (and how full they are), its levels, its order index
+    virtual BookMemoryStats getMemoryStats() const = 0;
+
+protected:
+    // the matching logic of the implementation, called for every order of the queue
+    virtual void processSingleOrder(Order& order) = 0;
+
+    // one price level, seen by the market data. key identifies the level in the book (its price in ticks
+    // for the ladder, the bits of its price for the map book)
+    struct LevelState {
+        Side side;
+        long long key;
+        double price;
+        unsigned long long quantity;
+        unsigned long long order_count;
+    };
+    // the books call it just BEFORE they change a level (an order rests, leaves or trades there):
+    // the first call of an order keeps the state of the level from before the order
+    void touchLevel(Side side, long long key, double price) {
+        if (market_data_enabled_) {
+            recordTouchedLevel(side, key, price);
+        }
+    }
+    // fill quantity and order_count of the level of this side and key (0 and 0 if it is empty)
+    virtual void readLevel(LevelState& level) const = 0;
+    // the best bid and the best ask levels (order_count 0 for an empty side)
+    virtual void readBestLevels(LevelState& best_bid, LevelState& best_ask) const = 0;
+    // append every non-empty level: bids from the best one down, then asks from the best one up
+    virtual void collectLevels(std::vector<LevelState>& out) const = 0;
+
     std::string instrument_name_;
-    std::map<double, std::list<Order>, std::greater<double>> bids_; 
-    std::map<double, std::list<Order>> asks_;                     
-  
-    std::set<long long> ids_traded_this_event_; 
-
-    // Corrected declarations:
-    void matchOrders(unsigned long long event_timestamp);
-
-    void recordMatchAndCreateOutput(Order& aggressive_order, Order& passive_order,
-                                    unsigned long long matched_qty, double match_price,
-                                    unsigned long long event_timestamp); // Added event_timestamp
-    
+    uint32_t symbol_id_; // interned id of instrument_name_, orders of other ids are rejected
+
     void addInitialOutputRecord(const Order& order_state_for_log, OrderStatus status_to_log, 
                                 unsigned long long executed_qty_this_event, 
                                 double exec_price, long long counterparty,
                                 unsigned long long event_timestamp); // Added event_timestamp
+
+    // Extended order types (order.hpp), the same in every book:
+    // the unfilled rest of an IOC order does not rest, it is reported CANCELED
+    void expireUnfilledRest(const Order& order, unsigned long long event_timestamp);
+    // an iceberg about to rest shows at most display_quantity, the rest of it goes to the hidden reserve
+    static void startIcebergSlice(Order& order) {
+        order.hidden_quantity = (order.display_quantity > 0 && order.display_quantity < order.remaining_quantity)
+                                    ? order.remaining_quantity - order.display_quantity : 0;
+    }
+    // the shown part of a resting iceberg is fully traded: the next slice comes out of the reserve.
+    // Returns its size (the caller moves the order to the back of its level, it loses its time priority)
+    static unsigned long long refillIcebergSlice(unsigned long long display_quantity, unsigned long long& hidden_quantity) {
+        unsigned long long slice = std::min(display_quantity, hidden_quantity);
+        hidden_quantity -= slice;
+        return slice;
+    }
+
+    // fill one execution report and push it to the output queue
+    void emitOutputRecord(unsigned long long event_timestamp, long long order_id, Side side, OrderType type,
+                          unsigned long long quantity, double price, OrderAction action, OrderStatus status,
+                          unsigned long long executed_quantity, double execution_price, long long counterparty_id);
+
+    // The two reports of every fill of one incoming order are collected on the stack of the sweep,
+    // and pushed to the output together (one push_batch) when the sweep is over, or when the batch is full
+    struct FillBatch {
+        static constexpr size_t kCapacity = 32; // reports, two per fill
+        ExecutionReport records[kCapacity];
+        size_t size = 0;
+    };
+    // same as emitOutputRecord, into the batch
+    void addFillRecord(FillBatch& batch, unsigned long long event_timestamp, long long order_id, Side side, OrderType type,
+                       unsigned long long quantity, double price, OrderAction action, OrderStatus status,
+                       unsigned long long executed_quantity, double execution_price, long long counterparty_id) {
+        if (batch.size == FillBatch::kCapacity) {
+            flushFillBatch(batch);
+        }
+        fillOutputRecord(batch.records[batch.size++], event_timestamp, order_id, side, type, quantity, price, action,
+                         status, executed_quantity, execution_price, counterparty_id);
+    }
+    void flushFillBatch(FillBatch& batch);
+
+    // Risk state of the book. The books call these when an order starts or stops resting (a trade, a cancel,
+    // a modify): the open orders of an account are only counted while the checks are on
+    void countRestingOrder(uint32_t account_id) {
+        if (risk_config_) {
+            open_orders_[account_id]++;
+        }
+    }
+    void uncountRestingOrder(uint32_t account_id) {
+        if (risk_config_) {
+            uint32_t* open_orders = open_orders_.find(account_id);
+            if (open_orders != nullptr && --*open_orders == 0) {
+                open_orders_.erase(account_id); // the table only holds the accounts resting in the book
+            }
+        }
+    }
+    // the sweep met a resting order of the account of the incoming order: they must not trade
+    bool isSelfTrade(uint32_t incoming_account, uint32_t resting_account) const {
+        return self_trade_prevention_ != SelfTradePrevention::NONE && incoming_account != 0 &&
+               incoming_account == resting_account;
+    }
+    // the account whose resting orders this order must not trade with (0 = none)
+    uint32_t selfTradeAccount(const Order& order) const {
+        return self_trade_prevention_ != SelfTradePrevention::NONE ? order.account_id : 0;
+    }
+    SelfTradePrevention self_trade_prevention_ = SelfTradePrevention::NONE;
+    // set by a sweep that the self-trade prevention stopped: the rest of the incoming order is canceled
+    bool self_trade_stopped_ = false;
+    unsigned long long self_trades_prevented_ = 0;
+
+private:
+    template <typename Book>
+    void runOrder(Order& order) {
+        // count the allocations of the matching itself (the output formatting is counted apart)
+        unsigned long long allocations_before = alloc_counter::thread_allocations();
+        unsigned long long output_allocations_before = output_allocations_;
+        current_sequence_ = order.sequence; // every report of this order carries it
+        if (market_data_snapshot_due_) {
+            publishMarketDataSnapshot(order.timestamp); // restored levels: their depth comes first
+        }
+        self_trade_stopped_ = false;
+        // the pre-trade checks come first: a rejected order never reaches the matching
+        if (risk_config_ == nullptr || passesRiskChecks(order)) {
+            if constexpr (std::is_same<Book, OrderBookBase>::value) {
+                processSingleOrder(order);
+            } else {
+                static_cast<Book*>(this)->Book::processSingleOrder(order); // qualified: no virtual call
+            }
+        }
+        if (market_data_enabled_) {
+            publishMarketData(order.timestamp);
+        }
+        matching_allocations_ += (alloc_counter::thread_allocations() - allocations_before)
+                                 - (output_allocations_ - output_allocations_before);
+        processed_orders_++;
+    }
+
+    // to the output ring, or to the report buffer of an inline caller
+    void pushRecord(const ExecutionReport& record) {
+        if (report_buffer_ != nullptr) {
+            report_buffer_->push_back(record);
+        } else {
+            output_log_queue_->push(record); // blocks while the ring is full
+        }
+    }
+    void pushRecords(ExecutionReport* records, size_t count) {
+        if (report_buffer_ != nullptr) {
+            report_buffer_->insert(report_buffer_->end(), records, records + count);
+        } else {
+            output_log_queue_->push_batch(records, count);
+        }
+    }
+    // the fields of a report, and the counters of its kind
+    void fillOutputRecord(ExecutionReport& report, unsigned long long event_timestamp, long long order_id, Side side,
+                          OrderType type, unsigned long long quantity, double price, OrderAction action,
+                          OrderStatus status, unsigned long long executed_quantity, double execution_price,
+                          long long counterparty_id);
+
+    // false (and the order is reported REJECTED) if a NEW or MODIFY order breaks a limit of its account
+    bool passesRiskChecks(const Order& order);
+
+    void recordTouchedLevel(Side side, long long key, double price);
+    // coalesced updates of the order that was just processed, the BBO, and the snapshot when it is due
+    void publishMarketData(unsigned long long event_timestamp);
+    void publishMarketDataSnapshot(unsigned long long event_timestamp);
+    void emitMarketData(unsigned long long event_timestamp, MarketDataKind kind, Side side, double price,
+                        unsigned long long quantity, unsigned long long order_count,
+                        double ask_price = 0.0, unsigned long long ask_quantity = 0);
+
+    std::shared_ptr<OutputQueue> output_log_queue_; // execution reports of this book, drained by the writer
+    std::vector<ExecutionReport>* report_buffer_ = nullptr;
+
+    bool market_data_enabled_ = false;
+    unsigned long long market_data_snapshot_interval_ = 0;
+    unsigned long long orders_since_market_data_snapshot_ = 0;
+    bool market_data_snapshot_due_ = false;
+    unsigned long long market_data_updates_ = 0;  // update_number of the last update
+    std::vector<LevelState> touched_levels_;      // levels changed by the current order, state before it
+    std::vector<LevelState> snapshot_levels_;     // reused by every snapshot
+    LevelState published_bid_{};                  // best levels of the last BBO update
+    LevelState published_ask_{};
+
+    std::shared_ptr<const RiskConfig> risk_config_; // nullptr: no pre-trade checks
+    FlatHashMap<uint32_t, uint32_t> open_orders_;   // account id -> resting orders in this book (only accounts with some)
+    unsigned long long risk_rejects_[static_cast<size_t>(RiskCheck::COUNT)] = {};
+    double last_trade_price_ = 0.0;                 // reference price of the price band
+    bool has_last_trade_ = false;
+
+    unsigned long long current_sequence_ = 0; // sequence number of the order being processed
+    unsigned long long processed_orders_ = 0;
+    unsigned long long matching_allocations_ = 0;
+    unsigned long long output_allocations_ = 0;
+    unsigned long long execution_reports_ = 0;
+    unsigned long long cancel_reports_ = 0;
+    unsigned long long reject_reports_ = 0;
 };
+
+
+// Reference order book: price levels in a std::map keyed by price, FIFO std::list of orders per level.
+// The nodes of the maps and the lists come from the NodePool of the book (node_pool.hpp), so the levels and
+// the orders that come and go reuse the same nodes instead of going through the heap; the order index is a
+// flat hash map (flat_hash_map.hpp) with the locations inline
+class OrderBook final : public OrderBookBase {
+    friend class OrderBookBase; // processOrderAs calls processSingleOrder directly
+public:
+    OrderBook(const std::string& instrument_name, uint32_t symbol_id);
+
+    void collectRestingOrders(std::vector<Order>& out) const override;
+    bool restoreRestingOrder(const Order& order) override;
+    size_t getLevelCount() const override { return bids_.size() + asks_.size(); }
+    size_t getRestingOrderCount() const override { return order_index_.size(); }
+    BookMemoryStats getMemoryStats() const override;
+
+private:
+    void processSingleOrder(Order& order) override;
+    void readLevel(LevelState& level) const override;
+    void readBestLevels(LevelState& best_bid, LevelState& best_ask) const override;
+    void collectLevels(std::vector<LevelState>& out) const override;
+
+    // FIFO list of the orders of one price, and the sum of their remaining quantities
+    // (kept up to date by every change, so the market data never walks the list)
+    using OrderList = std::list<Order, PoolAllocator<Order>>;
+    struct PriceLevel {
+        explicit PriceLevel(const PoolAllocator<Order>& allocator) : orders(allocator) {}
+        OrderList orders;
+        unsigned long long total_quantity = 0;  // what can trade at this price (FOK checks)
+        unsigned long long hidden_quantity = 0; // the part of it in iceberg reserves (not in the market data)
+    };
+    // declared first: the containers give their nodes back to it when the book is destroyed
+    NodePool node_pool_;
+    std::map<double, PriceLevel, std::greater<double>, PoolAllocator<std::pair<const double, PriceLevel>>> bids_;
+    std::map<double, PriceLevel, std::less<double>, PoolAllocator<std::pair<const double, PriceLevel>>> asks_;
+
+    // Where a resting order lives in the book: its node in the level list (the side and the price level are
+    // read from the order in the node, a resting order never changes them in place).
+    // std::list iterators stay valid until the node itself is erased, so we can jump straight to it.
+    struct OrderLocation {
+        OrderList::iterator position;
+    };
+    // order_id -> location of the resting order, so MODIFY and CANCEL don't have to scan the whole book
+    FlatHashMap<long long, OrderLocation> order_index_;
+
+    // add an order at the back of its price level and register it in the index
+    void restOrder(const Order& order);
+    // remove a resting order from the index (only if the index still points to this exact node)
+    void unindexOrder(long long order_id, OrderList::iterator position);
+    // find a resting order by id, copy it into removed_order and take it out of the book
+    bool removeRestingOrder(long long order_id, Order& removed_order);
+    // the market data key of a level of this book: the bits of its price
+    static long long levelKey(double price);
+    // false for a post-only order that would trade right away and for a FOK order that cannot trade
+    // completely right away (read from the total quantities of the levels, nothing is matched)
+    bool passesEntryChecks(const Order& order, bool is_market) const;
+
+    // match an incoming order against the opposite side in one pass: level after level from the best one,
+    // each level's queue consumed in a tight loop. LIMIT orders stop at their limit price, MARKET orders
+    // sweep until filled or the side is empty. Returns the number of fills
+    size_t sweep(Order& incoming_order, bool is_market, unsigned long long event_timestamp);
+    template <typename Levels>
+    size_t sweepSide(Levels& levels, Side resting_side, Order& incoming_order, bool is_market,
+                     unsigned long long event_timestamp, FillBatch& fills_batch);
+};
+
+// Creates the order book implementation selected with --book-type ("map" or "ladder")
+std::unique_ptr<OrderBookBase> createOrderBook(const std::string& book_type, const std::string& instrument_name,
+                                               uint32_t symbol_id);
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "pipeline_stats.hpp" // For OutputIoStats
+
+// How the text writers (report_writer.hpp) hand their buffers to the kernel ("--output-io"):
+//   SYNC      the formatting thread calls write() itself when its buffer is full (and waits for it)
+//   PWRITE    two buffers: while one is written by a background thread with pwrite(), the other is filled
+//   IO_URING  the same two buffers, but a full one is submitted to an io_uring ring and the formatting thread
+//             goes on at once: no extra thread, the kernel does the copy. When the kernel refuses io_uring
+//             (too old, or forbidden in a container) the file falls back to PWRITE
+// With two buffers the formatting thread only waits when it filled a whole buffer before the disk took the
+// previous one. "direct" adds O_DIRECT (when the file system allows it): the buffers are aligned on 4 KiB
+// and every write covers whole 4 KiB blocks at a 4 KiB offset, the partial last block is carried over to the
+// next buffer (and written padded with zeros at the end, the file is then cut back to its real size).
+enum class OutputIo : uint8_t {
+    SYNC,
+    PWRITE,
+    IO_URING
+};
+
+const char* outputIoToString(OutputIo io); // "sync", "pwrite", "io_uring"
+// "sync", "pwrite" or "io_uring". Returns false for anything else
+bool parseOutputIo(std::string_view text, OutputIo& io);
+
+struct OutputFileOptions {
+    OutputIo io = OutputIo::SYNC;
+    bool direct = false;
+    size_t buffer_bytes = 1 << 20;   // size of each buffer (rounded up to 4 KiB)
+    OutputIoStats* stats = nullptr;  // the write throughput of the file goes there, if given
+};
+
+// An output file written from big aligned buffers. The writer formats into data() and hands the first bytes
+// of it over with submit(); data() may be another buffer afterwards. Only one thread uses the object
+// (the background thread of PWRITE is internal).
+class OutputFile {
+public:
+    static constexpr size_t kAlignment = 4096;
+
+    OutputFile();
+    ~OutputFile(); // close() if it was not called (the errors are lost)
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    // create (or truncate) the file, returns false (and the reason in error) on failure
+    bool open(const std::string& path, const OutputFileOptions& options, std::string& error);
+    bool isOpen() const { return fd_ >= 0; }
+
+    // buffer being filled and its size
+    char* data() { return buffers_[current_]; }
+    size_t capacity() const { return capacity_; }
+
+    // write the first size bytes of data(). Returns the number of bytes now at the start of data() that still
+    // belong to the file (the partial last block in direct mode, 0 otherwise): the next bytes go after them
+    size_t submit(size_t size);
+    // the same, and wait until everything is in the file (the partial block of direct mode is written padded,
+    // and written again by the next submit)
+    size_t flush(size_t size);
+    // io_uring: take the completion of the write in flight if it is there, without waiting (the time of the writes
+    // in the stats is the time until a completion is seen: the writer calls this every few hundred lines)
+    void poll();
+    // make data() hold at least capacity bytes, keeping its first used bytes (for an absurdly long line)
+    void reserve(size_t capacity, size_t used);
+
+    // flush the first size bytes of data(), cut the file to its real size and close it.
+    // Returns false (and the reason in error) if a write failed
+    bool close(size_t size, std::string& error);
+
+    OutputIo io() const { return io_; }       // the one really used (after the fallbacks)
+    bool direct() const { return direct_; }   // false if the file system refused O_DIRECT
+    unsigned long long bytesWritten() const { return file_size_; } // bytes handed to the kernel so far
+    int writeErrno() const { return write_errno_; } // errno of the first failed write (known after flush())
+
+private:
+    struct Write {
+        const char* data = nullptr;
+        size_t size = 0;
+        uint64_t offset = 0;
+    };
+
+    // start writing the first size bytes of buffer at offset (buffer must then stay untouched until waitIdle)
+    void startWrite(int buffer, size_t size, uint64_t offset);
+    // wait for the write in flight, if any
+    void waitIdle();
+    // pwrite (or write for a pipe) of the whole range, keeps the first error
+    void writeRange(const Write& write);
+    void writerLoop();
+
+    bool setupUring();
+    void submitUring();
+    // wait for the next completion of the ring, false if the write in flight is not finished yet
+    bool reapUring();
+
+    int fd_ = -1;
+    OutputIo io_ = OutputIo::SYNC;
+    bool direct_ = false;
+    bool seekable_ = true;     // false for a pipe: plain write() in order, no pwrite
+    OutputIoStats* stats_ = nullptr;
+    char* buffers_[2] = {nullptr, nullptr};
+    size_t capacity_ = 0;
+    int current_ = 0;
+    uint64_t offset_ = 0;      // file offset of data()[0]
+    uint64_t file_size_ = 0;   // end of the bytes submitted so far
+    int write_errno_ = 0;      // errno of the first failed write (written by the background thread too, see mutex_)
+
+    // PWRITE: the background thread and the write it is given
+    std::thread writer_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    Write pending_;
+    bool has_pending_ = false;
+    bool stopping_ = false;
+
+    // IO_URING: the rings shared with the kernel (one write in flight at most, see output_file.cpp)
+    struct Uring;
+    std::unique_ptr<Uring> uring_;
+};
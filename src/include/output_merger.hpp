@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "orderbook.hpp"      // For ExecutionReport, OutputQueue
+#include "symbol_table.hpp"   // For kInvalidSymbol
+#include "worker_pool.hpp"
+
+// A watermark is a pseudo report a worker pushes into its output ring after each batch of orders:
+// "every report of the orders up to this sequence number is already in the ring".
+// It is told apart from a real report by its invalid instrument id, and never reaches the output file.
+inline ExecutionReport makeWatermark(unsigned long long sequence) {
+    ExecutionReport watermark{};
+    watermark.sequence = sequence;
+    watermark.symbol_id = SymbolTable::kInvalidSymbol;
+    return watermark;
+}
+
+inline bool isWatermark(const ExecutionReport& report) {
+    return report.symbol_id == SymbolTable::kInvalidSymbol;
+}
+
+// Writer side of the output: merges the output rings of all the workers into the order of the input.
+// The dispatcher numbers the orders and logs the worker of each one (WorkerPool::getRouteLog),
+// so the merge is a walk over the route log: for order number s, take the reports of sequence s
+// from the ring of its worker, until that ring shows a later report or a watermark at or past s.
+// A worker processes its orders in input order, so its ring is sorted by sequence and the reports of
+// one order stay in the order the book produced them. The output file is therefore the same,
+// byte for byte, whatever the number of workers and however the threads are scheduled.
+class OutputMerger {
+public:
+    // number of reports (or routes) taken from a ring at once
+    static constexpr size_t kLaneBatchSize = 256;
+
+    explicit OutputMerger(WorkerPool& worker_pool);
+    // any producer of routes and lanes (the shards of shard.hpp): route_log gives the lane of every order
+    OutputMerger(SpscRing<uint32_t>& route_log, const std::vector<OutputQueue*>& lanes);
+
+    OutputMerger(const OutputMerger&) = delete;
+    OutputMerger& operator=(const OutputMerger&) = delete;
+
+    // next reports in the order of the input. Waits for at least one, returns 0 once every worker
+    // is stopped and everything was merged (same contract as the pop_batch of the rings)
+    size_t pop_batch(ExecutionReport* out, size_t max_count);
+
+private:
+    // reports taken from the ring of one worker and not merged yet
+    struct Lane {
+        OutputQueue* queue = nullptr;
+        std::vector<ExecutionReport> reports = std::vector<ExecutionReport>(kLaneBatchSize);
+        size_t position = 0;
+        size_t size = 0;
+    };
+
+    SpscRing<uint32_t>& route_log_;
+    std::vector<Lane> lanes_;
+    std::vector<uint32_t> routes_ = std::vector<uint32_t>(kLaneBatchSize);
+    size_t route_position_ = 0;
+    size_t route_count_ = 0;
+
+    bool in_order_ = false;                 // true while the reports of current_sequence_ are merged
+    size_t current_lane_ = 0;               // worker of current_sequence_
+    unsigned long long current_sequence_ = 0;
+};
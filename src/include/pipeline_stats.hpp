@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "bench_stats.hpp" // For LatencySummary
+#include "logger.hpp"
+#include "order.hpp"       // For OrderQueue
+
+// Lightweight instrumentation of the pipeline (reader -> dispatcher -> workers -> writer).
+// Every counter and histogram has exactly one writer thread, so recording is a relaxed load and store
+// (no lock, no read-modify-write), and any other thread can read them while the pipeline runs:
+// that is what the periodic dump of --stats-interval does, the final summary reads them after the joins
+// (logPipelineSnapshot and logPipelineSummary, worker_pool.hpp).
+
+// clock of the instrumentation. steady_clock is a vDSO call (~20 ns): the per-order hops are only
+// timed for one order out of kLatencySamplePeriod, the other stages are timed per batch
+inline uint64_t statsNowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// one order out of this many gets its queueing and matching time measured (a power of two)
+constexpr unsigned long long kLatencySamplePeriod = 64;
+
+// counter written by one thread, readable by the others
+class StatCounter {
+public:
+    void add(uint64_t amount = 1) { value_.store(value_.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed); }
+    void set(uint64_t value) { value_.store(value, std::memory_order_relaxed); }
+    uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// HDR-style latency histogram (nanoseconds), written by one thread.
+// Values below 16 have their own bucket, above that every power of two is split into 16 buckets,
+// so a percentile is known within ~3% whatever the magnitude, in a fixed 8 KB table.
+class LatencyHistogram {
+public:
+    static constexpr unsigned kSubBucketBits = 4;
+    static constexpr size_t kSubBuckets = size_t{1} << kSubBucketBits;
+    static constexpr size_t kBucketCount = kSubBuckets + (64 - kSubBucketBits) * kSubBuckets;
+
+    // record `count` samples of this value (the batch timers record the mean of a batch once per item)
+    void record(uint64_t value_ns, uint64_t count = 1) {
+        std::atomic<uint64_t>& bucket = buckets_[bucketIndex(value_ns)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+        count_.add(count);
+        sum_ns_.add(value_ns * count);
+        if (value_ns > max_ns_.get()) {
+            max_ns_.set(value_ns);
+        }
+    }
+
+    uint64_t count() const { return count_.get(); }
+    uint64_t sumNs() const { return sum_ns_.get(); }
+
+    // add the samples of another histogram (this one must not be recorded into at the same time)
+    void merge(const LatencyHistogram& other);
+
+    // count, mean, percentiles (middle of their bucket) and max of the samples recorded so far
+    LatencySummary summarize() const;
+
+private:
+    static size_t bucketIndex(uint64_t value) {
+        if (value < kSubBuckets) {
+            return static_cast<size_t>(value);
+        }
+        const unsigned exponent = 63u - static_cast<unsigned>(__builtin_clzll(value)); // >= kSubBucketBits
+        const size_t sub_bucket = static_cast<size_t>(value >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+        return kSubBuckets + (exponent - kSubBucketBits) * kSubBuckets + sub_bucket;
+    }
+    // a value inside the bucket (its middle), used for the percentiles
+    static uint64_t bucketValue(size_t index);
+
+    std::array<std::atomic<uint64_t>, kBucketCount> buckets_{};
+    StatCounter count_;
+    StatCounter sum_ns_;
+    StatCounter max_ns_;
+};
+
+// times a stage by batches: start() before the work, stop(items) after it records the time per item
+class BatchTimer {
+public:
+    explicit BatchTimer(LatencyHistogram* histogram) : histogram_(histogram) {}
+
+    void start() {
+        if (histogram_ != nullptr) {
+            start_ns_ = statsNowNs();
+        }
+    }
+    void stop(size_t items) {
+        if (histogram_ != nullptr && items > 0) {
+            histogram_->record((statsNowNs() - start_ns_) / items, items);
+        }
+    }
+
+private:
+    LatencyHistogram* histogram_;
+    uint64_t start_ns_ = 0;
+};
+
+// writes of the output file (output_file.hpp). bytes, writes and write_ns are recorded by the thread that
+// sees the writes complete (the background thread of --output-io pwrite), the stalls by the formatting thread
+struct OutputIoStats {
+    StatCounter bytes;     // bytes written to the file
+    StatCounter writes;    // buffers written
+    StatCounter write_ns;  // time of the writes, from their start to their completion
+    StatCounter stall_ns;  // time the formatting thread waited for a buffer to be written
+    StatCounter stalls;
+};
+
+// histograms of the stages that run on one thread each (the workers keep theirs, see WorkerStats)
+struct PipelineStats {
+    LatencyHistogram parse;      // reader: parsing (or converting) one order, ns per order
+    LatencyHistogram dispatch;   // dispatcher: routing one order to its worker, waits for room included
+    LatencyHistogram formatting; // writer: formatting one execution report
+    LatencyHistogram journal_commit; // journal (--journal): one group commit (write + fdatasync), ns per commit
+    StatCounter reports_written;
+    OutputIoStats output;        // writer: the writes of the output file
+};
+
+// histograms and counters of one matching worker (written by its thread only)
+struct WorkerStats {
+    LatencyHistogram queueing; // sampled: from the dispatcher staging the order to the worker taking it
+    LatencyHistogram matching; // sampled: processOrder of the book (the matching and its reports)
+    StatCounter orders;
+    StatCounter batches;
+};
+
+// "count=.. mean=.. p50=.. p99=.. p99.9=.. max=.." of a histogram
+std::string formatLatency(const LatencySummary& summary);
+
+// "12.5 MiB in 13 writes, 850.0 MiB/s while writing, formatting waited 2 ms (1 times)" of the output file
+std::string formatOutputIo(const OutputIoStats& stats);
+
+// "depth/capacity (high-water hw, full waits n)" of a ring
+template <typename Queue>
+std::string formatQueue(const Queue& queue) {
+    std::ostringstream oss;
+    oss << queue.size() << "/" << queue.capacity() << " (high-water " << queue.high_water()
+        << ", full waits " << queue.full_waits() << ")";
+    return oss.str();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Big blocks of memory for the pools of the books (the slabs of an OrderPool, the chunks of a NodePool).
+// By default a block is a plain heap allocation. In the huge page mode ("--book-memory huge-pages", set
+// before the first book is created) the blocks are cut out of 8 MiB regions (four 2 MiB huge pages, so the
+// tail too small for the next block is a small part of a region) mapped with mmap: explicit huge
+// pages (MAP_HUGETLB) when the system has some reserved, otherwise normal pages marked with
+// madvise(MADV_HUGEPAGE) so the kernel backs them with transparent huge pages. A book with millions of
+// resting orders then needs one TLB entry per 2 MiB of orders instead of one per 4 KiB.
+// The books only give their blocks back when they are destroyed: a released block is kept for the next
+// block of the same size, the regions are never unmapped.
+// Blocks are taken and released rarely (every few thousand orders of a growing book), so a mutex is enough.
+namespace pool_memory {
+
+constexpr size_t kHugePageBytes = 2 << 20;
+constexpr size_t kRegionBytes = 4 * kHugePageBytes;
+constexpr size_t kBlockAlignment = 64; // blocks start on a cache line
+
+// before the first block (the blocks already given out stay where they are)
+void setHugePages(bool enabled);
+bool hugePagesEnabled();
+
+// a block of at least bytes bytes, aligned on kBlockAlignment (throws std::bad_alloc)
+void* allocateBlock(size_t bytes);
+// give back a block of allocateBlock, with the same size
+void releaseBlock(void* block, size_t bytes);
+
+// what the process took for the pools of its books
+struct Stats {
+    size_t block_bytes = 0;    // blocks given out and not released
+    size_t mapped_bytes = 0;   // huge page mode: bytes of the mapped regions
+    size_t hugetlb_bytes = 0;  // of them, explicit huge pages (the rest was madvised)
+};
+Stats stats();
+
+} // namespace pool_memory
+
+// Memory of one book (OrderBookBase::getMemoryStats), added up over the books for the summary
+struct BookMemoryStats {
+    size_t resting_orders = 0;
+    size_t levels = 0;           // non-empty price levels
+    size_t pool_bytes = 0;       // blocks held by the pools of the book (order records, nodes)
+    size_t pool_used_bytes = 0;  // the part of them holding live records (the rest is on free lists)
+    size_t other_bytes = 0;      // the rest: the price level array of a ladder, the order index
+
+    size_t totalBytes() const { return pool_bytes + other_bytes; }
+
+    BookMemoryStats& operator+=(const BookMemoryStats& other) {
+        resting_orders += other.resting_orders;
+        levels += other.levels;
+        pool_bytes += other.pool_bytes;
+        pool_used_bytes += other.pool_used_bytes;
+        other_bytes += other.other_bytes;
+        return *this;
+    }
+};
+
+// "12.5 MiB, 96 bytes per resting order (1000 orders), 40 levels, pools 8.0 MiB 75% used, other 4.5 MiB"
+std::string formatBookMemory(const BookMemoryStats& memory);
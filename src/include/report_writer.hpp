@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "market_data.hpp"
+#include "orderbook.hpp"     // For ExecutionReport
+#include "output_file.hpp"
+#include "symbol_table.hpp"
+
+// Writes the execution reports to the output CSV file.
+// This is the only place where the reports become text: numbers are formatted with std::to_chars
+// into one big reusable buffer, and the buffer is handed to the kernel once it is full: with write() from
+// this thread by default, or asynchronously while the next buffer is filled (--output-io, see output_file.hpp).
+// No iostream, no std::string per line: formatting a report does not allocate.
+class ReportWriter {
+public:
+    // size of the text buffers, each one written at once when it is full
+    static constexpr size_t kBufferBytes = 1 << 20;
+
+    explicit ReportWriter(const SymbolTable& symbols);
+    ~ReportWriter(); // flushes and closes the file if close() was not called
+
+    ReportWriter(const ReportWriter&) = delete;
+    ReportWriter& operator=(const ReportWriter&) = delete;
+
+    // create (or truncate) the output file, returns false (and the reason in error) on failure
+    bool open(const std::string& path, std::string& error, const OutputFileOptions& options = OutputFileOptions());
+
+    // the CSV header line
+    void writeHeader();
+    // format one report as a CSV line
+    void append(const ExecutionReport& report);
+
+    // write everything that is buffered. Returns false (and the reason in error) if a write failed
+    bool flush(std::string& error);
+    // flush and close the file
+    bool close(std::string& error);
+
+    unsigned long long getBytesWritten() const { return file_.bytesWritten(); }
+    const OutputFile& getFile() const { return file_; } // the I/O mode really used
+
+private:
+    // name of an instrument, looked up in the symbol table only the first time the id is seen
+    std::string_view instrumentName(uint32_t symbol_id);
+    // hand the buffer over to the file, keeps the first error
+    void writeBuffer();
+
+    const SymbolTable& symbols_;
+    std::vector<const std::string*> instrument_names_; // by symbol id, nullptr = not looked up yet
+    OutputFile file_;
+    size_t used_ = 0; // bytes at the start of file_.data()
+    unsigned appended_ = 0; // reports since the last OutputFile::poll()
+};
+
+// Writes the market data updates of the books (market_data.hpp) to a CSV file, the same way:
+//   sequence,timestamp,instrument,update,kind,side,price,quantity,orders,ask_price,ask_quantity
+// A BBO line has the best bid in price/quantity and the best ask in ask_price/ask_quantity
+// (0 for an empty side); the cells that do not apply to a kind are left empty.
+class MarketDataWriter {
+public:
+    static constexpr size_t kBufferBytes = 1 << 20;
+
+    explicit MarketDataWriter(const SymbolTable& symbols);
+    ~MarketDataWriter(); // flushes and closes the file if close() was not called
+
+    MarketDataWriter(const MarketDataWriter&) = delete;
+    MarketDataWriter& operator=(const MarketDataWriter&) = delete;
+
+    // create (or truncate) the file and write the header line. Returns false (and the reason in error) on failure
+    bool open(const std::string& path, std::string& error, const OutputFileOptions& options = OutputFileOptions());
+    void append(const MarketDataUpdate& update);
+    // flush and close the file
+    bool close(std::string& error);
+
+    unsigned long long getUpdateCount() const { return update_count_; }
+
+private:
+    void writeBuffer();
+
+    const SymbolTable& symbols_;
+    OutputFile file_;
+    size_t used_ = 0;
+    unsigned long long update_count_ = 0;
+};
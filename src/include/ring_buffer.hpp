@@ -0,0 +1,433 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+
+#include "wait_strategy.hpp"
+
+// Bounded lock-free ring buffers used between the stages of the pipeline.
+// They have the same interface as ThreadSafeQueue (push, pop, try_pop, empty, size),
+// plus batch versions, so a stage can switch from one to the other by changing a type.
+// The capacity is rounded up to a power of two, a full ring makes push() wait for the consumer.
+// The blocking calls (push, pop, push_batch, pop_batch) wait with the WaitStrategy of the ring.
+// When the producer is done it calls close(): pop_batch() then returns 0 once the ring is drained,
+// so the consumer loop is simply "while (pop_batch(...) > 0)".
+// Every ring also keeps two statistics for the pipeline dumps (pipeline_stats.hpp): the highest depth
+// seen by its consumer (high_water()) and the number of times a producer had to wait because it was full
+// (full_waits()). They cost nothing on the fast path: the depth is taken when the consumer reloads the
+// index of the producer anyway, and the waits are only counted on the slow path.
+
+// size of a cache line: the indexes written by the producer and by the consumer live on
+// different lines, so the two threads don't keep stealing each other's cache line
+constexpr size_t kCacheLineSize = 64;
+
+// smallest power of two >= value (and at least 2)
+inline size_t roundUpToPowerOfTwo(size_t value) {
+    size_t result = 2;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+// Single producer / single consumer ring.
+// Exactly one thread pushes and exactly one thread pops (reader -> dispatcher, dispatcher -> book).
+// Each side keeps a cached copy of the other side's index and only reloads it when the ring
+// looks full (or empty), so most operations touch no shared cache line at all.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity = 1024, WaitStrategyType wait_strategy = WaitStrategyType::SPIN_YIELD)
+        : mask_(roundUpToPowerOfTwo(capacity) - 1), buffer_(new T[mask_ + 1]),
+          not_empty_(wait_strategy), not_full_(wait_strategy) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer side -------------------------------------------------------
+
+    // add one item, returns false (and leaves item untouched) if the ring is full
+    bool try_push(T&& item) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - producer_cached_head_ > mask_) {
+            producer_cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - producer_cached_head_ > mask_) {
+                return false;
+            }
+        }
+        buffer_[tail & mask_] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        not_empty_.notify();
+        return true;
+    }
+    bool try_push(const T& item) {
+        T copy = item;
+        return try_push(std::move(copy));
+    }
+
+    // add one item, waits while the ring is full
+    void push(T item) {
+        while (!try_push(std::move(item))) {
+            countFullWait();
+            not_full_.wait([this]() { return size() <= mask_; });
+        }
+    }
+
+    // add up to count items (moved from items[0..count)), returns how many were added.
+    // the whole batch is published with a single store
+    size_t try_push_batch(T* items, size_t count) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t free_slots = mask_ + 1 - (tail - producer_cached_head_);
+        if (free_slots < count) {
+            producer_cached_head_ = head_.load(std::memory_order_acquire);
+            free_slots = mask_ + 1 - (tail - producer_cached_head_);
+        }
+        const size_t pushed = (count < free_slots) ? count : free_slots;
+        for (size_t i = 0; i < pushed; ++i) {
+            buffer_[(tail + i) & mask_] = std::move(items[i]);
+        }
+        if (pushed > 0) {
+            tail_.store(tail + pushed, std::memory_order_release);
+            not_empty_.notify();
+        }
+        return pushed;
+    }
+
+    // add all the items, waits while the ring is full
+    void push_batch(T* items, size_t count) {
+        size_t done = 0;
+        while (done < count) {
+            size_t pushed = try_push_batch(items + done, count - done);
+            if (pushed == 0) {
+                countFullWait();
+                not_full_.wait([this]() { return size() <= mask_; });
+            }
+            done += pushed;
+        }
+    }
+
+    // Consumer side -------------------------------------------------------
+
+    bool try_pop(T& item) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == consumer_cached_tail_) {
+            consumer_cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == consumer_cached_tail_) {
+                return false;
+            }
+            noteDepth(consumer_cached_tail_ - head);
+        }
+        item = std::move(buffer_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        not_full_.notify();
+        return true;
+    }
+
+    std::optional<T> try_pop() {
+        T item;
+        if (!try_pop(item)) {
+            return std::nullopt;
+        }
+        return item;
+    }
+
+    // waits until an item is available
+    T pop() {
+        T item;
+        while (!try_pop(item)) {
+            not_empty_.wait([this]() { return !empty(); });
+        }
+        return item;
+    }
+
+    // take up to max_count items into out[0..max_count), returns how many were taken.
+    // the whole batch is released to the producer with a single store
+    size_t try_pop_batch(T* out, size_t max_count) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        size_t available = consumer_cached_tail_ - head;
+        if (available < max_count) {
+            consumer_cached_tail_ = tail_.load(std::memory_order_acquire);
+            available = consumer_cached_tail_ - head;
+            noteDepth(available);
+        }
+        const size_t popped = (max_count < available) ? max_count : available;
+        for (size_t i = 0; i < popped; ++i) {
+            out[i] = std::move(buffer_[(head + i) & mask_]);
+        }
+        if (popped > 0) {
+            head_.store(head + popped, std::memory_order_release);
+            not_full_.notify();
+        }
+        return popped;
+    }
+
+    // waits for at least one item and takes up to max_count of them.
+    // returns 0 only when the ring is closed and everything has been popped
+    size_t pop_batch(T* out, size_t max_count) {
+        while (true) {
+            size_t popped = try_pop_batch(out, max_count);
+            if (popped > 0) {
+                return popped;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                // the items pushed before close() are visible now
+                return try_pop_batch(out, max_count);
+            }
+            not_empty_.wait([this]() { return !empty() || closed_.load(std::memory_order_acquire); });
+        }
+    }
+
+    // Producer: no more items will be pushed (wakes the consumer up)
+    void close() {
+        closed_.store(true, std::memory_order_release);
+        not_empty_.notify();
+    }
+    bool is_closed() const { return closed_.load(std::memory_order_acquire); }
+
+    // only call it before the producer and the consumer are started
+    void set_wait_strategy(WaitStrategyType wait_strategy) {
+        not_empty_.set_type(wait_strategy);
+        not_full_.set_type(wait_strategy);
+    }
+
+    // Both sides (approximate while the other thread is running) -----------
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+    size_t size() const {
+        const size_t head = head_.load(std::memory_order_acquire);
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        return tail - head;
+    }
+    size_t capacity() const { return mask_ + 1; }
+    // highest depth seen by the consumer, and number of waits of the producer on a full ring
+    size_t high_water() const { return high_water_.load(std::memory_order_relaxed); }
+    size_t full_waits() const { return full_waits_.load(std::memory_order_relaxed); }
+
+private:
+    // consumer only (single writer: a relaxed load and store, readable by the stats dumps)
+    void noteDepth(size_t depth) {
+        if (depth > high_water_.load(std::memory_order_relaxed)) {
+            high_water_.store(depth, std::memory_order_relaxed);
+        }
+    }
+    // producer only
+    void countFullWait() {
+        full_waits_.store(full_waits_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // written by the consumer
+    alignas(kCacheLineSize) std::atomic<size_t> head_{0};
+    size_t consumer_cached_tail_ = 0;
+    std::atomic<size_t> high_water_{0};
+    // written by the producer
+    alignas(kCacheLineSize) std::atomic<size_t> tail_{0};
+    size_t producer_cached_head_ = 0;
+    std::atomic<size_t> full_waits_{0};
+    // read only after construction
+    alignas(kCacheLineSize) const size_t mask_;
+    std::unique_ptr<T[]> buffer_;
+    WaitStrategy not_empty_; // the consumer waits here
+    WaitStrategy not_full_;  // the producer waits here
+    std::atomic<bool> closed_{false};
+};
+
+// Multiple producers / single consumer ring (every book -> the writer).
+// Bounded queue in the style of Dmitry Vyukov: each cell has a sequence number telling
+// whether it is free for the producer of that lap or ready for the consumer,
+// producers claim a position with one compare-and-swap and never wait for each other
+// while they copy their item.
+template <typename T>
+class MpscRing {
+public:
+    explicit MpscRing(size_t capacity = 1024, WaitStrategyType wait_strategy = WaitStrategyType::SPIN_YIELD)
+        : mask_(roundUpToPowerOfTwo(capacity) - 1), cells_(new Cell[mask_ + 1]),
+          not_empty_(wait_strategy), not_full_(wait_strategy) {
+        for (size_t i = 0; i <= mask_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    // Producer side (any thread) ------------------------------------------
+
+    // add one item, returns false (and leaves item untouched) if the ring is full
+    bool try_push(T&& item) {
+        size_t position = tail_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[position & mask_];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const std::intptr_t difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+            if (difference == 0) {
+                // the cell is free for this lap: try to claim the position
+                if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false; // the consumer has not freed this cell yet: full
+            } else {
+                position = tail_.load(std::memory_order_relaxed); // another producer took it
+            }
+        }
+        cell->value = std::move(item);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        not_empty_.notify();
+        return true;
+    }
+    bool try_push(const T& item) {
+        T copy = item;
+        return try_push(std::move(copy));
+    }
+
+    // add one item, waits while the ring is full
+    void push(T item) {
+        while (!try_push(std::move(item))) {
+            countFullWait();
+            not_full_.wait([this]() { return size() <= mask_; });
+        }
+    }
+
+    // add up to count items, returns how many were added
+    size_t try_push_batch(T* items, size_t count) {
+        size_t pushed = 0;
+        while (pushed < count && try_push(std::move(items[pushed]))) {
+            pushed++;
+        }
+        return pushed;
+    }
+
+    // add all the items, waits while the ring is full
+    void push_batch(T* items, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            push(std::move(items[i]));
+        }
+    }
+
+    // Consumer side (one thread) ------------------------------------------
+
+    bool try_pop(T& item) {
+        const size_t position = head_.load(std::memory_order_relaxed);
+        Cell& cell = cells_[position & mask_];
+        if (cell.sequence.load(std::memory_order_acquire) != position + 1) {
+            return false; // empty, or the producer of this cell has not finished its copy
+        }
+        item = std::move(cell.value);
+        // free the cell for the producers of the next lap
+        cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+        head_.store(position + 1, std::memory_order_release);
+        not_full_.notify();
+        return true;
+    }
+
+    std::optional<T> try_pop() {
+        T item;
+        if (!try_pop(item)) {
+            return std::nullopt;
+        }
+        return item;
+    }
+
+    // waits until an item is available
+    T pop() {
+        T item;
+        while (!try_pop(item)) {
+            not_empty_.wait([this]() { return headReady(); });
+        }
+        return item;
+    }
+
+    // take up to max_count items, stops at the first cell that is not ready
+    size_t try_pop_batch(T* out, size_t max_count) {
+        size_t popped = 0;
+        while (popped < max_count && try_pop(out[popped])) {
+            popped++;
+        }
+        return popped;
+    }
+
+    // waits for at least one item and takes up to max_count of them.
+    // returns 0 only when the ring is closed and everything has been popped
+    size_t pop_batch(T* out, size_t max_count) {
+        noteDepth(size());
+        while (true) {
+            size_t popped = try_pop_batch(out, max_count);
+            if (popped > 0) {
+                return popped;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                return try_pop_batch(out, max_count);
+            }
+            not_empty_.wait([this]() { return headReady() || closed_.load(std::memory_order_acquire); });
+        }
+    }
+
+    // no more items will be pushed: every producer must be done before calling it
+    void close() {
+        closed_.store(true, std::memory_order_release);
+        not_empty_.notify();
+    }
+    bool is_closed() const { return closed_.load(std::memory_order_acquire); }
+
+    // only call it before the producers and the consumer are started
+    void set_wait_strategy(WaitStrategyType wait_strategy) {
+        not_empty_.set_type(wait_strategy);
+        not_full_.set_type(wait_strategy);
+    }
+
+    // Both sides (approximate while the producers are running) -------------
+
+    // counts the claimed positions, an item being copied by its producer is already counted
+    bool empty() const { return size() == 0; }
+    size_t size() const {
+        const size_t head = head_.load(std::memory_order_acquire);
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        return (tail > head) ? tail - head : 0;
+    }
+    size_t capacity() const { return mask_ + 1; }
+    // highest depth seen by the consumer (at each pop_batch), and number of waits of the producers on a full ring
+    size_t high_water() const { return high_water_.load(std::memory_order_relaxed); }
+    size_t full_waits() const { return full_waits_.load(std::memory_order_relaxed); }
+
+private:
+    // consumer only
+    void noteDepth(size_t depth) {
+        if (depth > high_water_.load(std::memory_order_relaxed)) {
+            high_water_.store(depth, std::memory_order_relaxed);
+        }
+    }
+    // any producer, so this one is a real atomic increment (slow path only)
+    void countFullWait() { full_waits_.fetch_add(1, std::memory_order_relaxed); }
+
+    // true if the next cell of the consumer has been published
+    bool headReady() const {
+        const size_t position = head_.load(std::memory_order_relaxed);
+        return cells_[position & mask_].sequence.load(std::memory_order_acquire) == position + 1;
+    }
+
+    struct Cell {
+        std::atomic<size_t> sequence{0};
+        T value{};
+    };
+
+    // claimed by the producers
+    alignas(kCacheLineSize) std::atomic<size_t> tail_{0};
+    // advanced by the consumer
+    alignas(kCacheLineSize) std::atomic<size_t> head_{0};
+    std::atomic<size_t> high_water_{0};
+    // read only after construction
+    alignas(kCacheLineSize) const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    WaitStrategy not_empty_; // the consumer waits here
+    WaitStrategy not_full_;  // the producers wait here
+    std::atomic<bool> closed_{false};
+    std::atomic<size_t> full_waits_{0};
+};
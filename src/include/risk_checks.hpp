@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "logger.hpp"
+#include "order.hpp"
+
+// Pre-trade risk checks and self-trade prevention, inside the matching engine
+// ("--risk-limits", "--risk-account-limits", "--self-trade-prevention").
+// Every book runs the checks on a NEW or MODIFY order just before it matches it (OrderBookBase::runOrder):
+// an order that breaks a limit is reported REJECTED and never reaches the matching. A CANCEL is never checked.
+// The limits of an account are read from a flat table indexed by the account id (Order::account_id),
+// so a check is a few loads and compares, without any lookup or allocation.
+// Accounts are ids from 0 to max accounts - 1; account 0 means "no account": its orders get the default
+// limits but no open-order limit and no self-trade prevention.
+//
+// Every book keeps the state of the checks for its own instrument (open orders of each account, last trade):
+// a book is only touched by its worker, so the checks need no lock, and the result does not depend on how the
+// instruments are spread over the workers.
+
+// limits of one account (0 = no limit)
+struct AccountLimits {
+    unsigned long long max_order_quantity = 0; // quantity of one order
+    double max_order_notional = 0.0;           // quantity * price of one order (MARKET: * reference price)
+    uint32_t max_open_orders = 0;              // resting orders of the account in one book
+};
+
+// what the sweep does when an incoming order would trade with a resting order of the same account
+enum class SelfTradePrevention : uint8_t {
+    NONE,            // they trade
+    CANCEL_RESTING,  // the resting order is canceled, the sweep goes on (cancel oldest)
+    CANCEL_INCOMING, // the rest of the incoming order is canceled, the sweep stops (cancel newest)
+    CANCEL_BOTH      // both
+};
+
+// why an order was rejected by the checks (PASSED: it was not)
+enum class RiskCheck : uint8_t {
+    PASSED,
+    ACCOUNT,      // account id outside of the tables
+    QUANTITY,     // above max_order_quantity
+    NOTIONAL,     // above max_order_notional
+    PRICE_BAND,   // LIMIT price too far from the reference price of the book
+    OPEN_ORDERS,  // the account already has max_open_orders resting orders in the book
+    COUNT
+};
+std::string_view riskCheckToString(RiskCheck check);
+
+// Configuration of the checks, shared (read only) by every book
+struct RiskConfig {
+    static constexpr uint32_t kDefaultMaxAccounts = 4096;
+
+    bool checks_enabled = false; // the stage runs at all (set by parseLimits / loadAccountLimits)
+    // a LIMIT order is rejected if its price is more than this fraction away from the reference price
+    // of the book: the last trade, or the middle of the best bid and ask before the first trade (0 = no band)
+    double price_band = 0.0;
+    SelfTradePrevention self_trade_prevention = SelfTradePrevention::NONE;
+    // account id -> limits, every account has an entry
+    std::vector<AccountLimits> account_limits = std::vector<AccountLimits>(kDefaultMaxAccounts);
+
+    uint32_t maxAccounts() const { return static_cast<uint32_t>(account_limits.size()); }
+    // resize the tables (before parseLimits: every account gets the default limits)
+    void setMaxAccounts(uint32_t max_accounts) { account_limits.assign(max_accounts, AccountLimits{}); }
+
+    // default limits of every account and the price band, as a list like
+    // "max_quantity=1000,max_notional=250000,max_open_orders=50,price_band=0.05".
+    // Returns false (and logs the reason) if the list is malformed
+    bool parseLimits(const std::string& limits, Logger& logger);
+    // limits of some accounts, from a CSV file "account,max_quantity,max_notional,max_open_orders"
+    // (with that header, 0 or an empty field = no limit). Call it after parseLimits: a line replaces the default
+    // limits of its account. Returns false (and logs the reason) if the file cannot be used
+    bool loadAccountLimits(const std::string& path, Logger& logger);
+    // "none", "cancel-resting", "cancel-incoming" or "cancel-both". Returns false for another name
+    bool parseSelfTradePrevention(const std::string& mode);
+};
+std::string_view selfTradePreventionToString(SelfTradePrevention mode);
+
+// The checks of one order against the limits of its account (NEW and MODIFY orders only).
+// reference_price: last trade or middle of the book (0 if the book has neither, the band is then not checked),
+// open_orders: resting orders of the account in the book
+RiskCheck checkOrderRisk(const RiskConfig& config, const Order& order, double reference_price, uint32_t open_orders);
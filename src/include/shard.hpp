@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "logger.hpp"
+#include "order.hpp"
+#include "orderbook.hpp"      // For OutputQueue
+#include "pipeline_stats.hpp"
+#include "risk_checks.hpp"
+#include "ring_buffer.hpp"
+#include "shard_protocol.hpp"
+#include "shard_transport.hpp"
+#include "symbol_table.hpp"
+#include "wait_strategy.hpp"
+
+// Instruments partitioned over several engine processes ("--shards" / "--shard-listen").
+// The books of an instrument only depend on the orders of that instrument (that is why a WorkerPool can
+// spread them over its threads), so they can as well live in other processes, or on other hosts:
+//   - the front-end process reads (or takes from the gateway), journals, numbers and routes the orders, and
+//     writes the output. The ShardRouter replaces its WorkerPool: the same hash of the instrument picks the
+//     shard, and the orders go out through the channel of that shard (shard_transport.hpp)
+//   - every matching process ("--shard-listen ENDPOINT") owns the books of its instruments: one matching thread
+//     (a BookWorker), fed by the orders of its channel. The records of its output ring go back as they are,
+//     watermarks included
+//   - the front-end puts the reports of all the shards back into the order of the input with the OutputMerger,
+//     each shard being one lane: the output is the output of a single process, byte for byte
+// The book type and the risk checks are options of the matching processes (give all of them the same ones),
+// the market data is asked by the front-end, which writes the file.
+class ShardRouter {
+public:
+    // capacity of the route log (shard index of every order, read by the writer)
+    static constexpr size_t kRouteLogCapacity = 1 << 16;
+    // reports of a shard received but not merged yet
+    static constexpr size_t kOutputQueueCapacity = 1 << 14;
+    // orders of a shard buffered before they are written to its channel
+    static constexpr size_t kRoutingBatchSize = 128;
+    // how long the front-end waits for a shard that is not started yet
+    static constexpr int kConnectTimeoutMs = 10000;
+
+    // endpoints: "shm:NAME" or "tcp:HOST:PORT" of every shard (the index in this list is the shard index)
+    ShardRouter(const std::vector<std::string>& endpoints, const SymbolTable& symbols, WaitStrategyType wait_strategy,
+                Logger& logger);
+    ~ShardRouter();
+
+    ShardRouter(const ShardRouter&) = delete;
+    ShardRouter& operator=(const ShardRouter&) = delete;
+
+    // connect to every shard and check it runs the same protocol. Returns false (and the reason in error)
+    bool connect(bool market_data, unsigned long long market_data_snapshot_interval, std::string& error);
+    // start receiving the reports of the shards (one thread per shard)
+    void start();
+
+    // same contract as WorkerPool::dispatch (dispatcher thread only)
+    void dispatch(const Order& order) {
+        size_t shard_index = routeFor(order.symbol_id);
+        Shard& shard = *shards_[shard_index];
+        ShardOrderMessage& message = shard.order_message;
+        message.order = order;
+        message.order.sequence = next_sequence_++;
+        message.order.dispatch_ns = 0; // the clocks of two processes cannot be compared
+        if (!shard.writer->append(message, static_cast<uint8_t>(ShardMessageType::ORDER))) {
+            fail(shard, "cannot send the orders");
+        }
+        shard.sent_orders++;
+        pending_routes_.push_back(static_cast<uint32_t>(shard_index));
+        if (++shard.staged == kRoutingBatchSize) {
+            flushShard(shard);
+        }
+    }
+    // write the orders of every shard to its channel, then publish their routes
+    void flush();
+    // no more orders: every shard gets an END, the route log is closed. The reports keep coming until
+    // every shard has processed its orders
+    void stop();
+    // wait for the receiving threads (after stop(), once the writer merged everything)
+    void join();
+
+    // for the writer (OutputMerger)
+    SpscRing<uint32_t>& getRouteLog() { return route_log_; }
+    std::vector<OutputQueue*> getOutputQueues();
+
+    size_t size() const { return shards_.size(); }
+    // false if the channel of a shard broke: its reports are missing from the output
+    bool isHealthy() const { return !failed_.load(std::memory_order_acquire); }
+    unsigned long long getSentOrders() const;
+
+    // a few lines at info level, like logPipelineSnapshot (safe while the threads run)
+    void logSnapshot(Logger& logger, const PipelineStats& stats, const OrderQueue& reader_queue) const;
+    // the final summary, like logPipelineSummary (after join())
+    void logSummary(Logger& logger, const PipelineStats& stats, const OrderQueue& reader_queue) const;
+
+private:
+    struct Shard {
+        std::string endpoint;
+        std::unique_ptr<ShardChannel> channel;
+        std::unique_ptr<ShardMessageWriter> writer;   // dispatcher thread
+        std::unique_ptr<ShardMessageReader> reader;   // receiving thread
+        ShardOrderMessage order_message{};
+        size_t staged = 0;                            // orders appended since the last write
+        unsigned long long sent_orders = 0;           // dispatcher thread
+        std::atomic<unsigned long long> received_reports{0};
+        OutputQueue reports;
+        std::thread receiver;
+
+        Shard(std::string shard_endpoint, WaitStrategyType wait_strategy)
+            : endpoint(std::move(shard_endpoint)), reports(kOutputQueueCapacity, wait_strategy) {}
+    };
+
+    size_t routeFor(uint32_t symbol_id) {
+        if (symbol_id >= routes_.size()) {
+            growRoutes(symbol_id);
+        }
+        return routes_[symbol_id];
+    }
+    // routes of the new instruments, and their names to every shard
+    void growRoutes(uint32_t symbol_id);
+    void flushShard(Shard& shard);
+    // receiving thread of a shard: its REPORT messages into its output queue, until its END
+    void receive(Shard& shard);
+    void fail(const Shard& shard, const std::string& reason);
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    const SymbolTable& symbols_;
+    std::vector<uint32_t> routes_;  // symbol id -> shard index (dispatcher thread only)
+    unsigned long long next_sequence_ = 0;
+    std::vector<uint32_t> pending_routes_;
+    SpscRing<uint32_t> route_log_;
+    std::atomic<bool> failed_{false};
+    Logger& logger_;
+};
+
+// What a matching process needs besides its channel
+struct ShardServerConfig {
+    std::string endpoint;                         // "shm:NAME" or "tcp:[ADDRESS:]PORT"
+    std::string book_type = "map";
+    WaitStrategyType wait_strategy = WaitStrategyType::SPIN_YIELD;
+    int cpu = -1;                                 // cpu of the matching thread (-1: not pinned)
+    std::shared_ptr<const RiskConfig> risk_config; // nullptr: no risk checks
+};
+
+// The matching process: waits for its front-end, processes the orders it gets, sends the reports back.
+// Returns once the front-end sent END and every report went back (true), or if the channel broke (false)
+bool runShardServer(const ShardServerConfig& config, Logger& logger);
+
+// "shm:a,shm:b,tcp:host:7001" -> one endpoint per shard. Returns false if the list is empty or malformed
+bool parseShardList(const std::string& shard_list, std::vector<std::string>& endpoints);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "gateway_protocol.hpp" // For GatewayMessageHeader, kGatewayMaxMessageBytes
+#include "order.hpp"
+#include "orderbook.hpp"        // For ExecutionReport
+
+// Messages between a front-end engine and its matching shards (shard.hpp), over shared memory or TCP.
+// They have the header of the gateway messages (length, type, sequence of the message in its direction
+// from 1), but they carry the Order and ExecutionReport structs as they are: the front-end already parsed
+// the orders, converted their prices into ticks and numbered them, and a shard sends back the records of
+// its output ring the way its books pushed them (watermarks and market data included).
+// So both ends must be the same build, on machines of the same byte order: the HELLO messages check the
+// version of the protocol and the sizes of the two structs.
+//
+//   front-end -> shard: HELLO, then SYMBOL and ORDER messages, then END (no more orders)
+//   shard -> front-end: HELLO (the answer), then REPORT messages, then END (every order is processed)
+// The front-end declares every instrument to every shard, in symbol id order, before the first order that
+// uses it: the shard interns the names in the same order, so both sides use the same symbol ids.
+
+enum class ShardMessageType : uint8_t {
+    HELLO = 16,
+    SYMBOL = 17,
+    ORDER = 18,
+    REPORT = 19,
+    END = 20
+};
+
+constexpr uint32_t kShardProtocolVersion = 1;
+
+struct ShardHelloMessage {
+    GatewayMessageHeader header;
+    uint32_t protocol_version; // kShardProtocolVersion
+    uint32_t order_bytes;      // sizeof(Order)
+    uint32_t report_bytes;     // sizeof(ExecutionReport)
+    uint32_t shard_index;      // position of the shard in --shards
+    uint32_t shard_count;
+    uint32_t market_data;      // 1: the books publish their market data (front-end -> shard)
+    uint64_t market_data_snapshot_interval;
+};
+static_assert(sizeof(ShardHelloMessage) == 40, "the shard hello layout is part of the protocol");
+
+struct ShardSymbolMessage {
+    static constexpr size_t kMaxNameBytes = kGatewayMaxMessageBytes - sizeof(GatewayMessageHeader) - 8;
+    GatewayMessageHeader header;
+    uint32_t symbol_id;        // id of the instrument in the front-end
+    uint32_t name_length;
+    char name[kMaxNameBytes];  // only the first name_length bytes are sent (header.length says so)
+};
+
+struct ShardOrderMessage {
+    GatewayMessageHeader header;
+    Order order; // numbered by the front-end (Order::sequence), its reports carry that number
+};
+
+struct ShardReportMessage {
+    GatewayMessageHeader header;
+    ExecutionReport report; // a report, a watermark or a market data update
+};
+
+struct ShardEndMessage {
+    GatewayMessageHeader header;
+};
+
+static_assert(std::is_trivially_copyable<Order>::value, "an Order is sent to the shards as it is");
+static_assert(sizeof(ShardOrderMessage) <= kGatewayMaxMessageBytes && sizeof(ShardReportMessage) <= kGatewayMaxMessageBytes,
+              "the shard messages must fit the message buffers");
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gateway_protocol.hpp" // For GatewayMessageHeader, kGatewayMaxMessageBytes
+#include "logger.hpp"
+
+// Byte streams between a front-end engine and one matching shard (shard.hpp):
+//   - "shm:NAME": two rings in a POSIX shared memory segment, for the processes of one host.
+//     The shard creates the segment (/NAME) and waits, the front-end maps it and connects; the name is
+//     removed as soon as both sides have it mapped, so a crash leaves nothing behind in /dev/shm.
+//     Each ring has one writer and one reader process (the same head / tail indexes as SpscRing): a write
+//     or a read is a memcpy and one release store, without any system call. A side that waits spins,
+//     then yields, then sleeps a little, and notices when the other process is gone.
+//   - "tcp:HOST:PORT": one TCP connection, across hosts. The shard listens ("tcp:PORT" or "tcp:ADDR:PORT"),
+//     the front-end connects.
+// One thread writes a channel while another one reads it.
+class ShardChannel {
+public:
+    virtual ~ShardChannel() = default;
+
+    // write every byte, waits while the other side does not read. Returns false if the other side is gone
+    virtual bool write(const void* data, size_t size) = 0;
+    // read at least one byte (waits for it) and at most size. Returns 0 once the other side closed
+    // its direction and everything was read, or if it is gone
+    virtual size_t read(void* data, size_t size) = 0;
+    // no more writes: the reads of the other side return 0 once they got everything
+    virtual void closeWrite() = 0;
+    // "shm:NAME" or "tcp:ADDRESS:PORT" of the other side, for the logs
+    virtual std::string describe() const = 0;
+};
+
+// bytes of each ring of a shared memory channel
+constexpr size_t kShmChannelRingBytes = 4 << 20;
+
+// shard side: create the endpoint and wait for the front-end to connect.
+// Returns nullptr (and the reason in error) if the endpoint is malformed or cannot be opened
+std::unique_ptr<ShardChannel> acceptShardChannel(const std::string& endpoint, Logger& logger, std::string& error);
+
+// front-end side: connect to a shard, retrying for timeout_ms while it is not there yet (it may start later).
+// Returns nullptr (and the reason in error) if it did not work
+std::unique_ptr<ShardChannel> connectShardChannel(const std::string& endpoint, int timeout_ms, std::string& error);
+
+// Reads the messages (shard_protocol.hpp) of a channel: the bytes are read by big chunks, every whole message
+// is handed over in place. It checks the length and the sequence number of every message
+class ShardMessageReader {
+public:
+    static constexpr size_t kBufferBytes = 256 << 10;
+
+    explicit ShardMessageReader(ShardChannel& channel) : channel_(channel), buffer_(kBufferBytes) {}
+
+    // read a chunk of the channel, then call handler(header, message bytes) for every whole message in the buffer.
+    // The handler returns false to stop (e.g. on END): the messages after it stay in the buffer.
+    // Returns false once the channel is closed, the handler stopped, or a message is malformed (error says why)
+    template <typename Handler>
+    bool readMessages(Handler&& handler, std::string& error) {
+        if (!handleBuffered(handler, error)) {
+            return false;
+        }
+        if (begin_ > 0) {
+            // keep the start of the last message at the front of the buffer
+            std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+            end_ -= begin_;
+            begin_ = 0;
+        }
+        const size_t received = channel_.read(buffer_.data() + end_, buffer_.size() - end_);
+        if (received == 0) {
+            if (end_ > begin_) {
+                error = "the connection ended in the middle of a message";
+            }
+            return false;
+        }
+        end_ += received;
+        return handleBuffered(handler, error);
+    }
+
+private:
+    template <typename Handler>
+    bool handleBuffered(Handler& handler, std::string& error) {
+        while (end_ - begin_ >= sizeof(GatewayMessageHeader)) {
+            GatewayMessageHeader header;
+            std::memcpy(&header, buffer_.data() + begin_, sizeof(header));
+            if (header.length < sizeof(header) || header.length > kGatewayMaxMessageBytes) {
+                error = "malformed message of " + std::to_string(header.length) + " bytes";
+                return false;
+            }
+            if (header.sequence != next_sequence_) {
+                error = "message " + std::to_string(header.sequence) + " instead of " + std::to_string(next_sequence_);
+                return false;
+            }
+            if (end_ - begin_ < header.length) {
+                break; // the rest comes with the next read
+            }
+            const char* message = buffer_.data() + begin_;
+            begin_ += header.length;
+            next_sequence_++;
+            if (!handler(header, message)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    ShardChannel& channel_;
+    std::vector<char> buffer_;
+    size_t begin_ = 0; // first byte not handled yet
+    size_t end_ = 0;   // end of the bytes read
+    uint32_t next_sequence_ = 1;
+};
+
+// Builds the messages going out of one side of a channel, numbered from 1, and writes them by big chunks
+class ShardMessageWriter {
+public:
+    // bytes of messages written to the channel at once
+    static constexpr size_t kFlushBytes = 64 << 10;
+
+    explicit ShardMessageWriter(ShardChannel& channel) : channel_(channel) { buffer_.reserve(kFlushBytes + kGatewayMaxMessageBytes); }
+
+    // add a message: its first length bytes (the header is filled in here). Writes the buffer once it is big enough.
+    // Returns false if the other side is gone
+    template <typename Message>
+    bool append(Message& message, uint8_t type, size_t length = sizeof(Message)) {
+        message.header.length = static_cast<uint16_t>(length);
+        message.header.type = type;
+        message.header.reserved = 0;
+        message.header.sequence = next_sequence_++;
+        const char* bytes = reinterpret_cast<const char*>(&message);
+        buffer_.insert(buffer_.end(), bytes, bytes + length);
+        return buffer_.size() < kFlushBytes || flush();
+    }
+
+    // write what is buffered. Once a write failed nothing more is written (the other side is gone)
+    bool flush() {
+        if (!buffer_.empty() && !broken_) {
+            broken_ = !channel_.write(buffer_.data(), buffer_.size());
+        }
+        buffer_.clear();
+        return !broken_;
+    }
+
+private:
+    ShardChannel& channel_;
+    std::vector<char> buffer_;
+    uint32_t next_sequence_ = 1;
+    bool broken_ = false;
+};
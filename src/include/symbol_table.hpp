@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <shared_mutex>
+#include <cstdint>
+#include <limits>
+
+#include "flat_hash_map.hpp"
+
+// Interns instrument names into small dense integer ids (0, 1, 2, ...).
+// Orders carry the id instead of a std::string, so they can be copied without any allocation.
+// The reader thread interns new names while other threads read the names of ids they received:
+// lookups use a shared lock, and names are stored in a deque so references stay valid.
+// The ids are found through a flat hash map keyed by views of those stored names.
+class SymbolTable {
+public:
+    static constexpr uint32_t kInvalidSymbol = std::numeric_limits<uint32_t>::max();
+
+    SymbolTable() = default;
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    // Returns the id of the name, creating it if the name was never seen
+    uint32_t intern(const std::string& name);
+
+    // Returns the id of the name, or kInvalidSymbol if it is unknown
+    uint32_t find(const std::string& name) const;
+
+    // Name of an id returned by intern()
+    const std::string& name(uint32_t symbol_id) const;
+
+    size_t size() const;
+
+private:
+    mutable std::shared_mutex mutex_;
+    FlatHashMap<std::string_view, uint32_t> ids_; // views of the names of names_
+    std::deque<std::string> names_; // names_[id]
+};
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <algorithm> // For std::max
 #include <queue>
 #include <mutex>
 #include <condition_variable>
 #include <optional> // For a non-blocking pop that returns a value
+#include "wait_strategy.hpp"
 
 // A thread-safe queue implementation.
 // Template parameter T is the type of elements stored in the queue.
@@ -12,6 +14,9 @@ class ThreadSafeQueue {
 public:
     // Default constructor.
     ThreadSafeQueue() = default;
+    // Same constructor as the ring buffers (ring_buffer.hpp), so both can be swapped.
+    // This queue is not bounded, the capacity is ignored.
+    explicit ThreadSafeQueue(size_t /*capacity*/) {}
 
     // Deleted copy constructor and copy assignment operator to prevent accidental copying,
     // as copying mutexes and condition variables is problematic.
@@ -35,6 +40,7 @@ public:
         
         // Add the item to the underlying queue.
         data_queue_.push(std::move(item)); // Use std::move for efficiency if T is movable
+        high_water_ = std::max(high_water_, data_queue_.size());
         
         // Notify one waiting thread (if any) that an item is available.
         cond_var_.notify_one();
@@ -87,6 +93,55 @@ public:
     }
 
 
+    // Pushes several items with one lock (same interface as the ring buffers).
+    void push_batch(T* items, size_t count) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (size_t i = 0; i < count; ++i) {
+            data_queue_.push(std::move(items[i]));
+        }
+        high_water_ = std::max(high_water_, data_queue_.size());
+        cond_var_.notify_one();
+    }
+
+    // Pops up to max_count items with one lock, returns how many were popped.
+    size_t try_pop_batch(T* out, size_t max_count) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        size_t popped = 0;
+        while (popped < max_count && !data_queue_.empty()) {
+            out[popped++] = std::move(data_queue_.front());
+            data_queue_.pop();
+        }
+        return popped;
+    }
+
+    // Waits for at least one item (or for close()) and pops up to max_count items.
+    // Returns 0 only when the queue is closed and empty.
+    size_t pop_batch(T* out, size_t max_count) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cond_var_.wait(lock, [this] { return !data_queue_.empty() || closed_; });
+        size_t popped = 0;
+        while (popped < max_count && !data_queue_.empty()) {
+            out[popped++] = std::move(data_queue_.front());
+            data_queue_.pop();
+        }
+        return popped;
+    }
+
+    // No more items will be pushed: wakes up the threads blocked in pop_batch.
+    void close() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        closed_ = true;
+        cond_var_.notify_all();
+    }
+
+    bool is_closed() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return closed_;
+    }
+
+    // Same interface as the ring buffers: this queue always waits on its condition variable.
+    void set_wait_strategy(WaitStrategyType /*wait_strategy*/) {}
+
     // Checks if the queue is empty.
     // Returns true if the queue is empty, false otherwise.
     bool empty() const {
@@ -102,6 +157,14 @@ public:
         return data_queue_.size();
     }
 
+    // Same statistics as the ring buffers: highest number of items seen in the queue.
+    // The queue is never full, so nobody ever waits for room.
+    size_t high_water() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return high_water_;
+    }
+    size_t full_waits() const { return 0; }
+
 private:
     // The underlying std::queue to store elements.
     std::queue<T> data_queue_;
@@ -112,5 +175,11 @@ private:
     
     // Condition variable to wait for items to be added to the queue.
     std::condition_variable cond_var_;
+
+    // Set by close(), protected by mtx_.
+    bool closed_ = false;
+
+    // Largest size of data_queue_ so far, protected by mtx_.
+    size_t high_water_ = 0;
 };
 
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <cmath>
+#include "logger.hpp"
+
+// Per-instrument tick sizes.
+// Prices are converted once, at parse time, into an integer number of ticks
+// (price = ticks * tick_size) so the books can compare and index prices exactly
+// instead of using floating-point keys.
+class TickSizeTable {
+public:
+    explicit TickSizeTable(double default_tick_size = 0.01);
+
+    // Set the tick size of one instrument (overrides the default one)
+    void set_tick_size(const std::string& instrument, double tick_size);
+
+    // Parse a list of overrides like "AAPL=0.01,MSFT=0.05"
+    // Returns false (and logs the reason) if the list is malformed.
+    bool parse_overrides(const std::string& overrides, Logger& logger);
+
+    double get_default_tick_size() const { return default_tick_size_; }
+    double tick_size_for(const std::string& instrument) const;
+
+    // price -> nearest tick, and back
+    long long to_ticks(const std::string& instrument, double price) const {
+        return std::llround(price / tick_size_for(instrument));
+    }
+    double to_price(const std::string& instrument, long long ticks) const {
+        return static_cast<double>(ticks) * tick_size_for(instrument);
+    }
+
+private:
+    double default_tick_size_;
+    std::unordered_map<std::string, double> tick_sizes_; // only the instruments that override the default
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // _mm_pause
+#endif
+
+// How a thread waits for its queue (to get an item, or to get room for one).
+// - BUSY_SPIN:  never gives the core away, lowest latency, burns a core per waiting thread
+// - SPIN_YIELD: spins a little, then yields the core to other threads between checks
+// - PARK:       spins a little, then sleeps on a condition variable until the other side notifies it
+//               (the only one that does not use CPU while the pipeline is idle)
+enum class WaitStrategyType : uint8_t {
+    BUSY_SPIN,
+    SPIN_YIELD,
+    PARK
+};
+
+// "spin", "yield" or "park" (the names used by --wait-strategy)
+inline std::optional<WaitStrategyType> parseWaitStrategyType(const std::string& name) {
+    if (name == "spin") return WaitStrategyType::BUSY_SPIN;
+    if (name == "yield") return WaitStrategyType::SPIN_YIELD;
+    if (name == "park") return WaitStrategyType::PARK;
+    return std::nullopt;
+}
+
+inline const char* waitStrategyTypeToString(WaitStrategyType type) {
+    switch (type) {
+        case WaitStrategyType::BUSY_SPIN: return "spin";
+        case WaitStrategyType::SPIN_YIELD: return "yield";
+        case WaitStrategyType::PARK: return "park";
+    }
+    return "unknown";
+}
+
+// tell the CPU we are in a spin loop (saves power and helps the other hyper-thread)
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// One waiting point of a queue ("not empty" or "not full").
+// The waiting side calls wait(ready), the other side calls notify() after it changed the queue.
+// notify() only costs something with PARK, and only when a thread is really asleep.
+class WaitStrategy {
+public:
+    // number of checks done with pause before yielding / parking
+    static constexpr int kSpinIterations = 256;
+    // number of yields before parking
+    static constexpr int kYieldIterations = 16;
+
+    explicit WaitStrategy(WaitStrategyType type = WaitStrategyType::SPIN_YIELD) : type_(type) {}
+
+    WaitStrategy(const WaitStrategy&) = delete;
+    WaitStrategy& operator=(const WaitStrategy&) = delete;
+
+    // only call it while nobody waits (before the threads are started)
+    void set_type(WaitStrategyType type) { type_ = type; }
+    WaitStrategyType type() const { return type_; }
+
+    // returns once ready() is true
+    template <typename Ready>
+    void wait(Ready ready) {
+        if (type_ == WaitStrategyType::BUSY_SPIN) {
+            while (!ready()) {
+                cpuRelax();
+            }
+            return;
+        }
+
+        for (int i = 0; i < kSpinIterations; ++i) {
+            if (ready()) {
+                return;
+            }
+            cpuRelax();
+        }
+
+        if (type_ == WaitStrategyType::SPIN_YIELD) {
+            while (!ready()) {
+                std::this_thread::yield();
+            }
+            return;
+        }
+
+        // PARK
+        for (int i = 0; i < kYieldIterations; ++i) {
+            if (ready()) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleepers_.fetch_add(1, std::memory_order_relaxed);
+        // pairs with the fence of notify(): either the notifier sees us sleeping,
+        // or we see the change it made before going to sleep
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cond_var_.wait(lock, ready);
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // wake the parked threads, if any
+    void notify() {
+        if (type_ != WaitStrategyType::PARK) {
+            return;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        // taking the mutex makes sure the sleeper is either before its check, or already waiting
+        std::lock_guard<std::mutex> lock(mutex_);
+        cond_var_.notify_all();
+    }
+
+private:
+    WaitStrategyType type_;
+    std::atomic<uint32_t> sleepers_{0};
+    std::mutex mutex_;
+    std::condition_variable cond_var_;
+};
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "logger.hpp"
+#include "order.hpp"
+#include "orderbook.hpp"
+#include "pipeline_stats.hpp"
+#include "symbol_table.hpp"
+#include "wait_strategy.hpp"
+
+// Partition of an instrument among partition_count (the workers of a pool, or the shards of shard.hpp).
+// Symbol ids are dense (0, 1, 2...), the multiplicative hash spreads neighbouring ids while staying cheap
+inline size_t partitionOf(uint32_t symbol_id, size_t partition_count) {
+    return static_cast<size_t>((static_cast<uint64_t>(symbol_id) * 0x9E3779B97F4A7C15ULL) >> 32) % partition_count;
+}
+
+// One matching thread of the pool.
+// It owns the order books of every instrument sharded onto it, and drains its own inbound ring
+// (only the dispatcher pushes into it, so it is an SPSC ring).
+// The books of an instrument are created by the worker itself, the first time one of its orders arrives.
+// Its books push their execution reports into the output ring of the worker (only the writer pops it),
+// followed after every processed batch by a watermark saying up to which input sequence number
+// the output of this worker is complete (see output_merger.hpp).
+class BookWorker {
+public:
+    // capacity of the inbound ring of each worker
+    static constexpr size_t kInboundQueueCapacity = 1 << 14;
+    // number of orders the worker takes from its ring at once
+    static constexpr size_t kProcessingBatchSize = 64;
+    // capacity of the output ring of each worker
+    static constexpr size_t kOutputQueueCapacity = 1 << 14;
+
+    BookWorker(size_t worker_index, const std::string& book_type, const SymbolTable& symbols,
+               WaitStrategyType wait_strategy);
+
+    BookWorker(const BookWorker&) = delete;
+    BookWorker& operator=(const BookWorker&) = delete;
+
+    // start the thread, pinned to this cpu if cpu >= 0. Returns false if the pinning failed
+    // (the thread then runs unpinned)
+    bool start(int cpu);
+
+    // give a batch of orders to this worker with one push (dispatcher thread only, waits if the ring is full)
+    void dispatch(Order* orders, size_t count) {
+        inbound_.push_batch(orders, count);
+    }
+
+    // no more orders: the worker finishes its ring, closes its output ring, then its thread stops
+    void stop();
+
+    // put a resting order of a snapshot into the book of its instrument (before start() only).
+    // With market data, the book publishes its full depth before its next order
+    bool restoreRestingOrder(const Order& order) {
+        OrderBookBase& book = bookFor(order.symbol_id);
+        bool restored = book.restoreRestingOrder(order);
+        book.requestMarketDataSnapshot();
+        return restored;
+    }
+
+    // every book of this worker publishes its market data (market_data.hpp). Before start() and any restore
+    void enableMarketData(unsigned long long snapshot_interval) {
+        market_data_enabled_ = true;
+        market_data_snapshot_interval_ = snapshot_interval;
+    }
+    // every book of this worker runs the pre-trade checks (risk_checks.hpp). Before start() and any restore
+    void enableRiskChecks(const std::shared_ptr<const RiskConfig>& config) { risk_config_ = config; }
+
+    // number of orders processed so far, published after every batch. Once it reaches the number of
+    // orders dispatched to the worker, the worker is idle and its books can be read (acquire load)
+    unsigned long long getCompletedOrders() const { return completed_orders_.load(std::memory_order_acquire); }
+
+    // execution reports of this worker, in the order of the input (writer thread only)
+    OutputQueue& getOutputQueue() { return *output_log_queue_; }
+
+    // read them after stop(). Indexed by symbol id, nullptr for the instruments of the other workers
+    const std::vector<std::unique_ptr<OrderBookBase>>& getBooks() const { return books_; }
+
+    // readable while the worker runs (see pipeline_stats.hpp)
+    const WorkerStats& getStats() const { return stats_; }
+    const OrderQueue& getInboundQueue() const { return inbound_; }
+
+private:
+    void run();
+    // book of this instrument, created on first use
+    OrderBookBase& bookFor(uint32_t symbol_id);
+
+    size_t worker_index_;
+    std::string book_type_;
+    bool market_data_enabled_ = false;
+    unsigned long long market_data_snapshot_interval_ = 0;
+    std::shared_ptr<const RiskConfig> risk_config_; // nullptr: no risk checks
+    const SymbolTable& symbols_;
+    std::shared_ptr<OutputQueue> output_log_queue_;
+
+    OrderQueue inbound_;
+    // symbol id -> book. Symbol ids are dense, so a flat array replaces the hash lookup
+    std::vector<std::unique_ptr<OrderBookBase>> books_;
+    WorkerStats stats_;
+    std::atomic<unsigned long long> completed_orders_{0};
+    std::thread thread_;
+};
+
+// Fixed-size pool of matching threads.
+// Instruments are hash-sharded onto the workers: all the orders of an instrument go to the same worker,
+// so each book is only touched by one thread and keeps the order of its input.
+class WorkerPool {
+public:
+    // capacity of the route log (worker index of every dispatched order, read by the writer)
+    static constexpr size_t kRouteLogCapacity = 1 << 16;
+
+    // worker_count == 0 means one worker per core.
+    // worker_cpus: cpus to pin the workers to (worker i -> worker_cpus[i % size]), empty for no pinning
+    WorkerPool(size_t worker_count, const std::string& book_type, const SymbolTable& symbols,
+               WaitStrategyType wait_strategy, const std::vector<int>& worker_cpus, Logger& logger);
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void start();
+
+    // the books publish their level 2 market data into the output rings, between the execution reports
+    // (see market_data.hpp). Call it before start() and before restoring a snapshot
+    void enableMarketData(unsigned long long snapshot_interval) {
+        for (auto& worker : workers_) {
+            worker->enableMarketData(snapshot_interval);
+        }
+    }
+
+    // the books check every order against the limits of its account before they match it, and prevent
+    // self-trades (see risk_checks.hpp). Same rules as enableMarketData
+    void enableRiskChecks(const std::shared_ptr<const RiskConfig>& config) {
+        for (auto& worker : workers_) {
+            worker->enableRiskChecks(config);
+        }
+        risk_enabled_ = true;
+    }
+    bool isRiskEnabled() const { return risk_enabled_; }
+
+    // number of orders staged for a worker before they are pushed to its ring in one batch
+    static constexpr size_t kRoutingBatchSize = 128;
+
+    // route an order to the worker of its instrument (dispatcher thread only).
+    // The order gets the next input sequence number, and is staged with the other orders of the same worker;
+    // a full stage is pushed at once
+    void dispatch(const Order& order) {
+        size_t worker_index = routeFor(order.symbol_id);
+        Stage& stage = stages_[worker_index];
+        Order& staged_order = stage.orders[stage.size++];
+        staged_order = order;
+        staged_order.sequence = next_sequence_++;
+        // one order out of kLatencySamplePeriod carries the time it was staged (its queueing is measured)
+        staged_order.dispatch_ns = (staged_order.sequence & (kLatencySamplePeriod - 1)) == 0 ? statsNowNs() : 0;
+        pending_routes_.push_back(static_cast<uint32_t>(worker_index));
+        if (stage.size == kRoutingBatchSize) {
+            flushStage(worker_index);
+        }
+    }
+    // push every staged order to its worker, then their routes to the route log.
+    // The dispatcher calls it after each batch it routed, so no order waits in a stage while the input is idle
+    void flush();
+
+    // close the route log, let every worker finish its ring, and join them
+    void stop();
+
+    // put the resting orders of a snapshot back into their books (before start(), in the order of the snapshot).
+    // Returns false if the book of the order could not hold it
+    bool restoreRestingOrder(const Order& order) { return workers_[routeFor(order.symbol_id)]->restoreRestingOrder(order); }
+
+    // flush, then wait until every worker has processed every order dispatched to it (dispatcher thread only).
+    // Until the next dispatch the workers only wait on their empty rings: the dispatcher can read the books
+    // (that is how a snapshot is taken while the engine runs), the writer keeps draining the output
+    void waitUntilIdle();
+
+    // for the writer: the worker index of every order, in input sequence order.
+    // A route is published only once its order is in the ring of its worker
+    SpscRing<uint32_t>& getRouteLog() { return route_log_; }
+    OutputQueue& getOutputQueue(size_t worker_index) { return workers_[worker_index]->getOutputQueue(); }
+    const BookWorker& getWorker(size_t worker_index) const { return *workers_[worker_index]; }
+
+    size_t workerIndexFor(uint32_t symbol_id) const { return partitionOf(symbol_id, workers_.size()); }
+    size_t size() const { return workers_.size(); }
+
+    // totals over every book (read them after stop())
+    size_t getBookCount() const;
+    unsigned long long getProcessedOrders() const;
+    unsigned long long getMatchingAllocations() const;
+    unsigned long long getOutputAllocations() const;
+
+private:
+    // orders waiting to be pushed to one worker
+    struct Stage {
+        std::vector<Order> orders = std::vector<Order>(kRoutingBatchSize);
+        size_t size = 0;
+        unsigned long long dispatched = 0; // orders pushed to the worker so far
+    };
+
+    // worker of a symbol id, computed once per instrument and then read from a flat array
+    size_t routeFor(uint32_t symbol_id) {
+        if (symbol_id >= routes_.size()) {
+            growRoutes(symbol_id);
+        }
+        return routes_[symbol_id];
+    }
+    void growRoutes(uint32_t symbol_id);
+    void flushStage(size_t worker_index);
+
+    std::vector<std::unique_ptr<BookWorker>> workers_;
+    std::vector<uint32_t> routes_;  // symbol id -> worker index (dispatcher thread only)
+    bool risk_enabled_ = false;
+    std::vector<Stage> stages_;     // one per worker (dispatcher thread only)
+    unsigned long long next_sequence_ = 0;
+    std::vector<uint32_t> pending_routes_; // routes of the staged orders, published by flush()
+    SpscRing<uint32_t> route_log_;
+    std::vector<int> worker_cpus_;
+    Logger& logger_;
+};
+
+// parse a list of cpus like "2,3,4,5" (empty string for no pinning). Returns false if it is malformed
+bool parseCpuList(const std::string& cpu_list, std::vector<int>& cpus);
+
+// a few lines at info level: what every stage and every queue of the pipeline is doing right now.
+// Safe to call while the threads run (every value is read with a relaxed load)
+void logPipelineSnapshot(Logger& logger, const PipelineStats& stats, const OrderQueue& reader_queue,
+                         WorkerPool& worker_pool);
+
+// the final summary: the stages, the queues and the books (one line per book at debug level).
+// Call it after every thread is joined
+void logPipelineSummary(Logger& logger, const PipelineStats& stats, const OrderQueue& reader_queue,
+                        WorkerPool& worker_pool);
+
+// the memory report of the books (added up over the books of the process), and the huge pages they got
+void logBookMemory(Logger& logger, const BookMemoryStats& memory);
@@ -0,0 +1,184 @@
+// InlineReplay: replays an order file through the library API of the books (inline_engine.hpp).
+// Every order is matched on this thread by InlineEngine::submit, its events go straight to a sink:
+// no reader, worker or writer thread, no ring between them.
+//   InlineReplay <orders file> [--book-type map] [--tick-size 0.01] [--output reports.csv]
+// With --output the sink writes the events as the engine does, so the file can be compared with the
+// output of MyMatchingEngine (same lines, same order). Prints the submit throughput and latency.
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "argparse.hpp"
+#include "bench_stats.hpp"
+#include "binary_format.hpp"
+#include "csv_mmap_reader.hpp"
+#include "inline_engine.hpp"
+#include "logger.hpp"
+#include "report_writer.hpp"
+
+namespace {
+
+constexpr size_t kLoaderQueueCapacity = 1 << 16;
+constexpr size_t kLoaderBatchSize = 256;
+// one submit out of this many is timed on its own (reading the clock around every call would cost more than the call)
+constexpr size_t kLatencySamplePeriod = 64;
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// read every order of the file into memory, with the readers of the engine
+bool loadOrders(const std::string& path, Logger& logger, const TickSizeTable& tick_sizes, SymbolTable& symbols,
+                std::vector<Order>& orders) {
+    OrderQueue order_queue(kLoaderQueueCapacity, WaitStrategyType::PARK);
+    bool loaded = true;
+    std::thread reader_thread([&]() {
+        if (BinaryFileReader::hasMagic(path)) {
+            loaded = readOrdersFromBinaryFile(path, logger, order_queue, tick_sizes, symbols);
+        } else {
+            std::ifstream input_file_stream(path);
+            if (!input_file_stream.is_open()) {
+                loaded = false;
+            } else if (!readOrdersFromMappedFile(path, logger, order_queue, tick_sizes, symbols)) {
+                readOrdersFromStream(input_file_stream, logger, order_queue, tick_sizes, symbols);
+            }
+        }
+        order_queue.close();
+    });
+    std::vector<Order> batch(kLoaderBatchSize);
+    size_t count;
+    while ((count = order_queue.pop_batch(batch.data(), batch.size())) > 0) {
+        orders.insert(orders.end(), batch.begin(), batch.begin() + static_cast<std::ptrdiff_t>(count));
+    }
+    reader_thread.join();
+    return loaded && !orders.empty();
+}
+
+// counts the events, and writes them when it has a writer
+struct ReplaySink : ExecutionSink {
+    ReportWriter* writer = nullptr;
+    unsigned long long events = 0;
+    unsigned long long fills = 0;
+
+    void record(const ExecutionReport& report) {
+        events++;
+        if (writer != nullptr) {
+            writer->append(report);
+        }
+    }
+    void onAccepted(const ExecutionReport& report) { record(report); }
+    void onFill(const ExecutionReport& report) { fills++; record(report); }
+    void onCanceled(const ExecutionReport& report) { record(report); }
+    void onCompleted(const ExecutionReport& report) { record(report); }
+    void onRejected(const ExecutionReport& report) { record(report); }
+};
+
+template <typename Book>
+int replay(const std::string& input_path, const std::string& book_type, double tick_size, const std::string& output_path) {
+    Logger logger("InlineReplay");
+    logger.set_level(LogLevel::WARN); // the skipped lines are still reported
+
+    InlineEngine<Book> engine(tick_size);
+    std::vector<Order> orders;
+    if (!loadOrders(input_path, logger, engine.tickSizes(), engine.symbols(), orders)) {
+        logger.critical("No order could be read from: ", input_path);
+        return 1;
+    }
+
+    ReportWriter report_writer(engine.symbols());
+    ReplaySink sink;
+    std::string output_error;
+    if (!output_path.empty()) {
+        if (!report_writer.open(output_path, output_error)) {
+            logger.critical("Failed to open output file: ", output_path, " (", output_error, ")");
+            return 1;
+        }
+        report_writer.writeHeader();
+        sink.writer = &report_writer;
+    }
+
+    std::vector<uint64_t> latencies;
+    latencies.reserve(orders.size() / kLatencySamplePeriod + 1);
+    const uint64_t start_ns = nowNs();
+    for (size_t i = 0; i < orders.size(); ++i) {
+        if (i % kLatencySamplePeriod != 0) {
+            engine.submit(orders[i], sink);
+            continue;
+        }
+        const uint64_t submit_start_ns = nowNs();
+        engine.submit(orders[i], sink);
+        latencies.push_back(nowNs() - submit_start_ns);
+    }
+    const double seconds = static_cast<double>(nowNs() - start_ns) / 1e9;
+
+    if (!output_path.empty() && !report_writer.close(output_error)) {
+        logger.critical("Failed to write output file: ", output_path, " (", output_error, ")");
+        return 1;
+    }
+    LatencySummary latency = summarizeLatencies(latencies);
+    std::cout << std::fixed
+              << "book type:          " << book_type << "\n"
+              << "orders:             " << orders.size() << " (" << engine.symbols().size() << " instruments)\n"
+              << "events:             " << sink.events << " (" << sink.fills << " fills)\n"
+              << "elapsed:            " << std::setprecision(3) << seconds << " s"
+              << (output_path.empty() ? "" : " (events written to the output file)") << "\n"
+              << "throughput:         " << std::setprecision(0)
+              << (seconds > 0.0 ? static_cast<double>(orders.size()) / seconds : 0.0) << " orders/s\n"
+              << "submit (ns):        mean " << std::setprecision(0) << latency.mean_ns
+              << ", p50 " << latency.p50_ns << ", p99 " << latency.p99_ns
+              << ", p99.9 " << latency.p999_ns << ", max " << latency.max_ns << "\n";
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    ArgumentParser parser("Replay an order file through the inline library API of the books");
+    parser.add_argument("input_file")
+        .help("Order file to replay (CSV, or binary from OrderFileConverter).")
+        .type_string();
+    parser.add_flag({"--book-type"})
+        .help("Order book implementation: 'map' or 'ladder'.")
+        .set_default(std::string("map"))
+        .type_string();
+    parser.add_flag({"--tick-size"})
+        .help("Tick size of every instrument.")
+        .set_default(0.01)
+        .type_double();
+    parser.add_flag({"--output"})
+        .help("Write the execution events to this CSV file, like the engine (empty = only count them).")
+        .set_default(std::string(""))
+        .type_string();
+
+    std::string input_path, book_type, output_path;
+    double tick_size = 0.01;
+    try {
+        parser.parse_args(argc, argv);
+        input_path = parser.get<std::string>("input_file");
+        book_type = parser.get<std::string>("book_type");
+        if (book_type != "map" && book_type != "ladder") {
+            throw std::runtime_error("Invalid book type '" + book_type + "'. Expected 'map' or 'ladder'.");
+        }
+        tick_size = parser.get<double>("tick_size");
+        if (tick_size <= 0.0) {
+            throw std::runtime_error("Invalid value for --tick-size: it must be positive.");
+        }
+        output_path = parser.get<std::string>("output");
+    } catch (const std::runtime_error& err) {
+        std::cerr << "Error parsing arguments: " << err.what() << std::endl;
+        parser.print_help();
+        return 1;
+    }
+
+    // the book type is a template parameter of the engine: one replay per implementation
+    if (book_type == "ladder") {
+        return replay<LadderOrderBook>(input_path, book_type, tick_size, output_path);
+    }
+    return replay<OrderBook>(input_path, book_type, tick_size, output_path);
+}
@@ -0,0 +1,458 @@
+#include "journal.hpp"
+#include "csv_mmap_reader.hpp" // For MappedFile
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>     // For std::llround
+#include <cstdlib>   // For std::aligned_alloc
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// this class writes the orders to the journal by groups, and reads them back after a restart
+
+static constexpr char kJournalMagic[8] = {'M', 'E', 'J', 'O', 'U', 'R', 'N', 'L'};
+// bump it whenever the header or a record changes
+static constexpr uint32_t kJournalVersion = 1;
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// FNV-1a of the record, its checksum field counted as 0
+static uint32_t recordChecksum(const JournalRecord& record) {
+    JournalRecord copy = record;
+    copy.checksum = 0;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&copy);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(copy); ++i) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+OrderJournal::OrderJournal(Logger& logger, PipelineStats* stats) : logger_(logger), stats_(stats) {
+}
+
+OrderJournal::~OrderJournal() {
+    if (fd_ >= 0) {
+        std::string error;
+        close(error);
+    }
+    std::free(buffer_);
+}
+
+bool OrderJournal::open(const std::string& path, SymbolTable& symbols, const TickSizeTable& tick_sizes,
+                        std::vector<Order>& recovered, std::string& error) {
+    path_ = path;
+    symbols_ = &symbols;
+    buffer_ = static_cast<char*>(std::aligned_alloc(kBlockSize, kBufferBytes));
+    if (buffer_ == nullptr) {
+        error = "cannot allocate the journal buffer";
+        return false;
+    }
+    std::memset(buffer_, 0, kBufferBytes);
+
+    // read back the records of an existing journal
+    struct stat file_stat;
+    const bool existing = ::stat(path.c_str(), &file_stat) == 0 && file_stat.st_size > 0;
+    uint64_t data_end = kBlockSize;
+    if (existing) {
+        MappedFile file;
+        if (!file.open(path, error)) {
+            return false;
+        }
+        const std::string_view contents = file.contents();
+        JournalFileHeader header{};
+        if (contents.size() < kBlockSize) {
+            error = "not a journal file (too small)";
+            return false;
+        }
+        std::memcpy(&header, contents.data(), sizeof(header));
+        if (std::memcmp(header.magic, kJournalMagic, sizeof(kJournalMagic)) != 0) {
+            error = "not a journal file";
+            return false;
+        }
+        if (header.version != kJournalVersion || header.record_size != sizeof(JournalRecord)) {
+            error = "unsupported journal version " + std::to_string(header.version);
+            return false;
+        }
+
+        std::vector<uint32_t> engine_symbol_of; // journal id -> engine symbol id
+        std::vector<double> symbol_tick_sizes;  // journal id -> tick size
+        // a SYMBOL record whose name goes on in the next records
+        std::string pending_name;
+        uint64_t pending_symbol = 0;
+        uint64_t pending_name_length = 0;
+        uint64_t pending_symbol_start = 0;
+        bool name_pending = false;
+
+        uint64_t offset = kBlockSize;
+        for (; offset + sizeof(JournalRecord) <= contents.size(); offset += sizeof(JournalRecord)) {
+            JournalRecord record;
+            std::memcpy(&record, contents.data() + offset, sizeof(record));
+            const auto kind = static_cast<JournalRecordKind>(record.kind);
+            if (kind == JournalRecordKind::FREE || record.checksum != recordChecksum(record)) {
+                break; // the end of the journal, or a write torn by the crash
+            }
+            if (kind == JournalRecordKind::SYMBOL_NAME) {
+                if (!name_pending || record.sequence != pending_symbol) {
+                    break;
+                }
+                const size_t chunk = static_cast<size_t>(std::min<uint64_t>(JournalRecord::kPayloadBytes,
+                                                                            pending_name_length - pending_name.size()));
+                pending_name.append(reinterpret_cast<const char*>(record.payload), chunk);
+            } else if (name_pending) {
+                break; // a name was cut short
+            } else if (kind == JournalRecordKind::SYMBOL) {
+                JournalSymbolPayload payload;
+                std::memcpy(&payload, record.payload, sizeof(payload));
+                if (record.sequence != engine_symbol_of.size()) {
+                    break; // journal ids are given in order
+                }
+                pending_symbol = record.sequence;
+                pending_name_length = payload.name_length;
+                pending_name.assign(payload.name, static_cast<size_t>(std::min<uint64_t>(
+                                                      JournalSymbolPayload::kInlineNameBytes, payload.name_length)));
+                pending_symbol_start = offset;
+                name_pending = true;
+            } else if (kind == JournalRecordKind::ORDER) {
+                JournalOrderPayload payload;
+                std::memcpy(&payload, record.payload, sizeof(payload));
+                Order order;
+                if ((record.sequence < next_sequence_ && !recovered.empty()) ||
+                    payload.symbol_id >= engine_symbol_of.size() ||
+                    record.side > static_cast<uint8_t>(Side::SELL) ||
+                    record.type > static_cast<uint8_t>(OrderType::MARKET) ||
+                    record.action > static_cast<uint8_t>(OrderAction::CANCEL) ||
+                    !unpackOrderFlags(payload.flags, order.time_in_force, order.post_only)) {
+                    break;
+                }
+                order.timestamp = payload.timestamp;
+                order.order_id = payload.order_id;
+                order.symbol_id = engine_symbol_of[payload.symbol_id];
+                order.side = static_cast<Side>(record.side);
+                order.type = static_cast<OrderType>(record.type);
+                order.action = static_cast<OrderAction>(record.action);
+                order.quantity = payload.quantity;
+                order.price = payload.price;
+                order.display_quantity = payload.display_quantity;
+                order.account_id = payload.account_id;
+                // same conversion as the parsers (market orders keep 0 ticks)
+                if (order.type == OrderType::LIMIT) {
+                    order.price_ticks = std::llround(order.price / symbol_tick_sizes[payload.symbol_id]);
+                }
+                order.remaining_quantity = order.quantity;
+                order.status = OrderStatus::UNKNOWN;
+                order.sequence = record.sequence;
+                recovered.push_back(order);
+                next_sequence_ = record.sequence + 1;
+            } else {
+                break;
+            }
+            if (name_pending && pending_name.size() == pending_name_length) {
+                engine_symbol_of.push_back(symbols.intern(pending_name));
+                symbol_tick_sizes.push_back(tick_sizes.tick_size_for(pending_name));
+                name_pending = false;
+            }
+        }
+        // an incomplete name is dropped with its SYMBOL record
+        data_end = name_pending ? pending_symbol_start : offset;
+
+        // the instruments keep their journal ids for the next records
+        for (uint32_t journal_id = 0; journal_id < engine_symbol_of.size(); ++journal_id) {
+            const uint32_t engine_id = engine_symbol_of[journal_id];
+            if (engine_id >= journal_symbol_of_.size()) {
+                journal_symbol_of_.resize(static_cast<size_t>(engine_id) + 1, SymbolTable::kInvalidSymbol);
+            }
+            journal_symbol_of_[engine_id] = journal_id;
+        }
+        next_journal_symbol_ = static_cast<uint32_t>(engine_symbol_of.size());
+
+        // the last partial block goes back into the buffer: the next commit writes it again with the new records
+        buffer_offset_ = data_end / kBlockSize * kBlockSize;
+        used_ = static_cast<size_t>(data_end - buffer_offset_);
+        std::memcpy(buffer_, contents.data() + buffer_offset_, used_);
+    }
+
+    // O_DIRECT when the file system allows it (tmpfs does not, for example)
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+#ifdef O_DIRECT
+    fd_ = ::open(path.c_str(), flags | O_DIRECT, 0644);
+    if (fd_ < 0 && errno == EINVAL) {
+        fd_ = ::open(path.c_str(), flags, 0644);
+    }
+#else
+    fd_ = ::open(path.c_str(), flags, 0644);
+#endif
+    if (fd_ < 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+
+    if (existing) {
+        // whatever follows the last good record (a torn write, old preallocated space) is cut
+        if (::ftruncate(fd_, static_cast<off_t>(data_end)) != 0) {
+            error = std::strerror(errno);
+            return false;
+        }
+        preallocated_ = data_end;
+        return true;
+    }
+
+    // a new journal: its header block, synced before the first record
+    JournalFileHeader header{};
+    std::memcpy(header.magic, kJournalMagic, sizeof(kJournalMagic));
+    header.version = kJournalVersion;
+    header.record_size = static_cast<uint32_t>(sizeof(JournalRecord));
+    std::memcpy(buffer_, &header, sizeof(header));
+    const bool written = writeAt(buffer_, kBlockSize, 0) && ::fdatasync(fd_) == 0;
+    std::memset(buffer_, 0, kBlockSize);
+    if (!written) {
+        error = std::strerror(write_errno_ != 0 ? write_errno_ : errno);
+        return false;
+    }
+    buffer_offset_ = kBlockSize;
+    used_ = 0;
+    preallocated_ = kBlockSize;
+    return true;
+}
+
+bool OrderJournal::writeAt(const char* data, size_t size, uint64_t offset) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t result = ::pwrite(fd_, data + written, size - written, static_cast<off_t>(offset + written));
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            write_errno_ = errno;
+            return false;
+        }
+        written += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+size_t OrderJournal::bytesFor(const Order& order) const {
+    size_t bytes = sizeof(JournalRecord);
+    if (order.symbol_id >= journal_symbol_of_.size() || journal_symbol_of_[order.symbol_id] == SymbolTable::kInvalidSymbol) {
+        const size_t name_length = symbols_->name(order.symbol_id).size();
+        size_t records = 1;
+        if (name_length > JournalSymbolPayload::kInlineNameBytes) {
+            records += (name_length - JournalSymbolPayload::kInlineNameBytes + JournalRecord::kPayloadBytes - 1)
+                       / JournalRecord::kPayloadBytes;
+        }
+        bytes += records * sizeof(JournalRecord);
+    }
+    return bytes;
+}
+
+void OrderJournal::appendRecord(JournalRecord& record) {
+    record.checksum = recordChecksum(record);
+    std::memcpy(buffer_ + used_, &record, sizeof(record));
+    used_ += sizeof(record);
+}
+
+void OrderJournal::appendOrder(const Order& order, uint64_t input_position) {
+    if (order.symbol_id >= journal_symbol_of_.size()) {
+        journal_symbol_of_.resize(static_cast<size_t>(order.symbol_id) + 1, SymbolTable::kInvalidSymbol);
+    }
+    uint32_t& journal_symbol = journal_symbol_of_[order.symbol_id];
+    if (journal_symbol == SymbolTable::kInvalidSymbol) {
+        // first order of this instrument: its name goes first
+        journal_symbol = next_journal_symbol_++;
+        const std::string& name = symbols_->name(order.symbol_id);
+        JournalRecord record{};
+        record.kind = static_cast<uint8_t>(JournalRecordKind::SYMBOL);
+        record.sequence = journal_symbol;
+        JournalSymbolPayload payload{};
+        payload.name_length = static_cast<uint32_t>(name.size());
+        size_t done = std::min(name.size(), JournalSymbolPayload::kInlineNameBytes);
+        std::memcpy(payload.name, name.data(), done);
+        std::memcpy(record.payload, &payload, sizeof(payload));
+        appendRecord(record);
+        while (done < name.size()) {
+            JournalRecord name_record{};
+            name_record.kind = static_cast<uint8_t>(JournalRecordKind::SYMBOL_NAME);
+            name_record.sequence = journal_symbol;
+            const size_t chunk = std::min(name.size() - done, JournalRecord::kPayloadBytes);
+            std::memcpy(name_record.payload, name.data() + done, chunk);
+            appendRecord(name_record);
+            done += chunk;
+        }
+    }
+
+    JournalRecord record{};
+    record.kind = static_cast<uint8_t>(JournalRecordKind::ORDER);
+    record.side = static_cast<uint8_t>(order.side);
+    record.type = static_cast<uint8_t>(order.type);
+    record.action = static_cast<uint8_t>(order.action);
+    record.sequence = input_position;
+    JournalOrderPayload payload{};
+    payload.timestamp = order.timestamp;
+    payload.order_id = order.order_id;
+    payload.quantity = order.quantity;
+    payload.price = order.price;
+    payload.symbol_id = journal_symbol;
+    payload.flags = packOrderFlags(order.time_in_force, order.post_only);
+    payload.display_quantity = static_cast<uint32_t>(order.display_quantity); // checked by orderAttributesError
+    payload.account_id = order.account_id;
+    std::memcpy(record.payload, &payload, sizeof(payload));
+    appendRecord(record);
+    journaled_orders_++;
+    next_sequence_ = input_position + 1;
+}
+
+bool OrderJournal::commit() {
+    if (write_errno_ != 0) {
+        return false;
+    }
+    const size_t write_size = static_cast<size_t>(alignUp(used_, kBlockSize));
+    if (write_size == 0) {
+        return true;
+    }
+    std::memset(buffer_ + used_, 0, write_size - used_); // the rest of the last block is free space
+
+    // grow the file ahead of the writes, so the syncs do not have to change its size
+    const uint64_t end = buffer_offset_ + write_size;
+    if (end > preallocated_) {
+        const uint64_t new_size = alignUp(end, kPreallocateBytes);
+        int result = ::posix_fallocate(fd_, static_cast<off_t>(preallocated_), static_cast<off_t>(new_size - preallocated_));
+        if (result != 0) {
+            write_errno_ = result;
+            return false;
+        }
+        preallocated_ = new_size;
+    }
+
+    if (!writeAt(buffer_, write_size, buffer_offset_)) {
+        return false;
+    }
+    if (::fdatasync(fd_) != 0) {
+        write_errno_ = errno;
+        return false;
+    }
+    // keep the partial last block: the next records go after it, and it is written again with them
+    const size_t full_blocks = used_ / kBlockSize * kBlockSize;
+    std::memmove(buffer_, buffer_ + full_blocks, used_ - full_blocks);
+    buffer_offset_ += full_blocks;
+    used_ -= full_blocks;
+    commit_count_++;
+    return true;
+}
+
+bool OrderJournal::run(OrderQueue& input, OrderQueue& output, const std::vector<Order>& replay, uint64_t skip_before,
+                       std::chrono::microseconds commit_budget) {
+    std::vector<Order> batch(kBatchSize);
+
+    // the replayed orders are on disk already, they go on right away
+    for (size_t done = 0; done < replay.size(); done += kBatchSize) {
+        const size_t count = std::min(kBatchSize, replay.size() - done);
+        std::copy(replay.begin() + static_cast<std::ptrdiff_t>(done),
+                  replay.begin() + static_cast<std::ptrdiff_t>(done + count), batch.begin());
+        output.push_batch(batch.data(), count);
+    }
+
+    const uint64_t budget_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(commit_budget).count());
+    std::vector<Order> group; // orders of the buffer, sent on once they are committed
+    group.reserve(kBufferBytes / sizeof(JournalRecord));
+    uint64_t group_start_ns = 0;
+    uint64_t input_position = 0;
+    bool failed = false;
+
+    auto commit_group = [&]() {
+        if (group.empty() || failed) {
+            return;
+        }
+        const uint64_t start_ns = statsNowNs();
+        if (!commit()) {
+            failed = true;
+            logger_.critical("Journal write to", path_, "failed (" + std::string(std::strerror(write_errno_)) +
+                             "): the orders from input position", group.front().sequence, "on are not processed.");
+            group.clear();
+            return;
+        }
+        if (stats_ != nullptr) {
+            stats_->journal_commit.record(statsNowNs() - start_ns);
+        }
+        output.push_batch(group.data(), group.size());
+        group.clear();
+    };
+
+    while (true) {
+        size_t count;
+        if (group.empty()) {
+            // nothing waits for a commit: sleep on the ring (with its wait strategy)
+            count = input.pop_batch(batch.data(), batch.size());
+            if (count == 0) {
+                break;
+            }
+        } else {
+            // a group is open: gather what arrives until its budget is spent.
+            // (the window is short, so the thread yields instead of sleeping)
+            count = input.try_pop_batch(batch.data(), batch.size());
+            if (count == 0) {
+                if (input.is_closed()) {
+                    count = input.try_pop_batch(batch.data(), batch.size()); // pushed just before close()
+                    if (count == 0) {
+                        break;
+                    }
+                } else {
+                    if (statsNowNs() - group_start_ns >= budget_ns) {
+                        commit_group();
+                    } else {
+                        std::this_thread::yield();
+                    }
+                    continue;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            Order& order = batch[i];
+            const uint64_t position = input_position++;
+            if (position < skip_before || failed) {
+                continue; // already in the books or in the journal (or not durable any more)
+            }
+            if (kBufferBytes - used_ < bytesFor(order)) {
+                commit_group(); // the buffer is full: this group is committed now
+                if (failed) {
+                    continue;
+                }
+            }
+            if (group.empty()) {
+                group_start_ns = statsNowNs();
+            }
+            appendOrder(order, position);
+            order.sequence = position;
+            group.push_back(order);
+        }
+        if (!group.empty() && statsNowNs() - group_start_ns >= budget_ns) {
+            commit_group();
+        }
+    }
+    commit_group();
+    output.close();
+    return !failed;
+}
+
+bool OrderJournal::close(std::string& error) {
+    if (fd_ < 0) {
+        return true;
+    }
+    bool ok = commit();
+    // the preallocated space after the last record is given back
+    if (ok && (::ftruncate(fd_, static_cast<off_t>(buffer_offset_ + used_)) != 0 || ::fsync(fd_) != 0)) {
+        write_errno_ = errno;
+        ok = false;
+    }
+    if (!ok) {
+        error = std::strerror(write_errno_ != 0 ? write_errno_ : EIO);
+    }
+    ::close(fd_);
+    fd_ = -1;
+    return ok;
+}
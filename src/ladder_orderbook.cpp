@@ -0,0 +1,675 @@
+#include "ladder_orderbook.hpp"
+#include <iostream>
+#include <algorithm>
+
+// this class is the flat price ladder version of the order book.
+// The matching rules (and the output records) are the same as the map-based OrderBook,
+// only the storage of the price levels changes.
+
+LadderOrderBook::LadderOrderBook(const std::string& instrument_name, uint32_t symbol_id)
+    : OrderBookBase(instrument_name, symbol_id) {
+}
+
+// make sure the ladder has a slot for this price.
+// The array grows by at least its current size, so a price drifting in one direction
+// only costs a logarithmic number of reallocations
+bool LadderOrderBook::reserveLevel(long long price_ticks) {
+    if (levels_.empty()) {
+        base_ticks_ = price_ticks - kInitialLevels / 2;
+        origin_ticks_ = price_ticks;
+        levels_.resize(static_cast<size_t>(kInitialLevels));
+        occupied_words_.assign(static_cast<size_t>(kInitialLevels / 64), 0);
+        rebuildOccupancySummary();
+        return true;
+    }
+    const long long size = static_cast<long long>(levels_.size());
+    if (price_ticks >= base_ticks_ && price_ticks < base_ticks_ + size) {
+        return true;
+    }
+    const long long low = std::min(base_ticks_, price_ticks);
+    const long long high = std::max(base_ticks_ + size, price_ticks + 1);
+    if (high - low > kMaxLevels) {
+        return false; // too far away from the other prices of the book
+    }
+    // grow by whole bitmap words (64 levels)
+    auto round_up_64 = [](long long levels) { return (levels + 63) / 64 * 64; };
+    if (price_ticks < base_ticks_) {
+        long long grow = std::min(round_up_64(std::max(base_ticks_ - price_ticks, size)), kMaxLevels - size);
+        levels_.insert(levels_.begin(), static_cast<size_t>(grow), Level{});
+        occupied_words_.insert(occupied_words_.begin(), static_cast<size_t>(grow / 64), 0);
+        base_ticks_ -= grow;
+    } else {
+        long long grow = std::min(round_up_64(std::max(price_ticks + 1 - (base_ticks_ + size), size)), kMaxLevels - size);
+        levels_.resize(static_cast<size_t>(size + grow));
+        occupied_words_.resize(static_cast<size_t>((size + grow) / 64), 0);
+    }
+    rebuildOccupancySummary();
+    return true;
+}
+
+void LadderOrderBook::rebuildOccupancySummary() {
+    occupied_summary_.assign((occupied_words_.size() + 63) / 64, 0);
+    for (size_t word = 0; word < occupied_words_.size(); ++word) {
+        if (occupied_words_[word] != 0) {
+            occupied_summary_[word / 64] |= 1ULL << (word % 64);
+        }
+    }
+}
+
+void LadderOrderBook::markLevelOccupied(size_t level_index) {
+    const size_t word = level_index / 64;
+    occupied_words_[word] |= 1ULL << (level_index % 64);
+    occupied_summary_[word / 64] |= 1ULL << (word % 64);
+}
+
+void LadderOrderBook::markLevelEmpty(size_t level_index) {
+    const size_t word = level_index / 64;
+    occupied_words_[word] &= ~(1ULL << (level_index % 64));
+    if (occupied_words_[word] == 0) {
+        occupied_summary_[word / 64] &= ~(1ULL << (word % 64));
+    }
+}
+
+size_t LadderOrderBook::nextOccupiedLevel(size_t level_index) const {
+    if (level_index >= levels_.size()) {
+        return kNoLevel;
+    }
+    // rest of the word of level_index
+    size_t word = level_index / 64;
+    uint64_t bits = occupied_words_[word] & (~0ULL << (level_index % 64));
+    if (bits != 0) {
+        return word * 64 + static_cast<size_t>(__builtin_ctzll(bits));
+    }
+    // next non-empty word, found with the summary
+    word++;
+    if (word >= occupied_words_.size()) {
+        return kNoLevel;
+    }
+    size_t summary_word = word / 64;
+    uint64_t summary_bits = occupied_summary_[summary_word] & (~0ULL << (word % 64));
+    while (summary_bits == 0) {
+        if (++summary_word >= occupied_summary_.size()) {
+            return kNoLevel;
+        }
+        summary_bits = occupied_summary_[summary_word];
+    }
+    word = summary_word * 64 + static_cast<size_t>(__builtin_ctzll(summary_bits));
+    return word * 64 + static_cast<size_t>(__builtin_ctzll(occupied_words_[word]));
+}
+
+size_t LadderOrderBook::prevOccupiedLevel(size_t level_index) const {
+    if (level_index == kNoLevel) {
+        return kNoLevel;
+    }
+    // start of the word of level_index (bits 0..level_index%64)
+    size_t word = level_index / 64;
+    uint64_t bits = occupied_words_[word] & ((2ULL << (level_index % 64)) - 1);
+    if (bits != 0) {
+        return word * 64 + 63 - static_cast<size_t>(__builtin_clzll(bits));
+    }
+    // previous non-empty word, found with the summary
+    if (word == 0) {
+        return kNoLevel;
+    }
+    word--;
+    size_t summary_word = word / 64;
+    uint64_t summary_bits = occupied_summary_[summary_word] & ((2ULL << (word % 64)) - 1);
+    while (summary_bits == 0) {
+        if (summary_word == 0) {
+            return kNoLevel;
+        }
+        summary_bits = occupied_summary_[--summary_word];
+    }
+    word = summary_word * 64 + 63 - static_cast<size_t>(__builtin_clzll(summary_bits));
+    return word * 64 + 63 - static_cast<size_t>(__builtin_clzll(occupied_words_[word]));
+}
+
+// add the order at the back of its level (FIFO) and move the best price cursor if needed
+void LadderOrderBook::restOrder(const Order& order) {
+    touchLevel(order.side, order.price_ticks, order.price);
+    const uint32_t slot = pool_.allocate();
+    pool_.hot(slot) = RestingOrder{order.order_id, order.remaining_quantity, kNoSlot, kNoSlot,
+                                   order.side, order.type, order.action, order.status};
+    pool_.cold(slot) = RestingOrderInfo{order.timestamp, order.quantity, order.price, order.display_quantity,
+                                        order.hidden_quantity, order.account_id,
+                                        static_cast<int32_t>(order.price_ticks - origin_ticks_)};
+    countRestingOrder(order.account_id);
+
+    Level& level = levelAt(order.price_ticks);
+    if (level.tail == kNoSlot) {
+        level.head = slot;
+        markLevelOccupied(static_cast<size_t>(order.price_ticks - base_ticks_));
+    } else {
+        pool_.hot(level.tail).next = slot;
+        pool_.hot(slot).prev = level.tail;
+    }
+    level.tail = slot;
+    level.order_count++;
+    level.total_quantity += order.remaining_quantity;
+    level.hidden_quantity += order.hidden_quantity;
+
+    if (order.side == Side::BUY) {
+        if (!has_bids_ || order.price_ticks > best_bid_ticks_) {
+            best_bid_ticks_ = order.price_ticks;
+            has_bids_ = true;
+        }
+    } else {
+        if (!has_asks_ || order.price_ticks < best_ask_ticks_) {
+            best_ask_ticks_ = order.price_ticks;
+            has_asks_ = true;
+        }
+    }
+    order_index_.insert_or_assign(order.order_id, slot);
+}
+
+// remove a slot from the queue of its level
+void LadderOrderBook::unlinkSlot(uint32_t slot) {
+    const RestingOrder& resting_order = pool_.hot(slot);
+    const RestingOrderInfo& resting_info = pool_.cold(slot);
+    const long long price_ticks = origin_ticks_ + resting_info.level_offset;
+    Level& level = levelAt(price_ticks);
+    if (resting_order.prev == kNoSlot) {
+        level.head = resting_order.next;
+    } else {
+        pool_.hot(resting_order.prev).next = resting_order.next;
+    }
+    if (resting_order.next == kNoSlot) {
+        level.tail = resting_order.prev;
+    } else {
+        pool_.hot(resting_order.next).prev = resting_order.prev;
+    }
+    level.order_count--;
+    level.total_quantity -= resting_order.remaining_quantity;
+    level.hidden_quantity -= resting_info.hidden_quantity;
+    uncountRestingOrder(resting_info.account_id);
+    if (level.head == kNoSlot) {
+        markLevelEmpty(static_cast<size_t>(price_ticks - base_ticks_));
+    }
+}
+
+void LadderOrderBook::moveSlotToBack(Level& level, uint32_t slot) {
+    RestingOrder& resting_order = pool_.hot(slot);
+    if (level.tail == slot) {
+        return;
+    }
+    // out of its place (it is not the tail, so it has a next)...
+    if (resting_order.prev == kNoSlot) {
+        level.head = resting_order.next;
+    } else {
+        pool_.hot(resting_order.prev).next = resting_order.next;
+    }
+    pool_.hot(resting_order.next).prev = resting_order.prev;
+    // ...and after the tail
+    pool_.hot(level.tail).next = slot;
+    resting_order.prev = level.tail;
+    resting_order.next = kNoSlot;
+    level.tail = slot;
+}
+
+// post-only: the best opposite price must not cross the limit.
+// FOK: the levels that cross the limit (every level for a MARKET order) must hold the whole order,
+// and with the self-trade prevention none of them may hold an order of the same account;
+// the non-empty levels after the best ask are all asks, and before the best bid all bids
+bool LadderOrderBook::passesEntryChecks(const Order& order, bool is_market) const {
+    const bool incoming_is_buy = (order.side == Side::BUY);
+    if (order.post_only) {
+        if (incoming_is_buy ? (has_asks_ && best_ask_ticks_ <= order.price_ticks)
+                            : (has_bids_ && best_bid_ticks_ >= order.price_ticks)) {
+            return false;
+        }
+    }
+    if (order.time_in_force != TimeInForce::FOK) {
+        return true;
+    }
+    const uint32_t self_account = selfTradeAccount(order);
+    unsigned long long available = 0;
+    size_t level_index = kNoLevel;
+    if (incoming_is_buy ? has_asks_ : has_bids_) {
+        level_index = static_cast<size_t>((incoming_is_buy ? best_ask_ticks_ : best_bid_ticks_) - base_ticks_);
+    }
+    while (level_index != kNoLevel && available < order.remaining_quantity) {
+        const long long level_ticks = base_ticks_ + static_cast<long long>(level_index);
+        if (!is_market && (incoming_is_buy ? (level_ticks > order.price_ticks) : (level_ticks < order.price_ticks))) {
+            break;
+        }
+        available += levels_[level_index].total_quantity;
+        if (self_account != 0) {
+            for (uint32_t slot = levels_[level_index].head; slot != kNoSlot; slot = pool_.hot(slot).next) {
+                if (pool_.cold(slot).account_id == self_account) {
+                    return false;
+                }
+            }
+        }
+        if (incoming_is_buy) {
+            level_index = nextOccupiedLevel(level_index + 1);
+        } else {
+            level_index = (level_index == 0) ? kNoLevel : prevOccupiedLevel(level_index - 1);
+        }
+    }
+    return available >= order.remaining_quantity;
+}
+
+// the best bid level is empty: the next bid is the first non-empty level below it
+// (every non-empty level below the best bid is a bid level)
+void LadderOrderBook::advanceBestBid() {
+    const size_t best_index = static_cast<size_t>(best_bid_ticks_ - base_ticks_);
+    const size_t next_index = (best_index == 0) ? kNoLevel : prevOccupiedLevel(best_index - 1);
+    if (next_index == kNoLevel) {
+        has_bids_ = false;
+        return;
+    }
+    best_bid_ticks_ = base_ticks_ + static_cast<long long>(next_index);
+}
+
+// same for the asks, looking above the best ask
+void LadderOrderBook::advanceBestAsk() {
+    const size_t next_index = nextOccupiedLevel(static_cast<size_t>(best_ask_ticks_ - base_ticks_) + 1);
+    if (next_index == kNoLevel) {
+        has_asks_ = false;
+        return;
+    }
+    best_ask_ticks_ = base_ticks_ + static_cast<long long>(next_index);
+}
+
+// O(1) removal of a resting order (used by MODIFY and CANCEL)
+// the compact record is expanded back into a full Order for the caller
+bool LadderOrderBook::removeRestingOrder(long long order_id, Order& removed_order) {
+    const uint32_t slot = order_index_.erase(order_id);
+    if (slot == OrderIdIndex::kNotFound) {
+        return false;
+    }
+    expandSlot(slot, removed_order);
+
+    touchLevel(removed_order.side, removed_order.price_ticks, removed_order.price);
+    unlinkSlot(slot);
+    pool_.release(slot);
+
+    if (levelAt(removed_order.price_ticks).head == kNoSlot) {
+        if (removed_order.side == Side::BUY && removed_order.price_ticks == best_bid_ticks_) {
+            advanceBestBid();
+        } else if (removed_order.side == Side::SELL && removed_order.price_ticks == best_ask_ticks_) {
+            advanceBestAsk();
+        }
+    }
+    return true;
+}
+
+void LadderOrderBook::expandSlot(uint32_t slot, Order& order) const {
+    const RestingOrder& resting_order = pool_.hot(slot);
+    const RestingOrderInfo& resting_info = pool_.cold(slot);
+    order.timestamp = resting_info.timestamp;
+    order.order_id = resting_order.order_id;
+    order.symbol_id = symbol_id_;
+    order.side = resting_order.side;
+    order.type = resting_order.type;
+    order.quantity = resting_info.quantity;
+    order.price = resting_info.price;
+    order.price_ticks = origin_ticks_ + resting_info.level_offset;
+    order.action = resting_order.action;
+    order.remaining_quantity = resting_order.remaining_quantity;
+    order.cumulative_executed_quantity = resting_info.quantity - resting_order.remaining_quantity;
+    order.status = resting_order.status;
+    order.display_quantity = resting_info.display_quantity;
+    order.hidden_quantity = resting_info.hidden_quantity;
+    order.account_id = resting_info.account_id;
+}
+
+// one fill between the incoming order and a resting one, and its two output records
+void LadderOrderBook::recordFill(Order& incoming_order, uint32_t resting_slot, unsigned long long match_qty,
+                                 double match_price, bool incoming_reported_first, unsigned long long event_timestamp,
+                                 FillBatch& fills_batch) {
+    RestingOrder& resting_order = pool_.hot(resting_slot);
+    const RestingOrderInfo& resting_info = pool_.cold(resting_slot);
+
+    incoming_order.remaining_quantity -= match_qty;
+    incoming_order.cumulative_executed_quantity += match_qty;
+    incoming_order.status = (incoming_order.remaining_quantity == 0) ? OrderStatus::EXECUTED : OrderStatus::PARTIALLY_EXECUTED;
+
+    resting_order.remaining_quantity -= match_qty;
+    resting_order.status = (resting_order.remaining_quantity == 0) ? OrderStatus::EXECUTED : OrderStatus::PARTIALLY_EXECUTED;
+
+    auto emit_incoming = [&]() {
+        addFillRecord(fills_batch, event_timestamp, incoming_order.order_id, incoming_order.side, incoming_order.type,
+                      incoming_order.remaining_quantity, incoming_order.price, incoming_order.action,
+                      incoming_order.status, match_qty, match_price, resting_order.order_id);
+    };
+    auto emit_resting = [&]() {
+        addFillRecord(fills_batch, event_timestamp, resting_order.order_id, resting_order.side, resting_order.type,
+                      resting_order.remaining_quantity, resting_info.price, resting_order.action,
+                      resting_order.status, match_qty, match_price, incoming_order.order_id);
+    };
+    if (incoming_reported_first) {
+        emit_incoming();
+        emit_resting();
+    } else {
+        emit_resting();
+        emit_incoming();
+    }
+}
+
+// Walk the opposite side from the best price, and consume the queue of each level in a tight loop.
+// Returns the number of fills.
+// The match price and the order of the two output records follow the reference book:
+// - MARKET orders trade at the resting price, and the market order is reported first
+// - LIMIT orders trade at the price of the order that arrived first (the bid price on a tie),
+//   and the buy side is reported first
+size_t LadderOrderBook::sweep(Order& incoming_order, bool is_market, unsigned long long event_timestamp) {
+    const bool incoming_is_buy = (incoming_order.side == Side::BUY);
+    size_t fills = 0;
+    FillBatch fills_batch; // the records of the fills, pushed to the output together at the end
+
+    while (incoming_is_buy ? has_asks_ : has_bids_) {
+        const long long level_ticks = incoming_is_buy ? best_ask_ticks_ : best_bid_ticks_;
+        // a LIMIT order stops as soon as the best opposite price does not cross its limit
+        if (!is_market) {
+            if (incoming_is_buy ? (level_ticks > incoming_order.price_ticks) : (level_ticks < incoming_order.price_ticks)) {
+                break;
+            }
+        }
+
+        Level& level = levelAt(level_ticks);
+        touchLevel(incoming_is_buy ? Side::SELL : Side::BUY, level_ticks, pool_.cold(level.head).price);
+        while (level.head != kNoSlot) {
+            const uint32_t resting_slot = level.head;
+            const RestingOrder& resting_order = pool_.hot(resting_slot);
+            RestingOrderInfo& resting_info = pool_.cold(resting_slot);
+
+            // self-trade prevention: the two orders of one account do not trade
+            if (isSelfTrade(incoming_order.account_id, resting_info.account_id)) {
+                self_trades_prevented_++;
+                if (self_trade_prevention_ != SelfTradePrevention::CANCEL_INCOMING) {
+                    addFillRecord(fills_batch, event_timestamp, resting_order.order_id, resting_order.side,
+                                  resting_order.type, 0, 0.0, resting_order.action, OrderStatus::CANCELED, 0, 0.0, 0);
+                    order_index_.erase_if_slot(resting_order.order_id, resting_slot);
+                    unlinkSlot(resting_slot);
+                    pool_.release(resting_slot);
+                }
+                if (self_trade_prevention_ != SelfTradePrevention::CANCEL_RESTING) {
+                    self_trade_stopped_ = true; // the caller cancels the rest of the incoming order
+                    break;
+                }
+                continue;
+            }
+
+            double match_price;
+            if (is_market) {
+                match_price = resting_info.price;
+            } else if (incoming_is_buy) {
+                match_price = (resting_info.timestamp < incoming_order.timestamp) ? resting_info.price : incoming_order.price;
+            } else {
+                match_price = (incoming_order.timestamp < resting_info.timestamp) ? incoming_order.price : resting_info.price;
+            }
+            // only the shown part of a resting iceberg trades (the whole order for the others)
+            unsigned long long match_qty = std::min(incoming_order.remaining_quantity,
+                                                    resting_order.remaining_quantity - resting_info.hidden_quantity);
+
+            recordFill(incoming_order, resting_slot, match_qty, match_price, is_market || incoming_is_buy, event_timestamp,
+                       fills_batch);
+            level.total_quantity -= match_qty;
+            fills++;
+
+            // the resting order is fully executed: it leaves the book
+            if (resting_order.remaining_quantity == 0) {
+                order_index_.erase_if_slot(resting_order.order_id, resting_slot);
+                unlinkSlot(resting_slot);
+                pool_.release(resting_slot);
+            } else if (resting_order.remaining_quantity == resting_info.hidden_quantity) {
+                // an iceberg showed all it had: the next slice goes to the back of the level
+                level.hidden_quantity -= refillIcebergSlice(resting_info.display_quantity, resting_info.hidden_quantity);
+                moveSlotToBack(level, resting_slot);
+            }
+            if (incoming_order.remaining_quantity == 0) {
+                break;
+            }
+        }
+
+        if (level.head == kNoSlot) {
+            if (incoming_is_buy) {
+                advanceBestAsk();
+            } else {
+                advanceBestBid();
+            }
+        }
+        if (incoming_order.remaining_quantity == 0 || self_trade_stopped_) {
+            break;
+        }
+    }
+    flushFillBatch(fills_batch);
+    return fills;
+}
+
+void LadderOrderBook::processSingleOrder(Order& incoming_order_request) {
+    unsigned long long current_event_timestamp = incoming_order_request.timestamp;
+
+    // check if the order arriving is for the correct instrument of the book
+    if (incoming_order_request.symbol_id != symbol_id_) {
+        std::cerr << "Error: Order " << incoming_order_request.order_id << " for symbol id " << incoming_order_request.symbol_id
+                  << " sent to OrderBook for " << instrument_name_ << std::endl;
+        addInitialOutputRecord(incoming_order_request, OrderStatus::REJECTED, 0, 0.0, 0, current_event_timestamp);
+        return;
+    }
+
+    // a LIMIT price must fit in the ladder
+    if (incoming_order_request.type == OrderType::LIMIT && incoming_order_request.action != OrderAction::CANCEL
+        && !reserveLevel(incoming_order_request.price_ticks)) {
+        std::cerr << "Error: Order " << incoming_order_request.order_id << " price " << incoming_order_request.price
+                  << " is too far from the other prices of the ladder book for " << instrument_name_ << std::endl;
+        addInitialOutputRecord(incoming_order_request, OrderStatus::REJECTED, 0, 0.0, 0, current_event_timestamp);
+        return;
+    }
+
+    // if the order is NEW, initialize the remaining quantity and cumulative executed quantity
+    if (incoming_order_request.action == OrderAction::NEW) {
+        incoming_order_request.remaining_quantity = incoming_order_request.quantity;
+        incoming_order_request.cumulative_executed_quantity = 0;
+        incoming_order_request.status = OrderStatus::PENDING;
+    }
+
+    if (incoming_order_request.action == OrderAction::NEW) {
+        Order& order_to_process = incoming_order_request;
+        if (order_to_process.type == OrderType::LIMIT) {
+            // a post-only order that would trade, or a FOK order that cannot trade completely, is only rejected
+            if (!passesEntryChecks(order_to_process, false)) {
+                addInitialOutputRecord(order_to_process, OrderStatus::REJECTED, 0, 0.0, 0, current_event_timestamp);
+                return;
+            }
+            addInitialOutputRecord(order_to_process, OrderStatus::PENDING, 0, 0.0, 0, current_event_timestamp);
+            // match first, then rest what is left.
+            // (an order that crossed but has nothing left, e.g. a zero quantity, does not rest)
+            size_t fills = sweep(order_to_process, false, current_event_timestamp);
+            if (order_to_process.time_in_force != TimeInForce::GTC || self_trade_stopped_) {
+                // IOC and FOK never rest, nor an order stopped by the self-trade prevention
+                expireUnfilledRest(order_to_process, current_event_timestamp);
+            } else if (order_to_process.remaining_quantity > 0 || fills == 0) {
+                startIcebergSlice(order_to_process);
+                restOrder(order_to_process);
+            }
+
+        } else if (order_to_process.type == OrderType::MARKET) {
+            unsigned long long initial_market_order_qty = order_to_process.remaining_quantity;
+            // (a FOK market order that cannot trade completely does not trade, and is rejected below)
+            if (order_to_process.remaining_quantity > 0 && passesEntryChecks(order_to_process, true)) {
+                sweep(order_to_process, true, current_event_timestamp);
+            }
+            // if the market order has not been able to execute any quantity, we reject it
+            // (unless the self-trade prevention stopped it: its rest is canceled)
+            if (self_trade_stopped_) {
+                expireUnfilledRest(order_to_process, current_event_timestamp);
+            } else if (order_to_process.cumulative_executed_quantity == 0 && initial_market_order_qty > 0) {
+                addInitialOutputRecord(order_to_process, OrderStatus::REJECTED, 0, 0.0, 0, current_event_timestamp);
+            }
+        }
+
+    } else if (incoming_order_request.action == OrderAction::MODIFY) {
+        Order modified_order;
+        if (!removeRestingOrder(incoming_order_request.order_id, modified_order)) {
+            addInitialOutputRecord(incoming_order_request, OrderStatus::REJECTED, 0, 0.0, 0, current_event_timestamp);
+            return;
+        }
+
+        modified_order.timestamp = current_event_timestamp; // Use MODIFY event's timestamp
+        modified_order.price = incoming_order_request.price;
+        modified_order.price_ticks = incoming_order_request.price_ticks;
+        modified_order.quantity = incoming_order_request.quantity;
+        modified_order.action = OrderAction::MODIFY;
+        modified_order.type = incoming_order_request.type;
+        modified_order.time_in_force = incoming_order_request.time_in_force;
+        modified_order.post_only = incoming_order_request.post_only;
+        modified_order.display_quantity = incoming_order_request.display_quantity;
+        modified_order.hidden_quantity = 0; // the whole rest of the order can trade before it rests again
+
+        // the new quantity is already executed: nothing goes back to the book
+        if (modified_order.quantity <= modified_order.cumulative_executed_quantity) {
+            modified_order.remaining_quantity = 0;
+            modified_order.status = OrderStatus::EXECUTED;
+            if (modified_order.cumulative_executed_quantity == 0 && modified_order.quantity == 0) {
+                modified_order.status = OrderStatus::CANCELED;
+            }
+            addInitialOutputRecord(modified_order, modified_order.status, 0, 0.0, 0, current_event_timestamp);
+        } else {
+            modified_order.remaining_quantity = modified_order.quantity - modified_order.cumulative_executed_quantity;
+            modified_order.status = OrderStatus::PENDING;
+
+            if (modified_order.type == OrderType::LIMIT) {
+                // the order is already out of the book: a post-only MODIFY that would trade, or a FOK MODIFY
+                // that cannot trade completely, leaves it out (like a MODIFY to MARKET with no liquidity)
+                if (!passesEntryChecks(modified_order, false)) {
+                    addInitialOutputRecord(modified_order, OrderStatus::REJECTED, 0, 0.0, 0, current_event_timestamp);
+                    return;
+                }
+                size_t fills = sweep(modified_order, false, current_event_timestamp);
+                if (modified_order.time_in_force != TimeInForce::GTC || self_trade_stopped_) {
+                    expireUnfilledRest(modified_order, current_event_timestamp);
+                } else if (modified_order.remaining_quantity > 0) {
+                    startIcebergSlice(modified_order);
+                    restOrder(modified_order);
+                    // only report the resting order if it did not trade right away
+                    if (fills == 0) {
+                        addInitialOutputRecord(modified_order, modified_order.status, 0, 0.0, 0, current_event_timestamp);
+                    }
+                }
+            } else if (modified_order.type == OrderType::MARKET) {
+                unsigned long long initial_mod_market_qty = modified_order.remaining_quantity;
+                unsigned long long cum_exec_before_market_sweep = modified_order.cumulative_executed_quantity;
+                if (passesEntryChecks(modified_order, true)) {
+                    sweep(modified_order, true, current_event_timestamp);
+                }
+                if (self_trade_stopped_) {
+                    expireUnfilledRest(modified_order, current_event_timestamp);
+                } else if (modified_order.cumulative_executed_quantity == cum_exec_before_market_sweep && initial_mod_market_qty > 0) {
+                    addInitialOutputRecord(modified_order, OrderStatus::REJECTED, 0, 0.0, 0, current_event_timestamp);
+                }
+            }
+        }
+
+    } else if (incoming_order_request.action == OrderAction::CANCEL) {
+        Order order_being_cancelled_data;
+        if (removeRestingOrder(incoming_order_request.order_id, order_being_cancelled_data)) {
+            order_being_cancelled_data.timestamp = current_event_timestamp;
+            order_being_cancelled_data.action = OrderAction::CANCEL;
+            addInitialOutputRecord(order_being_cancelled_data, OrderStatus::CANCELED, 0, 0.0, 0, current_event_timestamp);
+        } else {
+            addInitialOutputRecord(incoming_order_request, OrderStatus::REJECTED, 0, 0.0, 0, current_event_timestamp);
+        }
+
+    } else {
+        std::cerr << "Warning: Unknown order action for order_id " << incoming_order_request.order_id << std::endl;
+        addInitialOutputRecord(incoming_order_request, OrderStatus::REJECTED, 0, 0.0, 0, current_event_timestamp);
+    }
+}
+
+// every non-empty level has its bit in the occupancy bitmap
+size_t LadderOrderBook::getLevelCount() const {
+    size_t level_count = 0;
+    for (uint64_t word : occupied_words_) {
+        level_count += static_cast<size_t>(__builtin_popcountll(word));
+    }
+    return level_count;
+}
+
+// the pool of the orders, and the ladder (every tick of its span has a level, empty or not) with its bitmaps
+BookMemoryStats LadderOrderBook::getMemoryStats() const {
+    BookMemoryStats memory;
+    memory.resting_orders = pool_.in_use();
+    memory.levels = getLevelCount();
+    memory.pool_bytes = pool_.bytes();
+    memory.pool_used_bytes = pool_.used_bytes();
+    memory.other_bytes = levels_.capacity() * sizeof(Level) +
+                         (occupied_words_.capacity() + occupied_summary_.capacity()) * sizeof(uint64_t) +
+                         order_index_.bytes();
+    return memory;
+}
+
+// bids from the best bid down, then asks from the best ask up, each level from its head (the oldest order)
+void LadderOrderBook::collectRestingOrders(std::vector<Order>& out) const {
+    auto collect_level = [&](size_t level_index) {
+        for (uint32_t slot = levels_[level_index].head; slot != kNoSlot; slot = pool_.hot(slot).next) {
+            out.emplace_back();
+            expandSlot(slot, out.back());
+        }
+    };
+    if (has_bids_) {
+        for (size_t level_index = static_cast<size_t>(best_bid_ticks_ - base_ticks_); level_index != kNoLevel;
+             level_index = (level_index == 0) ? kNoLevel : prevOccupiedLevel(level_index - 1)) {
+            collect_level(level_index);
+        }
+    }
+    if (has_asks_) {
+        for (size_t level_index = static_cast<size_t>(best_ask_ticks_ - base_ticks_); level_index != kNoLevel;
+             level_index = nextOccupiedLevel(level_index + 1)) {
+            collect_level(level_index);
+        }
+    }
+}
+
+bool LadderOrderBook::restoreRestingOrder(const Order& order) {
+    if (!reserveLevel(order.price_ticks)) {
+        return false;
+    }
+    restOrder(order);
+    return true;
+}
+
+// a level of the ladder is a price in ticks; the bids and the asks share the array,
+// so the level belongs to the side of its orders
+void LadderOrderBook::readLevel(LevelState& level) const {
+    if (levels_.empty() || level.key < base_ticks_ || level.key >= base_ticks_ + static_cast<long long>(levels_.size())) {
+        return;
+    }
+    const Level& ladder_level = levels_[static_cast<size_t>(level.key - base_ticks_)];
+    if (ladder_level.head != kNoSlot && pool_.hot(ladder_level.head).side == level.side) {
+        level.quantity = ladder_level.total_quantity - ladder_level.hidden_quantity;
+        level.order_count = ladder_level.order_count;
+    }
+}
+
+// the price of a non-empty level is the price of its oldest order
+LadderOrderBook::LevelState LadderOrderBook::levelState(Side side, size_t level_index) const {
+    const Level& level = levels_[level_index];
+    return LevelState{side, base_ticks_ + static_cast<long long>(level_index), pool_.cold(level.head).price,
+                      level.total_quantity - level.hidden_quantity, level.order_count};
+}
+
+void LadderOrderBook::readBestLevels(LevelState& best_bid, LevelState& best_ask) const {
+    if (has_bids_) {
+        best_bid = levelState(Side::BUY, static_cast<size_t>(best_bid_ticks_ - base_ticks_));
+    }
+    if (has_asks_) {
+        best_ask = levelState(Side::SELL, static_cast<size_t>(best_ask_ticks_ - base_ticks_));
+    }
+}
+
+void LadderOrderBook::collectLevels(std::vector<LevelState>& out) const {
+    if (has_bids_) {
+        for (size_t level_index = static_cast<size_t>(best_bid_ticks_ - base_ticks_); level_index != kNoLevel;
+             level_index = (level_index == 0) ? kNoLevel : prevOccupiedLevel(level_index - 1)) {
+            out.push_back(levelState(Side::BUY, level_index));
+        }
+    }
+    if (has_asks_) {
+        for (size_t level_index = static_cast<size_t>(best_ask_ticks_ - base_ticks_); level_index != kNoLevel;
+             level_index = nextOccupiedLevel(level_index + 1)) {
+            out.push_back(levelState(Side::SELL, level_index));
+        }
+    }
+}
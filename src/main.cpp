@@ -1,7 +1,7 @@
 #include "app_config.hpp" 
 #include "logger.hpp"
 #include "order.hpp"      // For Order struct, readOrdersFromStream, enums, and toString helpers
-#include "orderbook.hpp" // For OrderBook class and OutputRecord struct
+#include "orderbook.hpp" // For OrderBook class and ExecutionReport struct
 #include "thread_safe_queue.hpp" 
 #include <thread>
 #include <iostream>       // For std::cerr, std::cout
@@ -10,10 +10,28 @@
 #include <map>
 #include <string>
 #include <algorithm>      // For std::stable_sort
-#include "main.hpp"
+#include "pipeline_stats.hpp"
+#include "symbol_table.hpp"
+#include "worker_pool.hpp"
+#include "output_merger.hpp"
+#include "csv_mmap_reader.hpp"
+#include "report_writer.hpp"
+#include "binary_format.hpp"
+#include "book_snapshot.hpp"
+#include "journal.hpp"
+#include "gateway.hpp"
+#include "shard.hpp"
+#include "pool_memory.hpp"
+#include "csv_simd.hpp"
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 
-
+// capacities of the rings between the stages of the pipeline (rounded up to a power of two)
+constexpr size_t kReaderQueueCapacity = 1 << 17;  // reader -> dispatcher
+constexpr size_t kDispatchBatchSize = 256;        // orders taken from the reader ring at once
+constexpr size_t kWriterBatchSize = 256;          // output records taken from the output merger at once
 
 int main(int argc, char* argv[]) {
     AppConfig config("A matching engine for the stock market");
@@ -28,146 +46,473 @@ int main(int argc, char* argv[]) {
     // Configure log level (the level of infos from error we want to see)
     LogLevel log_level = string_to_level(config.get_log_level());
     logger.set_level(log_level); 
+    if (log_level < kCompiledMinLogLevel) {
+        logger.warn("Log level", config.get_log_level(), "is below the level compiled in:",
+                    std::string(level_to_string(kCompiledMinLogLevel)) + ",", "configure with -DENGINE_MIN_LOG_LEVEL=" +
+                    std::string(level_to_string(log_level)), "to get these messages");
+    }
+    // with the gateway, SIGINT / SIGTERM stop the input cleanly: they are blocked in every thread
+    // (so this has to come before the first thread is started) and read by the gateway
+    if (config.is_gateway_enabled()) {
+        std::string signal_error;
+        if (!OrderGateway::blockStopSignals(signal_error)) {
+            logger.critical("Cannot block the stop signals: ", signal_error);
+            return 1;
+        }
+    }
+    // from here the log calls of every thread only push records, a background thread writes the lines
+    logger.set_async(config.is_async_logging());
 
 
     logger.info("Configuration loaded successfully:");
     logger.info("  Log Level:       ", config.get_log_level());
+    logger.info("  Log Mode:        ", config.is_async_logging() ? "async" : "sync");
     logger.info("  Input File:      ", config.get_order_input_file());
     logger.info("  Output File:     ", config.get_order_result_output_file());
     logger.info("  Queue Size:      ", config.get_queue_size());
+    logger.info("  Book Type:       ", config.get_book_type());
+    logger.info("  Book Memory:     ", config.get_book_memory());
+    logger.info("  Tick Size:       ", config.get_tick_size());
+    logger.info("  Input Mode:      ", config.get_input_mode());
+    // parsers created from now on use the selected tokenizer (a level the cpu cannot run is lowered)
+    if (config.get_csv_simd() != "auto") {
+        csv_simd::Level csv_level = csv_simd::Level::SCALAR;
+        csv_simd::parseLevel(config.get_csv_simd(), csv_level);
+        csv_simd::setActiveLevel(csv_level);
+    }
+    logger.info("  CSV Tokenizer:   ", csv_simd::levelToString(csv_simd::activeLevel()));
+    logger.info("  Reader Threads:  ", config.get_reader_threads());
+    logger.info("  Input Format:    ", config.get_input_format());
+    logger.info("  Output Format:   ", config.get_output_format());
+    logger.info("  Output I/O:      ", config.get_output_io() + (config.is_output_direct() ? ", O_DIRECT" : ""));
+    logger.info("  Wait Strategy:   ", waitStrategyTypeToString(config.get_wait_strategy()));
+    logger.info("  Workers:         ", config.get_worker_count() == 0 ? std::string("one per core") : std::to_string(config.get_worker_count()));
+    if (!config.get_shards().empty()) {
+        logger.info("  Shards:          ", config.get_shards().size(), "matching processes (the local workers are not used)");
+    }
+    if (!config.get_shard_listen().empty()) {
+        logger.info("  Shard Listen:    ", config.get_shard_listen());
+    }
+    logger.info("  Stats Interval:  ", config.get_stats_interval() == 0 ? std::string("final summary only") : std::to_string(config.get_stats_interval()) + " ms");
+    if (!config.get_snapshot_in().empty()) {
+        logger.info("  Snapshot In:     ", config.get_snapshot_in());
+    }
+    if (!config.get_snapshot_out().empty()) {
+        logger.info("  Snapshot Out:    ", config.get_snapshot_out(),
+                    config.get_snapshot_every() == 0 ? std::string("(at the end)")
+                                                     : "(every " + std::to_string(config.get_snapshot_every()) + " orders)");
+    }
+    if (!config.get_market_data().empty()) {
+        logger.info("  Market Data:     ", config.get_market_data(),
+                    config.get_market_data_snapshot_every() == 0 ? std::string("(no depth snapshots)")
+                        : "(depth snapshot every " + std::to_string(config.get_market_data_snapshot_every()) + " orders of a book)");
+    }
+    if (config.is_gateway_enabled()) {
+        std::string gateway_description = "TCP port " + std::to_string(config.get_gateway_tcp_port()) +
+                                          ", UDP port " + std::to_string(config.get_gateway_udp_port());
+        if (!config.get_gateway_multicast().empty()) {
+            gateway_description += " (multicast " + config.get_gateway_multicast() + ")";
+        }
+        logger.info("  Gateway:         ", gateway_description + " on " + config.get_gateway_address());
+    }
+    if (!config.get_journal().empty()) {
+        logger.info("  Journal:         ", config.get_journal(),
+                    "(group commit within " + std::to_string(config.get_journal_commit_us()) + " us)");
+    }
+
+    // tick sizes used to convert the prices into integer ticks while parsing
+    TickSizeTable tick_sizes(config.get_tick_size());
+    if (!tick_sizes.parse_overrides(config.get_tick_size_overrides(), logger)) {
+        logger.critical("Invalid --tick-size-overrides value: ", config.get_tick_size_overrides());
+        return 1;
+    }
+
+    // limits of the pre-trade checks, read once and shared (read only) by every book
+    std::shared_ptr<RiskConfig> risk_config;
+    if (config.is_risk_enabled() || config.get_self_trade_prevention() != "none") {
+        risk_config = std::make_shared<RiskConfig>();
+        risk_config->setMaxAccounts(config.get_risk_max_accounts());
+        risk_config->parseSelfTradePrevention(config.get_self_trade_prevention());
+        if (!config.get_risk_limits().empty() && !risk_config->parseLimits(config.get_risk_limits(), logger)) {
+            logger.critical("Invalid --risk-limits value: ", config.get_risk_limits());
+            return 1;
+        }
+        if (!config.get_risk_account_limits().empty() &&
+            !risk_config->loadAccountLimits(config.get_risk_account_limits(), logger)) {
+            logger.critical("Failed to load the account limits: ", config.get_risk_account_limits());
+            return 1;
+        }
+        logger.info("  Risk Checks:     ", risk_config->checks_enabled
+                        ? "limits of " + std::to_string(risk_config->maxAccounts()) + " accounts" +
+                              (config.get_risk_limits().empty() ? std::string() : " (defaults " + config.get_risk_limits() + ")")
+                        : std::string("off"),
+                    "self-trade prevention", selfTradePreventionToString(risk_config->self_trade_prevention));
+    }
+
+    // before the first book: its pools take their blocks in the selected memory
+    pool_memory::setHugePages(config.get_book_memory() == "huge-pages");
 
+    // matching process of a sharded engine: the orders come from its front-end and the reports go back to it,
+    // there is no input or output file here (see shard.hpp)
+    if (!config.get_shard_listen().empty()) {
+        ShardServerConfig shard_config;
+        shard_config.endpoint = config.get_shard_listen();
+        shard_config.book_type = config.get_book_type();
+        shard_config.wait_strategy = config.get_wait_strategy();
+        shard_config.cpu = config.get_worker_cpus().empty() ? -1 : config.get_worker_cpus().front();
+        shard_config.risk_config = risk_config;
+        if (!runShardServer(shard_config, logger)) {
+            return 1;
+        }
+        logger.info("Matching engine shard completed successfully.");
+        return 0;
+    }
+    const bool sharded = !config.get_shards().empty();
+    if (sharded && risk_config) {
+        logger.warn("The risk checks run in the books: give --risk-limits / --self-trade-prevention to the matching processes.");
+    }
 
     //Read all orders from the input CSV file
     std::vector<Order> all_input_orders;
     // open the input file stream
     std::ifstream input_file_stream(config.get_order_input_file());
 
-    if (!input_file_stream.is_open()) {
+    if (!input_file_stream.is_open() && !config.is_gateway_enabled()) {
         logger.critical("Failed to open input order file: ", config.get_order_input_file());
         return 1; // Critical error, stop the program
     }
 
+    // instrument names are interned once by the reader; orders and books only carry the small symbol id
+    SymbolTable symbols;
+
+    // the output file is opened before any thread is started, so a bad path stops the program cleanly.
+    // The execution reports are formatted only by this writer (see report_writer.hpp),
+    // or stored as fixed-width records with --output-format binary (see binary_format.hpp)
+    // latency histograms and counters of every stage (see pipeline_stats.hpp), summarized at the end
+    PipelineStats pipeline_stats;
+
+    // The CSV files are written from double buffers by a background thread or io_uring with --output-io
+    // (see output_file.hpp); the binary output keeps its plain write() (its header is written last, at the start)
+    OutputFileOptions output_options;
+    parseOutputIo(config.get_output_io(), output_options.io);
+    output_options.direct = config.is_output_direct();
+    output_options.stats = &pipeline_stats.output;
+    ReportWriter report_writer(symbols);
+    BinaryReportWriter binary_report_writer(symbols);
+    const bool binary_output = config.get_output_format() == "binary";
+    std::string output_error;
+    bool output_opened = binary_output ? binary_report_writer.open(config.get_order_result_output_file(), output_error)
+                                       : report_writer.open(config.get_order_result_output_file(), output_error, output_options);
+    if (!output_opened) {
+        logger.critical("Failed to open output order result file: ", config.get_order_result_output_file(),
+                        " (", output_error, ")");
+        return 1; // error
+    }
+    if (!binary_output && report_writer.getFile().io() != output_options.io) {
+        logger.warn("io_uring cannot be used for the output file, it is written by a pwrite thread.");
+    }
+    if (!binary_output && output_options.direct && !report_writer.getFile().direct()) {
+        logger.warn("The file system of the output file refuses O_DIRECT, it goes through the page cache.");
+    }
+    // level 2 market data of the books: the updates come through the output merger with the reports
+    // (see market_data.hpp), and only this writer turns them into text
+    const bool market_data = !config.get_market_data().empty();
+    MarketDataWriter market_data_writer(symbols);
+    OutputFileOptions market_data_options = output_options;
+    market_data_options.stats = nullptr; // the throughput of the summary is the one of the reports
+    if (market_data && !market_data_writer.open(config.get_market_data(), output_error, market_data_options)) {
+        logger.critical("Failed to open the market data file: ", config.get_market_data(), " (", output_error, ")");
+        return 1;
+    }
+
     //To have a thread safe queue wich means that multiple threads can work together
     // without stealing each other's tasks
-    ThreadSafeQueue<Order> order_queue;
+    // (a lock-free ring: the reader is the only producer and the dispatcher the only consumer)
+    OrderQueue order_queue(kReaderQueueCapacity, config.get_wait_strategy());
 
     // readOrdersFromStream is defined in order.cpp and declared in order.hpp
+    // readOrdersFromMappedFile is defined in csv_mmap_reader.cpp
+
+    // Order Book Management and Processing Loop
+    // fixed pool of matching threads, each owning the books of the instruments sharded onto it
+    // and an output ring for their execution reports
+    // (with --shards the books are in other processes: the pool stays empty and is never started)
+    WorkerPool worker_pool(sharded ? 1 : config.get_worker_count(), config.get_book_type(), symbols,
+                           config.get_wait_strategy(), config.get_worker_cpus(), logger);
+    if (market_data) {
+        worker_pool.enableMarketData(config.get_market_data_snapshot_every());
+    }
+    if (risk_config) {
+        worker_pool.enableRiskChecks(risk_config);
+    }
+
+    // warm restart: the books come back from the snapshot (before any thread runs, so its instruments
+    // get the first symbol ids), and the input orders it already contains are skipped by the dispatcher
+    uint64_t resume_offset = 0;
+    if (!config.get_snapshot_in().empty() &&
+        !loadBookSnapshot(config.get_snapshot_in(), worker_pool, tick_sizes, symbols, resume_offset, logger)) {
+        logger.critical("Failed to load the book snapshot: ", config.get_snapshot_in());
+        return 1;
+    }
+    if (config.is_gateway_enabled() && resume_offset > 0) {
+        // the orders of the clients are new ones: nothing to skip
+        logger.info("The gateway does not skip the ", resume_offset, " input orders of the snapshot, only its books are used.");
+        resume_offset = 0;
+    }
+
+    // front-end of a sharded engine: the orders are routed to the matching processes of --shards
+    ShardRouter shard_router(config.get_shards(), symbols, config.get_wait_strategy(), logger);
+    if (sharded) {
+        std::string shard_error;
+        if (!shard_router.connect(market_data, config.get_market_data_snapshot_every(), shard_error)) {
+            logger.critical("Failed to connect to the shards: ", shard_error);
+            return 1;
+        }
+    }
+
+    const uint64_t pipeline_start_ns = statsNowNs();
 
+    // write-ahead journal (--journal): a stage between the reader and the dispatcher, an order is only
+    // matched once it is on disk. The orders journaled by an earlier run are read back here: the ones after
+    // the snapshot offset are replayed first, then the journal takes the input where its records end
+    const bool journaling = !config.get_journal().empty();
+    OrderJournal journal(logger, &pipeline_stats);
+    std::vector<Order> journal_replay;
+    if (journaling) {
+        std::string journal_error;
+        if (!journal.open(config.get_journal(), symbols, tick_sizes, journal_replay, journal_error)) {
+            logger.critical("Failed to open the journal ", config.get_journal(), ": ", journal_error);
+            return 1;
+        }
+        const size_t journaled = journal_replay.size();
+        journal_replay.erase(std::remove_if(journal_replay.begin(), journal_replay.end(),
+                                            [&](const Order& order) { return order.sequence < resume_offset; }),
+                             journal_replay.end());
+        logger.info("Journal ", config.get_journal(), " holds ", journaled, " orders, ", journal_replay.size(),
+                    " of them are replayed (input position ", journal.nextSequence(), " reached)");
+    }
+    // live input from the network (--gateway-tcp / --gateway-udp), in the place of the file reader
+    OrderGateway gateway(symbols, tick_sizes, logger);
+    if (config.is_gateway_enabled()) {
+        GatewayConfig gateway_config;
+        gateway_config.tcp_port = config.get_gateway_tcp_port();
+        gateway_config.udp_port = config.get_gateway_udp_port();
+        gateway_config.multicast_group = config.get_gateway_multicast();
+        gateway_config.bind_address = config.get_gateway_address();
+        std::string gateway_error;
+        if (!gateway.open(gateway_config, gateway_error)) {
+            logger.critical("Failed to open the gateway: ", gateway_error);
+            return 1;
+        }
+    }
 
-    std::atomic<bool> is_done_reading(false); // To signal when reading is done
+    // journaled orders, journal -> dispatcher (unused without a journal)
+    OrderQueue journaled_queue(journaling ? kReaderQueueCapacity : 2, config.get_wait_strategy());
 
     std::thread read_fromfile_thread(
         [&]() {
-                auto timer = TimingManager::ScopedTimer(
-                "Time reading from CSV", 
-                logger
-            );
-    
-           readOrdersFromStream(input_file_stream, logger, order_queue, 
-                             100000); // Pass the queue size from config
+            if (config.is_gateway_enabled()) {
+                // until SIGINT / SIGTERM, then the gateway sends the last reports (it closes order_queue)
+                gateway.run(order_queue);
+                return;
+            }
+            if (config.get_input_format() == "binary") {
+                // fixed-width records, nothing to parse (see binary_format.hpp)
+                if (!readOrdersFromBinaryFile(config.get_order_input_file(), logger, order_queue, tick_sizes, symbols,
+                                              &pipeline_stats.parse)) {
+                    logger.critical("No order could be read from the binary input file.");
+                }
+                input_file_stream.close();
+                order_queue.close(); // Signal that reading is done
+                return;
+            }
+            // the memory-mapped parser is used when possible, the stream parser otherwise
+            bool done_with_mmap = config.get_input_mode() == "mmap"
+                && readOrdersFromMappedFile(config.get_order_input_file(), logger, order_queue, tick_sizes, symbols,
+                                            config.get_reader_threads(), &pipeline_stats.parse);
+            if (!done_with_mmap) {
+                if (config.get_input_mode() == "mmap") {
+                    logger.warn("Falling back to the stream reader.");
+                }
+                if (config.get_reader_threads() > 1) {
+                    logger.warn("--reader-threads is ignored by the stream reader, it reads with one thread.");
+                }
+                readOrdersFromStream(input_file_stream, logger, order_queue, 
+                                 tick_sizes, symbols, &pipeline_stats.parse); // the queue is bounded by its capacity
+            }
             input_file_stream.close();
-            is_done_reading= true; // Signal that reading is done
+            order_queue.close(); // Signal that reading is done
         }
     );
 
     
 
-    // Order Book Management and Processing Loop
-    //  Map instrument name to its OrderBook instance
-    std::map<std::string, OrderBook> order_books; 
-    std::shared_ptr<ThreadSafeQueue<std::string>> output_log_queue; // log output records in a thread-safe manner
+    bool journal_ok = true;
+    std::thread journal_thread;
+    if (journaling) {
+        journal_thread = std::thread([&]() {
+            // the input orders already in the snapshot or in the journal are not journaled again
+            journal_ok = journal.run(order_queue, journaled_queue, journal_replay,
+                                     std::max<uint64_t>(resume_offset, journal.nextSequence()),
+                                     std::chrono::microseconds(config.get_journal_commit_us()));
+        });
+    }
 
-    output_log_queue = std::make_shared<ThreadSafeQueue<std::string>>(); // Initialize the output log queue
+    if (sharded) {
+        shard_router.start();
+        logger.info("Matching in ", shard_router.size(), " shard processes.");
+    } else {
+        worker_pool.start();
+        logger.info("Started ", worker_pool.size(), " matching workers.");
+    }
     
-    std::atomic<bool> is_done_launching_jobs(false); // To signal when processing is done
+    // position in the input of the next order (the orders of a loaded snapshot included),
+    // written by the dispatcher and read once it is joined
+    uint64_t input_position = 0;
     std::thread launch_work_thread([&]() {
-    auto timer = TimingManager::ScopedTimer(
-                "Time Starting order processing threads for all instruments", 
-                logger
-            );
-    
-    while (!is_done_reading || order_queue.size() != 0) {
-        // Process orders from the queue
-        if (order_queue.size() == 0) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1)); // Avoid busy-waiting
-            continue;
-        }
-      Order order_request = order_queue.pop(); // Pop from the thread-safe queue
-    // Pass by reference as OrderBook::addOrder takes Order&
-        logger.debug("Processing incoming order request: ID=", order_request.order_id, 
-                    ", Instrument=", order_request.instrument,
-                    ", Action=", orderActionToString(order_request.action),
-                    ", Type=", orderTypeToString(order_request.type), 
-                    ", Side=", sideToString(order_request.side),       
-                    ", Qty=", order_request.quantity, 
-                    ", Price=", order_request.price);
-        
-        // Find or create the OrderBook for the order's instrument
-        if (order_books.find(order_request.instrument) == order_books.end()) {
-            logger.debug("Creating new order book for instrument: ", order_request.instrument);
-            // Emplace a new OrderBook for this instrument
-            order_books.emplace(std::piecewise_construct,
-                                std::forward_as_tuple(order_request.instrument),
-                                std::forward_as_tuple(order_request.instrument));
-            order_books.at(order_request.instrument).set_output_log_queue(output_log_queue);
-            order_books.at(order_request.instrument).startProcessingThread(); // Start processing thread for this book
+    // orders are taken from the reader ring by batches, then staged per worker and pushed
+    // to each worker ring in batches too (one ring operation per batch instead of per order)
+    std::vector<Order> dispatch_batch(kDispatchBatchSize);
+    // pop_batch waits for orders, and returns 0 once the reader closed the queue and it is drained
+    size_t batch_size;
+    BatchTimer dispatch_timer(&pipeline_stats.dispatch);
+    const uint64_t snapshot_every = config.get_snapshot_every();
+    uint64_t next_snapshot = resume_offset + snapshot_every;
+    OrderQueue& dispatch_queue = journaling ? journaled_queue : order_queue;
+    while ((batch_size = dispatch_queue.pop_batch(dispatch_batch.data(), dispatch_batch.size())) > 0) {
+      dispatch_timer.start();
+      for (size_t i = 0; i < batch_size; ++i) {
+        Order& order_request = dispatch_batch[i];
+        // the journal gives the input position of each order (it drops or replays some), otherwise they are counted
+        const uint64_t position = journaling ? order_request.sequence : input_position;
+        input_position = position + 1;
+        // already in the books of the snapshot
+        if (position < resume_offset) {
+          continue;
         }
+        // a macro: without debug logging the arguments are not even evaluated
+        LOG_DEBUG(logger, "Processing incoming order request: ID=", order_request.order_id, 
+                  ", Instrument=", symbols.name(order_request.symbol_id),
+                  ", Action=", orderActionToString(order_request.action),
+                  ", Type=", orderTypeToString(order_request.type), 
+                  ", Side=", sideToString(order_request.side),       
+                  ", Qty=", order_request.quantity, 
+                  ", Price=", order_request.price);
         
-        OrderBook& current_book = order_books.at(order_request.instrument);
-        current_book.addOrder(order_request); // This method processes the order and generates OutputRecords
+        // the worker creates the book of the instrument the first time it sees it
+        if (sharded) {
+          shard_router.dispatch(order_request);
+        } else {
+          worker_pool.dispatch(order_request);
+        }
+      }
+      if (sharded) {
+        shard_router.flush();
+      } else {
+        worker_pool.flush();
+      }
+      dispatch_timer.stop(batch_size);
+
+      // periodic snapshot: the workers finish what they have, then the books are saved from this thread
+      if (snapshot_every > 0 && input_position >= next_snapshot) {
+        worker_pool.waitUntilIdle();
+        std::string snapshot_error;
+        if (writeBookSnapshot(config.get_snapshot_out(), worker_pool, symbols, input_position, snapshot_error)) {
+          logger.info("Book snapshot written at input offset ", input_position);
+        } else {
+          logger.error("Failed to write the book snapshot ", config.get_snapshot_out(), ": ", snapshot_error);
+        }
+        next_snapshot = input_position + snapshot_every;
+      }
     }
 
-   is_done_launching_jobs = true; // Signal that all orders have been launched for processing
-            
+    // every order has been dispatched: let each worker finish its ring (each one closes its output ring)
+    if (sharded) {
+      shard_router.stop();
+    } else {
+      worker_pool.stop();
+    }
     });
 
-    std::atomic<bool> is_done_processing_orders(false); // To signal when processing is done
-    std::thread read_orders_thread([&]() {
-        {
-            while(!is_done_launching_jobs){
-                std::this_thread::sleep_for(std::chrono::milliseconds(10)); // Avoid waiting
-            }
-            auto timer = TimingManager::ScopedTimer(
-                        "Time Stop processing threads for all instruments", 
-                        logger
-                    );
-            for (auto & [instrument_name, book] : order_books){
-                book.stopProcessingThread(); // Stop the processing thread for each order book
+    // periodic dump of the stats (--stats-interval), until the output is written
+    std::mutex stats_mutex;
+    std::condition_variable stats_wakeup;
+    bool stats_done = false;
+    std::thread stats_thread;
+    if (config.get_stats_interval() > 0) {
+        stats_thread = std::thread([&]() {
+            const std::chrono::milliseconds interval(config.get_stats_interval());
+            std::unique_lock<std::mutex> lock(stats_mutex);
+            while (!stats_wakeup.wait_for(lock, interval, [&]() { return stats_done; })) {
+                if (sharded) {
+                    shard_router.logSnapshot(logger, pipeline_stats, order_queue);
+                } else {
+                    logPipelineSnapshot(logger, pipeline_stats, order_queue, worker_pool);
+                }
             }
-            is_done_processing_orders = true; // Signal that processing is done
-        }
-    });
-
-    logger.info("All input orders have been processed by their respective order books.");
-
-    // Write the OutputRecord to the output CSV file
-    std::ofstream output_file_stream(config.get_order_result_output_file());
-    if (!output_file_stream.is_open()) {
-        logger.critical("Failed to open output order result file: ", config.get_order_result_output_file());
-        return 1; // error
+        });
     }
 
-    // Write the CSV header
-    output_file_stream << "timestamp,order_id,instrument,side,type,quantity,price,action,status,executed_quantity,execution_price,counterparty_id\n";
-
+    logger.info("All input orders have been processed by their respective order books.");
 
-    {
-    auto timer = TimingManager::ScopedTimer(
-        "Time writing results to output file", 
-        logger
-    );
+    // Write the execution reports to the output file opened above.
+    // The merger gives them in the order of the input, so the file does not depend on the thread scheduling
+    OutputMerger output_merger = sharded ? OutputMerger(shard_router.getRouteLog(), shard_router.getOutputQueues())
+                                         : OutputMerger(worker_pool);
+    bool output_written = false;
+    bool market_data_written = true;
+    std::string market_data_error;
+    auto write_reports = [&](auto& writer) {
+        // Write the CSV header
+        writer.writeHeader();
     
-        // Write each record in the output log queue to the output file
-    while (!output_log_queue->empty()  || !is_done_processing_orders) {
-        std::string record;
-        if (output_log_queue->try_pop(record)) {
-        output_file_stream << record << "\n";
-        } else {
-            std::this_thread::sleep_for(std::chrono::microseconds(10)); // Avoid waiting
+        // records are taken by batches. pop_batch waits for records,
+        // and returns 0 once all the workers are stopped and everything is merged
+        std::vector<ExecutionReport> records(kWriterBatchSize);
+        size_t record_count;
+        BatchTimer formatting_timer(&pipeline_stats.formatting);
+        while ((record_count = output_merger.pop_batch(records.data(), records.size())) > 0) {
+            formatting_timer.start();
+            if (market_data) {
+                // the market data updates go to their own file, the reports are packed at the front of the batch
+                size_t report_count = 0;
+                for (size_t i = 0; i < record_count; ++i) {
+                    if (isMarketData(records[i])) {
+                        market_data_writer.append(readMarketDataRecord(records[i]));
+                    } else {
+                        records[report_count++] = records[i];
+                    }
+                }
+                record_count = report_count;
+            }
+            for (size_t i = 0; i < record_count; ++i) {
+                writer.append(records[i]);
+            }
+            formatting_timer.stop(record_count);
+            pipeline_stats.reports_written.add(record_count);
+            if (config.is_gateway_enabled()) {
+                gateway.publishReports(records.data(), record_count); // back to the clients
+            }
+        }
+        if (config.is_gateway_enabled()) {
+            gateway.closeReports();
+        }
+        output_written = writer.close(output_error);
+        if (market_data) {
+            market_data_written = market_data_writer.close(market_data_error);
         }
-    }}
-    output_file_stream.close();
-    logger.info("Output records successfully written to: ", config.get_order_result_output_file());
+    };
+    if (binary_output) {
+        write_reports(binary_report_writer);
+    } else {
+        write_reports(report_writer);
+    }
+    if (output_written) {
+        logger.info("Output records successfully written to: ", config.get_order_result_output_file());
+        if (market_data && market_data_written) {
+            logger.info("Market data: ", market_data_writer.getUpdateCount(), " updates written to ", config.get_market_data());
+        }
+    }
 
     if (read_fromfile_thread.joinable()) {
         read_fromfile_thread.join(); // Wait for the reading thread to finish
@@ -176,9 +521,77 @@ int main(int argc, char* argv[]) {
      if (launch_work_thread.joinable()) {
         launch_work_thread.join(); // Wait for the reading thread to finish
     }
-    if (read_orders_thread.joinable()) {
-        read_orders_thread.join(); // Wait for the reading thread to finish
+    if (journal_thread.joinable()) {
+        journal_thread.join();
+    }
+    shard_router.join();
+    if (stats_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            stats_done = true;
+        }
+        stats_wakeup.notify_one();
+        stats_thread.join();
+    }
+    if (!output_written) {
+        logger.critical("Failed to write output order result file: ", config.get_order_result_output_file(),
+                        " (", output_error, ")");
+        return 1; // error
+    }
+    if (!shard_router.isHealthy()) {
+        logger.critical("The connection to a shard broke: the output is not complete.");
+        return 1;
+    }
+    if (!market_data_written) {
+        logger.critical("Failed to write the market data file: ", config.get_market_data(), " (", market_data_error, ")");
+        return 1;
+    }
+    if (journaling) {
+        std::string journal_error;
+        if (!journal.close(journal_error) || !journal_ok) {
+            logger.critical("Failed to write the journal ", config.get_journal(),
+                            journal_error.empty() ? std::string() : ": " + journal_error);
+            return 1;
+        }
+        logger.info("Journal: ", journal.getJournaledOrders(), " orders journaled in ", journal.getCommitCount(),
+                    " group commits");
+    }
+    if (input_position < resume_offset) {
+        logger.warn("The input has only ", input_position, " orders, fewer than the ", resume_offset,
+                    " orders of the snapshot: nothing was processed.");
+    }
+    // final snapshot: every worker is stopped, the books hold the whole input
+    if (!config.get_snapshot_out().empty()) {
+        std::string snapshot_error;
+        const uint64_t snapshot_offset = std::max<uint64_t>(input_position, resume_offset);
+        if (!writeBookSnapshot(config.get_snapshot_out(), worker_pool, symbols, snapshot_offset, snapshot_error)) {
+            logger.critical("Failed to write the book snapshot ", config.get_snapshot_out(), ": ", snapshot_error);
+            return 1;
+        }
+        logger.info("Book snapshot written to ", config.get_snapshot_out(), " (input offset ", snapshot_offset, ")");
+    }
+
+    // heap allocations made by the books while processing the orders.
+    // the matching part should stay at (almost) zero once the books are warm,
+    // the output part is the queueing of the execution reports
+    logger.info("Instruments:                  ", symbols.size());
+    if (sharded) {
+        // the books, and their counters, are in the matching processes
+        logger.info("Orders sent to the shards:    ", shard_router.getSentOrders());
+        logger.info("Pipeline ran in ", (statsNowNs() - pipeline_start_ns) / 1000000, " ms");
+        shard_router.logSummary(logger, pipeline_stats, order_queue);
+        logger.info("Matching engine run completed successfully.");
+        return 0;
     }
+    unsigned long long processed_orders = worker_pool.getProcessedOrders();
+    unsigned long long matching_allocations = worker_pool.getMatchingAllocations();
+    unsigned long long output_allocations = worker_pool.getOutputAllocations();
+    logger.info("Orders processed:             ", processed_orders);
+    logger.info("Allocations while matching:   ", matching_allocations);
+    logger.info("Allocations for output:       ", output_allocations);
+    logger.info("Pipeline ran in ", (statsNowNs() - pipeline_start_ns) / 1000000, " ms");
+    logPipelineSummary(logger, pipeline_stats, order_queue, worker_pool);
+
     logger.info("Matching engine run completed successfully.");
     return 0; // success
 }
@@ -1,4 +1,5 @@
 #include "order.hpp"
+#include "pipeline_stats.hpp"
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
@@ -7,6 +8,7 @@
 #include <iomanip>   
 #include <limits>    
 #include <atomic>
+#include <cmath>     // For std::llround, std::fabs
 
 
 
@@ -77,6 +79,51 @@ std::optional<OrderAction> sanitizeOrderAction(const std::string& action_str_raw
     return std::nullopt;
 }
 
+// Function to convert a raw string ("GTC", "ioc"...) into a valid "TimeInForce" enum (an empty field is GTC)
+std::optional<TimeInForce> sanitizeTimeInForce(const std::string& tif_str_raw, Logger& logger, const std::string& original_line) {
+    std::string tif_str = toUpper(trim_whitespace(tif_str_raw));
+    if (tif_str.empty() || tif_str == "GTC") {
+        return TimeInForce::GTC;
+    }
+    if (tif_str == "IOC") {
+        return TimeInForce::IOC;
+    }
+    if (tif_str == "FOK") {
+        return TimeInForce::FOK;
+    }
+    logger.warn("Invalid 'time_in_force' value: '", tif_str_raw, "'. Expected GTC, IOC or FOK. Original line: '", original_line, "'");
+    return std::nullopt;
+}
+
+// Function to convert a raw string ("Y", "0", "true"...) into the post-only flag (an empty field is no)
+std::optional<bool> sanitizePostOnly(const std::string& post_only_str_raw, Logger& logger, const std::string& original_line) {
+    std::string post_only_str = toUpper(trim_whitespace(post_only_str_raw));
+    if (post_only_str.empty() || post_only_str == "0" || post_only_str == "N" || post_only_str == "NO" || post_only_str == "FALSE") {
+        return false;
+    }
+    if (post_only_str == "1" || post_only_str == "Y" || post_only_str == "YES" || post_only_str == "TRUE") {
+        return true;
+    }
+    logger.warn("Invalid 'post_only' value: '", post_only_str_raw, "'. Expected Y or N. Original line: '", original_line, "'");
+    return std::nullopt;
+}
+
+const char* orderAttributesError(const Order& order) {
+    if (order.action == OrderAction::CANCEL) {
+        return nullptr; // a CANCEL only uses the order id
+    }
+    if (order.post_only && (order.type == OrderType::MARKET || order.time_in_force != TimeInForce::GTC)) {
+        return "post-only is only possible for a LIMIT GTC order";
+    }
+    if (order.display_quantity > 0 && (order.type == OrderType::MARKET || order.time_in_force != TimeInForce::GTC)) {
+        return "a display quantity (iceberg) is only possible for a LIMIT GTC order";
+    }
+    if (order.display_quantity > kMaxDisplayQuantity) {
+        return "the display quantity is too large";
+    }
+    return nullptr;
+}
+
 // Returns the value of a CSV field corresponding to a given header name.
 
 std::optional<std::string> get_field_by_header(
@@ -108,7 +155,9 @@ std::optional<Order> parseCsvLineToOrder(
     const std::vector<std::string>& fields, 
     const std::map<std::string, size_t>& header_map,
     Logger& logger,
-    const std::string& original_line 
+    const std::string& original_line,
+    const TickSizeTable& tick_sizes,
+    SymbolTable& symbols
 ) {
 
     //declare an order object. for now it is empty
@@ -168,8 +217,10 @@ std::optional<Order> parseCsvLineToOrder(
         return std::nullopt;
     }
     // we have access to the string in the temp_op_str
-    // and we affect it to the order.instrument object
-    order.instrument = *temp_opt_str; 
+    // the order only keeps the interned id of the instrument, not the string itself
+    order.symbol_id = symbols.intern(*temp_opt_str);
+    // tick size of this instrument, used below to convert the price into ticks
+    const double tick_size = tick_sizes.tick_size_for(*temp_opt_str);
 
     // check for the 'side' field in the CSV line
     temp_opt_str = get_field_by_header(fields, header_map, "side", logger);
@@ -231,7 +282,7 @@ std::optional<Order> parseCsvLineToOrder(
             // set price to 0
             order.price = 0.0; 
             if (!temp_opt_str->empty() && trim_whitespace(*temp_opt_str) != "0" && trim_whitespace(*temp_opt_str) != "0.0") {
-                 logger.debug("Price field value '", *temp_opt_str, "' ignored for MARKET order. Original line: '", original_line, "'");
+                 LOG_DEBUG(logger, "Price field value '", *temp_opt_str, "' ignored for MARKET order. Original line: '", original_line, "'");
             }
         } else { 
             try {
@@ -241,6 +292,13 @@ std::optional<Order> parseCsvLineToOrder(
                 if (order.price <= 0 && order.type == OrderType::LIMIT && order.action == OrderAction::NEW) { 
                      logger.warn("Field 'price' for NEW LIMIT order is zero or negative ('", *temp_opt_str, "'). This might be unintentional. Original line: '", original_line, "'");
                 }
+                // convert the price once into integer ticks, the books compare and index prices with it
+                order.price_ticks = std::llround(order.price / tick_size);
+                // if the price is not on the tick grid, it gets rounded to the nearest tick
+                if (std::fabs(static_cast<double>(order.price_ticks) * tick_size - order.price) > tick_size * 1e-6) {
+                    logger.warn("Field 'price' value '", *temp_opt_str, "' is not a multiple of the tick size ", tick_size,
+                                " and is rounded to the nearest tick. Original line: '", original_line, "'");
+                }
             // if the string can't be converted to a double
             } catch (const std::invalid_argument& ia) {
                 logger.error("Field 'price' with value '", *temp_opt_str, "' cannot be converted: invalid argument. Original line: '", original_line, "'. Details: ", ia.what());
@@ -264,6 +322,56 @@ std::optional<Order> parseCsvLineToOrder(
     if (!sanitized_action) return std::nullopt; 
     order.action = *sanitized_action;
 
+    // the optional columns of the extended order types (a file without them only has LIMIT/MARKET GTC orders)
+    auto optional_field = [&](const char* header_name) -> const std::string* {
+        auto it = header_map.find(header_name);
+        return (it != header_map.end() && it->second < fields.size()) ? &fields[it->second] : nullptr;
+    };
+    if (const std::string* tif_field = optional_field("time_in_force")) {
+        std::optional<TimeInForce> sanitized_tif = sanitizeTimeInForce(*tif_field, logger, original_line);
+        if (!sanitized_tif) return std::nullopt;
+        order.time_in_force = *sanitized_tif;
+    }
+    if (const std::string* post_only_field = optional_field("post_only")) {
+        std::optional<bool> sanitized_post_only = sanitizePostOnly(*post_only_field, logger, original_line);
+        if (!sanitized_post_only) return std::nullopt;
+        order.post_only = *sanitized_post_only;
+    }
+    if (const std::string* display_field = optional_field("display_quantity")) {
+        if (!trim_whitespace(*display_field).empty()) {
+            try {
+                order.display_quantity = std::stoull(*display_field);
+            } catch (const std::invalid_argument& ia) {
+                logger.error("Field 'display_quantity' with value '", *display_field, "' cannot be converted: invalid argument. Original line: '", original_line, "'. Details: ", ia.what());
+                return std::nullopt;
+            } catch (const std::out_of_range& oor) {
+                logger.error("Field 'display_quantity' with value '", *display_field, "' cannot be converted: out of range. Original line: '", original_line, "'. Details: ", oor.what());
+                return std::nullopt;
+            }
+        }
+    }
+    if (const std::string* account_field = optional_field("account")) {
+        if (!trim_whitespace(*account_field).empty()) {
+            try {
+                unsigned long long account_id = std::stoull(*account_field);
+                if (account_id > std::numeric_limits<uint32_t>::max()) {
+                    throw std::out_of_range("account id above 4294967295");
+                }
+                order.account_id = static_cast<uint32_t>(account_id);
+            } catch (const std::invalid_argument& ia) {
+                logger.error("Field 'account' with value '", *account_field, "' cannot be converted: invalid argument. Original line: '", original_line, "'. Details: ", ia.what());
+                return std::nullopt;
+            } catch (const std::out_of_range& oor) {
+                logger.error("Field 'account' with value '", *account_field, "' cannot be converted: out of range. Original line: '", original_line, "'. Details: ", oor.what());
+                return std::nullopt;
+            }
+        }
+    }
+    if (const char* attributes_error = orderAttributesError(order)) {
+        logger.warn("Invalid order attributes: ", attributes_error, ". Original line: '", original_line, "'");
+        return std::nullopt;
+    }
+
     // Initialize remaining_quantity and cumulative_executed_quantity
     // trhough time, orders are executed, so the remaining quantity will decrease
     order.remaining_quantity = order.quantity; 
@@ -277,8 +385,8 @@ std::optional<Order> parseCsvLineToOrder(
 // creates Order objects from the parsed lines,
 // and pushes them into a thread-safe queue for further processing.
 /// istream : representes an input stream
-void readOrdersFromStream(std::istream& stream, Logger& logger, ThreadSafeQueue<Order>& order_queue,
-long int  max_queue_size_allowed) {
+void readOrdersFromStream(std::istream& stream, Logger& logger, OrderQueue& order_queue,
+const TickSizeTable& tick_sizes, SymbolTable& symbols, LatencyHistogram* parse_latency) {
    
     // declare a line, wich will contain every line read from the CSV
     std::string line;
@@ -329,6 +437,10 @@ long int  max_queue_size_allowed) {
     // Second part of the function reads the rest of the csv and transforms them in Orders
     // count the number of orders
     long int order_succcess_parsed = 0;
+    // the parsing time is measured every kTimedBatch orders (the pushes into the queue are included)
+    constexpr long int kTimedBatch = 64;
+    BatchTimer parse_timer(parse_latency);
+    parse_timer.start();
     // as long as we can read lines from the stream, we read the next line
     while (std::getline(stream, line)) {
         line_number++;
@@ -336,7 +448,7 @@ long int  max_queue_size_allowed) {
         //clean
         std::string trimmed_line = trim_whitespace(line);
         if (trimmed_line.empty()) {
-            logger.debug("Skipping empty line at number: ", line_number);
+            LOG_DEBUG(logger, "Skipping empty line at number: ", line_number);
             continue;
         }
 
@@ -356,20 +468,22 @@ long int  max_queue_size_allowed) {
         }
         
         // convert the current line in an Order
-        std::optional<Order> parsed_order_opt = parseCsvLineToOrder(fields, header_map, logger, original_line_for_log);
+        std::optional<Order> parsed_order_opt = parseCsvLineToOrder(fields, header_map, logger, original_line_for_log, tick_sizes, symbols);
         if (parsed_order_opt) {
-            // if the queue is full, we wait
-            while (order_queue.size() >= static_cast<long unsigned>(max_queue_size_allowed))
-            { 
-                std::this_thread::sleep_for(std::chrono::milliseconds(1)); // Wait until space is available
-            }
-            order_queue.push(*parsed_order_opt); // Push to the thread-safe queue
+            // if the queue is full, push waits (with the wait strategy of the queue) until there is room
+            order_queue.push(std::move(*parsed_order_opt)); // Push to the queue (waits if the ring is full)
             order_succcess_parsed++;
+            if (order_succcess_parsed % kTimedBatch == 0) {
+                parse_timer.stop(kTimedBatch);
+                parse_timer.start();
+            }
         } else {
             logger.warn("Failed to parse order at line: ", line_number, ". See previous errors for details. Original line: '", original_line_for_log, "'");
         }
     }
 
+    parse_timer.stop(static_cast<size_t>(order_succcess_parsed % kTimedBatch));
+
     logger.info("Finished reading orders. Total lines processed (including header): ", 
         line_number, 
         "Orders successfully parsed: ", order_succcess_parsed);
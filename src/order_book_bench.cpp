@@ -0,0 +1,376 @@
+// OrderBookBench: microbenchmarks of the order book hot paths.
+// The books are driven directly through processOrder (no CSV, no threads): every scenario builds a book
+// of the requested depth, then times one operation at a time and reports ns/op percentiles.
+//   OrderBookBench [--book-types map,ladder] [--depths 1,10,100,1000] [--operations 20000] [--output results.csv]
+// The results are printed as a table and written as CSV (one line per scenario, book type and depth)
+// so they can be compared between versions.
+
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "alloc_counter.hpp"
+#include "argparse.hpp"
+#include "bench_stats.hpp"
+#include "order.hpp"
+#include "orderbook.hpp"
+
+namespace {
+
+constexpr double kTickSize = 0.01;
+constexpr long long kMidTicks = 100000; // bids rest below it, asks above it
+constexpr size_t kOutputCapacity = 1 << 16;
+
+// collects the timed operations of one scenario, the first `warmup` ones are dropped
+class Recorder {
+public:
+    explicit Recorder(size_t warmup) : warmup_(warmup) {}
+
+    void add(uint64_t nanoseconds, unsigned long long allocations) {
+        if (seen_++ < warmup_) {
+            return;
+        }
+        samples_.push_back(nanoseconds);
+        allocations_ += allocations;
+    }
+
+    std::vector<uint64_t>& samples() { return samples_; }
+    unsigned long long allocations() const { return allocations_; }
+
+private:
+    size_t warmup_;
+    size_t seen_ = 0;
+    std::vector<uint64_t> samples_;
+    unsigned long long allocations_ = 0;
+};
+
+// one book and the output ring it writes into (drained after every operation, outside the timing)
+class BenchBook {
+public:
+    explicit BenchBook(const std::string& book_type)
+        : output_(std::make_shared<OutputQueue>(kOutputCapacity, WaitStrategyType::SPIN_YIELD)),
+          book_(createOrderBook(book_type, "BENCH", 0)), reports_(256) {
+        book_->set_output_log_queue(output_);
+    }
+
+    long long nextId() { return next_id_++; }
+
+    Order makeOrder(long long order_id, Side side, OrderType type, long long ticks,
+                    unsigned long long quantity, OrderAction action) {
+        Order order;
+        order.timestamp = next_timestamp_++;
+        order.order_id = order_id;
+        order.symbol_id = 0;
+        order.side = side;
+        order.type = type;
+        order.quantity = quantity;
+        if (type == OrderType::LIMIT) {
+            order.price = static_cast<double>(ticks) * kTickSize;
+            order.price_ticks = ticks;
+        }
+        order.action = action;
+        order.remaining_quantity = quantity;
+        return order;
+    }
+
+    // setup step, not timed
+    void apply(Order order) {
+        book_->processOrder(order);
+        drain();
+    }
+
+    // the measured operation
+    void timed(Order order, Recorder& recorder) {
+        unsigned long long allocations_before = alloc_counter::thread_allocations();
+        auto start = std::chrono::steady_clock::now();
+        book_->processOrder(order);
+        auto end = std::chrono::steady_clock::now();
+        unsigned long long allocations = alloc_counter::thread_allocations() - allocations_before;
+        drain();
+        recorder.add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()),
+                     allocations);
+    }
+
+private:
+    void drain() {
+        while (output_->try_pop_batch(reports_.data(), reports_.size()) > 0) {
+        }
+    }
+
+    std::shared_ptr<OutputQueue> output_;
+    std::unique_ptr<OrderBookBase> book_;
+    std::vector<ExecutionReport> reports_;
+    long long next_id_ = 1;
+    unsigned long long next_timestamp_ = 1;
+};
+
+// ---------------------------------------------------------------------------------------------
+// scenarios. `depth` is the number of price levels, except for the cancel scenarios
+// where it is the length of the queue of the level
+
+// NEW limit orders that rest without crossing, into a book with `depth` levels per side
+void benchAddLimitNoCross(BenchBook& book, size_t depth, size_t iterations, std::mt19937_64& rng, Recorder& recorder) {
+    for (size_t level = 1; level <= depth; ++level) {
+        long long offset = static_cast<long long>(level);
+        book.apply(book.makeOrder(book.nextId(), Side::BUY, OrderType::LIMIT, kMidTicks - offset, 10, OrderAction::NEW));
+        book.apply(book.makeOrder(book.nextId(), Side::SELL, OrderType::LIMIT, kMidTicks + offset, 10, OrderAction::NEW));
+    }
+    std::uniform_int_distribution<long long> level_dist(1, static_cast<long long>(depth));
+    for (size_t i = 0; i < iterations; ++i) {
+        long long order_id = book.nextId();
+        long long ticks = kMidTicks - level_dist(rng);
+        book.timed(book.makeOrder(order_id, Side::BUY, OrderType::LIMIT, ticks, 10, OrderAction::NEW), recorder);
+        // keep the book at the same size
+        book.apply(book.makeOrder(order_id, Side::BUY, OrderType::LIMIT, ticks, 10, OrderAction::CANCEL));
+    }
+}
+
+// one aggressive limit order that sweeps `depth` ask levels (one order per level)
+void benchSweepLevels(BenchBook& book, size_t depth, size_t iterations, std::mt19937_64&, Recorder& recorder) {
+    for (size_t i = 0; i < iterations; ++i) {
+        for (size_t level = 1; level <= depth; ++level) {
+            book.apply(book.makeOrder(book.nextId(), Side::SELL, OrderType::LIMIT,
+                                      kMidTicks + static_cast<long long>(level), 10, OrderAction::NEW));
+        }
+        book.timed(book.makeOrder(book.nextId(), Side::BUY, OrderType::LIMIT, kMidTicks + static_cast<long long>(depth),
+                                  10 * depth, OrderAction::NEW), recorder);
+    }
+}
+
+enum class QueuePosition { FRONT, MIDDLE, BACK };
+
+// CANCEL of the order at the front, middle or back of one level with `depth` orders
+void benchCancel(BenchBook& book, size_t depth, size_t iterations, QueuePosition position, Recorder& recorder) {
+    const long long ticks = kMidTicks - 1;
+    std::deque<long long> queue; // ids in time priority
+    for (size_t i = 0; i < depth; ++i) {
+        queue.push_back(book.nextId());
+        book.apply(book.makeOrder(queue.back(), Side::BUY, OrderType::LIMIT, ticks, 10, OrderAction::NEW));
+    }
+    for (size_t i = 0; i < iterations; ++i) {
+        size_t index = position == QueuePosition::FRONT ? 0
+                     : position == QueuePosition::MIDDLE ? queue.size() / 2
+                                                         : queue.size() - 1;
+        long long order_id = queue[index];
+        book.timed(book.makeOrder(order_id, Side::BUY, OrderType::LIMIT, ticks, 10, OrderAction::CANCEL), recorder);
+        queue.erase(queue.begin() + static_cast<std::ptrdiff_t>(index));
+        // put a new order at the back, so the level keeps its length
+        queue.push_back(book.nextId());
+        book.apply(book.makeOrder(queue.back(), Side::BUY, OrderType::LIMIT, ticks, 10, OrderAction::NEW));
+    }
+}
+
+// MODIFY of a random resting order (one per level over `depth` bid levels), to a new price or a new quantity
+void benchModify(BenchBook& book, size_t depth, size_t iterations, std::mt19937_64& rng, bool change_price,
+                 Recorder& recorder) {
+    struct Resting {
+        long long order_id;
+        long long ticks;
+        unsigned long long quantity;
+    };
+    std::vector<Resting> resting;
+    for (size_t level = 1; level <= depth; ++level) {
+        resting.push_back({book.nextId(), kMidTicks - static_cast<long long>(level), 10});
+        book.apply(book.makeOrder(resting.back().order_id, Side::BUY, OrderType::LIMIT, resting.back().ticks,
+                                  resting.back().quantity, OrderAction::NEW));
+    }
+    std::uniform_int_distribution<size_t> order_dist(0, resting.size() - 1);
+    std::uniform_int_distribution<long long> level_dist(1, static_cast<long long>(depth));
+    for (size_t i = 0; i < iterations; ++i) {
+        Resting& order = resting[order_dist(rng)];
+        if (change_price) {
+            order.ticks = kMidTicks - level_dist(rng); // never crosses the (empty) ask side
+        } else {
+            order.quantity = order.quantity == 10 ? 20 : 10;
+        }
+        book.timed(book.makeOrder(order.order_id, Side::BUY, OrderType::LIMIT, order.ticks, order.quantity,
+                                  OrderAction::MODIFY), recorder);
+    }
+}
+
+// MARKET order that takes the best ask of a book with `depth` ask levels (depth 1 is the thin book)
+void benchMarketOrder(BenchBook& book, size_t depth, size_t iterations, std::mt19937_64&, Recorder& recorder) {
+    for (size_t level = 1; level <= depth; ++level) {
+        book.apply(book.makeOrder(book.nextId(), Side::SELL, OrderType::LIMIT, kMidTicks + static_cast<long long>(level),
+                                  10, OrderAction::NEW));
+    }
+    for (size_t i = 0; i < iterations; ++i) {
+        book.timed(book.makeOrder(book.nextId(), Side::BUY, OrderType::MARKET, 0, 10, OrderAction::NEW), recorder);
+        // refill the level that was taken
+        book.apply(book.makeOrder(book.nextId(), Side::SELL, OrderType::LIMIT, kMidTicks + 1, 10, OrderAction::NEW));
+    }
+}
+
+struct BenchResult {
+    std::string scenario;
+    std::string book_type;
+    size_t depth;
+    LatencySummary latency;
+    double allocations_per_op;
+};
+
+bool parseSizeList(const std::string& text, std::vector<size_t>& values) {
+    values.clear();
+    std::stringstream ss(text);
+    std::string entry;
+    while (std::getline(ss, entry, ',')) {
+        if (entry.empty()) {
+            continue;
+        }
+        try {
+            size_t parsed_chars = 0;
+            unsigned long value = std::stoul(entry, &parsed_chars);
+            if (parsed_chars != entry.size() || value == 0) {
+                return false;
+            }
+            values.push_back(static_cast<size_t>(value));
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return !values.empty();
+}
+
+std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> values;
+    std::stringstream ss(text);
+    std::string entry;
+    while (std::getline(ss, entry, ',')) {
+        if (!entry.empty()) {
+            values.push_back(entry);
+        }
+    }
+    return values;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    ArgumentParser parser("Microbenchmarks of the order book hot paths");
+    parser.add_flag({"--book-types"})
+        .help("Comma-separated book implementations to measure ('map', 'ladder').")
+        .set_default(std::string("map,ladder"))
+        .type_string();
+    parser.add_flag({"--depths"})
+        .help("Comma-separated book depths (price levels, or queue length for the cancel scenarios).")
+        .set_default(std::string("1,10,100,1000"))
+        .type_string();
+    parser.add_flag({"--operations"})
+        .help("Measured operations per scenario and depth (the sweep runs fewer on deep books).")
+        .set_default(20000)
+        .type_int();
+    parser.add_flag({"--seed"})
+        .help("Seed of the random prices and order choices.")
+        .set_default(42)
+        .type_int();
+    parser.add_flag({"--output"})
+        .help("CSV file receiving the results.")
+        .set_default(std::string("order_book_bench.csv"))
+        .type_string();
+
+    std::vector<std::string> book_types;
+    std::vector<size_t> depths;
+    size_t operations = 0;
+    unsigned int seed = 0;
+    std::string output_path;
+    try {
+        parser.parse_args(argc, argv);
+        book_types = splitList(parser.get<std::string>("book_types"));
+        for (const std::string& book_type : book_types) {
+            if (book_type != "map" && book_type != "ladder") {
+                throw std::runtime_error("Invalid book type '" + book_type + "'. Expected 'map' or 'ladder'.");
+            }
+        }
+        if (!parseSizeList(parser.get<std::string>("depths"), depths)) {
+            throw std::runtime_error("Invalid value for --depths: expected a list like '1,10,100'.");
+        }
+        int operations_arg = parser.get<int>("operations");
+        if (operations_arg < 1) {
+            throw std::runtime_error("Invalid value for --operations: it must be at least 1.");
+        }
+        operations = static_cast<size_t>(operations_arg);
+        seed = static_cast<unsigned int>(parser.get<int>("seed"));
+        output_path = parser.get<std::string>("output");
+    } catch (const std::runtime_error& err) {
+        std::cerr << "Error parsing arguments: " << err.what() << std::endl;
+        parser.print_help();
+        return 1;
+    }
+
+    struct Scenario {
+        std::string name;
+        void (*run)(BenchBook&, size_t, size_t, std::mt19937_64&, Recorder&);
+        bool fewer_on_deep_books; // the setup of every operation is proportional to the depth
+    };
+    const std::vector<Scenario> scenarios = {
+        {"add_limit_no_cross", benchAddLimitNoCross, false},
+        {"sweep_levels", benchSweepLevels, true},
+        {"cancel_front", [](BenchBook& b, size_t d, size_t n, std::mt19937_64&, Recorder& r) {
+            benchCancel(b, d, n, QueuePosition::FRONT, r); }, false},
+        {"cancel_middle", [](BenchBook& b, size_t d, size_t n, std::mt19937_64&, Recorder& r) {
+            benchCancel(b, d, n, QueuePosition::MIDDLE, r); }, false},
+        {"cancel_back", [](BenchBook& b, size_t d, size_t n, std::mt19937_64&, Recorder& r) {
+            benchCancel(b, d, n, QueuePosition::BACK, r); }, false},
+        {"modify_price", [](BenchBook& b, size_t d, size_t n, std::mt19937_64& rng, Recorder& r) {
+            benchModify(b, d, n, rng, true, r); }, false},
+        {"modify_quantity", [](BenchBook& b, size_t d, size_t n, std::mt19937_64& rng, Recorder& r) {
+            benchModify(b, d, n, rng, false, r); }, false},
+        {"market_order", benchMarketOrder, false},
+    };
+
+    std::vector<BenchResult> results;
+    std::cout << std::left << std::setw(20) << "scenario" << std::setw(8) << "book" << std::right
+              << std::setw(7) << "depth" << std::setw(9) << "ops" << std::setw(11) << "mean_ns"
+              << std::setw(9) << "p50" << std::setw(9) << "p90" << std::setw(9) << "p99"
+              << std::setw(10) << "p99.9" << std::setw(11) << "max" << std::setw(11) << "allocs/op" << "\n";
+    for (const Scenario& scenario : scenarios) {
+        for (const std::string& book_type : book_types) {
+            for (size_t depth : depths) {
+                size_t measured = operations;
+                if (scenario.fewer_on_deep_books) {
+                    measured = std::min(operations, std::max<size_t>(200, operations * 10 / depth));
+                }
+                const size_t warmup = measured / 10;
+                std::mt19937_64 rng(seed);
+                Recorder recorder(warmup);
+                {
+                    BenchBook book(book_type);
+                    scenario.run(book, depth, warmup + measured, rng, recorder);
+                }
+                BenchResult result{scenario.name, book_type, depth, summarizeLatencies(recorder.samples()),
+                                   static_cast<double>(recorder.allocations()) / static_cast<double>(measured)};
+                std::cout << std::left << std::setw(20) << result.scenario << std::setw(8) << result.book_type
+                          << std::right << std::setw(7) << depth << std::setw(9) << result.latency.count
+                          << std::setw(11) << std::fixed << std::setprecision(1) << result.latency.mean_ns
+                          << std::setw(9) << result.latency.p50_ns << std::setw(9) << result.latency.p90_ns
+                          << std::setw(9) << result.latency.p99_ns << std::setw(10) << result.latency.p999_ns
+                          << std::setw(11) << result.latency.max_ns << std::setw(11) << std::setprecision(2)
+                          << result.allocations_per_op << "\n";
+                results.push_back(result);
+            }
+        }
+    }
+
+    std::ofstream output_file(output_path);
+    if (!output_file.is_open()) {
+        std::cerr << "Failed to open the result file: " << output_path << std::endl;
+        return 1;
+    }
+    output_file << "scenario,book_type,depth,operations,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,allocations_per_op\n";
+    for (const BenchResult& result : results) {
+        output_file << result.scenario << ',' << result.book_type << ',' << result.depth << ','
+                    << result.latency.count << ',' << std::fixed << std::setprecision(1) << result.latency.mean_ns << ','
+                    << result.latency.p50_ns << ',' << result.latency.p90_ns << ',' << result.latency.p99_ns << ','
+                    << result.latency.p999_ns << ',' << result.latency.max_ns << ','
+                    << std::setprecision(3) << result.allocations_per_op << '\n';
+    }
+    std::cout << "Results written to " << output_path << "\n";
+    return 0;
+}
@@ -0,0 +1,222 @@
+// OrderFileConverter: converts the files of the matching engine between CSV and the binary format.
+//   OrderFileConverter <orders.csv> <orders.bin>     CSV orders -> binary orders (for --input-format binary)
+//   OrderFileConverter <file.bin> <file.csv>         binary orders or execution reports -> CSV
+//   OrderFileConverter <snapshot.bin> <books.csv>    book snapshot (--snapshot-out) -> CSV, one resting order per line
+// The direction is chosen from the input: a file starting with the binary magic is converted to CSV.
+// CSV orders are read by the same parsers as the engine, so invalid lines are skipped (and logged)
+// exactly like the engine would skip them.
+
+#include <charconv>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "binary_format.hpp"
+#include "csv_mmap_reader.hpp"
+#include "logger.hpp"
+#include "order.hpp"
+#include "report_writer.hpp"
+#include "symbol_table.hpp"
+#include "tick_size.hpp"
+
+// orders between the CSV reader thread and the writer
+constexpr size_t kConverterQueueCapacity = 1 << 16;
+constexpr size_t kConverterBatchSize = 256;
+
+// CSV orders -> binary orders
+static int convertCsvOrders(const std::string& input_path, const std::string& output_path, Logger& logger) {
+    std::ifstream input_file_stream(input_path);
+    if (!input_file_stream.is_open()) {
+        logger.critical("Failed to open input order file: ", input_path);
+        return 1;
+    }
+    BinaryFileWriter writer(BinaryFileKind::ORDERS, static_cast<uint32_t>(sizeof(BinaryOrderRecord)));
+    std::string error;
+    if (!writer.open(output_path, error)) {
+        logger.critical("Failed to open output file: ", output_path, " (", error, ")");
+        return 1;
+    }
+
+    // the prices are stored as written, the tick sizes are only used by the parser for its warnings
+    TickSizeTable tick_sizes;
+    SymbolTable symbols;
+    OrderQueue order_queue(kConverterQueueCapacity, WaitStrategyType::PARK);
+    std::thread reader_thread([&]() {
+        if (!readOrdersFromMappedFile(input_path, logger, order_queue, tick_sizes, symbols)) {
+            readOrdersFromStream(input_file_stream, logger, order_queue, tick_sizes, symbols);
+        }
+        order_queue.close();
+    });
+
+    std::vector<Order> orders(kConverterBatchSize);
+    size_t order_count;
+    while ((order_count = order_queue.pop_batch(orders.data(), orders.size())) > 0) {
+        for (size_t i = 0; i < order_count; ++i) {
+            BinaryOrderRecord record = toBinaryRecord(orders[i]);
+            writer.appendRecord(&record);
+        }
+    }
+    reader_thread.join();
+
+    const uint64_t record_count = writer.getRecordCount();
+    if (!writer.close(symbols, error)) {
+        logger.critical("Failed to write output file: ", output_path, " (", error, ")");
+        return 1;
+    }
+    logger.info("Wrote ", record_count, " orders and ", symbols.size(), " instruments to ", output_path);
+    return 0;
+}
+
+// binary orders -> CSV orders (same columns as the input of the engine)
+static int convertBinaryOrders(const std::string& input_path, const std::string& output_path, Logger& logger) {
+    BinaryFileReader file;
+    std::string error;
+    if (!file.open(input_path, BinaryFileKind::ORDERS, error)) {
+        logger.critical("Cannot read binary order file '", input_path, "': ", error);
+        return 1;
+    }
+    std::ofstream output_file_stream(output_path);
+    if (!output_file_stream.is_open()) {
+        logger.critical("Failed to open output file: ", output_path);
+        return 1;
+    }
+
+    output_file_stream << "timestamp,order_id,instrument,side,type,quantity,price,action\n";
+    for (size_t i = 0; i < file.recordCount(); ++i) {
+        const BinaryOrderRecord record = file.record<BinaryOrderRecord>(i);
+        if (record.symbol_id >= file.symbols().size()) {
+            logger.warn("Skipping binary order record number ", i, " with an unknown instrument");
+            continue;
+        }
+        // shortest text that reads back as the same double
+        char price[32];
+        std::to_chars_result price_end = std::to_chars(price, price + sizeof(price), record.price);
+        output_file_stream << record.timestamp << ','
+                           << record.order_id << ','
+                           << file.symbols()[record.symbol_id] << ','
+                           << sideToString(static_cast<Side>(record.side)) << ','
+                           << orderTypeToString(static_cast<OrderType>(record.type)) << ','
+                           << record.quantity << ','
+                           << std::string_view(price, static_cast<size_t>(price_end.ptr - price)) << ','
+                           << orderActionToString(static_cast<OrderAction>(record.action)) << '\n';
+    }
+    if (!output_file_stream.good()) {
+        logger.critical("Failed to write output file: ", output_path);
+        return 1;
+    }
+    logger.info("Wrote ", file.recordCount(), " orders to ", output_path);
+    return 0;
+}
+
+// binary execution reports -> the CSV output of the engine
+static int convertBinaryReports(const std::string& input_path, const std::string& output_path, Logger& logger) {
+    BinaryFileReader file;
+    std::string error;
+    if (!file.open(input_path, BinaryFileKind::EXECUTION_REPORTS, error)) {
+        logger.critical("Cannot read binary report file '", input_path, "': ", error);
+        return 1;
+    }
+
+    // the symbol ids of the file become the ids of this table (names are unique, so they map one to one)
+    SymbolTable symbols;
+    std::vector<uint32_t> symbol_ids;
+    for (std::string_view name : file.symbols()) {
+        symbol_ids.push_back(symbols.intern(std::string(name)));
+    }
+
+    ReportWriter writer(symbols);
+    if (!writer.open(output_path, error)) {
+        logger.critical("Failed to open output file: ", output_path, " (", error, ")");
+        return 1;
+    }
+    writer.writeHeader();
+    for (size_t i = 0; i < file.recordCount(); ++i) {
+        ExecutionReport report = fromBinaryRecord(file.record<BinaryReportRecord>(i));
+        if (report.symbol_id >= symbol_ids.size()) {
+            logger.warn("Skipping binary report record number ", i, " with an unknown instrument");
+            continue;
+        }
+        report.symbol_id = symbol_ids[report.symbol_id];
+        writer.append(report);
+    }
+    if (!writer.close(error)) {
+        logger.critical("Failed to write output file: ", output_path, " (", error, ")");
+        return 1;
+    }
+    logger.info("Wrote ", file.recordCount(), " execution reports to ", output_path);
+    return 0;
+}
+
+// book snapshot -> CSV: every resting order, book by book in priority order (see book_snapshot.hpp)
+static int convertBookSnapshot(const std::string& input_path, const std::string& output_path, Logger& logger) {
+    BinaryFileReader file;
+    std::string error;
+    if (!file.open(input_path, BinaryFileKind::BOOK_SNAPSHOT, error)) {
+        logger.critical("Cannot read book snapshot '", input_path, "': ", error);
+        return 1;
+    }
+    std::ofstream output_file_stream(output_path);
+    if (!output_file_stream.is_open()) {
+        logger.critical("Failed to open output file: ", output_path);
+        return 1;
+    }
+
+    output_file_stream << "instrument,side,price,order_id,timestamp,quantity,remaining_quantity,"
+                          "cumulative_executed_quantity,action,status\n";
+    for (size_t i = 0; i < file.recordCount(); ++i) {
+        const BinaryRestingOrderRecord record = file.record<BinaryRestingOrderRecord>(i);
+        if (record.symbol_id >= file.symbols().size()) {
+            logger.warn("Skipping snapshot record number ", i, " with an unknown instrument");
+            continue;
+        }
+        char price[32];
+        std::to_chars_result price_end = std::to_chars(price, price + sizeof(price), record.price);
+        output_file_stream << file.symbols()[record.symbol_id] << ','
+                           << sideToString(static_cast<Side>(record.side)) << ','
+                           << std::string_view(price, static_cast<size_t>(price_end.ptr - price)) << ','
+                           << record.order_id << ','
+                           << record.timestamp << ','
+                           << record.quantity << ','
+                           << record.remaining_quantity << ','
+                           << record.cumulative_executed_quantity << ','
+                           << orderActionToString(static_cast<OrderAction>(record.action)) << ','
+                           << orderStatusToString(static_cast<OrderStatus>(record.status)) << '\n';
+    }
+    if (!output_file_stream.good()) {
+        logger.critical("Failed to write output file: ", output_path);
+        return 1;
+    }
+    logger.info("Wrote ", file.recordCount(), " resting orders to ", output_path, " (snapshot at input offset ",
+                file.header().input_offset, ")");
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    Logger logger("OrderFileConverter");
+    if (argc != 3) {
+        logger.error("Usage: ", argv[0], " <input file> <output file>");
+        logger.error("  a CSV order file is converted to the binary format,");
+        logger.error("  a binary file (orders, execution reports or a book snapshot) is converted to CSV.");
+        return 1;
+    }
+    const std::string input_path = argv[1];
+    const std::string output_path = argv[2];
+
+    if (!BinaryFileReader::hasMagic(input_path)) {
+        return convertCsvOrders(input_path, output_path, logger);
+    }
+    BinaryFileKind kind;
+    std::string error;
+    if (!BinaryFileReader::readKind(input_path, kind, error)) {
+        logger.critical("Cannot read binary file '", input_path, "': ", error);
+        return 1;
+    }
+    if (kind == BinaryFileKind::ORDERS) {
+        return convertBinaryOrders(input_path, output_path, logger);
+    }
+    if (kind == BinaryFileKind::BOOK_SNAPSHOT) {
+        return convertBookSnapshot(input_path, output_path, logger);
+    }
+    return convertBinaryReports(input_path, output_path, logger);
+}
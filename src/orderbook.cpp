@@ -1,20 +1,197 @@
 #include "orderbook.hpp" 
+#include "ladder_orderbook.hpp"
 #include <iostream> 
 #include <algorithm> 
 #include <vector>    
-#include <set>       
+#include <iterator>  // For std::prev
 #include <atomic>
+#include <cstring>   // For std::memcpy
 
 //
 
+// Constructor for OrderBookBase, initializes with the instrument name and its interned id
+OrderBookBase::OrderBookBase(const std::string& instrument_name, uint32_t symbol_id)
+    : instrument_name_(instrument_name), symbol_id_(symbol_id) {
+}
+
 // Constructor for OrderBook, initializes with the instrument name
-OrderBook::OrderBook(const std::string& instrument_name)
-    : instrument_name_(instrument_name) {
+OrderBook::OrderBook(const std::string& instrument_name, uint32_t symbol_id)
+    : OrderBookBase(instrument_name, symbol_id),
+      bids_(PoolAllocator<std::pair<const double, PriceLevel>>(node_pool_)),
+      asks_(PoolAllocator<std::pair<const double, PriceLevel>>(node_pool_)) {
+}
+
+// pick the order book implementation by name
+std::unique_ptr<OrderBookBase> createOrderBook(const std::string& book_type, const std::string& instrument_name,
+                                               uint32_t symbol_id) {
+    if (book_type == "ladder") {
+        return std::make_unique<LadderOrderBook>(instrument_name, symbol_id);
+    }
+    return std::make_unique<OrderBook>(instrument_name, symbol_id);
+}
+
+// every output record goes through here, so the allocations of the output are counted in one place
+// (there should be none: the report is a plain struct copied into the ring)
+void OrderBookBase::emitOutputRecord(unsigned long long event_timestamp, long long order_id, Side side, OrderType type,
+                                     unsigned long long quantity, double price, OrderAction action, OrderStatus status,
+                                     unsigned long long executed_quantity, double execution_price, long long counterparty_id) {
+    unsigned long long allocations_before = alloc_counter::thread_allocations();
+    ExecutionReport report;
+    fillOutputRecord(report, event_timestamp, order_id, side, type, quantity, price, action, status,
+                     executed_quantity, execution_price, counterparty_id);
+    pushRecord(report); // Push the report to the output ring (blocks while it is full)
+    output_allocations_ += alloc_counter::thread_allocations() - allocations_before;
+}
+
+void OrderBookBase::fillOutputRecord(ExecutionReport& report, unsigned long long event_timestamp, long long order_id,
+                                     Side side, OrderType type, unsigned long long quantity, double price,
+                                     OrderAction action, OrderStatus status, unsigned long long executed_quantity,
+                                     double execution_price, long long counterparty_id) {
+    report.sequence = current_sequence_;
+    report.timestamp = event_timestamp;
+    report.order_id = order_id;
+    report.quantity = quantity;
+    report.price = price;
+    report.executed_quantity = executed_quantity;
+    report.execution_price = execution_price;
+    report.counterparty_id = counterparty_id;
+    report.symbol_id = symbol_id_;
+    report.side = side;
+    report.type = type;
+    report.action = action;
+    report.status = status;
+    if (executed_quantity > 0) {
+        execution_reports_++;
+        last_trade_price_ = execution_price;
+        has_last_trade_ = true;
+    } else if (status == OrderStatus::CANCELED) {
+        cancel_reports_++;
+    } else if (status == OrderStatus::REJECTED) {
+        reject_reports_++;
+    }
+}
+
+// the fills of a sweep go to the output in one push (one wake-up of the writer instead of one per report)
+void OrderBookBase::flushFillBatch(FillBatch& batch) {
+    if (batch.size == 0) {
+        return;
+    }
+    unsigned long long allocations_before = alloc_counter::thread_allocations();
+    pushRecords(batch.records, batch.size);
+    batch.size = 0;
+    output_allocations_ += alloc_counter::thread_allocations() - allocations_before;
 }
 
+// put an order at the back of its price level (FIFO) and remember where it is
+void OrderBook::restOrder(const Order& order) {
+    touchLevel(order.side, levelKey(order.price), order.price);
+    PriceLevel* level = nullptr;
+    if (order.side == Side::BUY) {
+        level = &bids_.try_emplace(order.price, PoolAllocator<Order>(node_pool_)).first->second;
+    } else {
+        level = &asks_.try_emplace(order.price, PoolAllocator<Order>(node_pool_)).first->second;
+    }
+    level->orders.push_back(order);
+    level->total_quantity += order.remaining_quantity;
+    level->hidden_quantity += order.hidden_quantity;
+    countRestingOrder(order.account_id);
+    order_index_.insert_or_assign(order.order_id, OrderLocation{std::prev(level->orders.end())});
+}
 
+long long OrderBook::levelKey(double price) {
+    long long key;
+    std::memcpy(&key, &price, sizeof(key));
+    return key;
+}
+
+// forget a resting order. If the same id was reused by a newer resting order, the index points
+// to the newer one and we must leave it alone
+void OrderBook::unindexOrder(long long order_id, OrderList::iterator position) {
+    order_index_.eraseIf(order_id, [&](const OrderLocation& location) { return location.position == position; });
+}
+
+// O(1) removal of a resting order (used by MODIFY and CANCEL)
+// returns false if the order is not resting in this book
+bool OrderBook::removeRestingOrder(long long order_id, Order& removed_order) {
+    OrderLocation location;
+    if (!order_index_.extract(order_id, location)) {
+        return false;
+    }
+
+    removed_order = *location.position; // copy of the order
+    uncountRestingOrder(removed_order.account_id);
+    touchLevel(removed_order.side, levelKey(removed_order.price), removed_order.price);
+    if (removed_order.side == Side::BUY) {
+        auto level_iter = bids_.find(removed_order.price);
+        level_iter->second.total_quantity -= removed_order.remaining_quantity;
+        level_iter->second.hidden_quantity -= removed_order.hidden_quantity;
+        level_iter->second.orders.erase(location.position);
+        if (level_iter->second.orders.empty()) {
+            bids_.erase(level_iter);
+        }
+    } else {
+        auto level_iter = asks_.find(removed_order.price);
+        level_iter->second.total_quantity -= removed_order.remaining_quantity;
+        level_iter->second.hidden_quantity -= removed_order.hidden_quantity;
+        level_iter->second.orders.erase(location.position);
+        if (level_iter->second.orders.empty()) {
+            asks_.erase(level_iter);
+        }
+    }
+    return true;
+}
+
+
+
+void OrderBookBase::expireUnfilledRest(const Order& order, unsigned long long event_timestamp) {
+    if (order.remaining_quantity > 0) {
+        addInitialOutputRecord(order, OrderStatus::CANCELED, 0, 0.0, 0, event_timestamp);
+    }
+}
+
+// does the opposite side have enough quantity for the whole order, within its limit price.
+// With the self-trade prevention (self_account != 0), a level that holds an order of the same account
+// fails it too: the sweep would stop or skip there, the order could not trade completely for sure
+template <typename Levels>
+static bool canFillCompletely(const Levels& levels, const Order& order, bool is_market, uint32_t self_account) {
+    const bool incoming_is_buy = (order.side == Side::BUY);
+    unsigned long long available = 0;
+    for (const auto& level : levels) {
+        if (available >= order.remaining_quantity) {
+            break;
+        }
+        if (!is_market && (incoming_is_buy ? (level.first > order.price) : (level.first < order.price))) {
+            break;
+        }
+        available += level.second.total_quantity;
+        if (self_account != 0) {
+            for (const Order& resting_order : level.second.orders) {
+                if (resting_order.account_id == self_account) {
+                    return false;
+                }
+            }
+        }
+    }
+    return available >= order.remaining_quantity;
+}
+
+bool OrderBook::passesEntryChecks(const Order& order, bool is_market) const {
+    if (order.post_only) {
+        // the best opposite price crosses its limit: it would trade
+        if (order.side == Side::BUY ? (!asks_.empty() && asks_.begin()->first <= order.price)
+                                    : (!bids_.empty() && bids_.begin()->first >= order.price)) {
+            return false;
+        }
+    }
+    if (order.time_in_force == TimeInForce::FOK) {
+        const uint32_t self_account = selfTradeAccount(order);
+        return order.side == Side::BUY ? canFillCompletely(asks_, order, is_market, self_account)
+                                       : canFillCompletely(bids_, order, is_market, self_account);
+    }
+    return true;
+}
 
-void OrderBook::addInitialOutputRecord(const Order& order_state_for_log, OrderStatus status_to_log, 
+void OrderBookBase::addInitialOutputRecord(const Order& order_state_for_log, OrderStatus status_to_log, 
     unsigned long long executed_qty_this_event, double exec_price, long long counterparty, 
     unsigned long long event_timestamp) {
     unsigned long long quantity_for_output_column = 0;
@@ -32,10 +209,9 @@ void OrderBook::addInitialOutputRecord(const Order& order_state_for_log, OrderSt
     double price_for_output_column = (status_to_log == OrderStatus::CANCELED) ? 0.0 : order_state_for_log.price;
     
     // output
-    auto outputrec = OutputRecord(
+    emitOutputRecord(
         event_timestamp,
         order_state_for_log.order_id,
-        instrument_name_, 
         order_state_for_log.side,
         order_state_for_log.type,
         quantity_for_output_column, 
@@ -46,86 +222,16 @@ void OrderBook::addInitialOutputRecord(const Order& order_state_for_log, OrderSt
         exec_price,     
         counterparty    
     );
-
-    // convert the output in a string
-    std::stringstream ss;
-    ss << outputrec;
-    output_log_queue_->push(ss.str()); // Push the output record to the thread-safe queue
 }
 
 
-// Match between 2 orders, and create the output necessary
-void OrderBook::recordMatchAndCreateOutput(Order& aggressive_order, Order& passive_order,
-                                        unsigned long long matched_qty, double match_price, unsigned long long event_timestamp) {
-    
-    // aggressive order = order that starts the trade
-    aggressive_order.remaining_quantity -= matched_qty;   // reduce the remainging quantity by the amount that has been traded
-    aggressive_order.cumulative_executed_quantity += matched_qty; // add the executed quantity to the cumulative
-    // if there's nothing else to execute : Order Status is EXECUTED. Else its PARTIALLY EXECUTED
-    aggressive_order.status = (aggressive_order.remaining_quantity == 0) ? OrderStatus::EXECUTED : OrderStatus::PARTIALLY_EXECUTED;
-
-    // passive order = order already in the book, and has just foudn a match
-    passive_order.remaining_quantity -= matched_qty;
-    passive_order.cumulative_executed_quantity += matched_qty;
-    passive_order.status = (passive_order.remaining_quantity == 0) ? OrderStatus::EXECUTED : OrderStatus::PARTIALLY_EXECUTED;
-
-    // save the IDs of the orders that have been matched
-    ids_traded_this_event_.insert(aggressive_order.order_id);
-    ids_traded_this_event_.insert(passive_order.order_id);
-
-    // if executed : remaining quantity is 0, else its the remaining quantity
-    unsigned long long aggressive_qty_for_output = (aggressive_order.status == OrderStatus::EXECUTED) ? 0 : aggressive_order.remaining_quantity;
-    unsigned long long passive_qty_for_output = (passive_order.status == OrderStatus::EXECUTED) ? 0 : passive_order.remaining_quantity;
-
-    // output for agressive order
-    auto outputrec1 = OutputRecord(
-        event_timestamp, 
-        aggressive_order.order_id, 
-        instrument_name_,
-        aggressive_order.side, 
-        aggressive_order.type, 
-        aggressive_qty_for_output, 
-        aggressive_order.price,    
-        aggressive_order.action,   
-        aggressive_order.status,   
-        matched_qty,  // what was just traded
-        match_price,  // price of transaction
-        passive_order.order_id  // counterparty ID
-    );
-
-    // output for passive order
-    auto outputrec2 = OutputRecord(
-        event_timestamp, 
-        passive_order.order_id, 
-        instrument_name_,
-        passive_order.side, 
-        passive_order.type, 
-        passive_qty_for_output, 
-        passive_order.price,    
-        passive_order.action,   
-        passive_order.status,   
-        matched_qty, 
-        match_price, 
-        aggressive_order.order_id // counterparty ID
-    );
-
-    // convert the output records to strings
-    std::stringstream ss1;
-    std::stringstream ss2;
-    ss1 << outputrec1;
-    ss2 << outputrec2;
-    output_log_queue_->push(ss1.str()); // Push the output record to the thread-safe queue
-    output_log_queue_->push(ss2.str()); // Push the output record to the thread-safe queue
-
-}
-
 // This function initializes the book for one order
 void OrderBook::processSingleOrder(Order& incoming_order_request) { 
     unsigned long long current_event_timestamp = incoming_order_request.timestamp;
 
     // check if the order arriving is for the correct instrument of the book
-    if (incoming_order_request.instrument != instrument_name_) {
-        std::cerr << "Error: Order " << incoming_order_request.order_id << " for instrument " << incoming_order_request.instrument
+    if (incoming_order_request.symbol_id != symbol_id_) {
+        std::cerr << "Error: Order " << incoming_order_request.order_id << " for symbol id " << incoming_order_request.symbol_id
                   << " sent to OrderBook for " << instrument_name_ << std::endl;
         // if not the good instrument : reject order
         addInitialOutputRecord(incoming_order_request, OrderStatus::REJECTED, 0, 0.0, 0, current_event_timestamp);
@@ -140,145 +246,57 @@ void OrderBook::processSingleOrder(Order& incoming_order_request) {
         incoming_order_request.status = OrderStatus::PENDING; 
     }
 
-    // clear the IDs of the orders that have just matched
-    ids_traded_this_event_.clear(); 
-
     // NEW orders processing
     if (incoming_order_request.action == OrderAction::NEW) {
-        Order order_to_process = incoming_order_request; 
+        // work directly on the incoming order (the book keeps its own copy when it rests)
+        Order& order_to_process = incoming_order_request; 
         // LIMIT orders are added to the book
         if (order_to_process.type == OrderType::LIMIT) {
-            if (order_to_process.side == Side::BUY) {
-                // if it s a BUY we add it to the bids
-                bids_[order_to_process.price].push_back(order_to_process);
-            } else { 
-                // else its in the asks
-                asks_[order_to_process.price].push_back(order_to_process);
+            // a post-only order that would trade, or a FOK order that cannot trade completely, is only rejected
+            if (!passesEntryChecks(order_to_process, false)) {
+                addInitialOutputRecord(order_to_process, OrderStatus::REJECTED, 0, 0.0, 0, current_event_timestamp);
+                return;
             }
-
             addInitialOutputRecord(order_to_process, OrderStatus::PENDING, 0, 0.0, 0, current_event_timestamp);
-            // try to match the order with the book
-            matchOrders(current_event_timestamp);
-            
+            // a NEW order takes over the index entry of a resting order with the same id,
+            // even if it does not rest (it is fully executed right away)
+            order_index_.erase(order_to_process.order_id);
+            // match first, then rest what is left: BUY orders go to the bids, SELL orders to the asks
+            // (an order that crossed but has nothing left, e.g. a zero quantity, does not rest)
+            size_t fills = sweep(order_to_process, false, current_event_timestamp);
+            if (order_to_process.time_in_force != TimeInForce::GTC || self_trade_stopped_) {
+                // IOC and FOK never rest, nor an order stopped by the self-trade prevention
+                expireUnfilledRest(order_to_process, current_event_timestamp);
+            } else if (order_to_process.remaining_quantity > 0 || fills == 0) {
+                startIcebergSlice(order_to_process);
+                restOrder(order_to_process);
+            }
+
         // MARKET order : immediate execution against the best available price in the book
         } else if (order_to_process.type == OrderType::MARKET) {
             unsigned long long initial_market_order_qty = order_to_process.remaining_quantity;
-
-            if (order_to_process.side == Side::BUY) {
-                // if its a BUY market order, we try to match it with the best asks
-                while (order_to_process.remaining_quantity > 0 && !asks_.empty()) {
-                    auto best_ask_level_iter = asks_.begin(); 
-                    std::list<Order>& orders_at_best_ask = best_ask_level_iter->second;
-                    
-                    if (orders_at_best_ask.empty()){ 
-                        asks_.erase(best_ask_level_iter); 
-                        continue;
-                    }
-                    Order& resting_sell_order = orders_at_best_ask.front(); 
-                    
-                    double match_price = resting_sell_order.price; 
-                    unsigned long long match_qty = std::min(order_to_process.remaining_quantity, resting_sell_order.remaining_quantity);
-
-                    // save the transaction
-                    recordMatchAndCreateOutput(order_to_process, resting_sell_order, match_qty, match_price, current_event_timestamp);
-
-                    // delete the passive order if it has found a counterparty and has been fully executed
-                    if (resting_sell_order.remaining_quantity == 0) {
-                        orders_at_best_ask.pop_front();
-                        if (orders_at_best_ask.empty()) {
-                            asks_.erase(best_ask_level_iter);
-                        }
-                    }
-                    if (order_to_process.remaining_quantity == 0) break;
-                }
-
-            // if its a SELL market order, we try to match it with the best bids
-            } else { 
-                while (order_to_process.remaining_quantity > 0 && !bids_.empty()) {
-                    auto best_bid_level_iter = bids_.begin(); 
-                    std::list<Order>& orders_at_best_bid = best_bid_level_iter->second;
-
-                     if (orders_at_best_bid.empty()){ 
-                        bids_.erase(best_bid_level_iter);
-                        continue;
-                    }
-                    Order& resting_buy_order = orders_at_best_bid.front(); 
-
-                    double match_price = resting_buy_order.price;
-                    unsigned long long match_qty = std::min(order_to_process.remaining_quantity, resting_buy_order.remaining_quantity);
-                    
-                    recordMatchAndCreateOutput(order_to_process, resting_buy_order, match_qty, match_price, current_event_timestamp);
-
-                    if (resting_buy_order.remaining_quantity == 0) {
-                        orders_at_best_bid.pop_front();
-                        if (orders_at_best_bid.empty()) {
-                            bids_.erase(best_bid_level_iter);
-                        }
-                    }
-                    if (order_to_process.remaining_quantity == 0) break;
-                }
+            // sweep the asks for a BUY, the bids for a SELL, at the resting prices
+            // (a FOK market order that cannot trade completely does not trade, and is rejected below)
+            if (order_to_process.remaining_quantity > 0 && passesEntryChecks(order_to_process, true)) {
+                sweep(order_to_process, true, current_event_timestamp);
             }
-            
+
             // if the market order has not been able to execute any quantity, we reject it
-            if (order_to_process.cumulative_executed_quantity == 0 && initial_market_order_qty > 0) { 
+            // (unless the self-trade prevention stopped it: its rest is canceled)
+            if (self_trade_stopped_) {
+                expireUnfilledRest(order_to_process, current_event_timestamp);
+            } else if (order_to_process.cumulative_executed_quantity == 0 && initial_market_order_qty > 0) { 
                  addInitialOutputRecord(order_to_process, OrderStatus::REJECTED, 0, 0.0, 0, current_event_timestamp); 
             }
         }
 
     // MODIFY order
     } else if (incoming_order_request.action == OrderAction::MODIFY) {
-        // indicate if we found the original order to modify (yes or no)
-        bool found_original_order = false;
-        Order existing_order_copy; 
-        std::vector<double> price_levels_to_erase_bids;
-        std::vector<double> price_levels_to_erase_asks;
-
-
-        // when we receive a MOODIFY order, we need to find the original order in the book,
+        // when we receive a MODIFY order, we need to find the original order in the book,
         // delete it from the book, modify it, and then re-add it to the book.
-        // This lambda function does that. we use a lmabda function to access every local variables
-        // without passing them as parameters like we do in a classic function
-        auto find_and_remove_from_list = 
-            [&](std::list<Order>& order_list, long long target_order_id, Order& copy_target) -> bool {
-            for (auto it = order_list.begin(); it != order_list.end(); ++it) {
-                if (it->order_id == target_order_id) {
-                    copy_target = *it;  // copy of the order
-                    order_list.erase(it); // delete it from the book
-                    return true;
-                }
-            }
-            return false; // if not found
-        };
-
-        // look at every price level in the bids
-        for (auto map_iter = bids_.begin(); map_iter != bids_.end(); ++map_iter) {
-            // if we find the order, we copy it and delete it from the book using our lambda function
-            if (find_and_remove_from_list(map_iter->second, incoming_order_request.order_id, existing_order_copy)) {
-                if (map_iter->second.empty()) {
-                    price_levels_to_erase_bids.push_back(map_iter->first);
-                }
-                // order found, we can stop looking
-                found_original_order = true;
-                break;
-            }
-        }
-        for(double p : price_levels_to_erase_bids) { bids_.erase(p); }
-
-        // if we didn't find the order in the bids, we look at the asks
-        if (!found_original_order) { 
-            for (auto map_iter = asks_.begin(); map_iter != asks_.end(); ++map_iter) {
-                // if we find the order, we copy it and delete it from the book using our lambda function
-                if (find_and_remove_from_list(map_iter->second, incoming_order_request.order_id, existing_order_copy)) {
-                    if (map_iter->second.empty()) {
-                       price_levels_to_erase_asks.push_back(map_iter->first);
-                    }
-                    // order found, we can stop looking
-                    found_original_order = true;
-                    break;
-                }
-            }
-            for(double p : price_levels_to_erase_asks) { asks_.erase(p); }
-        }
+        // The order index gives us its exact position, so no scan of the price levels is needed
+        Order modified_order; 
+        bool found_original_order = removeRestingOrder(incoming_order_request.order_id, modified_order);
 
         // if we didn't find the order in the bids or in the asks, we reject the MODIFY order
         if (!found_original_order) {
@@ -287,12 +305,16 @@ void OrderBook::processSingleOrder(Order& incoming_order_request) {
         }
 
 
-        Order modified_order = existing_order_copy; 
         modified_order.timestamp = current_event_timestamp; // Use MODIFY event's timestamp
         modified_order.price = incoming_order_request.price;       // Update price   
+        modified_order.price_ticks = incoming_order_request.price_ticks;
         modified_order.quantity = incoming_order_request.quantity;   // Update quantity
         modified_order.action = OrderAction::MODIFY;  // Set action to MODIFY
         modified_order.type = incoming_order_request.type;  // Update type of order    
+        modified_order.time_in_force = incoming_order_request.time_in_force; // and its extended attributes
+        modified_order.post_only = incoming_order_request.post_only;
+        modified_order.display_quantity = incoming_order_request.display_quantity;
+        modified_order.hidden_quantity = 0; // the whole rest of the order can trade before it rests again
 
         // check if the new quantity is valid
         if (modified_order.quantity <= modified_order.cumulative_executed_quantity) {
@@ -307,113 +329,47 @@ void OrderBook::processSingleOrder(Order& incoming_order_request) {
             modified_order.remaining_quantity = modified_order.quantity - modified_order.cumulative_executed_quantity;
             modified_order.status = OrderStatus::PENDING; 
 
-            Order order_to_readd = modified_order; 
+            Order& order_to_readd = modified_order; 
 
             // push back the modified order to the book
             if (order_to_readd.type == OrderType::LIMIT) {
-                 if (order_to_readd.side == Side::BUY) {
-                    bids_[order_to_readd.price].push_back(order_to_readd);
-                } else { 
-                    asks_[order_to_readd.price].push_back(order_to_readd);
-                }
-                
-
-                bool traded_in_match = false;
-                long long temp_id = order_to_readd.order_id; 
-                
-                // After re-adding the order, we try to match it immediately
-                matchOrders(current_event_timestamp);
-
-                if (ids_traded_this_event_.count(temp_id)) {
-                    traded_in_match = true;
+                // the order is already out of the book: a post-only MODIFY that would trade, or a FOK MODIFY
+                // that cannot trade completely, leaves it out (like a MODIFY to MARKET with no liquidity)
+                if (!passesEntryChecks(order_to_readd, false)) {
+                    addInitialOutputRecord(order_to_readd, OrderStatus::REJECTED, 0, 0.0, 0, current_event_timestamp);
+                    return;
                 }
-
-                // point to the final resting order after the match
-                Order* final_resting_order_ptr = nullptr;
-                if (order_to_readd.side == Side::BUY && bids_.count(order_to_readd.price)) {
-                    for (Order& o : bids_.at(order_to_readd.price)) { if (o.order_id == temp_id) { final_resting_order_ptr = &o; break; } }
-                } else if (order_to_readd.side == Side::SELL && asks_.count(order_to_readd.price)) {
-                    for (Order& o : asks_.at(order_to_readd.price)) { if (o.order_id == temp_id) { final_resting_order_ptr = &o; break; } }
-                }
-
-                if (final_resting_order_ptr && !traded_in_match) { // If it rests and wasn't part of the immediate match
-                     addInitialOutputRecord(*final_resting_order_ptr, final_resting_order_ptr->status, 0, 0.0, 0, current_event_timestamp);
+                // match first, then rest what is left at the back of its new level
+                size_t fills = sweep(order_to_readd, false, current_event_timestamp);
+                if (order_to_readd.time_in_force != TimeInForce::GTC || self_trade_stopped_) {
+                    expireUnfilledRest(order_to_readd, current_event_timestamp);
+                } else if (order_to_readd.remaining_quantity > 0) {
+                    startIcebergSlice(order_to_readd);
+                    restOrder(order_to_readd);
+                    // only report the resting order if it did not trade right away
+                    if (fills == 0) {
+                        addInitialOutputRecord(order_to_readd, order_to_readd.status, 0, 0.0, 0, current_event_timestamp);
+                    }
                 }
 
-
             } else if (order_to_readd.type == OrderType::MARKET) {
                 unsigned long long initial_mod_market_qty = order_to_readd.remaining_quantity;
                 unsigned long long cum_exec_before_market_sweep = order_to_readd.cumulative_executed_quantity;
-
-                if (order_to_readd.side == Side::BUY) {
-                    while (order_to_readd.remaining_quantity > 0 && !asks_.empty()) { 
-                        auto iter = asks_.begin(); 
-                        if (iter->second.empty()) { asks_.erase(iter); continue; }
-                        Order& resting = iter->second.front();
-                        double m_price = resting.price; unsigned long long m_qty = std::min(order_to_readd.remaining_quantity, resting.remaining_quantity);
-                        recordMatchAndCreateOutput(order_to_readd, resting, m_qty, m_price, current_event_timestamp);
-                        if(resting.remaining_quantity == 0) { iter->second.pop_front(); if(iter->second.empty()) asks_.erase(iter); }
-                        if(order_to_readd.remaining_quantity == 0) break;
-                    }
-                } else { 
-                    while (order_to_readd.remaining_quantity > 0 && !bids_.empty()) { 
-                        auto iter = bids_.begin(); 
-                        if (iter->second.empty()) { bids_.erase(iter); continue; }
-                        Order& resting = iter->second.front();
-                        double m_price = resting.price; unsigned long long m_qty = std::min(order_to_readd.remaining_quantity, resting.remaining_quantity);
-                        recordMatchAndCreateOutput(order_to_readd, resting, m_qty, m_price, current_event_timestamp);
-                        if(resting.remaining_quantity == 0) { iter->second.pop_front(); if(iter->second.empty()) bids_.erase(iter); }
-                        if(order_to_readd.remaining_quantity == 0) break;
-                    }
+                if (passesEntryChecks(order_to_readd, true)) {
+                    sweep(order_to_readd, true, current_event_timestamp);
                 }
-                if (order_to_readd.cumulative_executed_quantity == cum_exec_before_market_sweep && initial_mod_market_qty > 0) { 
+                if (self_trade_stopped_) {
+                    expireUnfilledRest(order_to_readd, current_event_timestamp);
+                } else if (order_to_readd.cumulative_executed_quantity == cum_exec_before_market_sweep && initial_mod_market_qty > 0) { 
                      addInitialOutputRecord(order_to_readd, OrderStatus::REJECTED, 0, 0.0, 0, current_event_timestamp); 
                 }
             }
         }
 
     } else if (incoming_order_request.action == OrderAction::CANCEL) {
-        bool found_and_cancelled = false;
+        // jump straight to the resting order through the index
         Order order_being_cancelled_data; 
-
-        std::vector<double> price_levels_to_erase_bids_cancel;
-        std::vector<double> price_levels_to_erase_asks_cancel;
-        
-        auto find_and_remove_for_cancel = 
-            [&](std::list<Order>& order_list, long long target_order_id, Order& copy_target) -> bool {
-            for (auto it = order_list.begin(); it != order_list.end(); ++it) {
-                if (it->order_id == target_order_id) {
-                    copy_target = *it; 
-                    order_list.erase(it);
-                    return true;
-                }
-            }
-            return false;
-        };
-
-        for (auto map_iter = bids_.begin(); map_iter != bids_.end(); ++map_iter) {
-            if (find_and_remove_for_cancel(map_iter->second, incoming_order_request.order_id, order_being_cancelled_data)) {
-                if (map_iter->second.empty()) {
-                    price_levels_to_erase_bids_cancel.push_back(map_iter->first);
-                }
-                found_and_cancelled = true;
-                break;
-            }
-        }
-        for(double p : price_levels_to_erase_bids_cancel) { bids_.erase(p); }
-
-        if (!found_and_cancelled) {
-            for (auto map_iter = asks_.begin(); map_iter != asks_.end(); ++map_iter) {
-                 if (find_and_remove_for_cancel(map_iter->second, incoming_order_request.order_id, order_being_cancelled_data)) {
-                    if (map_iter->second.empty()) {
-                        price_levels_to_erase_asks_cancel.push_back(map_iter->first);
-                    }
-                    found_and_cancelled = true;
-                    break;
-                }
-            }
-            for(double p : price_levels_to_erase_asks_cancel) { asks_.erase(p); }
-        }
+        bool found_and_cancelled = removeRestingOrder(incoming_order_request.order_id, order_being_cancelled_data);
 
         if (found_and_cancelled) {
             order_being_cancelled_data.timestamp = current_event_timestamp; 
@@ -432,107 +388,333 @@ void OrderBook::processSingleOrder(Order& incoming_order_request) {
 
 
 
-void OrderBook::matchOrders(unsigned long long event_timestamp) {
-    // as long as there is a bid and an ask, we try to match them
-    while (!bids_.empty() && !asks_.empty()) {
-        // bids (and asks) is a map with prices as keys, and lists of orders as values
-        // its in descending order, so the best bid is the first element (so we use begin)
-        auto best_bid_level_map_iter = bids_.begin(); 
-        auto best_ask_level_map_iter = asks_.begin(); 
-        double best_bid_price = best_bid_level_map_iter->first;
-        double best_ask_price = best_ask_level_map_iter->first;
+// Walk the opposite side from the best price, and consume the orders of each level in a tight loop.
+// Returns the number of fills.
+// The match price and the order of the two output records:
+// - MARKET orders trade at the resting price, and the market order is reported first
+// - LIMIT orders trade at the price of the order that arrived first (the bid price on a tie),
+//   and the buy side is reported first
+size_t OrderBook::sweep(Order& incoming_order, bool is_market, unsigned long long event_timestamp) {
+    FillBatch fills_batch;
+    size_t fills = (incoming_order.side == Side::BUY)
+                       ? sweepSide(asks_, Side::SELL, incoming_order, is_market, event_timestamp, fills_batch)
+                       : sweepSide(bids_, Side::BUY, incoming_order, is_market, event_timestamp, fills_batch);
+    flushFillBatch(fills_batch);
+    return fills;
+}
 
-        // if the best bid price is lower than the best ask price, we cannot match
-        if (best_bid_price < best_ask_price) { 
-            break; 
+// bids_ and asks_ are maps of different types (their order is not the same): one sweep for both
+template <typename Levels>
+size_t OrderBook::sweepSide(Levels& levels, Side resting_side, Order& incoming_order, bool is_market,
+                            unsigned long long event_timestamp, FillBatch& fills_batch) {
+    const bool incoming_is_buy = (incoming_order.side == Side::BUY);
+    size_t fills = 0;
+
+    auto level_iter = levels.begin();
+    while (level_iter != levels.end()) {
+        const double level_price = level_iter->first;
+        // a LIMIT order stops as soon as the best opposite price does not cross its limit
+        if (!is_market) {
+            if (incoming_is_buy ? (level_price > incoming_order.price) : (level_price < incoming_order.price)) {
+                break;
+            }
         }
 
-        // get the lists of orders at the best bid and ask prices
-        std::list<Order>& orders_at_best_bid = best_bid_level_map_iter->second;
-        std::list<Order>& orders_at_best_ask = best_ask_level_map_iter->second;
-        
-
-        if (orders_at_best_bid.empty()){ bids_.erase(best_bid_level_map_iter); continue; }
-        if (orders_at_best_ask.empty()){ asks_.erase(best_ask_level_map_iter); continue; }
-
-        // get the first orders in the lists (the best orders at the best bid and ask prices)
-        Order& buy_order = orders_at_best_bid.front();  
-        Order& sell_order = orders_at_best_ask.front(); 
-
-
-        double match_price;
-        if (buy_order.timestamp < sell_order.timestamp) { 
-            // if the buy order arrived first, we use its price
-            match_price = buy_order.price; 
-        } else if (sell_order.timestamp < buy_order.timestamp) { 
-            // if the sell order arrived first, we use its price
-            match_price = sell_order.price; 
-        } else { 
-        // if bid = ask, we use the best bid price
-            match_price = best_bid_price; 
-        }
-        
-        // calculate the quantity to match : the minimum of the available quantities
-        unsigned long long match_qty = std::min(buy_order.remaining_quantity, sell_order.remaining_quantity);
+        PriceLevel& level = level_iter->second;
+        touchLevel(resting_side, levelKey(level_price), level_price);
+        while (!level.orders.empty()) {
+            Order& resting_order = level.orders.front();
+
+            // self-trade prevention: the two orders of one account do not trade
+            if (isSelfTrade(incoming_order.account_id, resting_order.account_id)) {
+                self_trades_prevented_++;
+                if (self_trade_prevention_ != SelfTradePrevention::CANCEL_INCOMING) {
+                    addFillRecord(fills_batch, event_timestamp, resting_order.order_id, resting_order.side,
+                                  resting_order.type, 0, 0.0, resting_order.action, OrderStatus::CANCELED, 0, 0.0, 0);
+                    level.total_quantity -= resting_order.remaining_quantity;
+                    level.hidden_quantity -= resting_order.hidden_quantity;
+                    uncountRestingOrder(resting_order.account_id);
+                    unindexOrder(resting_order.order_id, level.orders.begin());
+                    level.orders.pop_front();
+                }
+                if (self_trade_prevention_ != SelfTradePrevention::CANCEL_RESTING) {
+                    self_trade_stopped_ = true; // the caller cancels the rest of the incoming order
+                    break;
+                }
+                continue;
+            }
 
-        // execute the trade
-        recordMatchAndCreateOutput(buy_order, sell_order, match_qty, match_price, event_timestamp);
+            double match_price;
+            if (is_market) {
+                match_price = resting_order.price;
+            } else if (incoming_is_buy) {
+                match_price = (resting_order.timestamp < incoming_order.timestamp) ? resting_order.price : incoming_order.price;
+            } else {
+                match_price = (incoming_order.timestamp < resting_order.timestamp) ? incoming_order.price : resting_order.price;
+            }
+            // only the shown part of a resting iceberg trades (the whole order for the others)
+            unsigned long long match_qty = std::min(incoming_order.remaining_quantity,
+                                                    resting_order.remaining_quantity - resting_order.hidden_quantity);
+
+            incoming_order.remaining_quantity -= match_qty;
+            incoming_order.cumulative_executed_quantity += match_qty;
+            incoming_order.status = (incoming_order.remaining_quantity == 0) ? OrderStatus::EXECUTED : OrderStatus::PARTIALLY_EXECUTED;
+            resting_order.remaining_quantity -= match_qty;
+            resting_order.cumulative_executed_quantity += match_qty;
+            resting_order.status = (resting_order.remaining_quantity == 0) ? OrderStatus::EXECUTED : OrderStatus::PARTIALLY_EXECUTED;
+            level.total_quantity -= match_qty;
+            fills++;
+
+            // the two records of the fill (the remaining quantity is 0 once an order is executed)
+            auto add_incoming = [&]() {
+                addFillRecord(fills_batch, event_timestamp, incoming_order.order_id, incoming_order.side, incoming_order.type,
+                              incoming_order.remaining_quantity, incoming_order.price, incoming_order.action,
+                              incoming_order.status, match_qty, match_price, resting_order.order_id);
+            };
+            auto add_resting = [&]() {
+                addFillRecord(fills_batch, event_timestamp, resting_order.order_id, resting_order.side, resting_order.type,
+                              resting_order.remaining_quantity, resting_order.price, resting_order.action,
+                              resting_order.status, match_qty, match_price, incoming_order.order_id);
+            };
+            if (is_market || incoming_is_buy) {
+                add_incoming();
+                add_resting();
+            } else {
+                add_resting();
+                add_incoming();
+            }
 
-        // if the oerder is completely executed, we remove it from the book
-        if (buy_order.remaining_quantity == 0) {
-            orders_at_best_bid.pop_front();
-        }
-        if (sell_order.remaining_quantity == 0) {
-            orders_at_best_ask.pop_front();
+            // the resting order is fully executed: it leaves the book
+            if (resting_order.remaining_quantity == 0) {
+                uncountRestingOrder(resting_order.account_id);
+                unindexOrder(resting_order.order_id, level.orders.begin());
+                level.orders.pop_front();
+            } else if (resting_order.remaining_quantity == resting_order.hidden_quantity) {
+                // an iceberg showed all it had: the next slice goes to the back of the level
+                // (splice keeps the node, so the index still points to it)
+                level.hidden_quantity -= refillIcebergSlice(resting_order.display_quantity, resting_order.hidden_quantity);
+                level.orders.splice(level.orders.end(), level.orders, level.orders.begin());
+            }
+            if (incoming_order.remaining_quantity == 0) {
+                break;
+            }
         }
 
-        if (orders_at_best_bid.empty()) {
-            bids_.erase(best_bid_level_map_iter); 
+        if (level.orders.empty()) {
+            level_iter = levels.erase(level_iter);
         }
-        if (orders_at_best_ask.empty()) {
-            asks_.erase(best_ask_level_map_iter); 
+        if (incoming_order.remaining_quantity == 0 || self_trade_stopped_) {
+            break;
         }
     }
+    return fills;
 }
 
 // get the nam of the instrument associated with this book
-const std::string& OrderBook::getInstrumentName() const {
+const std::string& OrderBookBase::getInstrumentName() const {
     return instrument_name_;
 }
 
 
 
-void OrderBook::printOrderBookSnapshot() const {
-    std::cout << "---- Order Book Snapshot for: " << instrument_name_ << " ----" << std::endl;
-    
-    // Print the current state of the order book in the asks part
-    std::cout << "ASKS (Price: RemainingQty@OrderID Action Status):" << std::endl;
-    if (asks_.empty()) {
-        // if the asks are empty, we print <empty>
-        std::cout << "  <empty>" << std::endl;
-    } else {
-        for (const auto& [price, order_list] : asks_) {
-            std::cout << "  Price " << price << ": ";
-            for (const auto& order : order_list) {
-                std::cout << order.remaining_quantity << "@" << order.order_id 
-                          << "(" << orderActionToString(order.action) << "," << orderStatusToString(order.status) << ") ";
+// the bids map is sorted from the highest price and the asks map from the lowest,
+// and each level list is in time priority: walking them in order gives the priority order
+// every node of the book is in its pool, the order index is its flat array
+BookMemoryStats OrderBook::getMemoryStats() const {
+    BookMemoryStats memory;
+    memory.resting_orders = order_index_.size();
+    memory.levels = getLevelCount();
+    memory.pool_bytes = node_pool_.bytes();
+    memory.pool_used_bytes = node_pool_.used_bytes();
+    memory.other_bytes = order_index_.bytes();
+    return memory;
+}
+
+void OrderBook::collectRestingOrders(std::vector<Order>& out) const {
+    for (const auto& level : bids_) {
+        out.insert(out.end(), level.second.orders.begin(), level.second.orders.end());
+    }
+    for (const auto& level : asks_) {
+        out.insert(out.end(), level.second.orders.begin(), level.second.orders.end());
+    }
+}
+
+bool OrderBook::restoreRestingOrder(const Order& order) {
+    restOrder(order);
+    return true;
+}
+
+
+void OrderBookBase::enableMarketData(unsigned long long snapshot_interval) {
+    market_data_enabled_ = true;
+    market_data_snapshot_interval_ = snapshot_interval;
+}
+
+void OrderBookBase::enableRiskChecks(const std::shared_ptr<const RiskConfig>& config) {
+    self_trade_prevention_ = config->self_trade_prevention;
+    if (config->checks_enabled) {
+        risk_config_ = config;
+        open_orders_.reserve(64); // grows with the number of accounts resting in the book, never shrinks
+    }
+}
+
+// the reference price of the band is the last trade of the book, or the middle of its best prices
+// while it has not traded (a restored book has no last trade)
+bool OrderBookBase::passesRiskChecks(const Order& order) {
+    if (order.action != OrderAction::NEW && order.action != OrderAction::MODIFY) {
+        return true;
+    }
+    double reference_price = last_trade_price_;
+    if (!has_last_trade_) {
+        reference_price = 0.0;
+        if (risk_config_->price_band > 0.0 || order.type == OrderType::MARKET) {
+            LevelState best_bid{Side::BUY, 0, 0.0, 0, 0};
+            LevelState best_ask{Side::SELL, 0, 0.0, 0, 0};
+            readBestLevels(best_bid, best_ask);
+            if (best_bid.order_count > 0 && best_ask.order_count > 0) {
+                reference_price = (best_bid.price + best_ask.price) / 2.0;
             }
-            std::cout << std::endl;
         }
     }
+    const uint32_t* resting = open_orders_.find(order.account_id);
+    const uint32_t open_orders = resting != nullptr ? *resting : 0;
+    const RiskCheck check = checkOrderRisk(*risk_config_, order, reference_price, open_orders);
+    if (check == RiskCheck::PASSED) {
+        return true;
+    }
+    risk_rejects_[static_cast<size_t>(check)]++;
+    addInitialOutputRecord(order, OrderStatus::REJECTED, 0, 0.0, 0, order.timestamp);
+    return false;
+}
+
+void OrderBookBase::requestMarketDataSnapshot() {
+    if (market_data_enabled_) {
+        touched_levels_.clear(); // the snapshot gives the restored levels
+        market_data_snapshot_due_ = true;
+    }
+}
 
-    std::cout << "BIDS (Price: RemainingQty@OrderID Action Status):" << std::endl;
-    if (bids_.empty()) {
-        std::cout << "  <empty>" << std::endl;
+// keep the state of the level from before the order, only the first time the order touches it.
+// An order touches only a few levels (a sweep touches its levels one after the other),
+// so the last ones are checked first
+void OrderBookBase::recordTouchedLevel(Side side, long long key, double price) {
+    for (size_t i = touched_levels_.size(); i > 0; --i) {
+        const LevelState& touched = touched_levels_[i - 1];
+        if (touched.key == key && touched.side == side) {
+            return;
+        }
+    }
+    LevelState level{side, key, price, 0, 0};
+    readLevel(level);
+    touched_levels_.push_back(level);
+}
+
+void OrderBookBase::publishMarketData(unsigned long long event_timestamp) {
+    // one update per level changed by the order: its state now against its state before the order
+    for (const LevelState& before : touched_levels_) {
+        LevelState now = before;
+        now.quantity = 0;
+        now.order_count = 0;
+        readLevel(now);
+        if (before.order_count == 0 && now.order_count > 0) {
+            emitMarketData(event_timestamp, MarketDataKind::LEVEL_ADD, now.side, now.price, now.quantity, now.order_count);
+        } else if (before.order_count > 0 && now.order_count == 0) {
+            emitMarketData(event_timestamp, MarketDataKind::LEVEL_DELETE, now.side, now.price, 0, 0);
+        } else if (before.quantity != now.quantity || before.order_count != now.order_count) {
+            emitMarketData(event_timestamp, MarketDataKind::LEVEL_CHANGE, now.side, now.price, now.quantity, now.order_count);
+        }
+    }
+    touched_levels_.clear();
+
+    // then the top of the book, if it moved
+    LevelState best_bid{Side::BUY, 0, 0.0, 0, 0};
+    LevelState best_ask{Side::SELL, 0, 0.0, 0, 0};
+    readBestLevels(best_bid, best_ask);
+    auto same_top = [](const LevelState& a, const LevelState& b) {
+        return a.order_count == 0 ? b.order_count == 0
+                                  : b.order_count > 0 && a.price == b.price && a.quantity == b.quantity;
+    };
+    if (!same_top(best_bid, published_bid_) || !same_top(best_ask, published_ask_)) {
+        emitMarketData(event_timestamp, MarketDataKind::BBO, Side::UNKNOWN,
+                       best_bid.order_count > 0 ? best_bid.price : 0.0, best_bid.order_count > 0 ? best_bid.quantity : 0, 0,
+                       best_ask.order_count > 0 ? best_ask.price : 0.0, best_ask.order_count > 0 ? best_ask.quantity : 0);
+        published_bid_ = best_bid;
+        published_ask_ = best_ask;
+    }
+
+    orders_since_market_data_snapshot_++;
+    if (market_data_snapshot_interval_ > 0 && orders_since_market_data_snapshot_ >= market_data_snapshot_interval_) {
+        publishMarketDataSnapshot(event_timestamp);
+    }
+}
+
+void OrderBookBase::publishMarketDataSnapshot(unsigned long long event_timestamp) {
+    snapshot_levels_.clear();
+    collectLevels(snapshot_levels_);
+    emitMarketData(event_timestamp, MarketDataKind::SNAPSHOT_BEGIN, Side::UNKNOWN, 0.0, 0, snapshot_levels_.size());
+    for (const LevelState& level : snapshot_levels_) {
+        emitMarketData(event_timestamp, MarketDataKind::SNAPSHOT_LEVEL, level.side, level.price, level.quantity,
+                       level.order_count);
+    }
+    orders_since_market_data_snapshot_ = 0;
+    market_data_snapshot_due_ = false;
+}
+
+void OrderBookBase::emitMarketData(unsigned long long event_timestamp, MarketDataKind kind, Side side, double price,
+                                   unsigned long long quantity, unsigned long long order_count,
+                                   double ask_price, unsigned long long ask_quantity) {
+    MarketDataUpdate update;
+    update.sequence = current_sequence_;
+    update.timestamp = event_timestamp;
+    update.update_number = ++market_data_updates_;
+    update.symbol_id = symbol_id_;
+    update.kind = kind;
+    update.side = side;
+    update.price = price;
+    update.quantity = quantity;
+    update.order_count = order_count;
+    update.ask_price = ask_price;
+    update.ask_quantity = ask_quantity;
+    pushRecord(makeMarketDataRecord(update));
+}
+
+// the levels of the map book are found by price (the key is only used by the base class)
+void OrderBook::readLevel(LevelState& level) const {
+    if (level.side == Side::BUY) {
+        auto level_iter = bids_.find(level.price);
+        if (level_iter != bids_.end()) {
+            level.quantity = level_iter->second.total_quantity - level_iter->second.hidden_quantity;
+            level.order_count = level_iter->second.orders.size();
+        }
     } else {
-        for (const auto& [price, order_list] : bids_) {
-            std::cout << "  Price " << price << ": ";
-            for (const auto& order : order_list) {
-                 std::cout << order.remaining_quantity << "@" << order.order_id 
-                          << "(" << orderActionToString(order.action) << "," << orderStatusToString(order.status) << ") ";
-            }
-            std::cout << std::endl;
+        auto level_iter = asks_.find(level.price);
+        if (level_iter != asks_.end()) {
+            level.quantity = level_iter->second.total_quantity - level_iter->second.hidden_quantity;
+            level.order_count = level_iter->second.orders.size();
         }
     }
-    std::cout << "----------------------------------------" << std::endl;
+}
+
+void OrderBook::readBestLevels(LevelState& best_bid, LevelState& best_ask) const {
+    if (!bids_.empty()) {
+        const PriceLevel& level = bids_.begin()->second;
+        best_bid = LevelState{Side::BUY, levelKey(bids_.begin()->first), bids_.begin()->first,
+                              level.total_quantity - level.hidden_quantity, level.orders.size()};
+    }
+    if (!asks_.empty()) {
+        const PriceLevel& level = asks_.begin()->second;
+        best_ask = LevelState{Side::SELL, levelKey(asks_.begin()->first), asks_.begin()->first,
+                              level.total_quantity - level.hidden_quantity, level.orders.size()};
+    }
+}
+
+void OrderBook::collectLevels(std::vector<LevelState>& out) const {
+    for (const auto& level : bids_) {
+        out.push_back(LevelState{Side::BUY, levelKey(level.first), level.first,
+                                 level.second.total_quantity - level.second.hidden_quantity, level.second.orders.size()});
+    }
+    for (const auto& level : asks_) {
+        out.push_back(LevelState{Side::SELL, levelKey(level.first), level.first,
+                                 level.second.total_quantity - level.second.hidden_quantity, level.second.orders.size()});
+    }
 }
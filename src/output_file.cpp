@@ -0,0 +1,460 @@
+#include "output_file.hpp"
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>   // For std::aligned_alloc
+#include <cstring>   // For std::memcpy, std::strerror
+#include <new>
+
+// io_uring without liburing: the two rings are mapped from the ring fd and used directly.
+// The writer is the only producer of the submission ring and the only consumer of the completion ring,
+// so it only needs the acquire / release accesses the kernel documents for the indexes.
+struct OutputFile::Uring {
+    int fd = -1;
+    void* sq_ring = nullptr;
+    size_t sq_ring_bytes = 0;
+    void* cq_ring = nullptr;  // the same mapping as sq_ring with IORING_FEAT_SINGLE_MMAP
+    size_t cq_ring_bytes = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_bytes = 0;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    iovec iov{};          // what is left of the write in flight (a short write is submitted again)
+    uint64_t offset = 0;
+    size_t total = 0;     // bytes of the whole write
+    bool busy = false;
+    uint64_t start_ns = 0;
+
+    ~Uring() {
+        if (sqes != nullptr) {
+            munmap(sqes, sqes_bytes);
+        }
+        if (cq_ring != nullptr && cq_ring != sq_ring) {
+            munmap(cq_ring, cq_ring_bytes);
+        }
+        if (sq_ring != nullptr) {
+            munmap(sq_ring, sq_ring_bytes);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+};
+
+namespace {
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+char* allocateBuffer(size_t bytes) {
+    void* buffer = std::aligned_alloc(OutputFile::kAlignment, bytes);
+    if (buffer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return static_cast<char*>(buffer);
+}
+
+int uringEnter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+} // namespace
+
+const char* outputIoToString(OutputIo io) {
+    switch (io) {
+        case OutputIo::SYNC: return "sync";
+        case OutputIo::PWRITE: return "pwrite";
+        case OutputIo::IO_URING: return "io_uring";
+    }
+    return "sync";
+}
+
+bool parseOutputIo(std::string_view text, OutputIo& io) {
+    if (text == "sync") {
+        io = OutputIo::SYNC;
+    } else if (text == "pwrite") {
+        io = OutputIo::PWRITE;
+    } else if (text == "io_uring") {
+        io = OutputIo::IO_URING;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+OutputFile::OutputFile() = default; // here, where Uring is complete
+
+OutputFile::~OutputFile() {
+    std::string error;
+    close(0, error);
+}
+
+bool OutputFile::open(const std::string& path, const OutputFileOptions& options, std::string& error) {
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        error = std::strerror(errno);
+        return false;
+    }
+    struct stat file_stat {};
+    seekable_ = fstat(fd_, &file_stat) == 0 && S_ISREG(file_stat.st_mode);
+    direct_ = false;
+#ifdef O_DIRECT
+    // only for a regular file, and only if its file system allows it (tmpfs does not, for example)
+    if (options.direct && seekable_) {
+        const int flags = fcntl(fd_, F_GETFL);
+        direct_ = flags >= 0 && fcntl(fd_, F_SETFL, flags | O_DIRECT) == 0;
+    }
+#endif
+    stats_ = options.stats;
+
+    io_ = options.io;
+    if (io_ == OutputIo::IO_URING && (!seekable_ || !setupUring())) {
+        io_ = OutputIo::PWRITE; // the writes of a pipe need no offset, the thread does them in order
+    }
+
+    capacity_ = alignUp(options.buffer_bytes == 0 ? 1 : options.buffer_bytes, kAlignment);
+    const int buffer_count = io_ == OutputIo::SYNC ? 1 : 2;
+    for (int i = 0; i < buffer_count; ++i) {
+        buffers_[i] = allocateBuffer(capacity_);
+    }
+    if (buffer_count == 1) {
+        buffers_[1] = buffers_[0]; // the one buffer is written and refilled in turn
+    }
+    current_ = 0;
+    offset_ = 0;
+    file_size_ = 0;
+    write_errno_ = 0;
+
+    if (io_ == OutputIo::PWRITE) {
+        stopping_ = false;
+        has_pending_ = false;
+        writer_ = std::thread([this]() { writerLoop(); });
+    }
+    return true;
+}
+
+bool OutputFile::setupUring() {
+    io_uring_params params{};
+    const int ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, 4, &params));
+    if (ring_fd < 0) {
+        return false;
+    }
+    auto ring = std::make_unique<Uring>();
+    ring->fd = ring_fd;
+    ring->sq_ring_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_bytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        ring->sq_ring_bytes = ring->cq_ring_bytes = std::max(ring->sq_ring_bytes, ring->cq_ring_bytes);
+    }
+    void* sq_ring = mmap(nullptr, ring->sq_ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                         IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+        return false;
+    }
+    ring->sq_ring = sq_ring;
+    void* cq_ring = sq_ring;
+    if (!single_mmap) {
+        cq_ring = mmap(nullptr, ring->cq_ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                       IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED) {
+            return false;
+        }
+    }
+    ring->cq_ring = cq_ring;
+    ring->sqes_bytes = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, ring->sqes_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                      IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+    ring->sqes = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sq_ring);
+    char* cq = static_cast<char*>(cq_ring);
+    ring->sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    ring->sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ring->sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    ring->cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    ring->cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    ring->cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    uring_ = std::move(ring);
+    return true;
+}
+
+void OutputFile::submitUring() {
+    Uring& ring = *uring_;
+    const unsigned tail = *ring.sq_tail; // only this thread moves the tail
+    const unsigned index = tail & *ring.sq_mask;
+    io_uring_sqe* sqe = &ring.sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITEV; // WRITEV is there since the first io_uring kernels (WRITE came later)
+    sqe->fd = fd_;
+    sqe->off = ring.offset;
+    sqe->addr = reinterpret_cast<uint64_t>(&ring.iov);
+    sqe->len = 1;
+    ring.sq_array[index] = index;
+    __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+    int result;
+    do {
+        result = uringEnter(ring.fd, 1, 0, 0);
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) {
+        write_errno_ = errno;
+        ring.busy = false;
+    }
+}
+
+bool OutputFile::reapUring() {
+    Uring& ring = *uring_;
+    const unsigned head = *ring.cq_head; // only this thread moves the head
+    if (head == __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    const int result = ring.cqes[head & *ring.cq_mask].res;
+    __atomic_store_n(ring.cq_head, head + 1, __ATOMIC_RELEASE);
+    if (result == -EINTR || result == -EAGAIN) {
+        submitUring();
+        return true;
+    }
+    if (result <= 0) {
+        write_errno_ = result < 0 ? -result : EIO; // nothing written: give up rather than loop
+        ring.busy = false;
+        return true;
+    }
+    const size_t written = static_cast<size_t>(result);
+    if (written < ring.iov.iov_len) {
+        // short write: the rest goes again
+        ring.iov.iov_base = static_cast<char*>(ring.iov.iov_base) + written;
+        ring.iov.iov_len -= written;
+        ring.offset += written;
+        submitUring();
+        return true;
+    }
+    ring.busy = false;
+    if (stats_ != nullptr) {
+        stats_->bytes.add(ring.total);
+        stats_->writes.add();
+        stats_->write_ns.add(statsNowNs() - ring.start_ns);
+    }
+    return true;
+}
+
+void OutputFile::writeRange(const Write& write) {
+    const uint64_t start_ns = stats_ != nullptr ? statsNowNs() : 0;
+    size_t written = 0;
+    while (written < write.size && write_errno_ == 0) {
+        ssize_t result = seekable_ ? ::pwrite(fd_, write.data + written, write.size - written,
+                                              static_cast<off_t>(write.offset + written))
+                                   : ::write(fd_, write.data + written, write.size - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            write_errno_ = errno; // the rest of the output is dropped, close() reports it
+            break;
+        }
+        written += static_cast<size_t>(result);
+    }
+    if (stats_ != nullptr) {
+        stats_->bytes.add(written);
+        stats_->writes.add();
+        stats_->write_ns.add(statsNowNs() - start_ns);
+    }
+}
+
+void OutputFile::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wakeup_.wait(lock, [this]() { return has_pending_ || stopping_; });
+        if (!has_pending_) {
+            return; // stopping, and nothing left to write
+        }
+        const Write write = pending_;
+        lock.unlock();
+        writeRange(write); // write_errno_ is only read by the other thread once has_pending_ is false again
+        lock.lock();
+        has_pending_ = false;
+        wakeup_.notify_all();
+    }
+}
+
+void OutputFile::startWrite(int buffer, size_t size, uint64_t offset) {
+    if (size == 0) {
+        return;
+    }
+    const Write write{buffers_[buffer], size, offset};
+    switch (io_) {
+        case OutputIo::SYNC:
+            writeRange(write);
+            break;
+        case OutputIo::PWRITE: {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_ = write;
+            has_pending_ = true;
+            wakeup_.notify_all();
+            break;
+        }
+        case OutputIo::IO_URING:
+            if (write_errno_ != 0) {
+                break;
+            }
+            uring_->iov.iov_base = const_cast<char*>(write.data);
+            uring_->iov.iov_len = write.size;
+            uring_->offset = write.offset;
+            uring_->total = write.size;
+            uring_->busy = true;
+            uring_->start_ns = stats_ != nullptr ? statsNowNs() : 0;
+            submitUring();
+            break;
+    }
+}
+
+void OutputFile::waitIdle() {
+    if (io_ == OutputIo::PWRITE) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (has_pending_) {
+            const uint64_t start_ns = statsNowNs();
+            wakeup_.wait(lock, [this]() { return !has_pending_; });
+            if (stats_ != nullptr) {
+                stats_->stall_ns.add(statsNowNs() - start_ns);
+                stats_->stalls.add();
+            }
+        }
+    } else if (io_ == OutputIo::IO_URING) {
+        poll(); // the write may have finished while the other buffer was filled: no wait
+        if (!uring_->busy) {
+            return;
+        }
+        const uint64_t start_ns = statsNowNs();
+        while (uring_->busy) {
+            if (!reapUring()) {
+                uringEnter(uring_->fd, 0, 1, IORING_ENTER_GETEVENTS); // an EINTR only makes us look again
+            }
+        }
+        if (stats_ != nullptr) {
+            stats_->stall_ns.add(statsNowNs() - start_ns);
+            stats_->stalls.add();
+        }
+    }
+}
+
+void OutputFile::poll() {
+    if (io_ == OutputIo::IO_URING) {
+        while (uring_->busy && reapUring()) {
+        }
+    }
+}
+
+size_t OutputFile::submit(size_t size) {
+    if (fd_ < 0) {
+        return 0;
+    }
+    // in direct mode only whole blocks leave, the partial last one starts the next buffer
+    const size_t write_size = direct_ ? size / kAlignment * kAlignment : size;
+    const size_t tail = size - write_size;
+    if (write_size == 0) {
+        return tail;
+    }
+    const int next = buffers_[1] == buffers_[0] ? current_ : 1 - current_;
+    if (next == current_) {
+        // one buffer (sync): write it, then move the tail to its front
+        startWrite(current_, write_size, offset_);
+        std::memmove(buffers_[current_], buffers_[current_] + write_size, tail);
+    } else {
+        waitIdle(); // the other buffer is free once its write is done
+        std::memcpy(buffers_[next], buffers_[current_] + write_size, tail);
+        startWrite(current_, write_size, offset_);
+        current_ = next;
+    }
+    offset_ += write_size;
+    file_size_ = offset_ + tail;
+    return tail;
+}
+
+size_t OutputFile::flush(size_t size) {
+    const size_t tail = submit(size);
+    waitIdle();
+    if (tail > 0 && fd_ >= 0) {
+        // the partial block, padded with zeros (close() cuts them off). offset_ does not move:
+        // the next submit writes the block again, with more bytes in it
+        const size_t padded = alignUp(tail, kAlignment);
+        std::memset(data() + tail, 0, padded - tail);
+        startWrite(current_, padded, offset_);
+        waitIdle();
+    }
+    return tail;
+}
+
+void OutputFile::reserve(size_t capacity, size_t used) {
+    if (capacity <= capacity_) {
+        return;
+    }
+    waitIdle();
+    const size_t new_capacity = alignUp(capacity, kAlignment);
+    const bool single = buffers_[1] == buffers_[0];
+    char* grown[2] = {nullptr, nullptr};
+    for (int i = 0; i < (single ? 1 : 2); ++i) {
+        grown[i] = allocateBuffer(new_capacity);
+    }
+    std::memcpy(grown[0], data(), used);
+    std::free(buffers_[0]);
+    if (!single) {
+        std::free(buffers_[1]);
+    }
+    buffers_[0] = grown[0];
+    buffers_[1] = single ? grown[0] : grown[1];
+    current_ = 0;
+    capacity_ = new_capacity;
+}
+
+bool OutputFile::close(size_t size, std::string& error) {
+    if (fd_ < 0) {
+        return write_errno_ == 0;
+    }
+    const size_t tail = flush(size);
+    if (io_ == OutputIo::PWRITE) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wakeup_.notify_all();
+        writer_.join();
+    }
+    uring_.reset();
+    bool ok = write_errno_ == 0;
+    if (!ok) {
+        error = std::strerror(write_errno_);
+    }
+    if (ok && direct_ && tail > 0 && ::ftruncate(fd_, static_cast<off_t>(offset_ + tail)) != 0) {
+        error = std::strerror(errno);
+        ok = false;
+    }
+    if (::close(fd_) != 0 && ok) {
+        error = std::strerror(errno);
+        ok = false;
+    }
+    fd_ = -1;
+    std::free(buffers_[0]);
+    if (buffers_[1] != buffers_[0]) {
+        std::free(buffers_[1]);
+    }
+    buffers_[0] = buffers_[1] = nullptr;
+    return ok;
+}
@@ -0,0 +1,71 @@
+#include "output_merger.hpp"
+
+// this class puts the reports of the matching workers back into the order of the input
+
+OutputMerger::OutputMerger(WorkerPool& worker_pool)
+    : route_log_(worker_pool.getRouteLog()), lanes_(worker_pool.size()) {
+    for (size_t i = 0; i < lanes_.size(); ++i) {
+        lanes_[i].queue = &worker_pool.getOutputQueue(i);
+    }
+}
+
+OutputMerger::OutputMerger(SpscRing<uint32_t>& route_log, const std::vector<OutputQueue*>& lanes)
+    : route_log_(route_log), lanes_(lanes.size()) {
+    for (size_t i = 0; i < lanes_.size(); ++i) {
+        lanes_[i].queue = lanes[i];
+    }
+}
+
+size_t OutputMerger::pop_batch(ExecutionReport* out, size_t max_count) {
+    size_t count = 0;
+    // once we have something to return we never wait: the caller gets what is ready
+    while (count < max_count) {
+        if (!in_order_) {
+            if (route_position_ == route_count_) {
+                route_count_ = count > 0 ? route_log_.try_pop_batch(routes_.data(), routes_.size())
+                                         : route_log_.pop_batch(routes_.data(), routes_.size());
+                route_position_ = 0;
+                if (route_count_ == 0) {
+                    return count; // nothing ready yet, or every order is merged (route log closed)
+                }
+            }
+            current_lane_ = routes_[route_position_++];
+            in_order_ = true;
+        }
+
+        Lane& lane = lanes_[current_lane_];
+        if (lane.position == lane.size) {
+            lane.size = count > 0 ? lane.queue->try_pop_batch(lane.reports.data(), lane.reports.size())
+                                  : lane.queue->pop_batch(lane.reports.data(), lane.reports.size());
+            lane.position = 0;
+            if (lane.size == 0) {
+                if (count > 0) {
+                    return count; // nothing ready yet in this ring
+                }
+                // the worker closed its ring: everything it produced is merged, this order is done
+                in_order_ = false;
+                current_sequence_++;
+                continue;
+            }
+        }
+
+        const ExecutionReport& report = lane.reports[lane.position];
+        if (isWatermark(report)) {
+            if (report.sequence < current_sequence_) {
+                lane.position++; // about orders that are already merged
+                continue;
+            }
+            // the worker is done with this order (the watermark stays, it may cover the next ones too)
+            in_order_ = false;
+            current_sequence_++;
+        } else if (report.sequence <= current_sequence_) {
+            out[count++] = report;
+            lane.position++;
+        } else {
+            // the worker already works on a later order: it is done with this one
+            in_order_ = false;
+            current_sequence_++;
+        }
+    }
+    return count;
+}
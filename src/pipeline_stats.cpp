@@ -0,0 +1,93 @@
+#include "pipeline_stats.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+// the reading side of the histograms (the recording itself is inline in the header).
+// The log lines of the whole pipeline are written by worker_pool.cpp
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        const uint64_t other_count = other.buckets_[i].load(std::memory_order_relaxed);
+        if (other_count > 0) {
+            buckets_[i].store(buckets_[i].load(std::memory_order_relaxed) + other_count, std::memory_order_relaxed);
+        }
+    }
+    count_.add(other.count_.get());
+    sum_ns_.add(other.sum_ns_.get());
+    if (other.max_ns_.get() > max_ns_.get()) {
+        max_ns_.set(other.max_ns_.get());
+    }
+}
+
+uint64_t LatencyHistogram::bucketValue(size_t index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    const size_t exponent = (index - kSubBuckets) / kSubBuckets + kSubBucketBits;
+    const uint64_t sub_bucket = (index - kSubBuckets) % kSubBuckets;
+    const unsigned shift = static_cast<unsigned>(exponent - kSubBucketBits);
+    const uint64_t lowest = (kSubBuckets + sub_bucket) << shift;
+    return lowest + ((uint64_t{1} << shift) >> 1); // middle of [lowest, lowest + 2^shift)
+}
+
+LatencySummary LatencyHistogram::summarize() const {
+    LatencySummary summary;
+    // the buckets are read one by one while the writer may still record: take the total from them,
+    // so the percentiles are consistent with the buckets that were read
+    std::array<uint64_t, kBucketCount> counts;
+    uint64_t total = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    summary.count = static_cast<size_t>(total);
+    if (total == 0) {
+        return summary;
+    }
+    summary.mean_ns = static_cast<double>(sum_ns_.get()) / static_cast<double>(std::max<uint64_t>(count_.get(), 1));
+    summary.max_ns = max_ns_.get();
+    // nearest rank, like summarizeLatencies (bench_stats.hpp)
+    auto percentile = [&](double fraction) {
+        const uint64_t rank = std::min(static_cast<uint64_t>(fraction * static_cast<double>(total)), total - 1);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            seen += counts[i];
+            if (seen > rank) {
+                return std::min(bucketValue(i), summary.max_ns);
+            }
+        }
+        return summary.max_ns;
+    };
+    summary.p50_ns = percentile(0.50);
+    summary.p90_ns = percentile(0.90);
+    summary.p99_ns = percentile(0.99);
+    summary.p999_ns = percentile(0.999);
+    return summary;
+}
+
+std::string formatLatency(const LatencySummary& summary) {
+    std::ostringstream oss;
+    oss << "count=" << summary.count << " mean=" << static_cast<uint64_t>(summary.mean_ns)
+        << " p50=" << summary.p50_ns << " p99=" << summary.p99_ns << " p99.9=" << summary.p999_ns
+        << " max=" << summary.max_ns;
+    return oss.str();
+}
+
+std::string formatOutputIo(const OutputIoStats& stats) {
+    constexpr double kMiB = 1024.0 * 1024.0;
+    const double mib = static_cast<double>(stats.bytes.get()) / kMiB;
+    const uint64_t write_ns = stats.write_ns.get();
+    std::ostringstream oss;
+    oss << std::fixed;
+    oss.precision(1);
+    oss << mib << " MiB in " << stats.writes.get() << " writes, ";
+    if (write_ns > 0) {
+        oss << mib / (static_cast<double>(write_ns) / 1e9) << " MiB/s while writing";
+    } else {
+        oss << "no write time";
+    }
+    oss << ", formatting waited " << stats.stall_ns.get() / 1000000 << " ms (" << stats.stalls.get() << " times)";
+    return oss.str();
+}
@@ -0,0 +1,155 @@
+#include "pool_memory.hpp"
+
+#include <sys/mman.h>
+
+#include <cstdint>
+#include <iomanip>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct PoolMemoryState {
+    std::mutex mutex;
+    bool huge_pages = false;
+    size_t blocks_given = 0;  // blocks ever given out: the mode cannot change after the first one
+    char* region = nullptr;   // region the next blocks are cut from
+    size_t region_used = 0;
+    size_t region_bytes = 0;
+    std::vector<std::pair<size_t, void*>> free_blocks; // huge page mode: released blocks and their sizes
+    pool_memory::Stats stats;
+};
+
+PoolMemoryState& state() {
+    static PoolMemoryState pool_state;
+    return pool_state;
+}
+
+size_t roundUp(size_t bytes, size_t multiple) {
+    return (bytes + multiple - 1) / multiple * multiple;
+}
+
+// bytes (a multiple of kHugePageBytes) of memory starting on a 2 MiB boundary: explicit huge pages if there
+// are enough reserved, otherwise normal pages the kernel may back with transparent huge pages
+char* mapRegion(size_t bytes, pool_memory::Stats& stats) {
+    void* mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mapping != MAP_FAILED) {
+        stats.mapped_bytes += bytes;
+        stats.hugetlb_bytes += bytes;
+        return static_cast<char*>(mapping);
+    }
+    // one huge page more than needed, so a 2 MiB boundary is in it; the head and the tail are unmapped
+    const size_t padded_bytes = bytes + pool_memory::kHugePageBytes;
+    mapping = mmap(nullptr, padded_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    char* start = static_cast<char*>(mapping);
+    char* aligned = reinterpret_cast<char*>(roundUp(reinterpret_cast<uintptr_t>(start), pool_memory::kHugePageBytes));
+    if (aligned > start) {
+        munmap(start, static_cast<size_t>(aligned - start));
+    }
+    char* end = aligned + bytes;
+    if (end < start + padded_bytes) {
+        munmap(end, static_cast<size_t>(start + padded_bytes - end));
+    }
+    madvise(aligned, bytes, MADV_HUGEPAGE); // only a hint: without transparent huge pages they stay 4 KiB pages
+    stats.mapped_bytes += bytes;
+    return aligned;
+}
+
+} // namespace
+
+namespace pool_memory {
+
+void setHugePages(bool enabled) {
+    PoolMemoryState& pool_state = state();
+    std::lock_guard<std::mutex> lock(pool_state.mutex);
+    if (pool_state.blocks_given == 0) {
+        pool_state.huge_pages = enabled;
+    }
+}
+
+bool hugePagesEnabled() {
+    PoolMemoryState& pool_state = state();
+    std::lock_guard<std::mutex> lock(pool_state.mutex);
+    return pool_state.huge_pages;
+}
+
+void* allocateBlock(size_t bytes) {
+    PoolMemoryState& pool_state = state();
+    const size_t block_bytes = roundUp(bytes == 0 ? 1 : bytes, kBlockAlignment);
+    std::lock_guard<std::mutex> lock(pool_state.mutex);
+    pool_state.blocks_given++;
+    pool_state.stats.block_bytes += block_bytes;
+    if (!pool_state.huge_pages) {
+        return ::operator new(block_bytes, std::align_val_t(kBlockAlignment));
+    }
+    for (size_t i = 0; i < pool_state.free_blocks.size(); ++i) {
+        if (pool_state.free_blocks[i].first == block_bytes) {
+            void* block = pool_state.free_blocks[i].second;
+            pool_state.free_blocks[i] = pool_state.free_blocks.back();
+            pool_state.free_blocks.pop_back();
+            return block;
+        }
+    }
+    if (block_bytes > kRegionBytes) {
+        // a big block gets a region of its own
+        return mapRegion(roundUp(block_bytes, kHugePageBytes), pool_state.stats);
+    }
+    if (pool_state.region == nullptr || pool_state.region_used + block_bytes > pool_state.region_bytes) {
+        pool_state.region = mapRegion(kRegionBytes, pool_state.stats);
+        pool_state.region_bytes = kRegionBytes;
+        pool_state.region_used = 0;
+    }
+    void* block = pool_state.region + pool_state.region_used;
+    pool_state.region_used += block_bytes;
+    return block;
+}
+
+void releaseBlock(void* block, size_t bytes) {
+    if (block == nullptr) {
+        return;
+    }
+    PoolMemoryState& pool_state = state();
+    const size_t block_bytes = roundUp(bytes == 0 ? 1 : bytes, kBlockAlignment);
+    std::lock_guard<std::mutex> lock(pool_state.mutex);
+    pool_state.stats.block_bytes -= block_bytes;
+    if (!pool_state.huge_pages) {
+        ::operator delete(block, std::align_val_t(kBlockAlignment));
+        return;
+    }
+    pool_state.free_blocks.emplace_back(block_bytes, block);
+}
+
+Stats stats() {
+    PoolMemoryState& pool_state = state();
+    std::lock_guard<std::mutex> lock(pool_state.mutex);
+    return pool_state.stats;
+}
+
+} // namespace pool_memory
+
+std::string formatBookMemory(const BookMemoryStats& memory) {
+    constexpr double kMiB = 1024.0 * 1024.0;
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1) << static_cast<double>(memory.totalBytes()) / kMiB << " MiB, ";
+    if (memory.resting_orders > 0) {
+        text << memory.totalBytes() / memory.resting_orders << " bytes per resting order";
+    } else {
+        text << "no resting order";
+    }
+    text << " (" << memory.resting_orders << " orders), " << memory.levels << " levels, pools "
+         << static_cast<double>(memory.pool_bytes) / kMiB << " MiB ";
+    if (memory.pool_bytes > 0) {
+        text << std::setprecision(0) << 100.0 * static_cast<double>(memory.pool_used_bytes) / static_cast<double>(memory.pool_bytes)
+             << "% used";
+    } else {
+        text << "unused";
+    }
+    text << std::setprecision(1) << ", other " << static_cast<double>(memory.other_bytes) / kMiB << " MiB";
+    return text.str();
+}
@@ -0,0 +1,201 @@
+#include "report_writer.hpp"
+
+#include <charconv>
+#include <cstring>   // For std::memcpy, std::strerror
+#include <cerrno>
+
+// longest line we can produce without the instrument name: 5 integers of at most 20 characters,
+// 2 prices of at most 13 characters ("-1.23457e+308"), the enum names and the commas
+static constexpr size_t kMaxRecordBytesWithoutInstrument = 256;
+
+ReportWriter::ReportWriter(const SymbolTable& symbols)
+    : symbols_(symbols) {
+}
+
+ReportWriter::~ReportWriter() {
+    std::string error;
+    close(error);
+}
+
+bool ReportWriter::open(const std::string& path, std::string& error, const OutputFileOptions& options) {
+    OutputFileOptions file_options = options;
+    file_options.buffer_bytes = kBufferBytes; // the buffers are only allocated for the writer really used
+    return file_.open(path, file_options, error);
+}
+
+void ReportWriter::writeHeader() {
+    static constexpr std::string_view kHeader =
+        "timestamp,order_id,instrument,side,type,quantity,price,action,status,executed_quantity,execution_price,counterparty_id\n";
+    if (file_.capacity() - used_ < kHeader.size()) {
+        writeBuffer();
+    }
+    std::memcpy(file_.data() + used_, kHeader.data(), kHeader.size());
+    used_ += kHeader.size();
+}
+
+std::string_view ReportWriter::instrumentName(uint32_t symbol_id) {
+    if (symbol_id >= instrument_names_.size()) {
+        instrument_names_.resize(symbol_id + 1, nullptr);
+    }
+    if (instrument_names_[symbol_id] == nullptr) {
+        // the symbol table keeps its names at a fixed address, so keeping a pointer is safe
+        instrument_names_[symbol_id] = &symbols_.name(symbol_id);
+    }
+    return *instrument_names_[symbol_id];
+}
+
+// to_chars never fails here: the caller made sure there is room for the longest value
+template <typename T>
+static char* appendNumber(char* out, char* end, T value) {
+    return std::to_chars(out, end, value).ptr;
+}
+
+// same text as "os << value" with the default stream settings (%g with 6 significant digits)
+static char* appendPrice(char* out, char* end, double value) {
+    return std::to_chars(out, end, value, std::chars_format::general, 6).ptr;
+}
+
+static char* appendText(char* out, std::string_view text) {
+    std::memcpy(out, text.data(), text.size());
+    return out + text.size();
+}
+
+void ReportWriter::append(const ExecutionReport& report) {
+    if (++appended_ == 256) {
+        appended_ = 0;
+        file_.poll();
+    }
+    std::string_view instrument = instrumentName(report.symbol_id);
+    if (file_.capacity() - used_ < kMaxRecordBytesWithoutInstrument + instrument.size()) {
+        writeBuffer();
+        // absurdly long name (used_ is the partial block kept by a direct file)
+        file_.reserve(used_ + kMaxRecordBytesWithoutInstrument + instrument.size(), used_);
+    }
+
+    char* out = file_.data() + used_;
+    char* end = file_.data() + file_.capacity();
+    out = appendNumber(out, end, report.timestamp);
+    *out++ = ',';
+    out = appendNumber(out, end, report.order_id);
+    *out++ = ',';
+    out = appendText(out, instrument);
+    *out++ = ',';
+    out = appendText(out, sideToString(report.side));
+    *out++ = ',';
+    out = appendText(out, orderTypeToString(report.type));
+    *out++ = ',';
+    out = appendNumber(out, end, report.quantity);
+    *out++ = ',';
+    out = appendPrice(out, end, report.price);
+    *out++ = ',';
+    out = appendText(out, orderActionToString(report.action));
+    *out++ = ',';
+    out = appendText(out, orderStatusToString(report.status));
+    *out++ = ',';
+    out = appendNumber(out, end, report.executed_quantity);
+    *out++ = ',';
+    out = appendPrice(out, end, report.execution_price);
+    *out++ = ',';
+    out = appendNumber(out, end, report.counterparty_id);
+    *out++ = '\n';
+    used_ = static_cast<size_t>(out - file_.data());
+}
+
+void ReportWriter::writeBuffer() {
+    used_ = file_.submit(used_); // a failed write drops the rest of the output, flush() and close() report it
+}
+
+bool ReportWriter::flush(std::string& error) {
+    used_ = file_.flush(used_);
+    if (file_.writeErrno() != 0) {
+        error = std::strerror(file_.writeErrno());
+        return false;
+    }
+    return true;
+}
+
+bool ReportWriter::close(std::string& error) {
+    const bool ok = file_.close(used_, error);
+    used_ = 0;
+    return ok;
+}
+
+MarketDataWriter::MarketDataWriter(const SymbolTable& symbols)
+    : symbols_(symbols) {
+}
+
+MarketDataWriter::~MarketDataWriter() {
+    std::string error;
+    close(error);
+}
+
+bool MarketDataWriter::open(const std::string& path, std::string& error, const OutputFileOptions& options) {
+    OutputFileOptions file_options = options;
+    file_options.buffer_bytes = kBufferBytes;
+    if (!file_.open(path, file_options, error)) {
+        return false;
+    }
+    static constexpr std::string_view kHeader =
+        "sequence,timestamp,instrument,update,kind,side,price,quantity,orders,ask_price,ask_quantity\n";
+    used_ = static_cast<size_t>(appendText(file_.data(), kHeader) - file_.data());
+    return true;
+}
+
+void MarketDataWriter::append(const MarketDataUpdate& update) {
+    // the symbol table keeps its names at a fixed address, and the updates of one instrument come in runs,
+    // so the name is looked up directly
+    std::string_view instrument = symbols_.name(update.symbol_id);
+    if (file_.capacity() - used_ < kMaxRecordBytesWithoutInstrument + instrument.size()) {
+        writeBuffer();
+        file_.reserve(used_ + kMaxRecordBytesWithoutInstrument + instrument.size(), used_); // absurdly long name
+    }
+
+    char* out = file_.data() + used_;
+    char* end = file_.data() + file_.capacity();
+    out = appendNumber(out, end, update.sequence);
+    *out++ = ',';
+    out = appendNumber(out, end, update.timestamp);
+    *out++ = ',';
+    out = appendText(out, instrument);
+    *out++ = ',';
+    out = appendNumber(out, end, update.update_number);
+    *out++ = ',';
+    out = appendText(out, marketDataKindToString(update.kind));
+    *out++ = ',';
+    if (update.side != Side::UNKNOWN) {
+        out = appendText(out, sideToString(update.side));
+    }
+    *out++ = ',';
+    if (update.kind != MarketDataKind::SNAPSHOT_BEGIN) {
+        out = appendPrice(out, end, update.price);
+        *out++ = ',';
+        out = appendNumber(out, end, update.quantity);
+    } else {
+        *out++ = ',';
+    }
+    *out++ = ',';
+    if (update.kind != MarketDataKind::BBO) {
+        out = appendNumber(out, end, update.order_count);
+    }
+    *out++ = ',';
+    if (update.kind == MarketDataKind::BBO) {
+        out = appendPrice(out, end, update.ask_price);
+        *out++ = ',';
+        out = appendNumber(out, end, update.ask_quantity);
+    } else {
+        *out++ = ',';
+    }
+    *out++ = '\n';
+    used_ = static_cast<size_t>(out - file_.data());
+    update_count_++;
+}
+
+void MarketDataWriter::writeBuffer() {
+    used_ = file_.submit(used_); // a failed write drops the rest of the file, close() reports it
+}
+
+bool MarketDataWriter::close(std::string& error) {
+    const bool ok = file_.close(used_, error);
+    used_ = 0;
+    return ok;
+}
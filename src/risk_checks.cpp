@@ -0,0 +1,182 @@
+#include "risk_checks.hpp"
+
+#include <cmath>     // For std::fabs
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+// this file reads the limits of the risk checks, and checks one order against them
+
+std::string_view riskCheckToString(RiskCheck check) {
+    switch (check) {
+        case RiskCheck::PASSED: return "passed";
+        case RiskCheck::ACCOUNT: return "unknown account";
+        case RiskCheck::QUANTITY: return "max quantity";
+        case RiskCheck::NOTIONAL: return "max notional";
+        case RiskCheck::PRICE_BAND: return "price band";
+        case RiskCheck::OPEN_ORDERS: return "max open orders";
+        default: return "unknown check";
+    }
+}
+
+std::string_view selfTradePreventionToString(SelfTradePrevention mode) {
+    switch (mode) {
+        case SelfTradePrevention::NONE: return "none";
+        case SelfTradePrevention::CANCEL_RESTING: return "cancel-resting";
+        case SelfTradePrevention::CANCEL_INCOMING: return "cancel-incoming";
+        case SelfTradePrevention::CANCEL_BOTH: return "cancel-both";
+        default: return "unknown";
+    }
+}
+
+bool RiskConfig::parseSelfTradePrevention(const std::string& mode) {
+    for (SelfTradePrevention candidate : {SelfTradePrevention::NONE, SelfTradePrevention::CANCEL_RESTING,
+                                          SelfTradePrevention::CANCEL_INCOMING, SelfTradePrevention::CANCEL_BOTH}) {
+        if (mode == selfTradePreventionToString(candidate)) {
+            self_trade_prevention = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// a limit of the list or of the file: an empty value is no limit, a negative one is an error
+static bool parseLimitValue(const std::string& text, double& value) {
+    if (text.empty()) {
+        value = 0.0;
+        return true;
+    }
+    try {
+        size_t used = 0;
+        value = std::stod(text, &used);
+        return used == text.size() && value >= 0.0;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// the quantities and counts are whole numbers
+static bool parseLimitCount(const std::string& text, unsigned long long max_value, unsigned long long& value) {
+    double number = 0.0;
+    if (!parseLimitValue(text, number) || number != std::floor(number) || number > static_cast<double>(max_value)) {
+        return false;
+    }
+    value = static_cast<unsigned long long>(number);
+    return true;
+}
+
+// read a list of "NAME=VALUE" separated by commas (like the tick size overrides)
+bool RiskConfig::parseLimits(const std::string& limits, Logger& logger) {
+    AccountLimits defaults;
+    std::stringstream limits_ss(limits);
+    std::string entry;
+    while (std::getline(limits_ss, entry, ',')) {
+        if (entry.empty()) {
+            continue;
+        }
+        size_t equal_pos = entry.find('=');
+        if (equal_pos == std::string::npos || equal_pos == 0) {
+            logger.error("Invalid risk limit '", entry, "'. Expected NAME=VALUE.");
+            return false;
+        }
+        const std::string name = entry.substr(0, equal_pos);
+        const std::string value_text = entry.substr(equal_pos + 1);
+        bool valid = false;
+        unsigned long long count = 0;
+        if (name == "max_quantity") {
+            valid = parseLimitCount(value_text, std::numeric_limits<unsigned long long>::max(), count);
+            defaults.max_order_quantity = count;
+        } else if (name == "max_notional") {
+            valid = parseLimitValue(value_text, defaults.max_order_notional);
+        } else if (name == "max_open_orders") {
+            valid = parseLimitCount(value_text, std::numeric_limits<uint32_t>::max(), count);
+            defaults.max_open_orders = static_cast<uint32_t>(count);
+        } else if (name == "price_band") {
+            valid = parseLimitValue(value_text, price_band);
+        } else {
+            logger.error("Unknown risk limit '", name, "'. Expected max_quantity, max_notional, max_open_orders or price_band.");
+            return false;
+        }
+        if (!valid) {
+            logger.error("Invalid value in risk limit '", entry, "'. It must be a positive number (0 = no limit).");
+            return false;
+        }
+    }
+    account_limits.assign(account_limits.size(), defaults);
+    checks_enabled = true;
+    return true;
+}
+
+bool RiskConfig::loadAccountLimits(const std::string& path, Logger& logger) {
+    std::ifstream limits_file(path);
+    if (!limits_file.is_open()) {
+        logger.error("Cannot open the account limits file: ", path);
+        return false;
+    }
+    std::string line;
+    long long line_number = 0;
+    while (std::getline(limits_file, line)) {
+        line_number++;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || (line_number == 1 && line.rfind("account", 0) == 0)) {
+            continue; // the header
+        }
+        std::vector<std::string> fields;
+        std::stringstream line_ss(line);
+        std::string field;
+        while (std::getline(line_ss, field, ',')) {
+            fields.push_back(field);
+        }
+        fields.resize(4); // the last limits may be left out
+        unsigned long long account_id = 0, max_quantity = 0, max_open_orders = 0;
+        AccountLimits limits;
+        if (fields[0].empty() || !parseLimitCount(fields[0], std::numeric_limits<uint32_t>::max(), account_id) ||
+            !parseLimitCount(fields[1], std::numeric_limits<unsigned long long>::max(), max_quantity) ||
+            !parseLimitValue(fields[2], limits.max_order_notional) ||
+            !parseLimitCount(fields[3], std::numeric_limits<uint32_t>::max(), max_open_orders)) {
+            logger.error("Invalid account limits at line ", line_number, " of ", path, ": '", line,
+                         "'. Expected account,max_quantity,max_notional,max_open_orders.");
+            return false;
+        }
+        if (account_id >= account_limits.size()) {
+            logger.error("Account ", account_id, " at line ", line_number, " of ", path,
+                         " is outside of the account tables (--risk-max-accounts ", account_limits.size(), ").");
+            return false;
+        }
+        limits.max_order_quantity = max_quantity;
+        limits.max_open_orders = static_cast<uint32_t>(max_open_orders);
+        account_limits[account_id] = limits;
+    }
+    checks_enabled = true;
+    return true;
+}
+
+RiskCheck checkOrderRisk(const RiskConfig& config, const Order& order, double reference_price, uint32_t open_orders) {
+    if (order.account_id >= config.account_limits.size()) {
+        return RiskCheck::ACCOUNT;
+    }
+    const AccountLimits& limits = config.account_limits[order.account_id];
+    if (limits.max_order_quantity > 0 && order.quantity > limits.max_order_quantity) {
+        return RiskCheck::QUANTITY;
+    }
+    // a MARKET order is valued at the reference price (not checked while the book has none)
+    const double valuation_price = (order.type == OrderType::MARKET) ? reference_price : order.price;
+    if (limits.max_order_notional > 0.0 &&
+        static_cast<double>(order.quantity) * valuation_price > limits.max_order_notional) {
+        return RiskCheck::NOTIONAL;
+    }
+    if (config.price_band > 0.0 && order.type == OrderType::LIMIT && reference_price > 0.0 &&
+        std::fabs(order.price - reference_price) > config.price_band * reference_price) {
+        return RiskCheck::PRICE_BAND;
+    }
+    // only a NEW order that may rest adds an open order (a MODIFY replaces one that is counted already)
+    if (limits.max_open_orders > 0 && order.account_id != 0 && order.action == OrderAction::NEW &&
+        order.type == OrderType::LIMIT && order.time_in_force == TimeInForce::GTC &&
+        open_orders >= limits.max_open_orders) {
+        return RiskCheck::OPEN_ORDERS;
+    }
+    return RiskCheck::PASSED;
+}
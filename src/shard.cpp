@@ -0,0 +1,406 @@
+#include "shard.hpp"
+
+#include <algorithm>
+#include <cstddef>  // For offsetof
+#include <cstring>
+#include <sstream>
+
+#include "output_merger.hpp" // For isWatermark
+#include "worker_pool.hpp"   // For BookWorker, partitionOf
+
+// this file spreads the instruments over several processes: the router of the front-end, and the matching process
+
+namespace {
+
+bool checkHello(const ShardHelloMessage& hello, std::string& error) {
+    if (hello.protocol_version != kShardProtocolVersion || hello.order_bytes != sizeof(Order) ||
+        hello.report_bytes != sizeof(ExecutionReport)) {
+        error = "the other side runs another build (protocol " + std::to_string(hello.protocol_version) +
+                ", orders of " + std::to_string(hello.order_bytes) + " bytes, reports of " +
+                std::to_string(hello.report_bytes) + " bytes)";
+        return false;
+    }
+    return true;
+}
+
+ShardHelloMessage makeHello() {
+    ShardHelloMessage hello{};
+    hello.protocol_version = kShardProtocolVersion;
+    hello.order_bytes = static_cast<uint32_t>(sizeof(Order));
+    hello.report_bytes = static_cast<uint32_t>(sizeof(ExecutionReport));
+    return hello;
+}
+
+// the first message of a channel must be its HELLO
+bool readHello(ShardMessageReader& reader, ShardHelloMessage& hello, std::string& error) {
+    bool received = false;
+    auto handler = [&](const GatewayMessageHeader& header, const char* message) {
+        if (header.type != static_cast<uint8_t>(ShardMessageType::HELLO) || header.length != sizeof(ShardHelloMessage)) {
+            error = "the first message is not a HELLO";
+            return false;
+        }
+        std::memcpy(&hello, message, sizeof(hello));
+        received = true;
+        return false; // the next messages are read by the caller
+    };
+    while (!received && reader.readMessages(handler, error)) {
+    }
+    if (!received && error.empty()) {
+        error = "the connection closed before the HELLO";
+    }
+    return received && checkHello(hello, error);
+}
+
+} // namespace
+
+ShardRouter::ShardRouter(const std::vector<std::string>& endpoints, const SymbolTable& symbols,
+                         WaitStrategyType wait_strategy, Logger& logger)
+    : symbols_(symbols), route_log_(kRouteLogCapacity, wait_strategy), logger_(logger) {
+    for (const std::string& endpoint : endpoints) {
+        shards_.push_back(std::make_unique<Shard>(endpoint, wait_strategy));
+    }
+}
+
+ShardRouter::~ShardRouter() {
+    join();
+}
+
+bool ShardRouter::connect(bool market_data, unsigned long long market_data_snapshot_interval, std::string& error) {
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        Shard& shard = *shards_[i];
+        shard.channel = connectShardChannel(shard.endpoint, kConnectTimeoutMs, error);
+        if (!shard.channel) {
+            error = "shard " + std::to_string(i) + " (" + shard.endpoint + "): " + error;
+            return false;
+        }
+        shard.writer = std::make_unique<ShardMessageWriter>(*shard.channel);
+        shard.reader = std::make_unique<ShardMessageReader>(*shard.channel);
+        ShardHelloMessage hello = makeHello();
+        hello.shard_index = static_cast<uint32_t>(i);
+        hello.shard_count = static_cast<uint32_t>(shards_.size());
+        hello.market_data = market_data ? 1 : 0;
+        hello.market_data_snapshot_interval = market_data_snapshot_interval;
+        ShardHelloMessage answer{};
+        if (!shard.writer->append(hello, static_cast<uint8_t>(ShardMessageType::HELLO)) || !shard.writer->flush() ||
+            !readHello(*shard.reader, answer, error)) {
+            error = "shard " + std::to_string(i) + " (" + shard.channel->describe() + "): " +
+                    (error.empty() ? std::string("the connection broke") : error);
+            return false;
+        }
+        logger_.info("Connected to shard ", i, " on ", shard.channel->describe());
+    }
+    return true;
+}
+
+void ShardRouter::start() {
+    for (auto& shard : shards_) {
+        Shard* shard_ptr = shard.get();
+        shard->receiver = std::thread([this, shard_ptr]() { receive(*shard_ptr); });
+    }
+}
+
+void ShardRouter::growRoutes(uint32_t symbol_id) {
+    // every shard learns every instrument, in symbol id order: they intern them with the same ids
+    for (uint32_t new_symbol = static_cast<uint32_t>(routes_.size()); new_symbol <= symbol_id; ++new_symbol) {
+        routes_.push_back(static_cast<uint32_t>(partitionOf(new_symbol, shards_.size())));
+        const std::string& name = symbols_.name(new_symbol);
+        ShardSymbolMessage message{};
+        message.symbol_id = new_symbol;
+        message.name_length = static_cast<uint32_t>(std::min(name.size(), ShardSymbolMessage::kMaxNameBytes));
+        std::memcpy(message.name, name.data(), message.name_length);
+        if (name.size() > ShardSymbolMessage::kMaxNameBytes) {
+            logger_.warn("Instrument name longer than ", ShardSymbolMessage::kMaxNameBytes, " bytes, cut for the shards: ", name);
+        }
+        for (auto& shard : shards_) {
+            shard->writer->append(message, static_cast<uint8_t>(ShardMessageType::SYMBOL),
+                                  offsetof(ShardSymbolMessage, name) + message.name_length);
+        }
+    }
+}
+
+void ShardRouter::flushShard(Shard& shard) {
+    shard.staged = 0;
+    if (!shard.writer->flush()) {
+        fail(shard, "cannot send the orders");
+    }
+}
+
+void ShardRouter::flush() {
+    for (auto& shard : shards_) {
+        if (shard->staged > 0) {
+            flushShard(*shard);
+        }
+    }
+    // the orders are in the channels: their routes can be merged
+    if (!pending_routes_.empty()) {
+        route_log_.push_batch(pending_routes_.data(), pending_routes_.size());
+        pending_routes_.clear();
+    }
+}
+
+void ShardRouter::stop() {
+    flush();
+    for (auto& shard : shards_) {
+        ShardEndMessage end{};
+        if (!shard->writer->append(end, static_cast<uint8_t>(ShardMessageType::END)) || !shard->writer->flush()) {
+            fail(*shard, "cannot send the END");
+        }
+        shard->channel->closeWrite();
+    }
+    route_log_.close();
+}
+
+void ShardRouter::join() {
+    for (auto& shard : shards_) {
+        if (shard->receiver.joinable()) {
+            shard->receiver.join();
+        }
+    }
+}
+
+void ShardRouter::receive(Shard& shard) {
+    std::vector<ExecutionReport> batch;
+    batch.reserve(ShardMessageReader::kBufferBytes / sizeof(ShardReportMessage) + 1);
+    bool ended = false;
+    std::string error;
+    auto handler = [&](const GatewayMessageHeader& header, const char* message) {
+        if (header.type == static_cast<uint8_t>(ShardMessageType::REPORT) && header.length == sizeof(ShardReportMessage)) {
+            ExecutionReport report;
+            std::memcpy(&report, message + sizeof(GatewayMessageHeader), sizeof(report));
+            batch.push_back(report);
+            return true;
+        }
+        if (header.type == static_cast<uint8_t>(ShardMessageType::END)) {
+            ended = true;
+        } else {
+            error = "unexpected message of type " + std::to_string(static_cast<unsigned>(header.type));
+        }
+        return false;
+    };
+    bool reading = true;
+    while (reading) {
+        reading = shard.reader->readMessages(handler, error);
+        // what this chunk brought is merged right away (the writer may be waiting for it)
+        if (!batch.empty()) {
+            shard.reports.push_batch(batch.data(), batch.size());
+            shard.received_reports.fetch_add(batch.size(), std::memory_order_relaxed);
+            batch.clear();
+        }
+    }
+    if (!ended) {
+        fail(shard, error.empty() ? std::string("the connection closed before the END") : error);
+    }
+    // the merger takes a closed queue as "this shard has nothing more"
+    shard.reports.close();
+}
+
+void ShardRouter::fail(const Shard& shard, const std::string& reason) {
+    if (!failed_.exchange(true)) {
+        logger_.error("Shard ", shard.endpoint, ": ", reason, ". Its reports are missing from the output.");
+    }
+}
+
+std::vector<OutputQueue*> ShardRouter::getOutputQueues() {
+    std::vector<OutputQueue*> queues;
+    for (auto& shard : shards_) {
+        queues.push_back(&shard->reports);
+    }
+    return queues;
+}
+
+unsigned long long ShardRouter::getSentOrders() const {
+    unsigned long long total = 0;
+    for (const auto& shard : shards_) {
+        total += shard->sent_orders;
+    }
+    return total;
+}
+
+void ShardRouter::logSnapshot(Logger& logger, const PipelineStats& stats, const OrderQueue& reader_queue) const {
+    logger.info("[stats] parsed", stats.parse.count(), "dispatched", stats.dispatch.count(),
+                "reports written", stats.reports_written.get());
+    if (stats.output.writes.get() > 0) {
+        logger.info("[stats] output file", formatOutputIo(stats.output));
+    }
+    logger.info("[stats] reader queue", formatQueue(reader_queue) + ", route log", formatQueue(route_log_));
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        logger.info("[stats] shard", i, "reports received", shards_[i]->received_reports.load(std::memory_order_relaxed),
+                    "output", formatQueue(shards_[i]->reports));
+    }
+}
+
+void ShardRouter::logSummary(Logger& logger, const PipelineStats& stats, const OrderQueue& reader_queue) const {
+    auto log_stage = [&](const char* name, const LatencyHistogram& histogram) {
+        logger.info(" ", name, formatLatency(histogram.summarize()),
+                    "busy_ms=" + std::to_string(histogram.sumNs() / 1000000));
+    };
+    logger.info("Pipeline latencies of the front-end (ns, HDR buckets of ~3%; the matching is in the shards):");
+    log_stage("parse     ", stats.parse);
+    log_stage("dispatch  ", stats.dispatch);
+    log_stage("formatting", stats.formatting);
+    if (stats.journal_commit.count() > 0) {
+        log_stage("journal   ", stats.journal_commit);
+    }
+    if (stats.output.writes.get() > 0) {
+        logger.info("Output file:", formatOutputIo(stats.output));
+    }
+    logger.info("Pipeline queues (depth/capacity at the end):");
+    logger.info("  reader -> dispatcher", formatQueue(reader_queue));
+    logger.info("  route log           ", formatQueue(route_log_));
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        const Shard& shard = *shards_[i];
+        logger.info("  shard", i, shard.endpoint + ":", shard.sent_orders, "orders sent,",
+                    shard.received_reports.load(std::memory_order_relaxed), "records received, output",
+                    formatQueue(shard.reports));
+    }
+}
+
+bool runShardServer(const ShardServerConfig& config, Logger& logger) {
+    std::string error;
+    std::unique_ptr<ShardChannel> channel = acceptShardChannel(config.endpoint, logger, error);
+    if (!channel) {
+        logger.critical("Shard cannot open ", config.endpoint, ": ", error);
+        return false;
+    }
+    ShardMessageReader reader(*channel);
+    ShardMessageWriter writer(*channel);
+    ShardHelloMessage hello{};
+    if (!readHello(reader, hello, error)) {
+        logger.critical("Shard ", channel->describe(), ": ", error);
+        return false;
+    }
+    ShardHelloMessage answer = makeHello();
+    answer.shard_index = hello.shard_index;
+    answer.shard_count = hello.shard_count;
+    if (!writer.append(answer, static_cast<uint8_t>(ShardMessageType::HELLO)) || !writer.flush()) {
+        logger.critical("Shard ", channel->describe(), ": the connection broke");
+        return false;
+    }
+    logger.info("Shard ", hello.shard_index, " of ", hello.shard_count, " connected to its front-end ", channel->describe(),
+                hello.market_data ? "(market data on)" : "");
+
+    // the books of this process: one matching thread, like a worker of the pool
+    SymbolTable symbols;
+    BookWorker worker(hello.shard_index, config.book_type, symbols, config.wait_strategy);
+    if (hello.market_data) {
+        worker.enableMarketData(hello.market_data_snapshot_interval);
+    }
+    if (config.risk_config) {
+        worker.enableRiskChecks(config.risk_config);
+    }
+    if (!worker.start(config.cpu)) {
+        logger.warn("Could not pin the matching thread to cpu ", config.cpu);
+    }
+
+    // the records of the output ring go back as they are (a separate thread: the front-end reads them
+    // while it is still sending orders)
+    bool sent = true;
+    unsigned long long sent_reports = 0;
+    std::thread sender([&]() {
+        std::vector<ExecutionReport> records(OutputMerger::kLaneBatchSize);
+        ShardReportMessage message{};
+        size_t count;
+        while ((count = worker.getOutputQueue().pop_batch(records.data(), records.size())) > 0) {
+            for (size_t i = 0; i < count && sent; ++i) {
+                message.report = records[i];
+                sent = writer.append(message, static_cast<uint8_t>(ShardMessageType::REPORT));
+            }
+            sent_reports += count;
+            // what is ready goes now (the front-end may wait for it)
+            sent = sent && writer.flush();
+        }
+        ShardEndMessage end{};
+        sent = sent && writer.append(end, static_cast<uint8_t>(ShardMessageType::END)) && writer.flush();
+        channel->closeWrite();
+    });
+
+    std::vector<Order> batch;
+    batch.reserve(BookWorker::kProcessingBatchSize);
+    unsigned long long received_orders = 0;
+    bool ended = false;
+    auto handler = [&](const GatewayMessageHeader& header, const char* message) {
+        if (header.type == static_cast<uint8_t>(ShardMessageType::ORDER) && header.length == sizeof(ShardOrderMessage)) {
+            Order order;
+            std::memcpy(&order, message + sizeof(GatewayMessageHeader), sizeof(order));
+            if (order.symbol_id >= symbols.size()) {
+                error = "order " + std::to_string(order.order_id) + " of an undeclared instrument";
+                return false;
+            }
+            // one order out of kLatencySamplePeriod measures its wait in this process, like in the pool
+            order.dispatch_ns = (order.sequence & (kLatencySamplePeriod - 1)) == 0 ? statsNowNs() : 0;
+            batch.push_back(order);
+            if (batch.size() == BookWorker::kProcessingBatchSize) {
+                worker.dispatch(batch.data(), batch.size());
+                batch.clear();
+            }
+            received_orders++;
+            return true;
+        }
+        if (header.type == static_cast<uint8_t>(ShardMessageType::SYMBOL) &&
+            header.length >= offsetof(ShardSymbolMessage, name) && header.length <= sizeof(ShardSymbolMessage)) {
+            ShardSymbolMessage symbol{};
+            std::memcpy(&symbol, message, header.length);
+            const size_t name_length = header.length - offsetof(ShardSymbolMessage, name);
+            if (symbols.intern(std::string(symbol.name, name_length)) != symbol.symbol_id) {
+                error = "instrument " + std::to_string(symbol.symbol_id) + " declared out of order";
+                return false;
+            }
+            return true;
+        }
+        if (header.type == static_cast<uint8_t>(ShardMessageType::END)) {
+            ended = true;
+        } else {
+            error = "unexpected message of type " + std::to_string(static_cast<unsigned>(header.type));
+        }
+        return false;
+    };
+    bool reading = true;
+    while (reading) {
+        reading = reader.readMessages(handler, error);
+        // no order waits in the batch while the front-end is idle
+        if (!batch.empty()) {
+            worker.dispatch(batch.data(), batch.size());
+            batch.clear();
+        }
+    }
+    worker.stop(); // finishes the ring, then closes the output ring: the sender sends the END
+    sender.join();
+
+    size_t book_count = 0;
+    unsigned long long fills = 0, resting_orders = 0;
+    BookMemoryStats memory;
+    for (const auto& book : worker.getBooks()) {
+        if (book) {
+            book_count++;
+            fills += book->getFillCount();
+            resting_orders += book->getRestingOrderCount();
+            memory += book->getMemoryStats();
+        }
+    }
+    logger.info("Shard ", hello.shard_index, ": ", received_orders, " orders, ", sent_reports, " records sent, ",
+                book_count, " books, ", fills, " fills, ", resting_orders, " resting orders");
+    logBookMemory(logger, memory);
+    logger.info("Shard matching (sampled) ", formatLatency(worker.getStats().matching.summarize()));
+    if (!ended || !sent) {
+        logger.critical("Shard ", hello.shard_index, ": ",
+                        error.empty() ? std::string("the connection to the front-end broke") : error);
+        return false;
+    }
+    return true;
+}
+
+bool parseShardList(const std::string& shard_list, std::vector<std::string>& endpoints) {
+    endpoints.clear();
+    std::stringstream shard_ss(shard_list);
+    std::string entry;
+    while (std::getline(shard_ss, entry, ',')) {
+        if (entry.empty()) {
+            continue;
+        }
+        if (entry.rfind("shm:", 0) != 0 && entry.rfind("tcp:", 0) != 0) {
+            return false;
+        }
+        endpoints.push_back(entry);
+    }
+    return !endpoints.empty();
+}
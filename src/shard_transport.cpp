@@ -0,0 +1,448 @@
+#include "shard_transport.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>   // For kill
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <new>       // For placement new
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "ring_buffer.hpp" // For kCacheLineSize
+
+// this file moves the bytes between a front-end and its shards: shared memory rings or a TCP connection
+
+namespace {
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "the rings in shared memory need lock-free atomics (they are shared by two processes)");
+
+constexpr uint64_t kShmMagic = 0x4448534D45474E45ULL; // "ENGEMSHD"
+constexpr uint32_t kShmVersion = 1;
+// state of a segment (0 while the shard fills it in)
+constexpr uint32_t kShmListening = 1;  // the shard waits for its front-end
+constexpr uint32_t kShmConnected = 2;  // the front-end has it mapped too
+
+// the error of the last system call, prefixed with what failed
+std::string systemError(const std::string& what) {
+    return what + ": " + std::strerror(errno);
+}
+
+// Waiting in a shared memory ring: spin a little, then give the cpu away, then sleep.
+// A process cannot wake up the other one, so a long wait polls (every 50 us): it adds at most that much
+// to an idle channel, and a busy channel never gets there
+class Backoff {
+public:
+    // false if the other process is gone (checked now and then while sleeping)
+    bool wait(int32_t peer_pid) {
+        rounds_++;
+        if (rounds_ < 128) {
+            return true; // spin
+        }
+        if (rounds_ < 1024) {
+            sched_yield();
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        if ((rounds_ & 1023) == 0 && peer_pid > 0 && kill(peer_pid, 0) != 0 && errno == ESRCH) {
+            return false;
+        }
+        return true;
+    }
+    void reset() { rounds_ = 0; }
+
+private:
+    uint64_t rounds_ = 0;
+};
+
+// indexes of one ring, in the segment (the bytes of the ring come after the header)
+struct ShmRingIndexes {
+    alignas(kCacheLineSize) std::atomic<uint64_t> head; // read position, written by the reader
+    alignas(kCacheLineSize) std::atomic<uint64_t> tail; // write position, written by the writer
+    std::atomic<uint32_t> closed;                       // the writer is done
+};
+
+struct ShmSegmentHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t ring_bytes;
+    std::atomic<uint32_t> state;
+    std::atomic<int32_t> shard_pid;
+    std::atomic<int32_t> front_end_pid;
+    ShmRingIndexes to_shard;
+    ShmRingIndexes to_front_end;
+};
+
+constexpr size_t kShmHeaderBytes = (sizeof(ShmSegmentHeader) + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize;
+constexpr size_t kShmSegmentBytes = kShmHeaderBytes + 2 * kShmChannelRingBytes;
+
+class ShmChannel : public ShardChannel {
+public:
+    // segment: mapped segment of kShmSegmentBytes, shard_side: which ring this side writes
+    ShmChannel(void* segment, bool shard_side, std::string name)
+        : segment_(segment), header_(static_cast<ShmSegmentHeader*>(segment)), name_(std::move(name)) {
+        char* rings = static_cast<char*>(segment) + kShmHeaderBytes;
+        char* to_shard = rings;
+        char* to_front_end = rings + kShmChannelRingBytes;
+        out_ = shard_side ? &header_->to_front_end : &header_->to_shard;
+        in_ = shard_side ? &header_->to_shard : &header_->to_front_end;
+        out_bytes_ = shard_side ? to_front_end : to_shard;
+        in_bytes_ = shard_side ? to_shard : to_front_end;
+        peer_pid_ = shard_side ? &header_->front_end_pid : &header_->shard_pid;
+    }
+
+    ~ShmChannel() override {
+        closeWrite();
+        munmap(segment_, kShmSegmentBytes);
+    }
+
+    bool write(const void* data, size_t size) override {
+        const char* bytes = static_cast<const char*>(data);
+        const uint64_t tail = out_->tail.load(std::memory_order_relaxed);
+        uint64_t written = 0;
+        Backoff backoff;
+        while (written < size) {
+            const uint64_t head = out_->head.load(std::memory_order_acquire);
+            const uint64_t free_bytes = kShmChannelRingBytes - (tail + written - head);
+            if (free_bytes == 0) {
+                if (!backoff.wait(peer_pid_->load(std::memory_order_relaxed))) {
+                    return false;
+                }
+                continue;
+            }
+            backoff.reset();
+            const uint64_t chunk = std::min<uint64_t>(free_bytes, size - written);
+            copyIn(out_bytes_, tail + written, bytes + written, chunk);
+            written += chunk;
+            out_->tail.store(tail + written, std::memory_order_release);
+        }
+        return true;
+    }
+
+    size_t read(void* data, size_t size) override {
+        const uint64_t head = in_->head.load(std::memory_order_relaxed);
+        Backoff backoff;
+        while (true) {
+            const uint64_t tail = in_->tail.load(std::memory_order_acquire);
+            if (tail != head) {
+                const uint64_t chunk = std::min<uint64_t>(tail - head, size);
+                copyOut(in_bytes_, head, static_cast<char*>(data), chunk);
+                in_->head.store(head + chunk, std::memory_order_release);
+                return static_cast<size_t>(chunk);
+            }
+            if (in_->closed.load(std::memory_order_acquire) != 0) {
+                // the last bytes were published before closed: one more look
+                if (in_->tail.load(std::memory_order_acquire) == head) {
+                    return 0;
+                }
+                continue;
+            }
+            if (!backoff.wait(peer_pid_->load(std::memory_order_relaxed))) {
+                return 0;
+            }
+        }
+    }
+
+    void closeWrite() override { out_->closed.store(1, std::memory_order_release); }
+
+    std::string describe() const override { return "shm:" + name_; }
+
+private:
+    // the ring is a power of two: a copy wraps around its end at most once
+    static void copyIn(char* ring, uint64_t position, const char* bytes, uint64_t size) {
+        const size_t offset = static_cast<size_t>(position & (kShmChannelRingBytes - 1));
+        const size_t first = std::min<size_t>(static_cast<size_t>(size), kShmChannelRingBytes - offset);
+        std::memcpy(ring + offset, bytes, first);
+        std::memcpy(ring, bytes + first, static_cast<size_t>(size) - first);
+    }
+    static void copyOut(const char* ring, uint64_t position, char* bytes, uint64_t size) {
+        const size_t offset = static_cast<size_t>(position & (kShmChannelRingBytes - 1));
+        const size_t first = std::min<size_t>(static_cast<size_t>(size), kShmChannelRingBytes - offset);
+        std::memcpy(bytes, ring + offset, first);
+        std::memcpy(bytes + first, ring, static_cast<size_t>(size) - first);
+    }
+
+    void* segment_;
+    ShmSegmentHeader* header_;
+    std::string name_;
+    ShmRingIndexes* out_;
+    ShmRingIndexes* in_;
+    char* out_bytes_;
+    const char* in_bytes_;
+    const std::atomic<int32_t>* peer_pid_;
+};
+static_assert((kShmChannelRingBytes & (kShmChannelRingBytes - 1)) == 0, "the shared memory rings are a power of two");
+
+class TcpChannel : public ShardChannel {
+public:
+    TcpChannel(int fd, std::string peer) : fd_(fd), peer_(std::move(peer)) {
+        const int enable = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        // room for the bursts of orders and reports
+        const int buffer_bytes = 4 << 20;
+        setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &buffer_bytes, sizeof(buffer_bytes));
+        setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &buffer_bytes, sizeof(buffer_bytes));
+    }
+    ~TcpChannel() override { ::close(fd_); }
+
+    bool write(const void* data, size_t size) override {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            const ssize_t sent = send(fd_, bytes, size, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            bytes += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    size_t read(void* data, size_t size) override {
+        while (true) {
+            const ssize_t received = recv(fd_, data, size, 0);
+            if (received >= 0) {
+                return static_cast<size_t>(received);
+            }
+            if (errno != EINTR) {
+                return 0;
+            }
+        }
+    }
+
+    void closeWrite() override { shutdown(fd_, SHUT_WR); }
+
+    std::string describe() const override { return "tcp:" + peer_; }
+
+private:
+    int fd_;
+    std::string peer_;
+};
+
+std::string addressToString(const sockaddr_in& address) {
+    char text[INET_ADDRSTRLEN] = {};
+    inet_ntop(AF_INET, &address.sin_addr, text, sizeof(text));
+    return std::string(text) + ":" + std::to_string(static_cast<unsigned>(ntohs(address.sin_port)));
+}
+
+// "NAME" of "shm:NAME": one component of a path, it becomes /NAME
+bool parseShmName(const std::string& name, std::string& error) {
+    if (name.empty() || name.size() > 200 || name.find('/') != std::string::npos) {
+        error = "invalid shared memory name '" + name + "' (expected shm:NAME, without '/')";
+        return false;
+    }
+    return true;
+}
+
+// "HOST:PORT" or just "PORT" (then host is left as it is)
+bool parseHostPort(const std::string& text, std::string& host, int& port, std::string& error) {
+    const size_t colon = text.rfind(':');
+    const std::string port_text = colon == std::string::npos ? text : text.substr(colon + 1);
+    if (colon != std::string::npos) {
+        host = text.substr(0, colon);
+    }
+    try {
+        size_t used = 0;
+        port = std::stoi(port_text, &used);
+        if (used == port_text.size() && port > 0 && port <= 65535 && !host.empty()) {
+            return true;
+        }
+    } catch (const std::exception&) {
+    }
+    error = "invalid TCP endpoint 'tcp:" + text + "' (expected tcp:HOST:PORT, or tcp:PORT to listen)";
+    return false;
+}
+
+std::unique_ptr<ShardChannel> acceptShm(const std::string& name, Logger& logger, std::string& error) {
+    const std::string path = "/" + name;
+    shm_unlink(path.c_str()); // a segment left by a shard that crashed
+    const int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        error = systemError("shm_open " + path);
+        return nullptr;
+    }
+    if (ftruncate(fd, static_cast<off_t>(kShmSegmentBytes)) != 0) {
+        error = systemError("ftruncate " + path);
+        ::close(fd);
+        shm_unlink(path.c_str());
+        return nullptr;
+    }
+    void* segment = mmap(nullptr, kShmSegmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (segment == MAP_FAILED) {
+        error = systemError("mmap " + path);
+        shm_unlink(path.c_str());
+        return nullptr;
+    }
+    // the segment is zero-filled: the atomics start at 0, the header is filled in before it is published
+    ShmSegmentHeader* header = new (segment) ShmSegmentHeader();
+    header->magic = kShmMagic;
+    header->version = kShmVersion;
+    header->ring_bytes = static_cast<uint32_t>(kShmChannelRingBytes);
+    header->shard_pid.store(static_cast<int32_t>(getpid()), std::memory_order_relaxed);
+    header->state.store(kShmListening, std::memory_order_release);
+    logger.info("Shard waiting for its front-end on shared memory ", path);
+
+    Backoff backoff;
+    while (header->state.load(std::memory_order_acquire) != kShmConnected) {
+        backoff.wait(0);
+    }
+    shm_unlink(path.c_str()); // both processes have it mapped, the name is not needed anymore
+    return std::make_unique<ShmChannel>(segment, true, name);
+}
+
+std::unique_ptr<ShardChannel> connectShm(const std::string& name, int timeout_ms, std::string& error) {
+    const std::string path = "/" + name;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true) {
+        // the shard may not have created it yet, or not sized it yet
+        const int fd = shm_open(path.c_str(), O_RDWR, 0600);
+        struct stat segment_stat{};
+        if (fd >= 0 && fstat(fd, &segment_stat) == 0 && static_cast<size_t>(segment_stat.st_size) == kShmSegmentBytes) {
+            void* segment = mmap(nullptr, kShmSegmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (segment == MAP_FAILED) {
+                error = systemError("mmap " + path);
+                return nullptr;
+            }
+            ShmSegmentHeader* header = static_cast<ShmSegmentHeader*>(segment);
+            uint32_t listening = kShmListening;
+            if (header->state.load(std::memory_order_acquire) == kShmListening &&
+                (header->magic != kShmMagic || header->version != kShmVersion ||
+                 header->ring_bytes != kShmChannelRingBytes)) {
+                error = path + " is not a shard segment of this version";
+                munmap(segment, kShmSegmentBytes);
+                return nullptr;
+            }
+            header->front_end_pid.store(static_cast<int32_t>(getpid()), std::memory_order_relaxed);
+            if (header->state.compare_exchange_strong(listening, kShmConnected, std::memory_order_acq_rel)) {
+                return std::make_unique<ShmChannel>(segment, false, name);
+            }
+            munmap(segment, kShmSegmentBytes); // not published yet, or taken by another front-end
+        } else if (fd >= 0) {
+            ::close(fd);
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            error = "no shard is waiting on shared memory " + path;
+            return nullptr;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+std::unique_ptr<ShardChannel> acceptTcp(const std::string& address_text, Logger& logger, std::string& error) {
+    std::string host = "0.0.0.0";
+    int port = 0;
+    if (!parseHostPort(address_text, host, port, error)) {
+        return nullptr;
+    }
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+        error = "invalid address '" + host + "'";
+        return nullptr;
+    }
+    const int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        error = systemError("TCP socket");
+        return nullptr;
+    }
+    const int enable = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    if (bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listen_fd, 1) != 0) {
+        error = systemError("listen on TCP " + addressToString(address));
+        ::close(listen_fd);
+        return nullptr;
+    }
+    logger.info("Shard waiting for its front-end on TCP ", addressToString(address));
+    sockaddr_in peer{};
+    socklen_t peer_length = sizeof(peer);
+    int fd;
+    do {
+        fd = accept4(listen_fd, reinterpret_cast<sockaddr*>(&peer), &peer_length, SOCK_CLOEXEC);
+    } while (fd < 0 && errno == EINTR);
+    ::close(listen_fd); // one front-end per shard
+    if (fd < 0) {
+        error = systemError("accept");
+        return nullptr;
+    }
+    return std::make_unique<TcpChannel>(fd, addressToString(peer));
+}
+
+std::unique_ptr<ShardChannel> connectTcp(const std::string& address_text, int timeout_ms, std::string& error) {
+    std::string host;
+    int port = 0;
+    if (!parseHostPort(address_text, host, port, error)) {
+        return nullptr;
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    const int lookup = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses);
+    if (lookup != 0) {
+        error = "cannot resolve '" + host + "': " + gai_strerror(lookup);
+        return nullptr;
+    }
+    sockaddr_in address{};
+    std::memcpy(&address, addresses->ai_addr, sizeof(address));
+    freeaddrinfo(addresses);
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true) {
+        const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            error = systemError("TCP socket");
+            return nullptr;
+        }
+        if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0) {
+            return std::make_unique<TcpChannel>(fd, addressToString(address));
+        }
+        error = systemError("connect to " + addressToString(address));
+        ::close(fd);
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return nullptr;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50)); // the shard is not listening yet
+    }
+}
+
+} // namespace
+
+std::unique_ptr<ShardChannel> acceptShardChannel(const std::string& endpoint, Logger& logger, std::string& error) {
+    if (endpoint.rfind("shm:", 0) == 0) {
+        const std::string name = endpoint.substr(4);
+        return parseShmName(name, error) ? acceptShm(name, logger, error) : nullptr;
+    }
+    if (endpoint.rfind("tcp:", 0) == 0) {
+        return acceptTcp(endpoint.substr(4), logger, error);
+    }
+    error = "invalid shard endpoint '" + endpoint + "' (expected shm:NAME or tcp:[ADDRESS:]PORT)";
+    return nullptr;
+}
+
+std::unique_ptr<ShardChannel> connectShardChannel(const std::string& endpoint, int timeout_ms, std::string& error) {
+    if (endpoint.rfind("shm:", 0) == 0) {
+        const std::string name = endpoint.substr(4);
+        return parseShmName(name, error) ? connectShm(name, timeout_ms, error) : nullptr;
+    }
+    if (endpoint.rfind("tcp:", 0) == 0) {
+        return connectTcp(endpoint.substr(4), timeout_ms, error);
+    }
+    error = "invalid shard endpoint '" + endpoint + "' (expected shm:NAME or tcp:HOST:PORT)";
+    return nullptr;
+}
@@ -0,0 +1,45 @@
+#include "symbol_table.hpp"
+#include <mutex>
+#include <stdexcept>
+
+// this class gives a small integer id to every instrument name
+
+uint32_t SymbolTable::intern(const std::string& name) {
+    {
+        // fast path: the name is already known (almost every order)
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        const uint32_t* known = ids_.find(name);
+        if (known != nullptr) {
+            return *known;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    // another thread may have added it between the two locks
+    const uint32_t* known = ids_.find(name);
+    if (known != nullptr) {
+        return *known;
+    }
+    uint32_t symbol_id = static_cast<uint32_t>(names_.size());
+    names_.push_back(name);
+    ids_.insert_or_assign(names_.back(), symbol_id); // the deque never moves the stored name
+    return symbol_id;
+}
+
+uint32_t SymbolTable::find(const std::string& name) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const uint32_t* known = ids_.find(name);
+    return (known == nullptr) ? kInvalidSymbol : *known;
+}
+
+const std::string& SymbolTable::name(uint32_t symbol_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (symbol_id >= names_.size()) {
+        throw std::out_of_range("SymbolTable: unknown symbol id " + std::to_string(symbol_id));
+    }
+    return names_[symbol_id];
+}
+
+size_t SymbolTable::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return names_.size();
+}
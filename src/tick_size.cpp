@@ -0,0 +1,53 @@
+#include "tick_size.hpp"
+#include <sstream>
+#include <stdexcept>
+
+// this class holds the tick size of every instrument, used to convert prices into integer ticks
+
+TickSizeTable::TickSizeTable(double default_tick_size)
+    : default_tick_size_(default_tick_size) {
+}
+
+void TickSizeTable::set_tick_size(const std::string& instrument, double tick_size) {
+    tick_sizes_[instrument] = tick_size;
+}
+
+// read a list of "INSTRUMENT=TICK" separated by commas
+bool TickSizeTable::parse_overrides(const std::string& overrides, Logger& logger) {
+    std::stringstream overrides_ss(overrides);
+    std::string entry;
+    while (std::getline(overrides_ss, entry, ',')) {
+        if (entry.empty()) {
+            continue;
+        }
+        size_t equal_pos = entry.find('=');
+        if (equal_pos == std::string::npos || equal_pos == 0 || equal_pos + 1 == entry.size()) {
+            logger.error("Invalid tick size override '", entry, "'. Expected INSTRUMENT=TICK_SIZE.");
+            return false;
+        }
+        std::string instrument = entry.substr(0, equal_pos);
+        double tick_size = 0.0;
+        try {
+            tick_size = std::stod(entry.substr(equal_pos + 1));
+        } catch (const std::exception& e) {
+            logger.error("Invalid tick size in override '", entry, "'. Details: ", e.what());
+            return false;
+        }
+        // a tick size of zero (or negative) would make every price conversion meaningless
+        if (!(tick_size > 0.0)) {
+            logger.error("Tick size must be positive in override '", entry, "'.");
+            return false;
+        }
+        set_tick_size(instrument, tick_size);
+    }
+    return true;
+}
+
+double TickSizeTable::tick_size_for(const std::string& instrument) const {
+    // most of the time there are no overrides at all, so we skip the hash of the instrument name
+    if (tick_sizes_.empty()) {
+        return default_tick_size_;
+    }
+    auto it = tick_sizes_.find(instrument);
+    return (it == tick_sizes_.end()) ? default_tick_size_ : it->second;
+}
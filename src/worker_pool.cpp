@@ -0,0 +1,360 @@
+#include "worker_pool.hpp"
+#include "output_merger.hpp"
+
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+
+// this class runs the order books: a fixed number of threads, each owning the books of many instruments
+
+BookWorker::BookWorker(size_t worker_index, const std::string& book_type, const SymbolTable& symbols,
+                       WaitStrategyType wait_strategy)
+    : worker_index_(worker_index), book_type_(book_type), symbols_(symbols),
+      output_log_queue_(std::make_shared<OutputQueue>(kOutputQueueCapacity, wait_strategy)),
+      inbound_(kInboundQueueCapacity, wait_strategy) {
+}
+
+bool BookWorker::start(int cpu) {
+    thread_ = std::thread([this]() { run(); });
+    // name the thread "match-N" so it can be found in top/perf/gdb
+    std::string thread_name = "match-" + std::to_string(worker_index_);
+    pthread_setname_np(thread_.native_handle(), thread_name.c_str());
+    if (cpu < 0) {
+        return true;
+    }
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(static_cast<size_t>(cpu), &cpu_set);
+    return pthread_setaffinity_np(thread_.native_handle(), sizeof(cpu_set), &cpu_set) == 0;
+}
+
+void BookWorker::stop() {
+    inbound_.close();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void BookWorker::run() {
+    Order batch[kProcessingBatchSize];
+    // pop_batch waits (with the wait strategy) for orders and returns 0 once the ring is closed and drained
+    size_t batch_size;
+    while ((batch_size = inbound_.pop_batch(batch, kProcessingBatchSize)) > 0) {
+        const uint64_t popped_ns = statsNowNs(); // one clock read per batch
+        for (size_t i = 0; i < batch_size; ++i) {
+            Order& order = batch[i];
+            if (order.dispatch_ns == 0) {
+                bookFor(order.symbol_id).processOrder(order);
+                continue;
+            }
+            // a sampled order: time its wait in the stage and the ring, and its matching
+            stats_.queueing.record(popped_ns > order.dispatch_ns ? popped_ns - order.dispatch_ns : 0);
+            const uint64_t matching_start_ns = statsNowNs();
+            bookFor(order.symbol_id).processOrder(order);
+            stats_.matching.record(statsNowNs() - matching_start_ns);
+        }
+        stats_.orders.add(batch_size);
+        stats_.batches.add();
+        completed_orders_.store(completed_orders_.load(std::memory_order_relaxed) + batch_size, std::memory_order_release);
+        // the output of this worker is now complete up to the last order of the batch
+        output_log_queue_->push(makeWatermark(batch[batch_size - 1].sequence));
+    }
+    output_log_queue_->close();
+}
+
+OrderBookBase& BookWorker::bookFor(uint32_t symbol_id) {
+    if (symbol_id >= books_.size()) {
+        books_.resize(static_cast<size_t>(symbol_id) + 1);
+    }
+    std::unique_ptr<OrderBookBase>& book = books_[symbol_id];
+    if (!book) {
+        // implementation chosen by --book-type
+        book = createOrderBook(book_type_, symbols_.name(symbol_id), symbol_id);
+        book->set_output_log_queue(output_log_queue_);
+        if (market_data_enabled_) {
+            book->enableMarketData(market_data_snapshot_interval_);
+        }
+        if (risk_config_) {
+            book->enableRiskChecks(risk_config_);
+        }
+    }
+    return *book;
+}
+
+WorkerPool::WorkerPool(size_t worker_count, const std::string& book_type, const SymbolTable& symbols,
+                       WaitStrategyType wait_strategy, const std::vector<int>& worker_cpus, Logger& logger)
+    : route_log_(kRouteLogCapacity, wait_strategy), worker_cpus_(worker_cpus), logger_(logger) {
+    if (worker_count == 0) {
+        worker_count = std::thread::hardware_concurrency();
+    }
+    if (worker_count == 0) {
+        worker_count = 1; // hardware_concurrency() may not know
+    }
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers_.push_back(std::make_unique<BookWorker>(i, book_type, symbols, wait_strategy));
+    }
+    stages_.resize(worker_count);
+}
+
+void WorkerPool::start() {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        int cpu = worker_cpus_.empty() ? -1 : worker_cpus_[i % worker_cpus_.size()];
+        if (!workers_[i]->start(cpu)) {
+            logger_.warn("Could not pin matching worker ", i, " to cpu ", cpu, ", it runs unpinned.");
+        } else if (cpu >= 0) {
+            logger_.debug("Matching worker ", i, " pinned to cpu ", cpu);
+        }
+    }
+}
+
+void WorkerPool::growRoutes(uint32_t symbol_id) {
+    size_t first_new = routes_.size();
+    routes_.resize(static_cast<size_t>(symbol_id) + 1);
+    for (size_t id = first_new; id < routes_.size(); ++id) {
+        routes_[id] = static_cast<uint32_t>(workerIndexFor(static_cast<uint32_t>(id)));
+    }
+}
+
+void WorkerPool::flushStage(size_t worker_index) {
+    Stage& stage = stages_[worker_index];
+    workers_[worker_index]->dispatch(stage.orders.data(), stage.size);
+    stage.dispatched += stage.size;
+    stage.size = 0;
+}
+
+void WorkerPool::flush() {
+    for (size_t i = 0; i < stages_.size(); ++i) {
+        if (stages_[i].size > 0) {
+            flushStage(i);
+        }
+    }
+    // the writer waits on the worker of a route it reads: the order must already be in that worker's ring
+    route_log_.push_batch(pending_routes_.data(), pending_routes_.size());
+    pending_routes_.clear();
+}
+
+void WorkerPool::waitUntilIdle() {
+    flush();
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        // rare (a snapshot), so a yield loop is enough
+        while (workers_[i]->getCompletedOrders() < stages_[i].dispatched) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void WorkerPool::stop() {
+    flush(); // nothing must stay in the stages
+    route_log_.close();
+    for (auto& worker : workers_) {
+        worker->stop();
+    }
+}
+
+size_t WorkerPool::getBookCount() const {
+    size_t book_count = 0;
+    for (const auto& worker : workers_) {
+        for (const auto& book : worker->getBooks()) {
+            if (book) {
+                book_count++;
+            }
+        }
+    }
+    return book_count;
+}
+
+unsigned long long WorkerPool::getProcessedOrders() const {
+    unsigned long long total = 0;
+    for (const auto& worker : workers_) {
+        for (const auto& book : worker->getBooks()) {
+            if (book) {
+                total += book->getProcessedOrders();
+            }
+        }
+    }
+    return total;
+}
+
+unsigned long long WorkerPool::getMatchingAllocations() const {
+    unsigned long long total = 0;
+    for (const auto& worker : workers_) {
+        for (const auto& book : worker->getBooks()) {
+            if (book) {
+                total += book->getMatchingAllocations();
+            }
+        }
+    }
+    return total;
+}
+
+unsigned long long WorkerPool::getOutputAllocations() const {
+    unsigned long long total = 0;
+    for (const auto& worker : workers_) {
+        for (const auto& book : worker->getBooks()) {
+            if (book) {
+                total += book->getOutputAllocations();
+            }
+        }
+    }
+    return total;
+}
+
+bool parseCpuList(const std::string& cpu_list, std::vector<int>& cpus) {
+    cpus.clear();
+    std::stringstream cpu_ss(cpu_list);
+    std::string entry;
+    while (std::getline(cpu_ss, entry, ',')) {
+        if (entry.empty()) {
+            continue;
+        }
+        try {
+            size_t parsed_chars = 0;
+            int cpu = std::stoi(entry, &parsed_chars);
+            if (parsed_chars != entry.size() || cpu < 0) {
+                return false;
+            }
+            cpus.push_back(cpu);
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace {
+
+// histograms of every worker added together
+void mergeWorkerHistograms(WorkerPool& worker_pool, LatencyHistogram& queueing, LatencyHistogram& matching) {
+    for (size_t i = 0; i < worker_pool.size(); ++i) {
+        queueing.merge(worker_pool.getWorker(i).getStats().queueing);
+        matching.merge(worker_pool.getWorker(i).getStats().matching);
+    }
+}
+
+} // namespace
+
+void logPipelineSnapshot(Logger& logger, const PipelineStats& stats, const OrderQueue& reader_queue,
+                         WorkerPool& worker_pool) {
+    // the histograms are big: the merged ones live on the heap, not on the stack of the dump thread
+    auto queueing = std::make_unique<LatencyHistogram>();
+    auto matching = std::make_unique<LatencyHistogram>();
+    mergeWorkerHistograms(worker_pool, *queueing, *matching);
+    uint64_t matched_orders = 0;
+    for (size_t i = 0; i < worker_pool.size(); ++i) {
+        matched_orders += worker_pool.getWorker(i).getStats().orders.get();
+    }
+    // (the logger puts a space between its arguments)
+    logger.info("[stats] parsed", stats.parse.count(), "dispatched", stats.dispatch.count(),
+                "matched", matched_orders, "reports written", stats.reports_written.get());
+    if (stats.output.writes.get() > 0) {
+        logger.info("[stats] output file", formatOutputIo(stats.output));
+    }
+    logger.info("[stats] reader queue", formatQueue(reader_queue) + ", route log", formatQueue(worker_pool.getRouteLog()));
+    for (size_t i = 0; i < worker_pool.size(); ++i) {
+        logger.info("[stats] worker", i, "inbound", formatQueue(worker_pool.getWorker(i).getInboundQueue()) + ", output",
+                    formatQueue(worker_pool.getOutputQueue(i)));
+    }
+    logger.info("[stats] queueing (sampled)", formatLatency(queueing->summarize()));
+    logger.info("[stats] matching (sampled)", formatLatency(matching->summarize()));
+}
+
+void logBookMemory(Logger& logger, const BookMemoryStats& memory) {
+    logger.info("Book memory:", formatBookMemory(memory));
+    if (pool_memory::hugePagesEnabled()) {
+        const pool_memory::Stats pools = pool_memory::stats();
+        constexpr size_t kMiB = 1 << 20;
+        logger.info("Huge pages:", pools.mapped_bytes / kMiB, "MiB mapped for the pools,", pools.hugetlb_bytes / kMiB,
+                    "MiB of them explicit huge pages (the rest is madvised for transparent huge pages)");
+    }
+}
+
+void logPipelineSummary(Logger& logger, const PipelineStats& stats, const OrderQueue& reader_queue,
+                        WorkerPool& worker_pool) {
+    auto queueing = std::make_unique<LatencyHistogram>();
+    auto matching = std::make_unique<LatencyHistogram>();
+    mergeWorkerHistograms(worker_pool, *queueing, *matching);
+
+    // each hop, in ns per order (per report for the formatting).
+    // busy = total time spent in the stage (not for the sampled hops, that only see some of the orders)
+    auto log_stage = [&](const char* name, const LatencyHistogram& histogram, bool sampled) {
+        logger.info(" ", name, formatLatency(histogram.summarize()),
+                    sampled ? std::string() : "busy_ms=" + std::to_string(histogram.sumNs() / 1000000));
+    };
+    logger.info("Pipeline latencies (ns, HDR buckets of ~3%; queueing and matching sampled on 1 order in",
+                std::to_string(kLatencySamplePeriod) + "):");
+    log_stage("parse     ", stats.parse, false);
+    log_stage("dispatch  ", stats.dispatch, false);
+    log_stage("queueing  ", *queueing, true);
+    log_stage("matching  ", *matching, true);
+    log_stage("formatting", stats.formatting, false);
+    if (stats.journal_commit.count() > 0) {
+        log_stage("journal   ", stats.journal_commit, false); // per group commit, not per order
+    }
+    if (stats.output.writes.get() > 0) {
+        logger.info("Output file:", formatOutputIo(stats.output));
+    }
+
+    logger.info("Pipeline queues (depth/capacity at the end):");
+    logger.info("  reader -> dispatcher", formatQueue(reader_queue));
+    logger.info("  route log           ", formatQueue(worker_pool.getRouteLog()));
+    for (size_t i = 0; i < worker_pool.size(); ++i) {
+        const BookWorker& worker = worker_pool.getWorker(i);
+        logger.info("  worker", i, "inbound", formatQueue(worker.getInboundQueue()) + ", output",
+                    formatQueue(worker_pool.getOutputQueue(i)) + ",", worker.getStats().orders.get(), "orders in",
+                    worker.getStats().batches.get(), "batches");
+    }
+
+    // per book counters (the books are only read here, after stop())
+    unsigned long long orders = 0, fills = 0, cancels = 0, rejects = 0;
+    size_t levels = 0, resting_orders = 0, book_count = 0;
+    BookMemoryStats memory;
+    for (size_t i = 0; i < worker_pool.size(); ++i) {
+        for (const auto& book : worker_pool.getWorker(i).getBooks()) {
+            if (!book) {
+                continue;
+            }
+            book_count++;
+            orders += book->getProcessedOrders();
+            fills += book->getFillCount();
+            cancels += book->getCancelCount();
+            rejects += book->getRejectCount();
+            levels += book->getLevelCount();
+            resting_orders += book->getRestingOrderCount();
+            const BookMemoryStats book_memory = book->getMemoryStats();
+            memory += book_memory;
+            logger.debug("  book", book->getInstrumentName() + ": orders", book->getProcessedOrders(),
+                         "fills", book->getFillCount(), "cancels", book->getCancelCount(),
+                         "rejects", book->getRejectCount(), "levels", book->getLevelCount(),
+                         "resting", book->getRestingOrderCount(), "memory", formatBookMemory(book_memory));
+        }
+    }
+    logger.info("Books:", book_count, "books, orders", orders, "fills", fills, "cancels", cancels,
+                "rejects", rejects, "levels", levels, "resting orders", resting_orders,
+                "(one line per book at debug level)");
+    logBookMemory(logger, memory);
+
+    // pre-trade checks: the rejects of every check, and the trades stopped by the self-trade prevention
+    if (worker_pool.isRiskEnabled()) {
+        unsigned long long check_rejects[static_cast<size_t>(RiskCheck::COUNT)] = {};
+        unsigned long long self_trades = 0;
+        for (size_t i = 0; i < worker_pool.size(); ++i) {
+            for (const auto& book : worker_pool.getWorker(i).getBooks()) {
+                if (!book) {
+                    continue;
+                }
+                for (size_t check = 1; check < static_cast<size_t>(RiskCheck::COUNT); ++check) {
+                    check_rejects[check] += book->getRiskRejectCount(static_cast<RiskCheck>(check));
+                }
+                self_trades += book->getSelfTradeCount();
+            }
+        }
+        std::string rejects_by_check;
+        for (size_t check = 1; check < static_cast<size_t>(RiskCheck::COUNT); ++check) {
+            rejects_by_check += (check == 1 ? "" : ", ") + std::string(riskCheckToString(static_cast<RiskCheck>(check))) +
+                                " " + std::to_string(check_rejects[check]);
+        }
+        logger.info("Risk checks: rejects by check (", rejects_by_check, "), self-trades prevented", self_trades);
+    }
+}